@@ -0,0 +1,105 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#ifndef OSGEARTH_APPLICATIONS_BENCH_UTILS_H
+#define OSGEARTH_APPLICATIONS_BENCH_UTILS_H 1
+
+// Helpers shared by the osgearth_*bench applications: summary statistics
+// and, optionally, a count of heap allocations.
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+namespace BenchUtils
+{
+    struct Summary
+    {
+        double mean, p50, p95, max;
+    };
+
+    inline Summary summarize(std::vector<double> values)
+    {
+        Summary s = { 0.0, 0.0, 0.0, 0.0 };
+        if (values.empty())
+            return s;
+
+        std::sort(values.begin(), values.end());
+        for (double v : values)
+            s.mean += v;
+        s.mean /= (double)values.size();
+        s.p50 = values[values.size() / 2];
+        s.p95 = values[std::min(values.size() - 1, (values.size() * 95) / 100)];
+        s.max = values.back();
+        return s;
+    }
+
+    inline void print(const char* name, const Summary& s, const char* units)
+    {
+        std::cout << "  " << name
+            << ": mean " << s.mean << units
+            << ", p50 " << s.p50 << units
+            << ", p95 " << s.p95 << units
+            << ", max " << s.max << units
+            << std::endl;
+    }
+
+    //! Number of heap allocations the calling thread has made. Only counts
+    //! in a program that defines OE_BENCH_COUNT_ALLOCATIONS before it
+    //! includes this header (in one source file).
+    inline unsigned long long& allocations()
+    {
+        static thread_local unsigned long long count = 0u;
+        return count;
+    }
+}
+
+#ifdef OE_BENCH_COUNT_ALLOCATIONS
+
+void* operator new(std::size_t size)
+{
+    ++BenchUtils::allocations();
+    if (void* ptr = std::malloc(size > 0 ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    ++BenchUtils::allocations();
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+#endif // OE_BENCH_COUNT_ALLOCATIONS
+
+#endif // OSGEARTH_APPLICATIONS_BENCH_UTILS_H
@@ -59,13 +59,16 @@ int usage(char** argv)
         << "\n    --extents [minLat] [minLong] [maxLat] [maxLong] : Lat/Long extends to copy"
         << "\n    --no-overwrite                      : skip tiles that already exist in the destination"
         << "\n    --threads [int]                     : go faster by using [n] working threads"
+        << "\n    --pipeline                          : read, encode and write tiles on separate threads"
+        << "\n    --write-threads [int]               : with --pipeline, number of writing threads (default = 1)"
+        << "\n    --checkpoint [file]                 : with --pipeline, record progress in [file] and resume from it"
         << std::endl;
 
     return 0;
 }
 
 // Visitor that converts image tiles
-struct ImageLayerTileCopy : public TileHandler
+struct ImageLayerTileCopy : public StagedTileHandler
 {
     ImageLayerTileCopy(ImageLayer* source, ImageLayer* dest, bool overwrite, bool compress)
         : _source(source), _dest(dest), _overwrite(overwrite), _compress(compress)
@@ -73,36 +76,58 @@ struct ImageLayerTileCopy : public TileHandler
         //nop
     }
 
-    bool handleTile(const TileKey& key, const TileVisitor& tv)
+    bool readTile(const TileKey& key, osg::ref_ptr<osg::Referenced>& data)
     {
-        bool ok = false;
-
         // if overwriting is disabled, check to see whether the destination
         // already has data for the key
         if (_overwrite == false)
         {
             if (_dest->createImage(key).valid())
             {
-                return true;
+                return false;
             }
         }
 
         GeoImage image = _source->createImage(key);
         if (image.valid())
         {
-            osg::ref_ptr<const osg::Image> imageToWrite = image.getImage();
-            if (_compress)
-                imageToWrite = ImageUtils::compressImage(image.getImage(), "cpu");
+            data = image.takeImage();
+            return true;
+        }
+        return false;
+    }
 
-            Status status = _dest->writeImage(key, imageToWrite.get(), 0L);
-            ok = status.isOK();
-            if (!ok)
-            {
-                OE_WARN << key.str() << ": " << status.message() << std::endl;
-            }
+    bool encodeTile(const TileKey& key, osg::ref_ptr<osg::Referenced>& data)
+    {
+        if (_compress)
+        {
+            // compressImage returns a new image, so it's ours to modify
+            data = const_cast<osg::Image*>(ImageUtils::compressImage(
+                static_cast<osg::Image*>(data.get()), "cpu"));
+        }
+        return data.valid();
+    }
+
+    bool writeTile(const TileKey& key, osg::ref_ptr<osg::Referenced>& data)
+    {
+        Status status = _dest->writeImage(key, static_cast<osg::Image*>(data.get()), 0L);
+        if (status.isError())
+        {
+            OE_WARN << key.str() << ": " << status.message() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool handleTile(const TileKey& key, const TileVisitor& tv)
+    {
+        // a tile that already exists counts as done
+        if (_overwrite == false && _dest->createImage(key).valid())
+        {
+            return true;
         }
 
-        return ok;
+        return StagedTileHandler::handleTile(key, tv);
     }
 
     bool hasData(const TileKey& key) const
@@ -117,7 +142,7 @@ struct ImageLayerTileCopy : public TileHandler
 };
 
 // Visitor that converts elevation tiles
-struct ElevationLayerTileCopy : public TileHandler
+struct ElevationLayerTileCopy : public StagedTileHandler
 {
     ElevationLayerTileCopy(ElevationLayer* source, ElevationLayer* dest, bool overwrite)
         : _source(source), _dest(dest), _overwrite(overwrite)
@@ -125,35 +150,48 @@ struct ElevationLayerTileCopy : public TileHandler
         //nop
     }
 
-    bool handleTile(const TileKey& key, const TileVisitor& tv)
+    bool readTile(const TileKey& key, osg::ref_ptr<osg::Referenced>& data)
     {
-        bool ok = false;
-
         // if overwriting is disabled, check to see whether the destination
         // already has data for the key
         if (_overwrite == false)
         {
             if (_dest->createHeightField(key).valid())
             {
-                return true;
+                return false;
             }
         }
 
         GeoHeightField hf = _source->createHeightField(key, 0L);
         if ( hf.valid() )
         {
-            Status s = _dest->writeHeightField(key, hf.getHeightField(), 0L);
-            ok = s.isOK();
-            if (!ok)
-            {
-                OE_WARN << key.str() << ": " << s.message() << std::endl;
-            }
+            // only the write stage looks at it, and it doesn't modify it
+            data = const_cast<osg::HeightField*>(hf.getHeightField());
+            return true;
         }
-        else
+        return false;
+    }
+
+    bool writeTile(const TileKey& key, osg::ref_ptr<osg::Referenced>& data)
+    {
+        Status s = _dest->writeHeightField(key, static_cast<osg::HeightField*>(data.get()), 0L);
+        if (s.isError())
+        {
+            OE_WARN << key.str() << ": " << s.message() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool handleTile(const TileKey& key, const TileVisitor& tv)
+    {
+        // a tile that already exists counts as done
+        if (_overwrite == false && _dest->createHeightField(key).valid())
         {
-            //OE_WARN << key.str() << " : " << hf.getStatus().message() << std::endl;
+            return true;
         }
-        return ok;
+
+        return StagedTileHandler::handleTile(key, tv);
     }
 
     bool hasData(const TileKey& key) const
@@ -255,6 +293,9 @@ struct ProgressReporter : public osgEarth::ProgressCallback
  *      --extents [minLat] [minLong] [maxLat] [maxLong] : Lat/Long extends to copy (*)
  *      --no-overwrite        : don't overwrite data that already exists
  *      --threads [int]       : number of threads to launch
+ *      --pipeline            : read, encode and write on separate threads
+ *      --write-threads [int] : with --pipeline, number of writing threads
+ *      --checkpoint [file]   : with --pipeline, save progress to resume later
  *
  * OSG arguments:
  *
@@ -439,7 +480,28 @@ main(int argc, char** argv)
     osg::ref_ptr<TileVisitor> visitor;
 
     unsigned numThreads = 1;
-    if (args.read("--threads", numThreads))
+    osg::ref_ptr<PipelinedTileVisitor> pipeline;
+    if (args.read("--pipeline"))
+    {
+        pipeline = new PipelinedTileVisitor();
+        if (args.read("--threads", numThreads))
+        {
+            pipeline->setNumThreads(PipelinedTileVisitor::STAGE_READ, numThreads);
+            pipeline->setNumThreads(PipelinedTileVisitor::STAGE_ENCODE, numThreads);
+        }
+        unsigned writeThreads;
+        if (args.read("--write-threads", writeThreads))
+        {
+            pipeline->setNumThreads(PipelinedTileVisitor::STAGE_WRITE, writeThreads);
+        }
+        std::string checkpoint;
+        if (args.read("--checkpoint", checkpoint))
+        {
+            pipeline->setCheckpointFile(checkpoint);
+        }
+        visitor = pipeline.get();
+    }
+    else if (args.read("--threads", numThreads))
     {
         MultithreadedTileVisitor* mtv = new MultithreadedTileVisitor();
         mtv->setNumThreads( numThreads < 1 ? 1 : numThreads );
@@ -556,6 +618,10 @@ main(int argc, char** argv)
 
     visitor->run( outputProfile.get() );
 
+    // flush any writes the output layer is still holding (e.g. an
+    // uncommitted MBTiles transaction)
+    output->close();
+
     osg::Timer_t t1 = osg::Timer::instance()->tick();
 
     std::cout
@@ -566,5 +632,10 @@ main(int argc, char** argv)
         << osg::Timer::instance()->delta_s(t0, t1)
         << " seconds." << std::endl;
 
+    if (pipeline.valid())
+    {
+        std::cout << pipeline->getThroughputReport() << std::flush;
+    }
+
     return 0;
 }
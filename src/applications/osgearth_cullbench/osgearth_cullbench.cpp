@@ -0,0 +1,346 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+// Measures the CPU cost of the terrain engine's update and cull traversals
+// without a window or GL context. Flies a synthetic camera path over a
+// procedural map and reports per-stage timings, tile counts, and heap
+// allocations per frame. With --max-cull-ms it exits with an error when
+// the terrain cull is too slow, for use in a regression script.
+
+#include <osgUtil/SceneView>
+#include <osgUtil/UpdateVisitor>
+#include <osg/FrameStamp>
+#include <osg/Stats>
+#include <osg/Timer>
+#include <osgEarth/Notify>
+#include <osgEarth/MapNode>
+#include <osgEarth/FractalElevationLayer>
+#include <osgEarth/DebugImageLayer>
+#include <osgEarth/GeoData>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Count heap allocations made by the calling thread, so that the numbers
+// reflect the update and cull traversals and not the loader threads.
+#define OE_BENCH_COUNT_ALLOCATIONS
+#include "../BenchUtils.h"
+
+#define LC "[cullbench] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+using namespace BenchUtils;
+
+int
+usage(const char* name)
+{
+    OE_NOTICE
+        << "\nUsage: " << name << " [options]" << std::endl
+        << "\n    --frames n                   : number of frames along the camera path (default 600)"
+        << "\n    --size w h                   : viewport size (default 1920 1080)"
+        << "\n    --tile-size n                : terrain tile size (default from the terrain options)"
+        << "\n    --no-settle                  : don't wait for the terrain to load before timing each frame"
+        << "\n    --timeout s                  : seconds to wait for the terrain to load, per frame (default 30)"
+        << "\n    --csv file                   : write the per-frame measurements to a CSV file"
+        << "\n    --max-cull-ms ms             : exit with an error if the mean terrain cull time exceeds this"
+        << std::endl;
+
+    return 0;
+}
+
+namespace
+{
+    // Number of idle frames in a row before we consider the terrain loaded;
+    // child tiles are created a frame before they start loading.
+    const int SETTLED_FRAMES = 2;
+
+    struct Sample
+    {
+        double update = 0.0;       // whole update traversal (ms)
+        double cull = 0.0;         // whole cull traversal (ms)
+        double terrainCull = 0.0;  // terrain culler pass (ms)
+        double terrainSort = 0.0;  // draw command sort (ms)
+        double registry = 0.0;     // live tile registry update (ms)
+        double tilesLive = 0.0;
+        double drawCommands = 0.0;
+        double tilesLoading = 0.0;
+        unsigned long long updateAllocations = 0u;
+        unsigned long long cullAllocations = 0u;
+    };
+
+    template<typename T>
+    Summary summarize(const std::vector<Sample>& samples, T Sample::*member)
+    {
+        std::vector<double> values;
+        values.reserve(samples.size());
+        for (auto& sample : samples)
+            values.push_back((double)(sample.*member));
+        return BenchUtils::summarize(values);
+    }
+
+    // A descending pass across the globe: starts high above the map and
+    // ends near the ground, looking ahead along the direction of travel.
+    osg::Matrixd getViewMatrix(const SpatialReference* srs, double t)
+    {
+        const SpatialReference* geo = srs->getGeographicSRS();
+
+        double altitude = 2.0e6 * pow(0.001, t); // 2000 km down to 2 km
+        double lon = -120.0 + 60.0 * t;
+        double lat = 20.0 + 25.0 * t;
+
+        // look at a point ahead of the camera, closer as we descend
+        double ahead = osg::clampBetween(altitude / 100000.0, 0.01, 10.0);
+
+        osg::Vec3d eye, target, up;
+        GeoPoint(geo, lon, lat, altitude, ALTMODE_ABSOLUTE).toWorld(eye);
+        GeoPoint(geo, lon + ahead, lat + ahead * 0.4, 0.0, ALTMODE_ABSOLUTE).toWorld(target);
+        GeoPoint(geo, lon, lat, altitude, ALTMODE_ABSOLUTE).createWorldUpVector(up);
+
+        return osg::Matrixd::lookAt(eye, target, up);
+    }
+
+    double getStat(osg::Camera* camera, unsigned frame, const std::string& name)
+    {
+        double value = 0.0;
+        camera->getStats()->getAttribute(frame, name, value);
+        return value;
+    }
+
+    class Bench
+    {
+    public:
+        Bench(osg::Node* root, osg::Camera* camera) :
+            _root(root),
+            _camera(camera),
+            _frame(0u)
+        {
+            _frameStamp = new osg::FrameStamp();
+
+            _updateVisitor = new osgUtil::UpdateVisitor();
+            _updateVisitor->setFrameStamp(_frameStamp.get());
+
+            _sceneView = new osgUtil::SceneView();
+            _sceneView->setDefaults(osgUtil::SceneView::NO_SCENEVIEW_LIGHT);
+            _sceneView->setCamera(_camera.get(), false);
+            _sceneView->setSceneData(_root.get());
+            _sceneView->setFrameStamp(_frameStamp.get());
+
+            _start = osg::Timer::instance()->tick();
+        }
+
+        // One update and cull traversal, as a viewer would run them
+        Sample frame()
+        {
+            const osg::Timer* timer = osg::Timer::instance();
+
+            ++_frame;
+            _frameStamp->setFrameNumber(_frame);
+            _frameStamp->setReferenceTime(timer->delta_s(_start, timer->tick()));
+            _frameStamp->setSimulationTime(_frameStamp->getReferenceTime());
+
+            Sample sample;
+
+            unsigned long long a0 = allocations();
+            osg::Timer_t t0 = timer->tick();
+
+            _updateVisitor->reset();
+            _updateVisitor->setTraversalNumber(_frame);
+            _root->accept(*_updateVisitor);
+
+            osg::Timer_t t1 = timer->tick();
+            sample.updateAllocations = allocations() - a0;
+            a0 = allocations();
+
+            _sceneView->cull();
+
+            osg::Timer_t t2 = timer->tick();
+            sample.cullAllocations = allocations() - a0;
+
+            sample.update = timer->delta_m(t0, t1);
+            sample.cull = timer->delta_m(t1, t2);
+            sample.terrainCull = 1000.0 * getStat(_camera.get(), _frame, "Terrain cull time taken");
+            sample.terrainSort = 1000.0 * getStat(_camera.get(), _frame, "Terrain sort time taken");
+            sample.registry = 1000.0 * getStat(_camera.get(), _frame, "Terrain update time taken");
+            sample.tilesLive = getStat(_camera.get(), _frame, "Terrain tiles live");
+            sample.drawCommands = getStat(_camera.get(), _frame, "Terrain draw commands");
+            sample.tilesLoading = getStat(_camera.get(), _frame, "Terrain tiles loading");
+            return sample;
+        }
+
+        // Runs frames until no visible tile is waiting on data.
+        // Returns false on timeout.
+        bool settle(double timeout)
+        {
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            int quietFrames = 0;
+            while (osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) < timeout)
+            {
+                quietFrames = frame().tilesLoading == 0.0 ? quietFrames + 1 : 0;
+                if (quietFrames >= SETTLED_FRAMES)
+                    return true;
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return false;
+        }
+
+    private:
+        osg::ref_ptr<osg::Node> _root;
+        osg::ref_ptr<osg::Camera> _camera;
+        osg::ref_ptr<osg::FrameStamp> _frameStamp;
+        osg::ref_ptr<osgUtil::UpdateVisitor> _updateVisitor;
+        osg::ref_ptr<osgUtil::SceneView> _sceneView;
+        osg::Timer_t _start;
+        unsigned _frame;
+    };
+}
+
+int
+main(int argc, char** argv)
+{
+    osgEarth::initialize();
+
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if (arguments.read("--help"))
+        return usage(argv[0]);
+
+    int frames = 600;
+    arguments.read("--frames", frames);
+
+    int width = 1920, height = 1080;
+    arguments.read("--size", width, height);
+
+    unsigned tileSize = 0u;
+    arguments.read("--tile-size", tileSize);
+
+    bool settle = !arguments.read("--no-settle");
+
+    double timeout = 30.0;
+    arguments.read("--timeout", timeout);
+
+    std::string csvFile;
+    arguments.read("--csv", csvFile);
+
+    double maxCullMs = -1.0;
+    arguments.read("--max-cull-ms", maxCullMs);
+
+    // Procedural map, so the results don't depend on the network or disk
+    osg::ref_ptr<Map> map = new Map();
+
+    FractalElevationLayer* elevation = new FractalElevationLayer();
+    elevation->setName("Fractal elevation");
+    map->addLayer(elevation);
+
+    DebugImageLayer* imagery = new DebugImageLayer();
+    imagery->setName("Debug imagery");
+    map->addLayer(imagery);
+
+    osg::ref_ptr<MapNode> mapNode = new MapNode(map.get());
+    if (tileSize > 0u)
+        mapNode->getTerrainOptions().setTileSize(tileSize);
+
+    if (!mapNode->open())
+    {
+        OE_WARN << LC << "Failed to open the map" << std::endl;
+        return -1;
+    }
+
+    osg::ref_ptr<osg::Camera> camera = new osg::Camera();
+    camera->setViewport(0, 0, width, height);
+    camera->setProjectionMatrixAsPerspective(30.0, (double)width / (double)height, 1.0, 1.0e7);
+    camera->setSmallFeatureCullingPixelSize(-1.0f);
+    camera->setStats(new osg::Stats("Camera"));
+    camera->getStats()->collectStats("terrain", true);
+
+    Bench bench(mapNode.get(), camera.get());
+    const SpatialReference* srs = map->getSRS();
+
+    std::vector<Sample> samples;
+    samples.reserve(frames);
+    int timeouts = 0;
+
+    for (int i = 0; i < frames; ++i)
+    {
+        double t = frames > 1 ? (double)i / (double)(frames - 1) : 0.0;
+        camera->setViewMatrix(getViewMatrix(srs, t));
+
+        // Time a frame over a fully loaded terrain, so the tile counts
+        // (and therefore the timings) are repeatable
+        if (settle && !bench.settle(timeout))
+            ++timeouts;
+
+        samples.push_back(bench.frame());
+    }
+
+    if (!csvFile.empty())
+    {
+        std::ofstream out(csvFile.c_str());
+        out << "frame,update_ms,cull_ms,terrain_cull_ms,terrain_sort_ms,registry_update_ms,"
+            << "tiles_live,draw_commands,tiles_loading,update_allocations,cull_allocations" << std::endl;
+        for (unsigned i = 0; i < samples.size(); ++i)
+        {
+            const Sample& s = samples[i];
+            out << i << ',' << s.update << ',' << s.cull << ',' << s.terrainCull << ','
+                << s.terrainSort << ',' << s.registry << ',' << s.tilesLive << ','
+                << s.drawCommands << ',' << s.tilesLoading << ','
+                << s.updateAllocations << ',' << s.cullAllocations << std::endl;
+        }
+    }
+
+    Summary terrainCull = summarize(samples, &Sample::terrainCull);
+
+    std::cout
+        << "Frames: " << samples.size()
+        << " (" << width << "x" << height << ", "
+        << (settle ? "settled" : "unsettled") << ")" << std::endl
+        << "Times:" << std::endl;
+    print("update traversal", summarize(samples, &Sample::update), " ms");
+    print("  tile registry update", summarize(samples, &Sample::registry), " ms");
+    print("cull traversal", summarize(samples, &Sample::cull), " ms");
+    print("  terrain culler", terrainCull, " ms");
+    print("  draw command sort", summarize(samples, &Sample::terrainSort), " ms");
+    std::cout << "Counts:" << std::endl;
+    print("tiles live", summarize(samples, &Sample::tilesLive), "");
+    print("draw commands", summarize(samples, &Sample::drawCommands), "");
+    std::cout << "Allocations per frame:" << std::endl;
+    print("update", summarize(samples, &Sample::updateAllocations), "");
+    print("cull", summarize(samples, &Sample::cullAllocations), "");
+
+    if (timeouts > 0)
+    {
+        OE_WARN << LC << timeouts << " frames timed out waiting for the terrain to load" << std::endl;
+    }
+
+    if (maxCullMs >= 0.0 && terrainCull.mean > maxCullMs)
+    {
+        OE_WARN << LC << "Mean terrain cull time " << terrainCull.mean
+            << " ms exceeds the limit of " << maxCullMs << " ms" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
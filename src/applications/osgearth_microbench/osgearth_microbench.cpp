@@ -0,0 +1,947 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+// Micro-benchmarks for osgEarth internals. Each one times a code path
+// against its alternative (or the code it replaced) on synthetic data and
+// prints the results. Run with no arguments to list them.
+
+#include <osgEarth/Threading>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Elevation>
+#include <osgEarth/Tessellator>
+#include <osgEarth/VirtualProgram>
+#include <osgEarth/PackedRTree>
+#include <osgEarth/rtree.h>
+#include <osgEarth/SDF>
+#include <osgEarth/ImageReprojector>
+#include <osgEarth/GDAL>
+#include <osgEarth/FeatureBatch>
+#include <osgEarth/AttributesFilter>
+#include <osgEarth/MBTiles>
+#include <osgEarth/ScreenSpaceLayoutImpl>
+#include <osgEarth/Notify>
+#include <osg/ArgumentParser>
+#include <osg/Group>
+#include <osg/State>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define LC "[microbench] "
+
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT 0x140B
+#endif
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+using namespace osgEarth::Internal;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double seconds(const Clock::time_point& t0, const Clock::time_point& t1)
+    {
+        return std::chrono::duration<double>(t1 - t0).count();
+    }
+
+    double ms(const Clock::time_point& t0, const Clock::time_point& t1)
+    {
+        return std::chrono::duration<double, std::milli>(t1 - t0).count();
+    }
+
+    double us(const Clock::time_point& t0, const Clock::time_point& t1)
+    {
+        return std::chrono::duration<double, std::micro>(t1 - t0).count();
+    }
+
+    // Keeps the compiler from discarding results we only compute to time them
+    volatile float sink = 0.0f;
+
+    //...................................................................
+
+    struct SchedulerResult
+    {
+        double jobsPerSecond;
+        double p99LatencyUS;
+    };
+
+    // Dispatches "count" trivial jobs into an arena and records how long
+    // each one waited between dispatch and execution.
+    SchedulerResult runScheduler(JobArena::Scheduler scheduler, unsigned threads, unsigned count)
+    {
+        JobArena arena("oe.microbench.scheduler", threads, JobArena::THREAD_POOL, scheduler);
+
+        std::vector<std::int64_t> latency(count);
+        JobGroup group;
+        Job job(&arena, &group);
+
+        auto t0 = Clock::now();
+        for (unsigned i = 0; i < count; ++i)
+        {
+            job.setPriority((float)(i % 24));
+            auto dispatched = Clock::now();
+            job.dispatch([&latency, i, dispatched](Cancelable*) {
+                latency[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - dispatched).count();
+            });
+        }
+        group.join();
+        auto elapsed = std::chrono::duration<double>(Clock::now() - t0).count();
+
+        std::sort(latency.begin(), latency.end());
+        SchedulerResult r;
+        r.jobsPerSecond = (double)count / elapsed;
+        r.p99LatencyUS = 0.001 * (double)latency[(count * 99) / 100];
+        return r;
+    }
+
+    void scheduler(osg::ArgumentParser& arguments)
+    {
+        // The priority scheduler sorts its whole queue on every pop, so keep
+        // the job count modest or the baseline will take minutes.
+        unsigned count = 20000;
+        arguments.read("--jobs", count);
+
+        for (unsigned threads : { 4u, 16u })
+        {
+            SchedulerResult pq = runScheduler(JobArena::SCHEDULER_PRIORITY, threads, count);
+            SchedulerResult ws = runScheduler(JobArena::SCHEDULER_WORK_STEALING, threads, count);
+
+            std::cout
+                << "threads=" << threads << " jobs=" << count << std::endl
+                << "  priority:      " << (int)pq.jobsPerSecond << " jobs/s, p99 dispatch latency " << pq.p99LatencyUS << " us" << std::endl
+                << "  work-stealing: " << (int)ws.jobsPerSecond << " jobs/s, p99 dispatch latency " << ws.p99LatencyUS << " us" << std::endl;
+        }
+    }
+
+    //...................................................................
+
+    osg::Image* makeGradient(int size, GLenum format, GLenum type)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(size, size, 1, format, type);
+        ImageUtils::PixelWriter write(image);
+        for (int t = 0; t < size; ++t)
+            for (int s = 0; s < size; ++s)
+                write(osg::Vec4f((float)s / (float)size, (float)t / (float)size, 0.5f, 1.0f), s, t);
+        return image;
+    }
+
+    // megapixels per second reading every pixel of an image "passes" times
+    double readPerPixel(const osg::Image* image, int passes)
+    {
+        ImageUtils::PixelReader read(image);
+        osg::Vec4f value, sum;
+        auto t0 = Clock::now();
+        for (int p = 0; p < passes; ++p)
+            for (int t = 0; t < image->t(); ++t)
+                for (int s = 0; s < image->s(); ++s)
+                    read(value, s, t), sum += value;
+        double secs = seconds(t0, Clock::now());
+        sink = sink + sum.length();
+        return 1e-6 * passes * image->s() * image->t() / secs;
+    }
+
+    double readPerRow(const osg::Image* image, int passes)
+    {
+        ImageUtils::PixelReader read(image);
+        std::vector<osg::Vec4f> row(image->s());
+        osg::Vec4f sum;
+        auto t0 = Clock::now();
+        for (int p = 0; p < passes; ++p)
+            for (int t = 0; t < image->t(); ++t)
+            {
+                read.readRow(row.data(), 0, t, image->s());
+                for (auto& value : row)
+                    sum += value;
+            }
+        double secs = seconds(t0, Clock::now());
+        sink = sink + sum.length();
+        return 1e-6 * passes * image->s() * image->t() / secs;
+    }
+
+    void pixels(osg::ArgumentParser& arguments)
+    {
+        int size = 1024, passes = 10;
+        arguments.read("--size", size);
+        arguments.read("--passes", passes);
+
+        GLenum formats[3][2] = {
+            { GL_RGBA, GL_UNSIGNED_BYTE },
+            { GL_RED, GL_FLOAT },
+            { GL_RG, GL_HALF_FLOAT } };
+        const char* names[3] = { "RGBA8", "R32F", "RG16F" };
+
+        for (int i = 0; i < 3; ++i)
+        {
+            osg::ref_ptr<osg::Image> image = makeGradient(size, formats[i][0], formats[i][1]);
+            std::cout << names[i] << " read: "
+                << readPerPixel(image.get(), passes) << " MP/s per-pixel, "
+                << readPerRow(image.get(), passes) << " MP/s per-row" << std::endl;
+        }
+
+        osg::ref_ptr<osg::Image> image = makeGradient(size, GL_RGBA, GL_UNSIGNED_BYTE);
+        auto t0 = Clock::now();
+        for (int p = 0; p < passes; ++p)
+        {
+            osg::ref_ptr<osg::Image> output;
+            ImageUtils::resizeImage(image.get(), size / 2, size / 2, output, 0, true);
+        }
+        double secs = seconds(t0, Clock::now());
+        std::cout << "RGBA8 resizeImage (bilinear): " << 1e-6 * passes * (size / 2) * (size / 2) / secs << " MP/s" << std::endl;
+    }
+
+    //...................................................................
+
+    unsigned char tileValue(const TileKey& key)
+    {
+        return (unsigned char)((key.getLOD()*31 + key.getTileX()*7 + key.getTileY()) % 251);
+    }
+
+    std::vector<TileKey> getKeys(const Profile* profile, unsigned maxLevel)
+    {
+        std::vector<TileKey> keys;
+        for (unsigned lod = 0; lod <= maxLevel; ++lod)
+        {
+            unsigned cols, rows;
+            profile->getNumTiles(lod, cols, rows);
+            for (unsigned x = 0; x < cols; ++x)
+                for (unsigned y = 0; y < rows; ++y)
+                    keys.push_back(TileKey(lod, x, y, profile));
+        }
+        return keys;
+    }
+
+    bool createMBTiles(const std::string& filename, const std::vector<TileKey>& keys, int size)
+    {
+        ::remove(filename.c_str());
+
+        osg::ref_ptr<MBTilesImageLayer> layer = new MBTilesImageLayer();
+        layer->setURL(filename);
+        layer->setFormat("png");
+        layer->setProfile(keys.front().getProfile());
+        if (layer->openForWriting().isError())
+            return false;
+
+        for (auto& key : keys)
+        {
+            osg::ref_ptr<osg::Image> image = new osg::Image();
+            image->allocateImage(size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+            ::memset(image->data(), tileValue(key), image->getTotalSizeInBytes());
+            if (layer->writeImage(key, image.get()).isError())
+                return false;
+        }
+
+        layer->close();
+        return true;
+    }
+
+    // Reads every key from "threads" threads at once; returns tiles/second
+    // and counts the tiles whose content did not match.
+    double readMBTiles(MBTilesImageLayer* layer, const std::vector<TileKey>& keys, unsigned threads, std::atomic_int& mismatches)
+    {
+        auto t0 = Clock::now();
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t]()
+            {
+                for (unsigned i = t; i < keys.size(); i += threads)
+                {
+                    GeoImage image = layer->createImage(keys[i]);
+                    if (!image.valid() || *image.getImage()->data() != tileValue(keys[i]))
+                        ++mismatches;
+                }
+            });
+        }
+
+        for (auto& w : workers)
+            w.join();
+
+        return (double)keys.size() / seconds(t0, Clock::now());
+    }
+
+    // Reads a global-geodetic .mbtiles file (or a generated one) with
+    // 1 to 16 threads.
+    void mbtiles(osg::ArgumentParser& arguments)
+    {
+        osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+
+        unsigned maxLevel = 6; // ~11000 tiles
+        arguments.read("--level", maxLevel);
+
+        std::string filename;
+        bool generated = !arguments.read("--file", filename);
+        if (generated)
+        {
+            filename = "microbench.mbtiles";
+            if (!createMBTiles(filename, getKeys(profile.get(), maxLevel), 256))
+            {
+                OE_WARN << LC << "Failed to create " << filename << std::endl;
+                return;
+            }
+        }
+
+        osg::ref_ptr<MBTilesImageLayer> layer = new MBTilesImageLayer();
+        layer->setURL(filename);
+        Status status = layer->open();
+        if (status.isError())
+        {
+            OE_WARN << LC << "Failed to open " << filename << ": " << status.message() << std::endl;
+            return;
+        }
+
+        std::vector<TileKey> keys = getKeys(layer->getProfile(), maxLevel);
+
+        for (unsigned threads : { 1u, 2u, 4u, 8u, 16u })
+        {
+            std::atomic_int mismatches(0);
+            double rate = readMBTiles(layer.get(), keys, threads, mismatches);
+            std::cout << "threads=" << threads << " tiles=" << keys.size()
+                << " : " << (int)rate << " tiles/s";
+            // only the generated tiles have known content
+            if (generated)
+                std::cout << ", " << mismatches << " mismatches";
+            std::cout << std::endl;
+        }
+
+        layer->close();
+        if (generated)
+            ::remove(filename.c_str());
+    }
+
+    //...................................................................
+
+    // Label-sized boxes scattered over (and a little past) a 1920x1080
+    // viewport. Every few labels share a parent, like the drawables of
+    // one PlaceNode.
+    void makeLabels(unsigned count, std::vector<osg::ref_ptr<osg::Node>>& parents, std::vector<RenderLeafBox>& labels)
+    {
+        std::mt19937 gen(count);
+        std::uniform_real_distribution<float> x(-100.0f, 2020.0f);
+        std::uniform_real_distribution<float> y(-50.0f, 1130.0f);
+        std::uniform_real_distribution<float> w(20.0f, 160.0f);
+        std::uniform_real_distribution<float> h(10.0f, 30.0f);
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            if (i % 3 == 0)
+                parents.push_back(new osg::Group());
+
+            float x0 = floor(x(gen)), y0 = floor(y(gen));
+            labels.push_back(std::make_pair(
+                parents.back().get(),
+                osg::BoundingBox(x0, y0, 0.0f, x0 + ceil(w(gen)), y0 + ceil(h(gen)), 0.0f)));
+        }
+    }
+
+    // The original occlusion test: each label against every placed label.
+    unsigned declutterBruteForce(const std::vector<RenderLeafBox>& labels)
+    {
+        std::vector<RenderLeafBox> used;
+        for (auto& label : labels)
+        {
+            bool clear = true;
+            for (auto& j : used)
+            {
+                bool isClear =
+                    label.second.xMin() > j.second.xMax() ||
+                    label.second.xMax() < j.second.xMin() ||
+                    label.second.yMin() > j.second.yMax() ||
+                    label.second.yMax() < j.second.yMin();
+
+                if (!isClear && label.first != j.first)
+                {
+                    clear = false;
+                    break;
+                }
+            }
+            if (clear)
+                used.push_back(label);
+        }
+        return used.size();
+    }
+
+    unsigned declutterGrid(DeclutterGrid& grid, const std::vector<RenderLeafBox>& labels)
+    {
+        unsigned placed = 0u;
+        grid.reset(0.0f, 0.0f, 1920.0f, 1080.0f);
+        for (auto& label : labels)
+        {
+            if (!grid.overlaps(label.first, label.second))
+            {
+                grid.insert(label.first, label.second);
+                ++placed;
+            }
+        }
+        return placed;
+    }
+
+    // Declutter time against label count
+    void declutter(osg::ArgumentParser&)
+    {
+        DeclutterGrid grid;
+
+        for (unsigned count : { 1000u, 5000u, 10000u, 25000u, 50000u })
+        {
+            std::vector<osg::ref_ptr<osg::Node>> parents;
+            std::vector<RenderLeafBox> labels;
+            makeLabels(count, parents, labels);
+
+            auto t0 = Clock::now();
+            unsigned brute = declutterBruteForce(labels);
+            auto t1 = Clock::now();
+            unsigned fast = declutterGrid(grid, labels);
+            auto t2 = Clock::now();
+
+            std::cout << "labels=" << count
+                << " placed=" << fast << (fast == brute ? "" : " (MISMATCH)")
+                << " : brute force " << ms(t0, t1) << " ms"
+                << ", grid " << ms(t1, t2) << " ms"
+                << std::endl;
+        }
+    }
+
+    //...................................................................
+
+    // Building-like features: squares, some with holes, with a mix of
+    // attribute types and an attribute only some features have.
+    void makeBuildings(unsigned count, FeatureList& features)
+    {
+        osg::ref_ptr<const SpatialReference> srs = SpatialReference::create("wgs84");
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            double x = (double)(i % 1000), y = (double)(i / 1000);
+            Polygon* poly = new Polygon();
+            poly->push_back(osg::Vec3d(x, y, 0));
+            poly->push_back(osg::Vec3d(x + 0.5, y, 0));
+            poly->push_back(osg::Vec3d(x + 0.5, y + 0.5, 0));
+            poly->push_back(osg::Vec3d(x, y + 0.5, 0));
+            if (i % 2 == 0)
+            {
+                Ring* hole = new Ring();
+                hole->push_back(osg::Vec3d(x + 0.1, y + 0.1, 0));
+                hole->push_back(osg::Vec3d(x + 0.2, y + 0.1, 0));
+                hole->push_back(osg::Vec3d(x + 0.2, y + 0.2, 0));
+                poly->getHoles().push_back(hole);
+            }
+
+            Feature* f = new Feature(poly, srs.get(), Style(), i);
+            f->set("building", std::string(i % 3 == 0 ? "yes" : "house"));
+            f->set("height", 3.0 * (i % 10));
+            f->set("levels", (long long)(i % 10));
+            f->set("roof", i % 2 == 0);
+            if (i % 4 == 0)
+                f->set("name", std::string("Building ") + std::to_string(i));
+            features.push_back(f);
+        }
+    }
+
+    // Attribute filtering on lists and batches
+    void featureBatch(osg::ArgumentParser& arguments)
+    {
+        unsigned count = 200000;
+        arguments.read("--features", count);
+
+        FeatureList features;
+        makeBuildings(count, features);
+
+        std::vector<std::string> attrs(1, "name");
+        osg::ref_ptr<FeatureFilter> filter = new AttributesFilter(attrs);
+        FilterContext cx;
+
+        auto t0 = Clock::now();
+        osg::ref_ptr<FeatureBatch> batch = new FeatureBatch();
+        batch->append(features);
+        auto t1 = Clock::now();
+        filter->push(*batch.get(), cx);
+        auto t2 = Clock::now();
+        filter->push(features, cx);
+        auto t3 = Clock::now();
+
+        std::cout << "features=" << count
+            << " : to batch " << ms(t0, t1) << " ms"
+            << ", filter batch " << ms(t1, t2) << " ms"
+            << ", filter list " << ms(t2, t3) << " ms"
+            << std::endl;
+    }
+
+    //...................................................................
+
+    // GDAL against the warp mesh, with and without a cached mesh
+    void reproject(osg::ArgumentParser&)
+    {
+        osg::ref_ptr<const SpatialReference> wgs84 = SpatialReference::create("wgs84");
+        osg::ref_ptr<const SpatialReference> mercator = SpatialReference::create("spherical-mercator");
+        osg::ref_ptr<osg::Image> image = makeGradient(256, GL_RGBA, GL_UNSIGNED_BYTE);
+
+        // 8x8 tiles of a mercator quadrant
+        std::vector<GeoExtent> from, to;
+        const double size = 20037508.34 / 8.0;
+        for (int y = 0; y < 8; ++y)
+        {
+            for (int x = 0; x < 8; ++x)
+            {
+                from.push_back(GeoExtent(mercator.get(), x*size, y*size, (x + 1)*size, (y + 1)*size));
+                to.push_back(from.back().transform(wgs84.get()));
+            }
+        }
+        const unsigned tiles = from.size();
+
+        ImageReprojector reprojector;
+
+        auto t0 = Clock::now();
+        for (unsigned i = 0; i < tiles; ++i)
+        {
+            osg::ref_ptr<osg::Image> result = GDAL::reprojectImage(
+                image.get(),
+                from[i].getSRS()->getWKT(), from[i].xMin(), from[i].yMin(), from[i].xMax(), from[i].yMax(),
+                to[i].getSRS()->getWKT(), to[i].xMin(), to[i].yMin(), to[i].xMax(), to[i].yMax(),
+                256, 256, true);
+        }
+        auto t1 = Clock::now();
+        for (unsigned i = 0; i < tiles; ++i)
+            osg::ref_ptr<osg::Image> result = reprojector.reproject(image.get(), from[i], to[i], 256, 256, true);
+        auto t2 = Clock::now();
+        for (unsigned i = 0; i < tiles; ++i)
+            osg::ref_ptr<osg::Image> result = reprojector.reproject(image.get(), from[i], to[i], 256, 256, true);
+        auto t3 = Clock::now();
+
+        std::cout << "tiles=" << tiles
+            << " : GDAL " << ms(t0, t1) << " ms"
+            << ", mesh " << ms(t1, t2) << " ms"
+            << ", cached mesh " << ms(t2, t3) << " ms"
+            << " (mesh cache hit ratio " << reprojector.getCacheStats()._hitRatio << ")"
+            << std::endl;
+    }
+
+    //...................................................................
+
+    // The normal map kernel against a per-texel PixelWriter loop
+    void normalMap(osg::ArgumentParser& arguments)
+    {
+        const int size = ELEVATION_TILE_SIZE;
+        const int stride = size + 2;
+        const double spacing = 30.0; // meters
+
+        int tiles = 200;
+        arguments.read("--tiles", tiles);
+
+        // rolling terrain, with a one-texel apron
+        std::vector<float> heights(stride*stride);
+        for (int t = 0; t < stride; ++t)
+            for (int s = 0; s < stride; ++s)
+                heights[t*stride + s] = (float)(200.0*sin(0.013*s) * cos(0.021*t) + 35.0*sin(0.11*(s + t)));
+
+        std::vector<double> dx(size, spacing);
+
+        osg::ref_ptr<osg::Image> image = new osg::Image();
+        image->allocateImage(size, size, 1, GL_RG, GL_UNSIGNED_BYTE);
+        ImageUtils::PixelWriter write(image.get());
+        osg::Vec3 normal;
+        osg::Vec4 pixel;
+
+        auto t0 = Clock::now();
+        for (int i = 0; i < tiles; ++i)
+        {
+            for (int t = 0; t < size; ++t)
+            {
+                for (int s = 0; s < size; ++s)
+                {
+                    const float* h = &heights[(t + 1)*stride + s + 1];
+                    osg::Vec3 a(2.0 * spacing, 0.0, h[1] - h[-1]);
+                    osg::Vec3 b(0.0, 2.0 * spacing, h[stride] - h[-stride]);
+                    normal = a ^ b;
+                    normal.normalize();
+                    NormalMapGenerator::pack(normal, pixel);
+                    write(pixel, s, t);
+                }
+            }
+        }
+        auto t1 = Clock::now();
+        for (int i = 0; i < tiles; ++i)
+        {
+            NormalMapGenerator::createNormals(
+                &heights[0], size, size, &dx[0], spacing, nullptr, image->data(), nullptr);
+        }
+        auto t2 = Clock::now();
+
+        std::cout << "tiles=" << tiles
+            << " : per texel " << ms(t0, t1) << " ms"
+            << ", kernel " << ms(t1, t2) << " ms"
+            << std::endl;
+    }
+
+    //...................................................................
+
+    // Roughly circular ring with a jagged edge; star-shaped about its
+    // center, so it never crosses itself.
+    void makeRing(Ring* ring, double cx, double cy, double r, int n, double jitter, std::mt19937& rng, bool cw =false)
+    {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        for (int i = 0; i < n; ++i)
+        {
+            double a = 2.0*osg::PI*(double)(cw ? n - i : i) / (double)n;
+            double rr = r * (1.0 - jitter * uniform(rng));
+            ring->push_back(osg::Vec3d(cx + rr * cos(a), cy + rr * sin(a), 0.0));
+        }
+    }
+
+    Polygon* coastline(int numPoints)
+    {
+        std::mt19937 rng(42);
+        Polygon* p = new Polygon();
+        makeRing(p, 0.0, 0.0, 50000.0, numPoints, 0.3, rng);
+        return p;
+    }
+
+    // Lake with a grid of islands
+    Polygon* lake(int islandsPerSide)
+    {
+        std::mt19937 rng(7);
+        Polygon* p = new Polygon();
+        makeRing(p, 0.0, 0.0, 1000.0 * islandsPerSide, 400, 0.05, rng);
+        double spacing = 1000.0;
+        double start = -0.5 * spacing * (double)(islandsPerSide - 1);
+        for (int i = 0; i < islandsPerSide; ++i)
+        {
+            for (int j = 0; j < islandsPerSide; ++j)
+            {
+                Ring* island = new Ring();
+                makeRing(island, start + i * spacing, start + j * spacing, 300.0, 24, 0.4, rng, true);
+                p->getHoles().push_back(island);
+            }
+        }
+        return p;
+    }
+
+    // Sweep against ear clipping
+    void tessellate(osg::ArgumentParser&)
+    {
+        osg::ref_ptr<Polygon> polygons[] = {
+            coastline(10000),
+            coastline(100000),
+            lake(10)
+        };
+
+        for (auto& p : polygons)
+        {
+            std::vector<uint32_t> indices;
+            Tessellator tess;
+
+            tess.setMethod(Tessellator::METHOD_SWEEP);
+            auto t0 = Clock::now();
+            tess.tessellate2D(p.get(), indices);
+            auto t1 = Clock::now();
+
+            tess.setMethod(Tessellator::METHOD_EARCUT);
+            tess.tessellate2D(p.get(), indices);
+            auto t2 = Clock::now();
+
+            std::cout << "points=" << p->getTotalPointCount() << " holes=" << p->getHoles().size()
+                << " : sweep " << ms(t0, t1) << " ms"
+                << ", earcut " << ms(t1, t2) << " ms"
+                << std::endl;
+        }
+    }
+
+    //...................................................................
+
+    // A state with "depth" nested statesets, each with a VirtualProgram
+    // that adds one function, like a deep scene graph would during cull.
+    // (osg::State does not hold references to the statesets it's given.)
+    osg::State* makeState(int depth, std::vector<osg::ref_ptr<osg::StateSet> >& stateSets)
+    {
+        osg::State* state = new osg::State();
+        for (int i = 0; i < depth; ++i)
+        {
+            osg::StateSet* stateSet = new osg::StateSet();
+            stateSets.push_back(stateSet);
+            VirtualProgram* vp = VirtualProgram::getOrCreate(stateSet);
+            std::string name = "oe_bench_" + std::to_string(i);
+            vp->setFunction(name, "void " + name + "(inout vec4 v) { }\n", ShaderComp::LOCATION_VERTEX_MODEL);
+            state->pushStateSet(stateSet);
+        }
+        return state;
+    }
+
+    // The accumulate/lookup part of VirtualProgram::apply
+    osg::ref_ptr<osg::Program> lookupProgram(ProgramRepo* repo, osg::State& state, unsigned frame, UID user)
+    {
+        std::vector<osg::ref_ptr<PolyShader> > shaders;
+        VirtualProgram::getPolyShaders(state, shaders);
+
+        ProgramKey key;
+        key.reserve(shaders.size());
+        for (auto& shader : shaders)
+            key.push_back(shader->getHash());
+
+        osg::ref_ptr<osg::Program> program = repo->use(key, ProgramRepo::hash(key), frame, user);
+        if (!program.valid())
+        {
+            program = new osg::Program();
+            program->addShader(new osg::Shader(osg::Shader::VERTEX, "void oe_bench_program(inout vec4 v) { }\n"));
+            repo->add(key, ProgramRepo::hash(key), program, frame, user);
+        }
+        return program;
+    }
+
+    // Accumulate and look up programs under deep state stacks, on one
+    // and several threads
+    void programRepo(osg::ArgumentParser& arguments)
+    {
+        int iterations = 20000;
+        arguments.read("--iterations", iterations);
+
+        for (int depth : { 4, 16, 64 })
+        {
+            for (unsigned numThreads : { 1u, 4u })
+            {
+                osg::ref_ptr<ProgramRepo> repo = new ProgramRepo();
+
+                auto t0 = Clock::now();
+
+                std::vector<std::thread> threads;
+                for (unsigned t = 0; t < numThreads; ++t)
+                {
+                    threads.emplace_back([&repo, depth, iterations, t]()
+                        {
+                            std::vector<osg::ref_ptr<osg::StateSet> > stateSets;
+                            osg::ref_ptr<osg::State> state = makeState(depth, stateSets);
+                            for (int i = 0; i < iterations; ++i)
+                            {
+                                lookupProgram(repo.get(), *state, (unsigned)i / 100u, (UID)t);
+                            }
+                        });
+                }
+                for (auto& thread : threads)
+                    thread.join();
+
+                double elapsed = ms(t0, Clock::now());
+
+                std::cout << "depth=" << depth << " threads=" << numThreads
+                    << " : " << elapsed << " ms, "
+                    << (1.0e6 * elapsed / (double)(iterations * numThreads)) << " ns/lookup"
+                    << ", lookups/frame=" << repo->getStats().lookups
+                    << std::endl;
+            }
+        }
+    }
+
+    //...................................................................
+
+    // Tile-sized boxes scattered over the globe, like a mosaic index
+    std::vector<PackedRTree::Box> makeBoxes(unsigned count, double size, unsigned seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> lon(-180.0, 180.0 - size);
+        std::uniform_real_distribution<double> lat(-90.0, 90.0 - size);
+        std::vector<PackedRTree::Box> boxes(count);
+        for (auto& box : boxes)
+        {
+            box.xmin = lon(rng);
+            box.ymin = lat(rng);
+            box.xmax = box.xmin + size;
+            box.ymax = box.ymin + size;
+        }
+        return boxes;
+    }
+
+    // Packed R-tree against the dynamic RTree
+    void packedRTree(osg::ArgumentParser& arguments)
+    {
+        unsigned numQueries = 100000;
+        arguments.read("--queries", numQueries);
+
+        for (unsigned count : { 10000u, 100000u, 1000000u })
+        {
+            std::vector<PackedRTree::Box> boxes = makeBoxes(count, 0.1, 1);
+            std::vector<PackedRTree::Box> queries = makeBoxes(numQueries, 0.5, 2);
+
+            auto t0 = Clock::now();
+            PackedRTree packed;
+            packed.build(boxes);
+            auto t1 = Clock::now();
+
+            RTree<unsigned, double, 2> dynamic;
+            for (unsigned i = 0; i < count; ++i)
+            {
+                double min[2] = { boxes[i].xmin, boxes[i].ymin };
+                double max[2] = { boxes[i].xmax, boxes[i].ymax };
+                dynamic.Insert(min, max, i);
+            }
+            auto t2 = Clock::now();
+
+            std::vector<unsigned> hits;
+            std::size_t packedHits = 0;
+            for (auto& query : queries)
+            {
+                hits.clear();
+                packed.search(query, hits);
+                packedHits += hits.size();
+            }
+            auto t3 = Clock::now();
+
+            std::size_t dynamicHits = 0;
+            for (auto& query : queries)
+            {
+                hits.clear();
+                double min[2] = { query.xmin, query.ymin };
+                double max[2] = { query.xmax, query.ymax };
+                dynamic.Search(min, max, &hits, std::numeric_limits<int>::max());
+                dynamicHits += hits.size();
+            }
+            auto t4 = Clock::now();
+
+            std::cout << "items=" << count
+                << (packedHits == dynamicHits ? "" : " (MISMATCH)")
+                << " : packed build " << ms(t0, t1) << " ms"
+                << ", query " << us(t2, t3) / numQueries << " us"
+                << " | rtree build " << ms(t1, t2) << " ms"
+                << ", query " << us(t3, t4) / numQueries << " us"
+                << std::endl;
+        }
+    }
+
+    //...................................................................
+
+    // Nearest-neighbor field from a raster with data at a sparse,
+    // pseudo-random scattering of pixels
+    void sdf(osg::ArgumentParser& arguments)
+    {
+        int size = 512, tiles = 50;
+        arguments.read("--size", size);
+        arguments.read("--tiles", tiles);
+
+        osg::Image* image = new osg::Image();
+        image->allocateImage(size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        ImageUtils::PixelWriter write(image);
+        write.assign(Color(1, 1, 1, 0));
+
+        std::srand(7);
+        for (int t = 0; t < size; ++t)
+            for (int s = 0; s < size; ++s)
+                if (std::rand() % 1000 < 2)
+                    write(Color::Black, s, t);
+
+        GeoImage raster(image, GeoExtent(SpatialReference::get("wgs84"), 0.0, 0.0, 1.0, 1.0));
+
+        SDFGenerator sdfgen;
+        GeoImage nnfield;
+        auto t0 = Clock::now();
+        for (int i = 0; i < tiles; ++i)
+        {
+            sdfgen.createNearestNeighborField(raster, false, nnfield, nullptr);
+        }
+        auto t1 = Clock::now();
+
+        std::cout << "tiles=" << tiles << " size=" << size
+            << " : " << ms(t0, t1) / tiles << " ms per tile"
+            << std::endl;
+    }
+
+    //...................................................................
+
+    struct Benchmark
+    {
+        const char* name;
+        const char* description;
+        void (*run)(osg::ArgumentParser&);
+    };
+
+    const Benchmark benchmarks[] =
+    {
+        { "scheduler", "JobArena priority vs. work-stealing scheduler [--jobs n]", scheduler },
+        { "pixels",    "PixelReader per-pixel vs. per-row reads, resizeImage [--size n] [--passes n]", pixels },
+        { "mbtiles",   "MBTiles concurrent read throughput [--file global-geodetic.mbtiles] [--level n]", mbtiles },
+        { "declutter", "Declutter occlusion test, brute force vs. grid", declutter },
+        { "featurebatch", "AttributesFilter on a FeatureBatch vs. a FeatureList [--features n]", featureBatch },
+        { "reproject", "ImageReprojector warp mesh vs. GDAL reprojection", reproject },
+        { "normalmap", "NormalMapGenerator kernel vs. a per-texel loop [--tiles n]", normalMap },
+        { "tessellator", "Tessellator sweep vs. ear clipping", tessellate },
+        { "programrepo", "ProgramRepo lookups under deep state stacks [--iterations n]", programRepo },
+        { "rtree",     "PackedRTree vs. the dynamic RTree, build and query [--queries n]", packedRTree },
+        { "sdf",       "SDFGenerator nearest-neighbor field [--size n] [--tiles n]", sdf },
+    };
+}
+
+int
+usage(const char* name)
+{
+    OE_NOTICE
+        << "\nUsage: " << name << " benchmark [benchmark ...] [options]"
+        << "\n       " << name << " --all [options]"
+        << "\n\nBenchmarks:" << std::endl;
+
+    for (auto& b : benchmarks)
+        OE_NOTICE << "    " << b.name << " : " << b.description << std::endl;
+
+    return 0;
+}
+
+int
+main(int argc, char** argv)
+{
+    osgEarth::initialize();
+
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if (argc < 2 || arguments.read("--help"))
+        return usage(argv[0]);
+
+    bool all = arguments.read("--all");
+
+    std::vector<const Benchmark*> selected;
+    for (auto& b : benchmarks)
+    {
+        if (all || arguments.find(b.name) > 0)
+            selected.push_back(&b);
+    }
+
+    if (selected.empty())
+    {
+        OE_WARN << LC << "No such benchmark" << std::endl;
+        return usage(argv[0]);
+    }
+
+    for (auto b : selected)
+    {
+        std::cout << "-- " << b->name << std::endl;
+        b->run(arguments);
+    }
+
+    return 0;
+}
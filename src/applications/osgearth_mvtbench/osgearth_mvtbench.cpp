@@ -0,0 +1,237 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+// Measures how fast MVT tiles decode into features. Loads the tiles of a
+// local .mbtiles file into memory, decodes them a number of times, and
+// reports the throughput, per-tile timings and heap allocations.
+
+#include <osgEarth/MVT>
+#include <osgEarth/Registry>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Notify>
+#include <osg/ArgumentParser>
+#include <sqlite3.h>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// Count heap allocations, to see what decoding costs besides the features
+#define OE_BENCH_COUNT_ALLOCATIONS
+#include "../BenchUtils.h"
+
+#define LC "[mvtbench] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+using namespace BenchUtils;
+
+int
+usage(const char* name)
+{
+    OE_NOTICE
+        << "\nUsage: " << name << " file.mbtiles [options]" << std::endl
+        << "\n    --zoom n                     : only decode tiles at this zoom level"
+        << "\n    --limit n                    : maximum number of tiles to load (default 1000)"
+        << "\n    --passes n                   : number of timed passes over the tiles (default 5)"
+        << "\n    --layers a,b,...             : only decode these MVT layers"
+        << "\n    --attributes a,b,...         : only decode these attributes"
+        << std::endl;
+
+    return 0;
+}
+
+namespace
+{
+    struct Tile
+    {
+        TileKey key;
+        std::string data;
+    };
+
+    bool loadTiles(const std::string& filename, int zoom, int limit, std::vector<Tile>& tiles)
+    {
+        sqlite3* db = nullptr;
+        if (sqlite3_open_v2(filename.c_str(), &db, SQLITE_OPEN_READONLY, 0L) != SQLITE_OK)
+        {
+            OE_WARN << LC << "Failed to open " << filename << ": " << sqlite3_errmsg(db) << std::endl;
+            sqlite3_close(db);
+            return false;
+        }
+
+        std::string sql = "SELECT zoom_level, tile_column, tile_row, tile_data FROM tiles";
+        if (zoom >= 0)
+            sql += " WHERE zoom_level = " + std::to_string(zoom);
+        sql += " LIMIT " + std::to_string(limit);
+
+        sqlite3_stmt* select = nullptr;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &select, 0L) != SQLITE_OK)
+        {
+            OE_WARN << LC << "Failed to prepare SQL: " << sql << "; " << sqlite3_errmsg(db) << std::endl;
+            sqlite3_close(db);
+            return false;
+        }
+
+        const Profile* profile = Registry::instance()->getSphericalMercatorProfile();
+
+        while (sqlite3_step(select) == SQLITE_ROW)
+        {
+            int z = sqlite3_column_int(select, 0);
+            int x = sqlite3_column_int(select, 1);
+            int y = sqlite3_column_int(select, 2);
+
+            unsigned numCols, numRows;
+            profile->getNumTiles(z, numCols, numRows);
+
+            Tile tile;
+            tile.key = TileKey(z, x, numRows - y - 1, profile);
+            tile.data.assign(
+                (const char*)sqlite3_column_blob(select, 3),
+                sqlite3_column_bytes(select, 3));
+            tiles.emplace_back(std::move(tile));
+        }
+
+        sqlite3_finalize(select);
+        sqlite3_close(db);
+        return true;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osgEarth::initialize();
+
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if (argc < 2 || arguments.read("--help"))
+        return usage(argv[0]);
+
+    int zoom = -1;
+    arguments.read("--zoom", zoom);
+
+    int limit = 1000;
+    arguments.read("--limit", limit);
+
+    int passes = 5;
+    arguments.read("--passes", passes);
+
+    StringTokenizer tok(", ", "");
+    tok.keepEmpties() = false;
+    StringVector names;
+
+    MVT::ReadOptions options;
+
+    std::string layers;
+    if (arguments.read("--layers", layers))
+    {
+        tok.tokenize(layers, names);
+        options.layers.insert(names.begin(), names.end());
+    }
+
+    std::string attributes;
+    if (arguments.read("--attributes", attributes))
+    {
+        tok.tokenize(attributes, names);
+        for (auto& name : names)
+            options.attributes.insert(toLower(name));
+    }
+
+    std::string filename = argv[1];
+
+    std::vector<Tile> tiles;
+    if (!loadTiles(filename, zoom, limit, tiles) || tiles.empty())
+    {
+        OE_WARN << LC << "No tiles to decode in " << filename << std::endl;
+        return -1;
+    }
+
+    std::size_t bytes = 0u;
+    for (auto& tile : tiles)
+        bytes += tile.data.size();
+
+    FeatureList features;
+    std::size_t numFeatures = 0u;
+    int failed = 0;
+
+    // One untimed pass, so the decoder's buffers reach their working size
+    for (auto& tile : tiles)
+    {
+        if (!MVT::readTile(tile.data.data(), tile.data.size(), tile.key, features, &options))
+            ++failed;
+        numFeatures += features.size();
+    }
+
+    std::vector<double> times;
+    std::vector<double> allocationCounts;
+    times.reserve(tiles.size() * passes);
+    allocationCounts.reserve(tiles.size() * passes);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int pass = 0; pass < passes; ++pass)
+    {
+        for (auto& tile : tiles)
+        {
+            unsigned long long a0 = allocations();
+            auto t0 = std::chrono::steady_clock::now();
+
+            MVT::readTile(tile.data.data(), tile.data.size(), tile.key, features, &options);
+
+            auto t1 = std::chrono::steady_clock::now();
+            allocationCounts.push_back((double)(allocations() - a0));
+            times.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double decoded = (double)passes;
+
+    std::cout
+        << "Tiles: " << tiles.size() << " (" << bytes / 1024u << " KB), "
+        << numFeatures << " features";
+    if (!options.layers.empty())
+        std::cout << ", layers " << layers;
+    if (!options.attributes.empty())
+        std::cout << ", attributes " << attributes;
+    std::cout << std::endl;
+
+    if (seconds > 0.0)
+    {
+        std::cout
+            << "Throughput (" << passes << " passes):" << std::endl
+            << "  " << (decoded * tiles.size()) / seconds << " tiles/s, "
+            << (decoded * bytes) / (1024.0 * 1024.0 * seconds) << " MB/s, "
+            << (decoded * numFeatures) / seconds << " features/s" << std::endl;
+    }
+
+    std::cout << "Per tile:" << std::endl;
+    print("decode", summarize(times), " ms");
+    print("allocations", summarize(allocationCounts), "");
+
+    if (failed > 0)
+    {
+        OE_WARN << LC << failed << " tiles failed to decode" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
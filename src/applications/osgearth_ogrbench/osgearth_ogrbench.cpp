@@ -0,0 +1,210 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+// Measures how OGR feature reads scale with the number of threads. Splits
+// the extent of a local feature file (a GeoPackage, for example) into tiles,
+// reads them all through an OGRFeatureSource with 1, 2, 4, ... threads, and
+// reports the throughput and per-tile timings of each run.
+
+#include <osgEarth/OGRFeatureSource>
+#include <osgEarth/FeatureCursor>
+#include <osgEarth/Registry>
+#include <osgEarth/Notify>
+#include <osg/ArgumentParser>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "../BenchUtils.h"
+
+#define LC "[ogrbench] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+using namespace BenchUtils;
+
+int
+usage(const char* name)
+{
+    OE_NOTICE
+        << "\nUsage: " << name << " file.gpkg [options]" << std::endl
+        << "\n    --layer name                 : layer to read within the file"
+        << "\n    --level n                    : tile level at which to query features (default 6)"
+        << "\n    --threads n                  : largest number of reader threads (default: number of cores)"
+        << "\n    --passes n                   : number of timed passes over the tiles (default 3)"
+        << std::endl;
+
+    return 0;
+}
+
+namespace
+{
+    struct Run
+    {
+        double seconds = 0.0;
+        std::size_t features = 0u;
+        std::vector<double> times;
+    };
+
+    // Reads every tile "passes" times, with "numThreads" threads taking
+    // the next unread tile until there are none left.
+    Run read(FeatureSource* source, const std::vector<TileKey>& keys, unsigned numThreads, int passes)
+    {
+        Run run;
+        std::vector<Run> perThread(numThreads);
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (int pass = 0; pass < passes; ++pass)
+        {
+            std::atomic<unsigned> next(0u);
+            std::vector<std::thread> threads;
+
+            for (unsigned t = 0; t < numThreads; ++t)
+            {
+                threads.emplace_back([&, t]()
+                {
+                    Run& local = perThread[t];
+                    for (unsigned i = next++; i < keys.size(); i = next++)
+                    {
+                        auto t0 = std::chrono::steady_clock::now();
+
+                        Query query;
+                        query.tileKey() = keys[i];
+                        osg::ref_ptr<FeatureCursor> cursor = source->createFeatureCursor(query, nullptr);
+                        while (cursor.valid() && cursor->hasMore())
+                        {
+                            cursor->nextFeature();
+                            ++local.features;
+                        }
+                        cursor = nullptr;
+
+                        auto t1 = std::chrono::steady_clock::now();
+                        local.times.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+                    }
+                });
+            }
+
+            for (auto& thread : threads)
+                thread.join();
+        }
+
+        run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (auto& local : perThread)
+        {
+            run.features += local.features;
+            run.times.insert(run.times.end(), local.times.begin(), local.times.end());
+        }
+        return run;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osgEarth::initialize();
+
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if (argc < 2 || arguments.read("--help"))
+        return usage(argv[0]);
+
+    std::string layer;
+    arguments.read("--layer", layer);
+
+    int level = 6;
+    arguments.read("--level", level);
+
+    int maxThreads = (int)std::max(1u, std::thread::hardware_concurrency());
+    arguments.read("--threads", maxThreads);
+
+    int passes = 3;
+    arguments.read("--passes", passes);
+
+    std::string filename = argv[1];
+
+    osg::ref_ptr<OGRFeatureSource> source = new OGRFeatureSource();
+    source->setURL(filename);
+    if (!layer.empty())
+        source->setLayer(layer);
+
+    // measure the reads, not the in-memory tile cache:
+    source->options().l2CacheSize() = 0u;
+
+    Status status = source->open();
+    if (status.isError())
+    {
+        OE_WARN << LC << "Failed to open " << filename << ": " << status.message() << std::endl;
+        return -1;
+    }
+
+    std::vector<TileKey> keys;
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+    profile->getIntersectingTiles(source->getFeatureProfile()->getExtent(), level, keys);
+
+    if (keys.empty())
+    {
+        OE_WARN << LC << "No tiles at level " << level << " intersect " << filename << std::endl;
+        return -1;
+    }
+
+    std::cout
+        << "Source: " << filename << ", " << source->getFeatureCount() << " features" << std::endl
+        << "Tiles: " << keys.size() << " at level " << level << ", " << passes << " passes" << std::endl;
+
+    // One untimed pass with one thread, to warm up the file system cache
+    read(source.get(), keys, 1u, 1);
+
+    // 1, 2, 4, ... and the largest count
+    std::vector<int> threadCounts;
+    for (int n = 1; n < maxThreads; n *= 2)
+        threadCounts.push_back(n);
+    threadCounts.push_back(std::max(1, maxThreads));
+
+    double baseline = 0.0;
+
+    for (int numThreads : threadCounts)
+    {
+        Run run = read(source.get(), keys, (unsigned)numThreads, passes);
+
+        double tilesPerSecond = run.seconds > 0.0 ? (double)(keys.size() * passes) / run.seconds : 0.0;
+        if (numThreads == 1)
+            baseline = tilesPerSecond;
+
+        Summary s = summarize(run.times);
+
+        std::cout
+            << "  " << numThreads << " threads: "
+            << tilesPerSecond << " tiles/s, "
+            << (run.seconds > 0.0 ? (double)run.features / run.seconds : 0.0) << " features/s, "
+            << "speedup " << (baseline > 0.0 ? tilesPerSecond / baseline : 0.0) << "x, "
+            << "per tile mean " << s.mean << " ms, p50 " << s.p50 << " ms, p95 " << s.p95 << " ms, max " << s.max << " ms"
+            << std::endl;
+    }
+
+    source->close();
+
+    return 0;
+}
@@ -0,0 +1,354 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+// Records a camera path over the terrain, then replays it headlessly and
+// reports how long the terrain takes to reach full resolution, so that
+// tile scheduling changes (like prefetching) can be compared.
+
+#include <osgViewer/Viewer>
+#include <osg/AnimationPath>
+#include <osg/Stats>
+#include <osg/Timer>
+#include <osgEarth/Notify>
+#include <osgEarth/EarthManipulator>
+#include <osgEarth/ExampleResources>
+#include <osgEarth/MapNode>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#define LC "[replay] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+int
+usage(const char* name)
+{
+    OE_NOTICE
+        << "\nUsage: " << name << " file.earth [--record | --replay] path.txt [options]" << std::endl
+        << "\n    --record path.txt            : fly around with the mouse; the camera path is saved on exit"
+        << "\n    --replay path.txt            : replay a recorded path headlessly and report timings"
+        << "\n    --prefetch                   : enable predictive tile prefetching during replay"
+        << "\n    --prefetch-frames n          : frames ahead to predict (default from the earth file)"
+        << "\n    --prefetch-budget n          : maximum prefetch requests in flight"
+        << "\n    --size w h                   : replay viewport size (default 1280 720)"
+        << "\n    --fps n                      : replay frame rate (default 60)"
+        << "\n    --timeout s                  : seconds to wait for the terrain to settle (default 60)"
+        << std::endl
+        << MapNodeHelper().usage() << std::endl;
+
+    return 0;
+}
+
+namespace
+{
+    // Number of idle frames in a row before we consider the terrain settled;
+    // child tiles are created a frame before they start loading.
+    const int SETTLED_FRAMES = 5;
+
+    struct Report
+    {
+        std::vector<double> intervals; // seconds spent below full resolution, per episode
+        int frames = 0;
+        int framesAtFullRes = 0;
+        double settleTime = -1.0;
+    };
+
+    osg::GraphicsContext* createPbuffer(int width, int height)
+    {
+        osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+        traits->readDISPLAY();
+        traits->setUndefinedScreenDetailsToDefaultScreen();
+        traits->x = 0;
+        traits->y = 0;
+        traits->width = width;
+        traits->height = height;
+        traits->windowDecoration = false;
+        traits->doubleBuffer = true;
+        traits->sharedContext = 0;
+        traits->pbuffer = true;
+        return osg::GraphicsContext::createGraphicsContext(traits.get());
+    }
+
+    // Number of visible terrain tiles still waiting on data in the last frame
+    int getTilesLoading(osgViewer::Viewer& viewer)
+    {
+        double value = 0.0;
+        osg::Stats* stats = viewer.getCamera()->getStats();
+        unsigned frame = viewer.getFrameStamp()->getFrameNumber();
+        stats->getAttribute(frame, "Terrain tiles loading", value);
+        return (int)value;
+    }
+
+    double getStat(osgViewer::Viewer& viewer, const std::string& name)
+    {
+        double value = 0.0;
+        viewer.getCamera()->getStats()->getAttribute(
+            viewer.getFrameStamp()->getFrameNumber(), name, value);
+        return value;
+    }
+
+    void throttle(const osg::Timer_t& frameStart, double period)
+    {
+        double spent = osg::Timer::instance()->delta_s(frameStart, osg::Timer::instance()->tick());
+        if (spent < period)
+            std::this_thread::sleep_for(std::chrono::duration<double>(period - spent));
+    }
+
+    int record(osgViewer::Viewer& viewer, const std::string& filename)
+    {
+        osg::ref_ptr<osg::AnimationPath> path = new osg::AnimationPath();
+        path->setLoopMode(osg::AnimationPath::NO_LOOPING);
+
+        viewer.realize();
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        while (!viewer.done())
+        {
+            viewer.frame();
+
+            double t = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+            const osg::Matrixd& m = viewer.getCamera()->getInverseViewMatrix();
+            path->insert(t, osg::AnimationPath::ControlPoint(m.getTrans(), m.getRotate()));
+        }
+
+        std::ofstream out(filename.c_str());
+        if (!out.is_open())
+        {
+            OE_WARN << LC << "Cannot write " << filename << std::endl;
+            return -1;
+        }
+        path->write(out);
+
+        OE_NOTICE << LC << "Recorded " << path->getTimeControlPointMap().size()
+            << " samples (" << path->getPeriod() << " s) to " << filename << std::endl;
+        return 0;
+    }
+
+    // Renders frames at the given rate until the terrain stops loading.
+    // Returns the time it took, or a negative number on timeout.
+    double settle(osgViewer::Viewer& viewer, double period, double timeout)
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        int idleFrames = 0;
+        while (!viewer.done())
+        {
+            osg::Timer_t frameStart = osg::Timer::instance()->tick();
+            viewer.frame();
+
+            idleFrames = getTilesLoading(viewer) == 0 ? idleFrames + 1 : 0;
+            double t = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+            if (idleFrames >= SETTLED_FRAMES)
+                return t;
+            if (t > timeout)
+                break;
+
+            throttle(frameStart, period);
+        }
+        return -1.0;
+    }
+
+    int replay(osgViewer::Viewer& viewer, const std::string& filename, double fps, double timeout)
+    {
+        osg::ref_ptr<osg::AnimationPath> path = new osg::AnimationPath();
+        std::ifstream in(filename.c_str());
+        if (!in.is_open())
+        {
+            OE_WARN << LC << "Cannot read " << filename << std::endl;
+            return -1;
+        }
+        path->read(in);
+        if (path->empty())
+        {
+            OE_WARN << LC << "No camera path in " << filename << std::endl;
+            return -1;
+        }
+
+        osg::Camera* camera = viewer.getCamera();
+        camera->getStats()->collectStats("terrain", true);
+
+        const double period = 1.0 / fps;
+        const double duration = path->getPeriod();
+
+        // Start from a fully loaded view at the beginning of the path
+        osg::Matrixd m;
+        path->getMatrix(path->getFirstTime(), m);
+        camera->setViewMatrix(osg::Matrixd::inverse(m));
+        viewer.realize();
+
+        double warmup = settle(viewer, period, timeout);
+        if (warmup < 0.0)
+            OE_WARN << LC << "Terrain did not settle at the start of the path; results will be skewed" << std::endl;
+
+        Report report;
+        double dispatched0 = getStat(viewer, "Terrain prefetch dispatched");
+        double hits0 = getStat(viewer, "Terrain prefetch hits");
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        double episodeStart = -1.0;
+        double t = 0.0;
+
+        // Fly the path in real time, so the loader sees the same pressure
+        // as it would interactively.
+        while (!viewer.done() && t <= duration)
+        {
+            osg::Timer_t frameStart = osg::Timer::instance()->tick();
+            t = osg::Timer::instance()->delta_s(start, frameStart);
+
+            path->getMatrix(path->getFirstTime() + std::min(t, duration), m);
+            camera->setViewMatrix(osg::Matrixd::inverse(m));
+            viewer.frame();
+
+            ++report.frames;
+            if (getTilesLoading(viewer) == 0)
+            {
+                ++report.framesAtFullRes;
+                if (episodeStart >= 0.0)
+                {
+                    report.intervals.push_back(t - episodeStart);
+                    episodeStart = -1.0;
+                }
+            }
+            else if (episodeStart < 0.0)
+            {
+                episodeStart = t;
+            }
+
+            throttle(frameStart, period);
+        }
+
+        // Time to full resolution once the camera comes to rest
+        report.settleTime = settle(viewer, period, timeout);
+        if (episodeStart >= 0.0 && report.settleTime >= 0.0)
+            report.intervals.push_back(duration - episodeStart + report.settleTime);
+
+        double total = 0.0, longest = 0.0;
+        for (double i : report.intervals)
+        {
+            total += i;
+            longest = std::max(longest, i);
+        }
+
+        std::cout
+            << "Path: " << filename << " (" << duration << " s)" << std::endl
+            << "Frames rendered: " << report.frames << std::endl
+            << "Frames at full resolution: " << report.framesAtFullRes
+            << " (" << (report.frames > 0 ? 100.0 * report.framesAtFullRes / report.frames : 0.0) << "%)" << std::endl
+            << "Low-resolution episodes: " << report.intervals.size() << std::endl
+            << "Time to full resolution: mean "
+            << (report.intervals.empty() ? 0.0 : total / report.intervals.size()) << " s"
+            << ", max " << longest << " s"
+            << ", total " << total << " s" << std::endl
+            << "Settle time after path end: ";
+        if (report.settleTime >= 0.0)
+            std::cout << report.settleTime << " s" << std::endl;
+        else
+            std::cout << "timed out" << std::endl;
+
+        std::cout
+            << "Prefetch requests: " << (getStat(viewer, "Terrain prefetch dispatched") - dispatched0)
+            << ", used by tiles: " << (getStat(viewer, "Terrain prefetch hits") - hits0) << std::endl;
+
+        return 0;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osgEarth::initialize();
+
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if (arguments.read("--help"))
+        return usage(argv[0]);
+
+    std::string recordFile, replayFile;
+    arguments.read("--record", recordFile);
+    arguments.read("--replay", replayFile);
+    if (recordFile.empty() == replayFile.empty())
+        return usage(argv[0]);
+
+    bool prefetch = arguments.read("--prefetch");
+    unsigned prefetchFrames = 0u, prefetchBudget = 0u;
+    arguments.read("--prefetch-frames", prefetchFrames);
+    arguments.read("--prefetch-budget", prefetchBudget);
+
+    int width = 1280, height = 720;
+    arguments.read("--size", width, height);
+
+    double fps = 60.0, timeout = 60.0;
+    arguments.read("--fps", fps);
+    arguments.read("--timeout", timeout);
+
+    osgViewer::Viewer viewer(arguments);
+
+    if (!recordFile.empty())
+    {
+        viewer.setCameraManipulator(new EarthManipulator(arguments));
+    }
+    else
+    {
+        osg::ref_ptr<osg::GraphicsContext> gc = createPbuffer(width, height);
+        if (!gc.valid())
+        {
+            OE_WARN << LC << "Failed to create a pbuffer for headless replay" << std::endl;
+            return -1;
+        }
+
+        osg::Camera* camera = viewer.getCamera();
+        camera->setGraphicsContext(gc.get());
+        camera->setViewport(0, 0, width, height);
+        camera->setProjectionMatrixAsPerspective(30.0, (double)width / (double)height, 1.0, 1.0e7);
+        GLenum buffer = gc->getTraits()->doubleBuffer ? GL_BACK : GL_FRONT;
+        camera->setDrawBuffer(buffer);
+        camera->setReadBuffer(buffer);
+
+        // one thread, so the stats we read belong to the frame just drawn
+        viewer.setThreadingModel(viewer.SingleThreaded);
+    }
+
+    viewer.getCamera()->setSmallFeatureCullingPixelSize(-1.0f);
+
+    osg::Node* node = MapNodeHelper().load(arguments, &viewer);
+    MapNode* mapNode = MapNode::get(node);
+    if (!mapNode)
+        return usage(argv[0]);
+
+    if (prefetch)
+        mapNode->getTerrainOptions().setPrefetch(true);
+    if (prefetchFrames > 0u)
+        mapNode->getTerrainOptions().setPrefetchFrames(prefetchFrames);
+    if (prefetchBudget > 0u)
+        mapNode->getTerrainOptions().setPrefetchBudget(prefetchBudget);
+
+    viewer.setSceneData(node);
+
+    if (!recordFile.empty())
+        return record(viewer, recordFile);
+    else
+        return replay(viewer, replayFile, fps, timeout);
+}
@@ -94,3 +94,32 @@ AttributesFilter::push(FeatureList& input, FilterContext& context)
 
     return context;
 }
+
+FilterContext
+AttributesFilter::push(FeatureBatch& input, FilterContext& context)
+{
+    // resolve the names once, then test the columns:
+    std::vector<int> fields;
+    for (auto& a : _attributes)
+    {
+        int field = input.getSchema()->find(a);
+        if (field >= 0)
+            fields.push_back(field);
+    }
+
+    std::vector<bool> keep(input.size(), false);
+    for (unsigned row = 0; row < input.size(); ++row)
+    {
+        for (auto field : fields)
+        {
+            if (input.hasAttr(row, field))
+            {
+                keep[row] = true;
+                break;
+            }
+        }
+    }
+
+    input.select(keep);
+    return context;
+}
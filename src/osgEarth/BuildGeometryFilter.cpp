@@ -114,7 +114,8 @@ _maxAngle_deg ( 180.0 ),
 _geoInterp    ( GEOINTERP_RHUMB_LINE ),
 _maxPolyTilingAngle_deg( 45.0f ),
 _optimizeVertexOrdering( false ),
-_maximumCreaseAngle(Angle(0.0, Units::DEGREES))
+_maximumCreaseAngle(Angle(0.0, Units::DEGREES)),
+_tessellationMethod(Tessellator::METHOD_AUTO)
 {
     //nop
 }
@@ -790,7 +791,7 @@ namespace
      * Tesselates an osg::Geometry using the osgEarth tesselator.
      * If it fails, fall back to the osgUtil tesselator.
      */
-    bool tesselateGeometry(osg::Geometry* geometry, bool useOSGTessellator)
+    bool tesselateGeometry(osg::Geometry* geometry, bool useOSGTessellator, Tessellator::Method method)
     {
         if (useOSGTessellator) {
             osgUtil::Tessellator tess;
@@ -800,6 +801,7 @@ namespace
         }
         else {
             osgEarth::Tessellator oeTess;
+            oeTess.setMethod(method);
             if (!oeTess.tessellateGeometry(*geometry))
             {
                 osgUtil::Tessellator tess;
@@ -1057,6 +1059,7 @@ BuildGeometryFilter::tileAndBuildPolygon(
 
     // tessellate
     Tessellator tess;
+    tess.setMethod(*_tessellationMethod);
 
     std::vector<uint32_t> indices;
     if (tess.tessellate2D(proj.get(), indices, plane) == false)
@@ -1165,7 +1168,7 @@ BuildGeometryFilter::tileAndBuildPolygon(Geometry*               ring,
             if ( temp->getNumPrimitiveSets() > 0 )
             {
                 // Tesselate the polygon while the coordinates are still in the LTP
-                if (tesselateGeometry( temp.get(), useOSGTessellator().value() ))
+                if (tesselateGeometry( temp.get(), useOSGTessellator().value(), tessellationMethod().value() ))
                 {
                     osg::Vec3Array* verts = static_cast<osg::Vec3Array*>(temp->getVertexArray());
                     if ( verts->getNumElements() > 0 )
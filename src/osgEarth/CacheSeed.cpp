@@ -35,8 +35,8 @@ _map( map )
 {
 }
 
-bool CacheTileHandler::handleTile(const TileKey& key, const TileVisitor& tv)
-{        
+bool CacheTileHandler::readTile(const TileKey& key, osg::ref_ptr<osg::Referenced>& data)
+{
     ImageLayer* imageLayer = dynamic_cast< ImageLayer* >( _layer.get() );
     ElevationLayer* elevationLayer = dynamic_cast< ElevationLayer* >( _layer.get() );    
 
@@ -58,6 +58,17 @@ bool CacheTileHandler::handleTile(const TileKey& key, const TileVisitor& tv)
         }            
     }
 
+    return false;
+}
+
+bool CacheTileHandler::handleTile(const TileKey& key, const TileVisitor& tv)
+{        
+    osg::ref_ptr<osg::Referenced> data;
+    if (readTile(key, data))
+    {
+        return true;
+    }
+
     // If we didn't produce a result but the key isn't within range then we should continue to 
     // traverse the children b/c a min level was set.
     if (!_layer->isKeyInLegalRange(key))
@@ -117,5 +128,33 @@ void CacheSeed::setVisitor(TileVisitor* visitor)
 void CacheSeed::run( TileLayer* layer, const Map* map )
 {
     _visitor->setTileHandler( new CacheTileHandler( layer, map ) );
+
+    // Unless the caller set its own, give the visitor the layer's data
+    // extents so it can skip subtrees the layer has no data for.
+    bool useLayerExtents = _visitor->getDataExtents().empty();
+    if (useLayerExtents)
+    {
+        const Profile* layerProfile = layer->getProfile();
+        for (auto& de : layer->getDataExtents())
+        {
+            GeoExtent extent = de.transform(map->getSRS());
+            if (!extent.isValid())
+                continue;
+
+            // data extent levels are in the layer's profile
+            DataExtent mapExtent(extent);
+            if (de.minLevel().isSet())
+                mapExtent.minLevel() = layerProfile ? map->getProfile()->getEquivalentLOD(layerProfile, de.minLevel().get()) : de.minLevel().get();
+            if (de.maxLevel().isSet())
+                mapExtent.maxLevel() = layerProfile ? map->getProfile()->getEquivalentLOD(layerProfile, de.maxLevel().get()) : de.maxLevel().get();
+            _visitor->addDataExtent(mapExtent);
+        }
+    }
+
     _visitor->run( map->getProfile() );
+
+    if (useLayerExtents)
+    {
+        _visitor->clearDataExtents();
+    }
 }
\ No newline at end of file
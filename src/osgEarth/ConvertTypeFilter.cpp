@@ -87,3 +87,10 @@ ConvertTypeFilter::push( FeatureList& input, FilterContext& context )
 
     return context;
 }
+
+FilterContext
+ConvertTypeFilter::push( FeatureBatch& input, FilterContext& context )
+{
+    input.convertGeometry(_toType);
+    return context;
+}
@@ -21,6 +21,7 @@
 #include <osgEarth/Map>
 #include <osgEarth/Progress>
 #include <osgEarth/Metrics>
+#include <cfloat>
 
 using namespace osgEarth;
 
@@ -209,6 +210,29 @@ ElevationTexture::generateNormalMap(
 #undef LC
 #define LC "[NormalMapGenerator] "
 
+namespace
+{
+    // Key of the tile next to "key", or false if there's none (past the
+    // poles, or past the edge of a profile that doesn't wrap around)
+    bool getNeighborKey(const TileKey& key, int xoffset, int yoffset, TileKey& out)
+    {
+        unsigned tx, ty;
+        key.getProfile()->getNumTiles(key.getLOD(), tx, ty);
+
+        int x = (int)key.getTileX() + xoffset;
+        int y = (int)key.getTileY() + yoffset;
+
+        if (y < 0 || y >= (int)ty)
+            return false;
+
+        if ((x < 0 || x >= (int)tx) && key.getProfile()->getLatLongExtent().width() < 360.0)
+            return false;
+
+        out = key.createNeighborKey(xoffset, yoffset);
+        return true;
+    }
+}
+
 osg::Texture2D*
 NormalMapGenerator::createNormalMap(
     const TileKey& key,
@@ -224,30 +248,13 @@ NormalMapGenerator::createNormalMap(
 
     ElevationPool::WorkingSet* workingSet = static_cast<ElevationPool::WorkingSet*>(ws);
 
-    osg::ref_ptr<osg::Image> image = new osg::Image();
-    image->allocateImage(
-        ELEVATION_TILE_SIZE, ELEVATION_TILE_SIZE, 1,
-        GL_RG, GL_UNSIGNED_BYTE);
-
     ElevationPool* pool = map->getElevationPool();
 
-    ImageUtils::PixelWriter write(image.get());
-
-    ImageUtils::PixelWriter writeRuggedness(ruggedness);
-
-    osg::Vec3 normal;
-    osg::Vec2 packedNormal;
-    osg::Vec4 pixel;
-
-    GeoPoint
-        north(key.getProfile()->getSRS()),
-        south(key.getProfile()->getSRS()),
-        east(key.getProfile()->getSRS()),
-        west(key.getProfile()->getSRS());
-
-    osg::Vec3 a[4];
-
+    const int size = ELEVATION_TILE_SIZE;
+    const int stride = size + 2;
     const GeoExtent& ex = key.getExtent();
+    const double spacingX = ex.width() / (double)(size - 1);
+    const double spacingY = ex.height() / (double)(size - 1);
 
     // fetch the base tile in order to get resolutions data.
     osg::ref_ptr<ElevationTexture> heights;
@@ -256,121 +263,147 @@ NormalMapGenerator::createNormalMap(
     if (!heights.valid())
         return NULL;
 
-    // build the sample set.
-    std::vector<osg::Vec4d> points(write.s() * write.t() * 4);
-    int p = 0;
-    for(int t=0; t<write.t(); ++t)
-    {
-        double v = (double)t/(double)(write.t()-1);
-        double y = ex.yMin() + v*ex.height();
-        east.y() = y;
-        west.y() = y;
+    // Heights of the tile with a one-texel apron all around. Edge texels are
+    // shared by neighboring tiles, so the apron comes from the texels next
+    // to the neighbor's edge.
+    std::vector<float> grid(stride*stride, NO_DATA_VALUE);
+    std::vector<unsigned char> filled(stride*stride, 0);
 
-        for(int s=0; s<write.s(); ++s)
+    // copies a row (dcol=1) or column (drow=1) of heights into the grid
+    auto copyTexels = [&](const osg::HeightField* hf, int col, int row, int dcol, int drow, int dest, int destStep)
+    {
+        for (int i = 0; i < size; ++i, dest += destStep)
         {
-            double u = (double)s/(double)(write.s()-1);
-            double x = ex.xMin() + u*ex.width();
-            north.x() = x;
-            south.x() = x;
-
-            double r = heights->getResolution(s, t);
-
-            east.x() = x + r;
-            west.x() = x - r;
-            north.y() = y + r;
-            south.y() = y - r;
-
-            points[p++].set(west.x(), west.y(), 0.0, r);
-            points[p++].set(east.x(), east.y(), 0.0, r);
-            points[p++].set(south.x(), south.y(), 0.0, r);
-            points[p++].set(north.x(), north.y(), 0.0, r);
+            grid[dest] = hf->getHeight(col + i*dcol, row + i*drow);
+            filled[dest] = 1;
         }
-    }
+    };
 
-    int sampleOK = map->getElevationPool()->sampleMapCoords(
-        points,
-        workingSet,
-        progress);
-
-    if (progress && progress->isCanceled())
+    auto usable = [&](const ElevationTexture* tex, const TileKey& k)
     {
-        // canceled. Bail.
-        return NULL;
-    }
-
-    if (sampleOK < 0)
+        return
+            tex && tex->getTileKey() == k &&
+            tex->getHeightField() &&
+            (int)tex->getHeightField()->getNumColumns() == size &&
+            (int)tex->getHeightField()->getNumRows() == size;
+    };
+
+    // When the pool falls back on a lower-res tile, its heights don't line
+    // up with ours and everything is sampled below.
+    const float* resolutions = nullptr;
+    if (usable(heights.get(), key))
     {
-        OE_WARN << LC << "Internal error - contact support" << std::endl;
-        return NULL;
-    }
+        const osg::HeightField* hf = heights->getHeightField();
+        for (int t = 0; t < size; ++t)
+            copyTexels(hf, 0, t, 1, 0, (t + 1)*stride + 1, 1);
 
-    Distance res(0.0, key.getProfile()->getSRS()->getUnits());
-    double dx, dy;
-    osg::Vec4 riPixel;
+        if (heights->getResolutions().size() == (std::size_t)(size*size))
+            resolutions = &heights->getResolutions()[0];
+    }
 
-    for(int t=0; t<write.t(); ++t)
+    // Neighbors; the tile keys' y axis points south.
+    // east (apron column size+1) <- neighbor column 1
+    // west (apron column 0)      <- neighbor column size-2
+    // north (apron row size+1)   <- neighbor row 1
+    // south (apron row 0)        <- neighbor row size-2
+    const int offsets[4][2] = { {1, 0}, {-1, 0}, {0, -1}, {0, 1} };
+    for (int n = 0; n < 4; ++n)
     {
-        double v = (double)t/(double)(write.t()-1);
-        double y_or_lat = ex.yMin() + v*ex.height();
+        TileKey neighborKey;
+        if (!getNeighborKey(key, offsets[n][0], offsets[n][1], neighborKey))
+            continue;
 
-        for(int s=0; s<write.s(); ++s)
-        {
-            int p = (4*write.s()*t + 4*s);
+        osg::ref_ptr<ElevationTexture> neighbor;
+        pool->getTile(neighborKey, true, neighbor, workingSet, progress);
 
-            res.set(points[p].w(), res.getUnits());
-            dx = res.asDistance(Units::METERS, y_or_lat);
-            dy = res.asDistance(Units::METERS, 0.0);
+        if (progress && progress->isCanceled())
+            return NULL;
 
-            riPixel.r() = 0.0f;
-
-            // only attempt to create a normal vector if all the data is valid:
-            // a valid resolution value and four valid corner points.
-            if (res.getValue() != FLT_MAX &&
-                points[p+0].z() != NO_DATA_VALUE &&
-                points[p+1].z() != NO_DATA_VALUE &&
-                points[p+2].z() != NO_DATA_VALUE &&
-                points[p+3].z() != NO_DATA_VALUE)
-            {
-                a[0].set(-dx, 0, points[p+0].z());
-                a[1].set( dx, 0, points[p+1].z());
-                a[2].set(0, -dy, points[p+2].z());
-                a[3].set(0,  dy, points[p+3].z());
+        if (!usable(neighbor.get(), neighborKey))
+            continue;
 
-                normal = (a[1]-a[0]) ^ (a[3]-a[2]);
-                normal.normalize();
+        const osg::HeightField* hf = neighbor->getHeightField();
+        switch (n)
+        {
+        case 0: copyTexels(hf, 1, 0, 0, 1, stride + size + 1, stride); break;
+        case 1: copyTexels(hf, size - 2, 0, 0, 1, stride, stride); break;
+        case 2: copyTexels(hf, 0, 1, 1, 0, (size + 1)*stride + 1, 1); break;
+        case 3: copyTexels(hf, 0, size - 2, 1, 0, 1, 1); break;
+        }
+    }
 
-                if (ruggedness)
-                {
-                    // rudimentary normalized ruggedness index
-                    riPixel.r() = 0.25 * (
-                        fabs(points[p + 0].z() - points[p + 3].z()) +
-                        fabs(points[p + 1].z() - points[p + 0].z()) +
-                        fabs(points[p + 2].z() - points[p + 1].z()) +
-                        fabs(points[p + 3].z() - points[p + 2].z()));
-                    riPixel.r() = clamp(riPixel.r() / (float)dy, 0.0f, 1.0f);
-                    riPixel.r() = harden(harden(riPixel.r()));
-                }
-            }
-            else
+    // Sample whatever we couldn't copy (except the unused apron corners).
+    std::vector<osg::Vec4d> points;
+    std::vector<int> indices;
+    for (int t = 0; t < stride; ++t)
+    {
+        for (int s = 0; s < stride; ++s)
+        {
+            bool corner = (s == 0 || s == stride - 1) && (t == 0 || t == stride - 1);
+            int k = t*stride + s;
+            if (!filled[k] && !corner)
             {
-                normal.set(0,0,1);
+                points.push_back(osg::Vec4d(
+                    ex.xMin() + (double)(s - 1)*spacingX,
+                    ex.yMin() + (double)(t - 1)*spacingY,
+                    0.0,
+                    spacingY));
+                indices.push_back(k);
             }
+        }
+    }
 
-            NormalMapGenerator::pack(normal, pixel);
-
-            // TODO: won't actually be written until we make the format GL_RGB
-            // but we need to rewrite the curvature generator first
-            //pixel.b() = 0.0f; // 0.5f*(1.0f+normalMap->getCurvature(s, t));
+    if (!points.empty())
+    {
+        int sampleOK = pool->sampleMapCoords(points, workingSet, progress);
 
-            write(pixel, s, t);
+        if (progress && progress->isCanceled())
+        {
+            // canceled. Bail.
+            return NULL;
+        }
 
-            if (ruggedness)
-            {
-                writeRuggedness(riPixel, s, t);
-            }
+        if (sampleOK < 0)
+        {
+            OE_WARN << LC << "Internal error - contact support" << std::endl;
+            return NULL;
         }
+
+        for (unsigned i = 0; i < points.size(); ++i)
+            grid[indices[i]] = points[i].z();
     }
 
+    // An apron with no data at all (beyond the edge of the map) repeats
+    // the edge of the tile.
+    for (int i = 1; i <= size; ++i)
+    {
+        if (grid[i] == NO_DATA_VALUE) grid[i] = grid[stride + i];
+        if (grid[(stride - 1)*stride + i] == NO_DATA_VALUE) grid[(stride - 1)*stride + i] = grid[(stride - 2)*stride + i];
+        if (grid[i*stride] == NO_DATA_VALUE) grid[i*stride] = grid[i*stride + 1];
+        if (grid[i*stride + stride - 1] == NO_DATA_VALUE) grid[i*stride + stride - 1] = grid[i*stride + stride - 2];
+    }
+
+    // Texel spacing in meters, which for a geographic tile depends on the latitude
+    std::vector<double> dx(size);
+    Distance spacing(spacingX, key.getProfile()->getSRS()->getUnits());
+    for (int t = 0; t < size; ++t)
+        dx[t] = spacing.asDistance(Units::METERS, ex.yMin() + (double)t*spacingY);
+    double dy = Distance(spacingY, spacing.getUnits()).asDistance(Units::METERS, 0.0);
+
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage(size, size, 1, GL_RG, GL_UNSIGNED_BYTE);
+
+    bool writeRuggedness =
+        ruggedness &&
+        ruggedness->s() == size && ruggedness->t() == size &&
+        ruggedness->getPixelFormat() == GL_RED &&
+        ruggedness->getDataType() == GL_UNSIGNED_BYTE;
+
+    createNormals(
+        &grid[0], size, size, &dx[0], dy, resolutions,
+        image->data(),
+        writeRuggedness ? ruggedness->data() : nullptr);
+
     osg::Texture2D* normalTex = new osg::Texture2D(image.get());
 
     normalTex->setInternalFormat(GL_RG8);
@@ -385,6 +418,82 @@ NormalMapGenerator::createNormalMap(
     return normalTex;
 }
 
+void
+NormalMapGenerator::createNormals(
+    const float* heights,
+    int width,
+    int height,
+    const double* dx,
+    double dy,
+    const float* resolutions,
+    unsigned char* normals,
+    unsigned char* ruggedness)
+{
+    const int stride = width + 2;
+    const float fdy = (float)dy;
+
+    // The inner loops have no calls or branches (no-data texels are masked
+    // out arithmetically) so that the compiler can vectorize them.
+    for (int t = 0; t < height; ++t)
+    {
+        const float* row = heights + (t + 1)*stride + 1;
+        const float* south = row - stride;
+        const float* north = row + stride;
+        unsigned char* out = normals + 2 * t*width;
+        const float fdx = (float)dx[t];
+
+        // The normal is the cross product of the central differences,
+        // (-dy*(e-w), -dx*(n-s), 2*dx*dy) up to a scale factor. Octahedral
+        // packing divides out the scale anyway, so no sqrt is needed.
+        for (int s = 0; s < width; ++s)
+        {
+            float w = row[s - 1], e = row[s + 1], so = south[s], no = north[s];
+            float valid = (float)(
+                (w != NO_DATA_VALUE) & (e != NO_DATA_VALUE) &
+                (so != NO_DATA_VALUE) & (no != NO_DATA_VALUE));
+
+            float nx = valid * -fdy * (e - w);
+            float ny = valid * -fdx * (no - so);
+            float nz = 2.0f * fdx * fdy;
+            float d = 1.0f / (fabsf(nx) + fabsf(ny) + nz);
+
+            out[2 * s + 0] = (unsigned char)(int)(127.5f * (nx*d + 1.0f));
+            out[2 * s + 1] = (unsigned char)(int)(127.5f * (ny*d + 1.0f));
+        }
+
+        unsigned char* ri = ruggedness ? ruggedness + t*width : nullptr;
+        if (ri)
+        {
+            // rudimentary normalized ruggedness index
+            for (int s = 0; s < width; ++s)
+            {
+                float w = row[s - 1], e = row[s + 1], so = south[s], no = north[s];
+                float valid = (float)(
+                    (w != NO_DATA_VALUE) & (e != NO_DATA_VALUE) &
+                    (so != NO_DATA_VALUE) & (no != NO_DATA_VALUE));
+
+                float r = 0.25f * (fabsf(w - no) + fabsf(e - w) + fabsf(so - e) + fabsf(no - so));
+                r = harden(harden(fminf(fmaxf(r / fdy, 0.0f), 1.0f)));
+                ri[s] = (unsigned char)(int)(255.0f * valid * r);
+            }
+        }
+
+        // texels without data get a vertical normal
+        const float* res = resolutions ? resolutions + t*width : nullptr;
+        if (res)
+        {
+            for (int s = 0; s < width; ++s)
+            {
+                if (res[s] == FLT_MAX)
+                {
+                    out[2 * s + 0] = out[2 * s + 1] = 127;
+                    if (ri) ri[s] = 0;
+                }
+            }
+        }
+    }
+}
+
 void
 NormalMapGenerator::pack(const osg::Vec3& n, osg::Vec4& p)
 {
@@ -27,6 +27,9 @@
 
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <functional>
+#include <memory>
 
 using namespace osgEarth;
 
@@ -59,6 +62,188 @@ ElevationPool::StrongLRU::clear()
 }
 
 
+// default byte budget for the shared L2 cache
+#define OE_ELEVPOOL_DEFAULT_BUDGET (64u * 1024u * 1024u)
+
+namespace
+{
+    // approximate memory held by an elevation texture
+    std::size_t getSizeInBytes(const ElevationTexture* tex)
+    {
+        std::size_t bytes = tex->getResolutions().size() * sizeof(float);
+
+        const osg::Image* image = tex->getImage(0);
+        if (image)
+            bytes += image->getTotalSizeInBytes();
+
+        const osg::HeightField* hf = tex->getHeightField();
+        if (hf)
+            bytes += hf->getNumColumns() * hf->getNumRows() * sizeof(float);
+
+        return bytes;
+    }
+}
+
+ElevationPool::ShardedLUT::ShardedLUT(std::size_t budgetBytes) :
+    _budgetPerShard(budgetBytes / NUM_SHARDS),
+    _hits(0u),
+    _misses(0u),
+    _evictions(0u)
+{
+    for (unsigned i = 0; i < NUM_SHARDS; ++i)
+        _shards[i]._mutex.setName("OE.ElevPool.L2[" + std::to_string(i) + "]");
+}
+
+ElevationPool::ShardedLUT::Shard&
+ElevationPool::ShardedLUT::shard(const Internal::RevElevationKey& key)
+{
+    std::size_t h = key.hash();
+    return _shards[(h ^ (h >> 16)) % NUM_SHARDS];
+}
+
+bool
+ElevationPool::ShardedLUT::get(const Internal::RevElevationKey& key, Pointer& output)
+{
+    Shard& s = shard(key);
+    ScopedMutexLock lock(s._mutex);
+
+    auto i = s._entries.find(key);
+    if (i != s._entries.end())
+    {
+        i->second._weak.lock(output);
+        if (output.valid())
+        {
+            i->second._referenced = true;
+            _hits++;
+            return true;
+        }
+        else
+        {
+            // observer was orphaned..remove it. (An entry with a strong
+            // reference can never be orphaned, so it is not in the clock.)
+            s._entries.erase(i);
+        }
+    }
+
+    _misses++;
+    return false;
+}
+
+void
+ElevationPool::ShardedLUT::put(const Internal::RevElevationKey& key, Pointer& value)
+{
+    if (!value.valid())
+        return;
+
+    Shard& s = shard(key);
+    ScopedMutexLock lock(s._mutex);
+
+    Entry& entry = s._entries[key];
+    entry._weak = value.get();
+    entry._referenced = true;
+
+    if (entry._strong.get() != value.get())
+    {
+        if (entry._strong.valid())
+        {
+            s._bytes -= entry._bytes;
+        }
+        else
+        {
+            s._clock.push_back(key);
+        }
+
+        entry._strong = value;
+        entry._bytes = getSizeInBytes(value.get());
+        s._bytes += entry._bytes;
+    }
+
+    evict(s);
+}
+
+void
+ElevationPool::ShardedLUT::evict(Shard& s)
+{
+    // CLOCK: sweep the hand around the resident entries, giving each
+    // recently referenced entry a second chance before dropping its
+    // strong reference. The weak entry stays in case someone else
+    // is still holding the texture. (Call with the shard locked.)
+    const std::size_t budget = _budgetPerShard;
+
+    while (s._bytes > budget && !s._clock.empty())
+    {
+        if (s._hand >= s._clock.size())
+            s._hand = 0u;
+
+        auto i = s._entries.find(s._clock[s._hand]);
+
+        if (i != s._entries.end() && i->second._referenced)
+        {
+            i->second._referenced = false;
+            ++s._hand;
+        }
+        else
+        {
+            if (i != s._entries.end())
+            {
+                s._bytes -= i->second._bytes;
+                i->second._strong = nullptr;
+                i->second._bytes = 0u;
+                _evictions++;
+            }
+
+            s._clock[s._hand] = s._clock.back();
+            s._clock.pop_back();
+        }
+    }
+}
+
+void
+ElevationPool::ShardedLUT::setBudget(std::size_t bytes)
+{
+    _budgetPerShard = bytes / NUM_SHARDS;
+
+    for (unsigned i = 0; i < NUM_SHARDS; ++i)
+    {
+        ScopedMutexLock lock(_shards[i]._mutex);
+        evict(_shards[i]);
+    }
+}
+
+void
+ElevationPool::ShardedLUT::clear()
+{
+    for (unsigned i = 0; i < NUM_SHARDS; ++i)
+    {
+        Shard& s = _shards[i];
+        ScopedMutexLock lock(s._mutex);
+        s._entries.clear();
+        s._clock.clear();
+        s._hand = 0u;
+        s._bytes = 0u;
+    }
+}
+
+ElevationPool::CacheStats
+ElevationPool::ShardedLUT::getStats()
+{
+    CacheStats stats;
+    stats.hits = _hits;
+    stats.misses = _misses;
+    stats.evictions = _evictions;
+    stats.budget = _budgetPerShard * NUM_SHARDS;
+    stats.bytes = 0u;
+    stats.entries = 0u;
+
+    for (auto& shard : _shards)
+    {
+        ScopedMutexLock lock(shard._mutex);
+        stats.bytes += shard._bytes;
+        stats.entries += shard._entries.size();
+    }
+    return stats;
+}
+
 void
 ElevationPool::MapCallbackAdapter::onMapModelChanged(const MapModelChange& c)
 {
@@ -71,11 +256,8 @@ ElevationPool::ElevationPool() :
     _mapDataDirty(true),
     _workers(0),
     _refreshMutex("OE.ElevPool.RM"),
-    _globalLUTMutex("OE.ElevPool.GLUT"),
-    _L2(64u)
+    _L2(OE_ELEVPOOL_DEFAULT_BUDGET)
 {
-    _L2._lru.setName("OE.ElevPool.LRU");
-
     // adapter for detecting elevation layer changes
     _mapCallback = new MapCallbackAdapter();
 }
@@ -95,6 +277,18 @@ ElevationPool::clear()
     _mapDataDirty = true;
 }
 
+void
+ElevationPool::setCacheBudget(std::size_t bytes)
+{
+    _L2.setBudget(bytes);
+}
+
+ElevationPool::CacheStats
+ElevationPool::getCacheStats() const
+{
+    return _L2.getStats();
+}
+
 void
 ElevationPool::setMap(const Map* map)
 {
@@ -214,10 +408,6 @@ ElevationPool::refresh(const Map* map)
     }
 
     _L2.clear();
-
-    _globalLUTMutex.write_lock();
-    _globalLUT.clear();
-    _globalLUTMutex.write_unlock();
 }
 
 int
@@ -266,32 +456,11 @@ ElevationPool::findExistingRaster(
     *fromL2 = false;
     *fromLUT = false;
 
-    // Next check the system LUT -- see if someone somewhere else
+    // Check the system LUT -- see if someone somewhere else
     // already has it (the terrain or another WorkingSet)
-    optional<Internal::RevElevationKey> orphanedKey;
-    {
-        ScopedReadLock lock(_globalLUTMutex);
-
-        auto i = _globalLUT.find(key);
-        if (i != _globalLUT.end())
-        {
-            i->second.lock(output);
-            if (output.valid())
-            {
-                *fromLUT = true;
-            }
-            else
-            {
-                // observer was orphaned..remove it
-                orphanedKey = key;
-            }
-        }
-    }
-
-    if (orphanedKey.isSet())
+    if (_L2.get(key, output))
     {
-        ScopedWriteLock lock(_globalLUTMutex);
-        _globalLUT.erase(orphanedKey.get());
+        *fromLUT = true;
     }
 
     // found it, so stick it in the L2 cache
@@ -392,15 +561,8 @@ ElevationPool::getOrCreateRaster(
     if (ws)
         ws->_lru.push(result);
 
-    // update the L2 cache:
-    _L2.push(result);
-
-    // update system weak-LUT:
-    if (!fromLUT)
-    {
-        ScopedWriteLock lock(_globalLUTMutex);
-        _globalLUT[key] = result.get();
-    }
+    // update the L2 cache and system weak-LUT:
+    _L2.put(key, result);
 
     return result;
 }
@@ -458,6 +620,279 @@ namespace
     }
 }
 
+// Batch sampling engine for sampleMapCoords.
+// Points are bucketed by tile, each tile's raster is resolved once,
+// and the bilinear reads for the whole bucket run over contiguous arrays.
+// Large batches are spread across a job arena.
+#define ARENA_ELEVATION_BATCH "oe.elevationpool"
+
+// Minimum number of points before a batch is split across threads
+#define OE_ELEVPOOL_PARALLEL_THRESHOLD 16384u
+
+namespace
+{
+    // Reference from a point to the tile containing it
+    struct TileRef
+    {
+        TileRef(std::uint64_t tile_, unsigned index_) :
+            tile(tile_), index(index_) { }
+
+        std::uint64_t tile;
+        unsigned index;
+
+        bool operator < (const TileRef& rhs) const {
+            return tile < rhs.tile;
+        }
+
+        // packs (lod, x, y) into a single sortable integer
+        static std::uint64_t pack(int lod, unsigned x, unsigned y) {
+            return ((std::uint64_t)lod << 58) | ((std::uint64_t)y << 29) | (std::uint64_t)x;
+        }
+
+        TileKey unpack(const Profile* profile) const {
+            const std::uint64_t mask = (1u << 29) - 1u;
+            return TileKey(
+                (unsigned)(tile >> 58),
+                (unsigned)(tile & mask),
+                (unsigned)((tile >> 29) & mask),
+                profile);
+        }
+    };
+
+    // Bilinear interpolation over a raw float grid for a batch of
+    // normalized [0..1] coordinates. Kept branch-free in structure-of-arrays
+    // form so the compiler can vectorize it. Requires cols, rows >= 2.
+    void bilinearBatch(
+        const float* grid,
+        int cols, int rows, int stride,
+        const float* u, const float* v,
+        float* out,
+        unsigned count)
+    {
+        const float sizeS = (float)(cols - 1);
+        const float sizeT = (float)(rows - 1);
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            const float s = u[i] * sizeS;
+            const float t = v[i] * sizeT;
+
+            const int s0 = std::min((int)s, cols - 2);
+            const int t0 = std::min((int)t, rows - 2);
+
+            const float smix = s - (float)s0;
+            const float tmix = t - (float)t0;
+
+            const float* row0 = grid + t0 * stride + s0;
+            const float* row1 = row0 + stride;
+
+            const float top = row0[0] + (row0[1] - row0[0]) * smix;
+            const float bot = row1[0] + (row1[1] - row1[0]) * smix;
+
+            out[i] = top + (bot - top) * tmix;
+        }
+    }
+
+    // Sample the buckets [firstRun, lastRun) of a sorted reference list.
+    // Returns the number of valid samples, or -1 upon cancelation.
+    template<typename POINTS, typename GET_RASTER>
+    int sampleRuns(
+        POINTS& points,
+        const std::vector<TileRef>& refs,
+        const std::vector<unsigned>& runs,
+        unsigned firstRun,
+        unsigned lastRun,
+        const Profile* profile,
+        GET_RASTER& getRaster,
+        ProgressCallback* progress)
+    {
+        std::vector<float> u, v, out;
+        ElevationPool::Envelope::QuickSampleVars qvars;
+        osg::Vec4f elev;
+        int count = 0;
+
+        for (unsigned r = firstRun; r < lastRun; ++r)
+        {
+            const unsigned begin = runs[r];
+            const unsigned size = runs[r + 1] - begin;
+
+            osg::ref_ptr<ElevationTexture> raster = getRaster(refs[begin].unpack(profile));
+
+            // bail on cancelation
+            if (progress && progress->isCanceled())
+            {
+                return -1;
+            }
+
+            if (!raster.valid())
+            {
+                for (unsigned k = begin; k < begin + size; ++k)
+                    points[refs[k].index].z() = NO_DATA_VALUE;
+                continue;
+            }
+
+            const GeoExtent& ex = raster->getExtent();
+            const double xmin = ex.xMin(), ymin = ex.yMin();
+            const double width = ex.width(), height = ex.height();
+
+            u.resize(size), v.resize(size), out.resize(size);
+
+            for (unsigned k = 0; k < size; ++k)
+            {
+                const auto& p = points[refs[begin + k].index];
+
+                // Note: This can happen on the map edges..
+                // TODO: consider looping around for geo and clamping for projected
+                u[k] = (float)osg::clampBetween((p.x() - xmin) / width, 0.0, 1.0);
+                v[k] = (float)osg::clampBetween((p.y() - ymin) / height, 0.0, 1.0);
+            }
+
+            const osg::Image* image = raster->getImage(0);
+
+            if (image &&
+                image->getPixelFormat() == GL_RED &&
+                image->getDataType() == GL_FLOAT &&
+                image->s() >= 2 && image->t() >= 2)
+            {
+                bilinearBatch(
+                    reinterpret_cast<const float*>(image->data()),
+                    image->s(), image->t(),
+                    image->getRowStepInBytes() / sizeof(float),
+                    u.data(), v.data(), out.data(),
+                    size);
+            }
+            else
+            {
+                for (unsigned k = 0; k < size; ++k)
+                {
+                    quickSample(raster->reader(), u[k], v[k], elev, qvars);
+                    out[k] = elev.r();
+                }
+            }
+
+            for (unsigned k = 0; k < size; ++k)
+            {
+                points[refs[begin + k].index].z() = out[k];
+                if (out[k] != NO_DATA_VALUE)
+                    ++count;
+            }
+        }
+
+        return count;
+    }
+
+    // Shared by the threads working on one batch. Outlives the call,
+    // since jobs that never got a chunk may still run after it returns.
+    struct BatchState
+    {
+        using Function = std::function<void(unsigned)>;
+
+        BatchState(unsigned numChunks) :
+            _numChunks(numChunks), _next(0u), _done(0u), _count(0), _canceled(false),
+            _mutex("OE.ElevPool.Batch") { }
+
+        // Runs chunks until there are none left to claim
+        void run(const Function& sampleChunk)
+        {
+            for (unsigned i = _next++; i < _numChunks; i = _next++)
+            {
+                sampleChunk(i);
+                ScopedMutexLock lock(_mutex);
+                if (++_done == _numChunks)
+                    _cv.notify_all();
+            }
+        }
+
+        // Blocks until every claimed chunk is done
+        void wait()
+        {
+            ScopedMutexLock lock(_mutex);
+            _cv.wait(_mutex, [this]() { return _done == _numChunks; });
+        }
+
+        const unsigned _numChunks;
+        std::atomic<unsigned> _next;
+        unsigned _done;
+        std::atomic<int> _count;
+        std::atomic<bool> _canceled;
+        Threading::Mutex _mutex;
+        std::condition_variable_any _cv;
+    };
+
+    template<typename POINTS, typename GET_RASTER>
+    int sampleBatch(
+        POINTS& points,
+        std::vector<TileRef>& refs,
+        const Profile* profile,
+        GET_RASTER& getRaster,
+        ProgressCallback* progress)
+    {
+        if (refs.empty())
+            return 0;
+
+        std::sort(refs.begin(), refs.end());
+
+        // start index of each bucket, plus an end sentinel
+        std::vector<unsigned> runs;
+        runs.push_back(0u);
+        for (unsigned i = 1; i < refs.size(); ++i)
+            if (refs[i].tile != refs[i - 1].tile)
+                runs.push_back(i);
+        unsigned numRuns = runs.size();
+        runs.push_back(refs.size());
+
+        unsigned numChunks = std::min(numRuns, getConcurrency());
+
+        // Stay serial for small batches
+        if (refs.size() < OE_ELEVPOOL_PARALLEL_THRESHOLD || numChunks < 2u)
+        {
+            return sampleRuns(points, refs, runs, 0u, numRuns, profile, getRaster, progress);
+        }
+
+        // Split at bucket boundaries into chunks of roughly equal point count.
+        const unsigned pointsPerChunk = (refs.size() + numChunks - 1) / numChunks;
+        std::vector<unsigned> chunks;
+        chunks.push_back(0u);
+        while (chunks.back() < numRuns)
+        {
+            unsigned last = chunks.back() + 1u;
+            while (last < numRuns && runs[last] - runs[chunks.back()] < pointsPerChunk)
+                ++last;
+            chunks.push_back(last);
+        }
+
+        auto batch = std::make_shared<BatchState>(chunks.size() - 1u);
+
+        BatchState::Function sampleChunk = [&](unsigned i)
+        {
+            if (batch->_canceled)
+                return;
+            int n = sampleRuns(points, refs, runs, chunks[i], chunks[i + 1], profile, getRaster, progress);
+            if (n < 0)
+                batch->_canceled = true;
+            else
+                batch->_count += n;
+        };
+
+        // Workers and the calling thread all claim chunks from the same
+        // counter. The caller never waits on a job that has not started,
+        // so this cannot deadlock even when called from a busy (or the
+        // same) arena; a job that starts after the chunks are gone
+        // just returns.
+        Job job(JobArena::get(ARENA_ELEVATION_BATCH));
+        job.setName("oe.elevationpool.batch");
+        const BatchState::Function* sampleChunkPtr = &sampleChunk;
+        for (unsigned i = 1; i < batch->_numChunks; ++i)
+        {
+            job.dispatch([batch, sampleChunkPtr](Cancelable*) { batch->run(*sampleChunkPtr); });
+        }
+        batch->run(sampleChunk);
+        batch->wait();
+
+        return batch->_canceled ? -1 : (int)batch->_count;
+    }
+}
+
 bool
 ElevationPool::prepareEnvelope(
     ElevationPool::Envelope& env,
@@ -633,139 +1068,80 @@ ElevationPool::sampleMapCoords(
     sync(map.get(), ws);
     ScopedAtomicCounter counter(_workers);
 
-    Internal::RevElevationKey key;
-    key._revision = getElevationRevision(map.get());
-
-    osg::ref_ptr<ElevationTexture> raster;
-    osg::Vec4 elev;
-    double u, v;
-
     const Profile* profile = map->getProfile();
     double pw = profile->getExtent().width();
     double ph = profile->getExtent().height();
     double pxmin = profile->getExtent().xMin();
     double pymin = profile->getExtent().yMin();
 
-    int count = 0;
-
-    Envelope::QuickCache quickCache;
-    Envelope::QuickSampleVars qvars;
-
-    //TODO: TESTING..?
-    //ws = NULL;
-
-    unsigned tw, th;
+    unsigned tw = 0, th = 0;
     double rx, ry;
-    int tx, ty;
-    int tx_prev = INT_MAX, ty_prev = INT_MAX;
+    unsigned tx, ty;
     float lastRes = -1.0f;
-    int lod;
-    int lod_prev = INT_MAX;
+    int lod = -1;
     const Units& units = map->getSRS()->getUnits();
     Distance pointRes(0.0, units);
 
-    for(auto& p : points)
+    // Pass 1: find the tile each point falls in.
+    std::vector<TileRef> refs;
+    refs.reserve(points.size());
+
+    for(unsigned i = 0; i < points.size(); ++i)
     {
+        osg::Vec4d& p = points[i];
+
         if (p.w() == FLT_MAX)
             continue;
 
+        // Reconsider, b/c an inset could mean we need to re-query the LOD.
+        if ((p.w() >= 0.0f && p.w() != lastRes) ||
+            (lod < 0))
         {
-            //OE_PROFILING_ZONE_NAMED("createTileKey");
-
-            // Reconsider, b/c an inset could mean we need to re-query the LOD.
-            if ((p.w() >= 0.0f && p.w() != lastRes) ||
-                (lod < 0))
-            {
-                pointRes.set(p.w(), units);
-
-                double resolutionInMapUnits = pointRes.asDistance(units, p.y());
+            pointRes.set(p.w(), units);
 
-                unsigned maxLOD = profile->getLevelOfDetailForHorizResolution(
-                    resolutionInMapUnits,
-                    ELEVATION_TILE_SIZE);
+            double resolutionInMapUnits = pointRes.asDistance(units, p.y());
 
-                lod = std::min( getLOD(p.x(), p.y()), (int)maxLOD );
-                if (lod < 0)
-                {
-                    p.z() = NO_DATA_VALUE;
-                    continue;
-                }
-
-                profile->getNumTiles(lod, tw, th);
-
-                lastRes = p.w();
-            }
+            unsigned maxLOD = profile->getLevelOfDetailForHorizResolution(
+                resolutionInMapUnits,
+                ELEVATION_TILE_SIZE);
 
-            rx = (p.x()-pxmin)/pw, ry = (p.y()-pymin)/ph;
-            tx = osg::clampBelow((unsigned)(rx * (double)tw), tw-1u ); // TODO: wrap around for geo
-            ty = osg::clampBelow((unsigned)((1.0-ry) * (double)th), th-1u );
-
-            if (lod != lod_prev || tx != tx_prev || ty != ty_prev)
+            lod = std::min( getLOD(p.x(), p.y()), (int)maxLOD );
+            if (lod < 0)
             {
-                key._tilekey = TileKey(lod, tx, ty, profile);
-                lod_prev = lod;
-                tx_prev = tx;
-                ty_prev = ty;
+                p.z() = NO_DATA_VALUE;
+                continue;
             }
-        }
-
-        if (key._tilekey.valid())
-        {
-            auto iter = quickCache.find(key);
 
-            if (iter == quickCache.end())
-            {
-                raster = getOrCreateRaster(
-                    key,   // key to query
-                    map.get(), // map to query
-                    true,  // fall back on lower resolution data if necessary
-                    ws,    // user's workingset
-                    progress);
+            profile->getNumTiles(lod, tw, th);
 
-                // bail on cancelation before using the quickcache
-                if (progress && progress->isCanceled())
-                {
-                    return -1;
-                }
+            lastRes = p.w();
+        }
 
-                quickCache[key] = raster.get();
-            }
-            else
-            {
-                raster = iter->second;
-            }
+        rx = (p.x()-pxmin)/pw, ry = (p.y()-pymin)/ph;
+        tx = osg::clampBelow((unsigned)(rx * (double)tw), tw-1u ); // TODO: wrap around for geo
+        ty = osg::clampBelow((unsigned)((1.0-ry) * (double)th), th-1u );
 
-            {
-                //OE_PROFILING_ZONE_NAMED("sample");
-                if (raster.valid())
-                {
-                    u = (p.x() - raster->getExtent().xMin()) /  raster->getExtent().width();
-                    v = (p.y() - raster->getExtent().yMin()) /  raster->getExtent().height();
+        refs.emplace_back(TileRef::pack(lod, tx, ty), i);
+    }
 
-                    // Note: This can happen on the map edges..
-                    // TODO: consider looping around for geo and clamping for projected
-                    u = osg::clampBetween(u, 0.0, 1.0);
-                    v = osg::clampBetween(v, 0.0, 1.0);
+    // Pass 2: resolve each tile once and sample all its points together.
+    int revision = getElevationRevision(map.get());
 
-                    quickSample(raster->reader(), u, v, elev, qvars);
-                    p.z() = elev.r();
-                }
-                else
-                {
-                    p.z() = NO_DATA_VALUE;
-                }
-            }
-        }
-        else
-        {
-            p.z() = NO_DATA_VALUE;
-        }
+    auto getRaster = [&](const TileKey& tilekey)
+    {
+        Internal::RevElevationKey key;
+        key._tilekey = tilekey;
+        key._revision = revision;
 
-        if (p.z() != NO_DATA_VALUE)
-            ++count;
-    }
+        return getOrCreateRaster(
+            key,   // key to query
+            map.get(), // map to query
+            true,  // fall back on lower resolution data if necessary
+            ws,    // user's workingset
+            progress);
+    };
 
-    return count;
+    return sampleBatch(points, refs, profile, getRaster, progress);
 }
 
 int
@@ -787,33 +1163,17 @@ ElevationPool::sampleMapCoords(
     sync(map.get(), ws);
     ScopedAtomicCounter counter(_workers);
 
-    Internal::RevElevationKey key;
-    key._revision = getElevationRevision(map.get());
-
-    osg::ref_ptr<ElevationTexture> raster;
-    osg::Vec4 elev;
-    double u, v;
-
     const Profile* profile = map->getProfile();
     double pw = profile->getExtent().width();
     double ph = profile->getExtent().height();
     double pxmin = profile->getExtent().xMin();
     double pymin = profile->getExtent().yMin();
 
-    int count = 0;
-
-    Envelope::QuickCache quickCache;
-    Envelope::QuickSampleVars qvars;
-
     unsigned tw, th;
     double rx, ry;
-    int tx, ty;
-    int tx_prev = INT_MAX, ty_prev = INT_MAX;
-    float lastRes = -1.0f;
+    unsigned tx, ty;
     int lod;
-    int lod_prev = INT_MAX;
     const Units& units = map->getSRS()->getUnits();
-    Distance pointRes(0.0, units);
 
     double resolutionInMapUnits = resolution.asDistance(units, points[0].y());
 
@@ -829,81 +1189,39 @@ ElevationPool::sampleMapCoords(
 
     profile->getNumTiles(lod, tw, th);
 
-    for(auto& p : points)
-    {
-        {
-            //OE_PROFILING_ZONE_NAMED("createTileKey");
-
-            rx = (p.x()-pxmin)/pw, ry = (p.y()-pymin)/ph;
-            tx = osg::clampBelow((unsigned)(rx * (double)tw), tw-1u ); // TODO: wrap around for geo
-            ty = osg::clampBelow((unsigned)((1.0-ry) * (double)th), th-1u );
+    // Pass 1: find the tile each point falls in.
+    std::vector<TileRef> refs;
+    refs.reserve(points.size());
 
-            if (lod != lod_prev || tx != tx_prev || ty != ty_prev)
-            {
-                key._tilekey = TileKey(lod, tx, ty, profile);
-                lod_prev = lod;
-                tx_prev = tx;
-                ty_prev = ty;
-            }
-        }
-
-        if (key._tilekey.valid())
-        {
-            auto iter = quickCache.find(key);
-
-            if (iter == quickCache.end())
-            {
-                raster = getOrCreateRaster(
-                    key,   // key to query
-                    map.get(), // map to query
-                    true,  // fall back on lower resolution data if necessary
-                    ws,    // user's workingset
-                    progress);
+    for(unsigned i = 0; i < points.size(); ++i)
+    {
+        const osg::Vec3d& p = points[i];
 
-                // bail on cancelation before using the quickcache
-                if (progress && progress->isCanceled())
-                {
-                    return -1;
-                }
+        rx = (p.x()-pxmin)/pw, ry = (p.y()-pymin)/ph;
+        tx = osg::clampBelow((unsigned)(rx * (double)tw), tw-1u ); // TODO: wrap around for geo
+        ty = osg::clampBelow((unsigned)((1.0-ry) * (double)th), th-1u );
 
-                quickCache[key] = raster.get();
-            }
-            else
-            {
-                raster = iter->second;
-            }
-
-            {
-                //OE_PROFILING_ZONE_NAMED("sample");
-                if (raster.valid())
-                {
-                    u = (p.x() - raster->getExtent().xMin()) /  raster->getExtent().width();
-                    v = (p.y() - raster->getExtent().yMin()) /  raster->getExtent().height();
+        refs.emplace_back(TileRef::pack(lod, tx, ty), i);
+    }
 
-                    // Note: This can happen on the map edges..
-                    // TODO: consider looping around for geo and clamping for projected
-                    u = osg::clampBetween(u, 0.0, 1.0);
-                    v = osg::clampBetween(v, 0.0, 1.0);
+    // Pass 2: resolve each tile once and sample all its points together.
+    int revision = getElevationRevision(map.get());
 
-                    quickSample(raster->reader(), u, v, elev, qvars);
-                    p.z() = elev.r();
-                }
-                else
-                {
-                    p.z() = NO_DATA_VALUE;
-                }
-            }
-        }
-        else
-        {
-            p.z() = NO_DATA_VALUE;
-        }
+    auto getRaster = [&](const TileKey& tilekey)
+    {
+        Internal::RevElevationKey key;
+        key._tilekey = tilekey;
+        key._revision = revision;
 
-        if (p.z() != NO_DATA_VALUE)
-            ++count;
-    }
+        return getOrCreateRaster(
+            key,   // key to query
+            map.get(), // map to query
+            true,  // fall back on lower resolution data if necessary
+            ws,    // user's workingset
+            progress);
+    };
 
-    return count;
+    return sampleBatch(points, refs, profile, getRaster, progress);
 }
 
 ElevationSample
@@ -0,0 +1,896 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/FeatureBatch>
+#include <osgEarth/StringUtils>
+#include <algorithm>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    // removes the entries of a per-row vector whose row is not kept
+    template<typename T>
+    void compact(std::vector<T>& v, const std::vector<bool>& keep)
+    {
+        unsigned out = 0;
+        for (unsigned i = 0; i < v.size(); ++i)
+        {
+            if (keep[i])
+            {
+                if (out != i)
+                    v[out] = std::move(v[i]);
+                ++out;
+            }
+        }
+        v.resize(out);
+    }
+
+    Geometry* createGeometryOfType(Geometry::Type type, unsigned capacity)
+    {
+        switch (type)
+        {
+        case Geometry::TYPE_POINT:      return new Point(capacity);
+        case Geometry::TYPE_POINTSET:   return new PointSet(capacity);
+        case Geometry::TYPE_LINESTRING: return new LineString(capacity);
+        case Geometry::TYPE_RING:       return new Ring(capacity);
+        case Geometry::TYPE_POLYGON:    return new Polygon(capacity);
+        default:                        return new Geometry(capacity);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+
+FeatureBatchSchema::FeatureBatchSchema() :
+    _mutex("FeatureBatchSchema(OE)")
+{
+    //nop
+}
+
+int
+FeatureBatchSchema::add(const std::string& name, AttributeType type)
+{
+    std::string key = toLower(name);
+
+    Threading::ScopedMutexLock lock(_mutex);
+
+    std::unordered_map<std::string, int>::const_iterator i = _lookup.find(key);
+    if (i != _lookup.end())
+        return i->second;
+
+    int field = _fields.size();
+    _fields.push_back(std::make_pair(name, type));
+    _lookup[key] = field;
+    return field;
+}
+
+int
+FeatureBatchSchema::find(const std::string& name) const
+{
+    std::string key = toLower(name);
+
+    Threading::ScopedMutexLock lock(_mutex);
+
+    std::unordered_map<std::string, int>::const_iterator i = _lookup.find(key);
+    return i != _lookup.end() ? i->second : -1;
+}
+
+unsigned
+FeatureBatchSchema::size() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _fields.size();
+}
+
+std::string
+FeatureBatchSchema::getName(int field) const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return field >= 0 && field < (int)_fields.size() ? _fields[field].first : EMPTY_STRING;
+}
+
+AttributeType
+FeatureBatchSchema::getType(int field) const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return field >= 0 && field < (int)_fields.size() ? _fields[field].second : ATTRTYPE_UNSPECIFIED;
+}
+
+//----------------------------------------------------------------------------
+
+FeatureBatch::FeatureBatch(FeatureBatchSchema* schema) :
+    _schema(schema ? schema : new FeatureBatchSchema())
+{
+    _rowParts.push_back(0u);
+}
+
+void
+FeatureBatch::reserve(unsigned rows, unsigned coords)
+{
+    _fids.reserve(rows);
+    _geoInterp.reserve(rows);
+    _multi.reserve(rows);
+    _rowParts.reserve(rows + 1);
+    _parts.reserve(rows);
+    _coords.reserve(coords);
+}
+
+void
+FeatureBatch::clear()
+{
+    _srs = nullptr;
+    _fids.clear();
+    _geoInterp.clear();
+    _styles.clear();
+    _columns.clear();
+    _stringIndex.clear();
+    _strings.clear();
+    _coords.clear();
+    _parts.clear();
+    _multi.clear();
+    _rowParts.clear();
+    _rowParts.push_back(0u);
+}
+
+bool
+FeatureBatch::acceptSRS(const SpatialReference* srs)
+{
+    if (srs == nullptr)
+        return true;
+
+    if (!_srs.valid())
+    {
+        _srs = srs;
+        return true;
+    }
+
+    return _srs.get() == srs || _srs->isEquivalentTo(srs);
+}
+
+int
+FeatureBatch::getField(const std::string& name, AttributeType type)
+{
+    // features from one source spell their attribute names the same way,
+    // so an exact-match cache avoids the schema lock for nearly every value.
+    std::unordered_map<std::string, int>::const_iterator i = _fieldCache.find(name);
+    if (i != _fieldCache.end())
+        return i->second;
+
+    int field = _schema->add(name, type);
+    _fieldCache[name] = field;
+    return field;
+}
+
+unsigned
+FeatureBatch::intern(const std::string& value)
+{
+    std::pair<std::unordered_map<std::string, unsigned>::iterator, bool> r =
+        _stringIndex.emplace(value, (unsigned)_strings.size());
+
+    if (r.second)
+        _strings.push_back(&r.first->first);
+
+    return r.first->second;
+}
+
+bool
+FeatureBatch::append(const Feature* feature)
+{
+    if (feature == nullptr || !acceptSRS(feature->getSRS()))
+        return false;
+
+    unsigned row = _fids.size();
+
+    _fids.push_back(feature->getFID());
+
+    _geoInterp.push_back(feature->geoInterp().isSet() ? (signed char)feature->geoInterp().get() : -1);
+
+    if (feature->style().isSet())
+        _styles[row] = feature->style().get();
+
+    const AttributeTable& attrs = feature->getAttrs();
+    for (AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
+    {
+        setValue(getField(a->first, a->second.first), a->first, row, a->second);
+    }
+    padColumns(row + 1);
+
+    const Geometry* geom = feature->getGeometry();
+    _multi.push_back(geom && geom->getType() == Geometry::TYPE_MULTI ? 1 : 0);
+    if (geom)
+        appendParts(geom);
+    _rowParts.push_back(_parts.size());
+
+    return true;
+}
+
+unsigned
+FeatureBatch::append(const FeatureList& features)
+{
+    unsigned count = 0u;
+    for (FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+    {
+        if (append(i->get()))
+            ++count;
+    }
+    return count;
+}
+
+bool
+FeatureBatch::append(const FeatureBatch& batch, unsigned row)
+{
+    if (&batch == this || row >= batch.size() || !acceptSRS(batch.getSRS()))
+        return false;
+
+    unsigned r = _fids.size();
+
+    _fids.push_back(batch._fids[row]);
+    _geoInterp.push_back(batch._geoInterp[row]);
+
+    std::map<unsigned, Style>::const_iterator style = batch._styles.find(row);
+    if (style != batch._styles.end())
+        _styles[r] = style->second;
+
+    bool sameSchema = (batch._schema.get() == _schema.get());
+
+    for (unsigned f = 0; f < batch._columns.size(); ++f)
+    {
+        const Column& column = batch._columns[f];
+        if (column.used && column.state[row] != STATE_ABSENT)
+        {
+            AttributeValue value = batch.getValue(column, row);
+            int field = sameSchema ? (int)f : getField(column.name, value.first);
+            setValue(field, column.name, r, value);
+        }
+    }
+    padColumns(r + 1);
+
+    _multi.push_back(batch._multi[row]);
+    for (unsigned p = batch._rowParts[row]; p < batch._rowParts[row + 1]; ++p)
+    {
+        const Part& part = batch._parts[p];
+        appendPart(part, batch._coords.data() + part.offset);
+    }
+    _rowParts.push_back(_parts.size());
+
+    return true;
+}
+
+void
+FeatureBatch::setValue(int field, const std::string& name, unsigned row, const AttributeValue& value)
+{
+    if (field >= (int)_columns.size())
+        _columns.resize(field + 1);
+
+    Column& column = _columns[field];
+
+    if (!column.used)
+    {
+        column.used = true;
+        column.name = name;
+        column.type = value.first;
+    }
+    else if (!column.mixed && column.type != value.first)
+    {
+        makeMixed(column);
+    }
+
+    while (column.state.size() < row)
+    {
+        column.state.push_back(STATE_ABSENT);
+        pushDefault(column);
+    }
+
+    column.state.push_back(value.second.set ? STATE_SET : STATE_NULL);
+    pushValue(column, value);
+}
+
+void
+FeatureBatch::pushValue(Column& column, const AttributeValue& value)
+{
+    if (column.mixed)
+    {
+        column.values.push_back(value);
+        return;
+    }
+
+    switch (column.type)
+    {
+    case ATTRTYPE_DOUBLE:      column.doubles.push_back(value.second.doubleValue); break;
+    case ATTRTYPE_INT:         column.ints.push_back(value.second.intValue); break;
+    case ATTRTYPE_BOOL:        column.bools.push_back(value.second.boolValue ? 1 : 0); break;
+    case ATTRTYPE_STRING:      column.strings.push_back(intern(value.second.stringValue)); break;
+    case ATTRTYPE_DOUBLEARRAY: column.arrays.push_back(value.second.doubleArrayValue); break;
+    default: break;
+    }
+}
+
+void
+FeatureBatch::pushDefault(Column& column)
+{
+    if (column.mixed)
+    {
+        column.values.push_back(AttributeValue());
+        return;
+    }
+
+    switch (column.type)
+    {
+    case ATTRTYPE_DOUBLE:      column.doubles.push_back(0.0); break;
+    case ATTRTYPE_INT:         column.ints.push_back(0LL); break;
+    case ATTRTYPE_BOOL:        column.bools.push_back(0); break;
+    case ATTRTYPE_STRING:      column.strings.push_back(intern(EMPTY_STRING)); break;
+    case ATTRTYPE_DOUBLEARRAY: column.arrays.push_back(std::vector<double>()); break;
+    default: break;
+    }
+}
+
+void
+FeatureBatch::makeMixed(Column& column)
+{
+    std::vector<AttributeValue> values;
+    values.reserve(column.state.size());
+    for (unsigned row = 0; row < column.state.size(); ++row)
+    {
+        values.push_back(column.state[row] != STATE_ABSENT ? getValue(column, row) : AttributeValue());
+    }
+
+    std::vector<double>().swap(column.doubles);
+    std::vector<long long>().swap(column.ints);
+    std::vector<unsigned char>().swap(column.bools);
+    std::vector<unsigned>().swap(column.strings);
+    std::vector<std::vector<double> >().swap(column.arrays);
+
+    column.values.swap(values);
+    column.mixed = true;
+}
+
+void
+FeatureBatch::padColumns(unsigned rows)
+{
+    for (std::vector<Column>::iterator column = _columns.begin(); column != _columns.end(); ++column)
+    {
+        if (column->used)
+        {
+            while (column->state.size() < rows)
+            {
+                column->state.push_back(STATE_ABSENT);
+                pushDefault(*column);
+            }
+        }
+    }
+}
+
+void
+FeatureBatch::appendParts(const Geometry* geom)
+{
+    if (geom->getType() == Geometry::TYPE_MULTI)
+    {
+        const GeometryCollection& parts = static_cast<const MultiGeometry*>(geom)->getComponents();
+        for (GeometryCollection::const_iterator i = parts.begin(); i != parts.end(); ++i)
+        {
+            if (i->valid())
+                appendParts(i->get());
+        }
+        return;
+    }
+
+    const Polygon* polygon = dynamic_cast<const Polygon*>(geom);
+
+    Part part;
+    part.type = geom->getType();
+    part.count = geom->size();
+    part.holes = 0u;
+
+    if (polygon)
+    {
+        for (RingCollection::const_iterator hole = polygon->getHoles().begin(); hole != polygon->getHoles().end(); ++hole)
+        {
+            if (hole->valid())
+                ++part.holes;
+        }
+    }
+
+    appendPart(part, geom->asVector().data());
+
+    if (polygon)
+    {
+        for (RingCollection::const_iterator hole = polygon->getHoles().begin(); hole != polygon->getHoles().end(); ++hole)
+        {
+            if (hole->valid())
+            {
+                Part ring;
+                ring.type = Geometry::TYPE_RING;
+                ring.count = hole->get()->size();
+                ring.holes = 0u;
+                appendPart(ring, hole->get()->asVector().data());
+            }
+        }
+    }
+}
+
+void
+FeatureBatch::appendPart(const Part& part, const osg::Vec3d* coords)
+{
+    Part copy = part;
+    copy.offset = _coords.size();
+    _coords.insert(_coords.end(), coords, coords + part.count);
+    _parts.push_back(copy);
+}
+
+void
+FeatureBatch::select(const std::vector<bool>& keep)
+{
+    if (keep.size() != size())
+        return;
+
+    // styles are sparse, so renumber them:
+    std::map<unsigned, Style> styles;
+    unsigned out = 0u;
+    for (unsigned row = 0; row < keep.size(); ++row)
+    {
+        if (keep[row])
+        {
+            std::map<unsigned, Style>::iterator style = _styles.find(row);
+            if (style != _styles.end())
+                styles[out] = style->second;
+            ++out;
+        }
+    }
+    _styles.swap(styles);
+
+    compact(_fids, keep);
+    compact(_geoInterp, keep);
+
+    for (std::vector<Column>::iterator column = _columns.begin(); column != _columns.end(); ++column)
+    {
+        compact(column->state, keep);
+        compact(column->doubles, keep);
+        compact(column->ints, keep);
+        compact(column->bools, keep);
+        compact(column->strings, keep);
+        compact(column->arrays, keep);
+        compact(column->values, keep);
+    }
+
+    // geometry moves towards the front, so compact it in place:
+    unsigned outRow = 0u, outPart = 0u, outCoord = 0u;
+    unsigned p0 = _rowParts[0];
+    for (unsigned row = 0; row < keep.size(); ++row)
+    {
+        unsigned p1 = _rowParts[row + 1];
+        if (keep[row])
+        {
+            for (unsigned p = p0; p < p1; ++p)
+            {
+                Part part = _parts[p];
+                std::copy(
+                    _coords.begin() + part.offset,
+                    _coords.begin() + part.offset + part.count,
+                    _coords.begin() + outCoord);
+                part.offset = outCoord;
+                outCoord += part.count;
+                _parts[outPart++] = part;
+            }
+            _multi[outRow] = _multi[row];
+            _rowParts[++outRow] = outPart;
+        }
+        p0 = p1;
+    }
+    _coords.resize(outCoord);
+    _parts.resize(outPart);
+    _multi.resize(outRow);
+    _rowParts.resize(outRow + 1);
+}
+
+void
+FeatureBatch::convertGeometry(Geometry::Type toType)
+{
+    std::vector<osg::Vec3d> coords;
+    coords.reserve(_coords.size() + size());
+
+    std::vector<Part> parts;
+    parts.reserve(_parts.size());
+
+    std::vector<unsigned> rowParts;
+    rowParts.reserve(_rowParts.size());
+    rowParts.push_back(0u);
+
+    for (unsigned row = 0; row < size(); ++row)
+    {
+        unsigned p0 = _rowParts[row], p1 = _rowParts[row + 1];
+
+        // Multi-geometries clone as they are, whatever the type asked for;
+        // but cloning a Ring opens it, and that includes polygon holes.
+        if (_multi[row] || p0 == p1 || _parts[p0].type == toType)
+        {
+            bool cloned = _multi[row] && p0 < p1 && _parts[p0].type != toType;
+
+            for (unsigned p = p0; p < p1; ++p)
+            {
+                Part part = _parts[p];
+                part.offset = coords.size();
+                coords.insert(coords.end(), _coords.begin() + _parts[p].offset, _coords.begin() + _parts[p].offset + part.count);
+
+                if (cloned && part.type == Geometry::TYPE_RING)
+                {
+                    while (part.count > 2 && coords[part.offset] == coords.back())
+                    {
+                        coords.pop_back();
+                        --part.count;
+                    }
+                }
+
+                parts.push_back(part);
+            }
+        }
+
+        // Geometry::cloneAs has no conversion to a multi-geometry, so the
+        // row loses its geometry; everything else keeps only the outer ring.
+        else if (toType != Geometry::TYPE_MULTI)
+        {
+            const Part& outer = _parts[p0];
+
+            Part part;
+            part.type = toType;
+            part.offset = coords.size();
+            part.count = outer.count;
+            part.holes = 0u;
+            coords.insert(coords.end(), _coords.begin() + outer.offset, _coords.begin() + outer.offset + outer.count);
+
+            bool fromRing = outer.type == Geometry::TYPE_RING || outer.type == Geometry::TYPE_POLYGON;
+
+            // Ring::cloneAs closes the line:
+            if (toType == Geometry::TYPE_LINESTRING && fromRing)
+            {
+                if (part.count > 1 && coords[part.offset] != coords.back())
+                {
+                    osg::Vec3d first = coords[part.offset];
+                    coords.push_back(first);
+                    ++part.count;
+                }
+            }
+
+            // Ring and Polygon constructors open the ring:
+            else if (toType == Geometry::TYPE_RING || toType == Geometry::TYPE_POLYGON)
+            {
+                while (part.count > 2 && coords[part.offset] == coords.back())
+                {
+                    coords.pop_back();
+                    --part.count;
+                }
+            }
+
+            parts.push_back(part);
+        }
+
+        rowParts.push_back(parts.size());
+    }
+
+    _coords.swap(coords);
+    _parts.swap(parts);
+    _rowParts.swap(rowParts);
+}
+
+const Style*
+FeatureBatch::getStyle(unsigned row) const
+{
+    std::map<unsigned, Style>::const_iterator i = _styles.find(row);
+    return i != _styles.end() ? &i->second : nullptr;
+}
+
+optional<GeoInterpolation>
+FeatureBatch::getGeoInterp(unsigned row) const
+{
+    optional<GeoInterpolation> value;
+    if (_geoInterp[row] >= 0)
+        value = (GeoInterpolation)_geoInterp[row];
+    return value;
+}
+
+const std::string&
+FeatureBatch::getFieldName(int field) const
+{
+    return field >= 0 && field < (int)_columns.size() ? _columns[field].name : EMPTY_STRING;
+}
+
+const FeatureBatch::Column*
+FeatureBatch::getColumn(unsigned row, int field) const
+{
+    if (field < 0 || field >= (int)_columns.size())
+        return nullptr;
+
+    const Column& column = _columns[field];
+    return column.used && column.state[row] != STATE_ABSENT ? &column : nullptr;
+}
+
+bool
+FeatureBatch::hasAttr(unsigned row, int field) const
+{
+    return getColumn(row, field) != nullptr;
+}
+
+bool
+FeatureBatch::isSet(unsigned row, int field) const
+{
+    const Column* column = getColumn(row, field);
+    return column && column->state[row] == STATE_SET;
+}
+
+AttributeType
+FeatureBatch::getType(unsigned row, int field) const
+{
+    const Column* column = getColumn(row, field);
+    if (!column)
+        return ATTRTYPE_UNSPECIFIED;
+    return column->mixed ? column->values[row].first : column->type;
+}
+
+std::string
+FeatureBatch::getString(unsigned row, int field) const
+{
+    const Column* column = getColumn(row, field);
+    if (!column)
+        return EMPTY_STRING;
+
+    if (column->mixed)
+        return column->values[row].getString();
+
+    if (column->state[row] != STATE_SET)
+        return EMPTY_STRING;
+
+    switch (column->type)
+    {
+    case ATTRTYPE_STRING: return *_strings[column->strings[row]];
+    case ATTRTYPE_DOUBLE: return osgEarth::toString(column->doubles[row]);
+    case ATTRTYPE_INT:    return osgEarth::toString(column->ints[row]);
+    case ATTRTYPE_BOOL:   return osgEarth::toString(column->bools[row] != 0);
+    default: break;
+    }
+    return EMPTY_STRING;
+}
+
+double
+FeatureBatch::getDouble(unsigned row, int field, double defaultValue) const
+{
+    const Column* column = getColumn(row, field);
+    if (!column)
+        return defaultValue;
+
+    if (column->mixed)
+        return column->values[row].getDouble(defaultValue);
+
+    if (column->state[row] != STATE_SET)
+        return defaultValue;
+
+    switch (column->type)
+    {
+    case ATTRTYPE_STRING: return Strings::as<double>(*_strings[column->strings[row]], defaultValue);
+    case ATTRTYPE_DOUBLE: return column->doubles[row];
+    case ATTRTYPE_INT:    return (double)column->ints[row];
+    case ATTRTYPE_BOOL:   return column->bools[row] ? 1.0 : 0.0;
+    default: break;
+    }
+    return defaultValue;
+}
+
+long long
+FeatureBatch::getInt(unsigned row, int field, long long defaultValue) const
+{
+    const Column* column = getColumn(row, field);
+    if (!column)
+        return defaultValue;
+
+    if (column->mixed)
+        return column->values[row].getInt(defaultValue);
+
+    if (column->state[row] != STATE_SET)
+        return defaultValue;
+
+    switch (column->type)
+    {
+    case ATTRTYPE_STRING: return Strings::as<int>(*_strings[column->strings[row]], defaultValue);
+    case ATTRTYPE_DOUBLE: return (long long)column->doubles[row];
+    case ATTRTYPE_INT:    return column->ints[row];
+    case ATTRTYPE_BOOL:   return column->bools[row] ? 1 : 0;
+    default: break;
+    }
+    return defaultValue;
+}
+
+bool
+FeatureBatch::getBool(unsigned row, int field, bool defaultValue) const
+{
+    const Column* column = getColumn(row, field);
+    if (!column)
+        return defaultValue;
+
+    if (column->mixed)
+        return column->values[row].getBool(defaultValue);
+
+    if (column->state[row] != STATE_SET)
+        return defaultValue;
+
+    switch (column->type)
+    {
+    case ATTRTYPE_STRING: return Strings::as<bool>(*_strings[column->strings[row]], defaultValue);
+    case ATTRTYPE_DOUBLE: return column->doubles[row] != 0.0;
+    case ATTRTYPE_INT:    return column->ints[row] != 0;
+    case ATTRTYPE_BOOL:   return column->bools[row] != 0;
+    default: break;
+    }
+    return defaultValue;
+}
+
+const std::vector<double>*
+FeatureBatch::getDoubleArray(unsigned row, int field) const
+{
+    static const std::vector<double> s_empty;
+
+    const Column* column = getColumn(row, field);
+    if (!column)
+        return nullptr;
+
+    if (column->mixed)
+        return &column->values[row].getDoubleArrayValue();
+
+    return column->type == ATTRTYPE_DOUBLEARRAY ? &column->arrays[row] : &s_empty;
+}
+
+AttributeValue
+FeatureBatch::getValue(unsigned row, int field) const
+{
+    const Column* column = getColumn(row, field);
+    return column ? getValue(*column, row) : AttributeValue();
+}
+
+AttributeValue
+FeatureBatch::getValue(const Column& column, unsigned row) const
+{
+    if (column.mixed)
+        return column.values[row];
+
+    AttributeValue value;
+    value.first = column.type;
+    value.second.set = (column.state[row] == STATE_SET);
+
+    switch (column.type)
+    {
+    case ATTRTYPE_DOUBLE:      value.second.doubleValue = column.doubles[row]; break;
+    case ATTRTYPE_INT:         value.second.intValue = column.ints[row]; break;
+    case ATTRTYPE_BOOL:        value.second.boolValue = column.bools[row] != 0; break;
+    case ATTRTYPE_STRING:      value.second.stringValue = *_strings[column.strings[row]]; break;
+    case ATTRTYPE_DOUBLEARRAY: value.second.doubleArrayValue = column.arrays[row]; break;
+    default: break;
+    }
+    return value;
+}
+
+bool
+FeatureBatch::hasGeometry(unsigned row) const
+{
+    return _multi[row] != 0 || _rowParts[row + 1] > _rowParts[row];
+}
+
+Geometry::Type
+FeatureBatch::getGeometryType(unsigned row) const
+{
+    if (_multi[row])
+        return Geometry::TYPE_MULTI;
+
+    return _rowParts[row + 1] > _rowParts[row] ? _parts[_rowParts[row]].type : Geometry::TYPE_UNKNOWN;
+}
+
+Geometry::Type
+FeatureBatch::getComponentType(unsigned row) const
+{
+    return _rowParts[row + 1] > _rowParts[row] ? _parts[_rowParts[row]].type : Geometry::TYPE_UNKNOWN;
+}
+
+const osg::Vec3d*
+FeatureBatch::getCoords(unsigned row, unsigned& out_count) const
+{
+    unsigned p0 = _rowParts[row], p1 = _rowParts[row + 1];
+    if (p0 == p1)
+    {
+        out_count = 0u;
+        return nullptr;
+    }
+
+    unsigned begin = _parts[p0].offset;
+    unsigned end = _parts[p1 - 1].offset + _parts[p1 - 1].count;
+    out_count = end - begin;
+    return out_count > 0u ? _coords.data() + begin : nullptr;
+}
+
+Geometry*
+FeatureBatch::createPart(unsigned p) const
+{
+    const Part& part = _parts[p];
+    const osg::Vec3d* coords = _coords.data() + part.offset;
+
+    Geometry* geom = createGeometryOfType(part.type, part.count);
+    geom->insert(geom->end(), coords, coords + part.count);
+
+    if (part.holes > 0u)
+    {
+        Polygon* polygon = static_cast<Polygon*>(geom);
+        for (unsigned h = p + 1; h <= p + part.holes; ++h)
+        {
+            const Part& hole = _parts[h];
+            Ring* ring = new Ring(hole.count);
+            ring->insert(ring->end(), _coords.data() + hole.offset, _coords.data() + hole.offset + hole.count);
+            polygon->getHoles().push_back(ring);
+        }
+    }
+
+    return geom;
+}
+
+Geometry*
+FeatureBatch::createGeometry(unsigned row) const
+{
+    unsigned p0 = _rowParts[row], p1 = _rowParts[row + 1];
+
+    if (_multi[row])
+    {
+        MultiGeometry* multi = new MultiGeometry();
+        for (unsigned p = p0; p < p1; p += 1u + _parts[p].holes)
+        {
+            multi->add(createPart(p));
+        }
+        return multi;
+    }
+
+    return p1 > p0 ? createPart(p0) : nullptr;
+}
+
+Feature*
+FeatureBatch::createFeature(unsigned row) const
+{
+    Feature* feature = new Feature(createGeometry(row), _srs.get(), Style(), _fids[row]);
+
+    const Style* style = getStyle(row);
+    if (style)
+        feature->style() = *style;
+
+    if (_geoInterp[row] >= 0)
+        feature->geoInterp() = (GeoInterpolation)_geoInterp[row];
+
+    for (unsigned field = 0; field < _columns.size(); ++field)
+    {
+        const Column& column = _columns[field];
+        if (column.used && column.state[row] != STATE_ABSENT)
+        {
+            feature->set(column.name, getValue(column, row));
+        }
+    }
+
+    return feature;
+}
+
+void
+FeatureBatch::createFeatures(FeatureList& output) const
+{
+    for (unsigned row = 0; row < size(); ++row)
+    {
+        output.push_back(createFeature(row));
+    }
+}
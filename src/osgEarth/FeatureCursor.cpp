@@ -58,6 +58,19 @@ FeatureCursor::fill(
     }
 }
 
+unsigned
+FeatureCursor::fill(FeatureBatch& output, unsigned maxFeatures)
+{
+    unsigned count = 0u;
+    while (count < maxFeatures && hasMore())
+    {
+        osg::ref_ptr<Feature> f = nextFeature();
+        if (output.append(f.get()))
+            ++count;
+    }
+    return count;
+}
+
 //---------------------------------------------------------------------------
 
 FeatureListCursor::FeatureListCursor(const FeatureList& features) :
@@ -89,6 +102,120 @@ FeatureListCursor::nextFeature()
 
 //---------------------------------------------------------------------------
 
+FeatureTile::FeatureTile(FeatureList& features) :
+_sizeInBytes(0u)
+{
+    _features.swap(features);
+
+    for (auto& feature : _features)
+    {
+        _sizeInBytes += sizeof(Feature);
+
+        const Geometry* geom = feature->getGeometry();
+        if (geom)
+            _sizeInBytes += sizeof(Geometry) + geom->getTotalPointCount() * sizeof(osg::Vec3d);
+
+        // rough cost of an attribute: a map node plus the key and value data
+        for (auto& attr : feature->getAttrs())
+        {
+            const AttributeValueUnion& value = attr.second.second;
+            _sizeInBytes +=
+                sizeof(AttributeTable::value_type) + 32u + attr.first.size() +
+                value.stringValue.size() + value.doubleArrayValue.size() * sizeof(double);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+
+FeatureTileCursor::FeatureTileCursor(const FeatureTile* tile) :
+FeatureCursor(0L),
+_tile(tile)
+{
+    _iter = _tile->getFeatures().begin();
+}
+
+FeatureTileCursor::~FeatureTileCursor()
+{
+    //nop
+}
+
+bool
+FeatureTileCursor::hasMore() const
+{
+    return _iter != _tile->getFeatures().end();
+}
+
+Feature*
+FeatureTileCursor::nextFeature()
+{
+    // the caller may modify what it gets, and the shared feature must stay as it is
+    return osg::clone(nextSharedFeature(), osg::CopyOp::DEEP_COPY_ALL);
+}
+
+const Feature*
+FeatureTileCursor::nextSharedFeature()
+{
+    const Feature* f = _iter->get();
+    _iter++;
+    return f;
+}
+
+unsigned
+FeatureTileCursor::fill(FeatureBatch& output, unsigned maxFeatures)
+{
+    // appending to a batch copies the data, so no Features are cloned
+    unsigned count = 0u;
+    while (count < maxFeatures && hasMore())
+    {
+        if (output.append(_iter->get()))
+            ++count;
+        _iter++;
+    }
+    return count;
+}
+
+//---------------------------------------------------------------------------
+
+FeatureBatchCursor::FeatureBatchCursor(const FeatureBatch* input) :
+FeatureCursor(0L),
+_batch( input ),
+_row  ( 0u )
+{
+    //nop
+}
+
+FeatureBatchCursor::~FeatureBatchCursor()
+{
+    //nop
+}
+
+bool
+FeatureBatchCursor::hasMore() const
+{
+    return _batch.valid() && _row < _batch->size();
+}
+
+Feature*
+FeatureBatchCursor::nextFeature()
+{
+    return hasMore() ? _batch->createFeature(_row++) : 0L;
+}
+
+unsigned
+FeatureBatchCursor::fill(FeatureBatch& output, unsigned maxFeatures)
+{
+    unsigned count = 0u;
+    while (count < maxFeatures && hasMore())
+    {
+        if (output.append(*_batch.get(), _row++))
+            ++count;
+    }
+    return count;
+}
+
+//---------------------------------------------------------------------------
+
 GeometryFeatureCursor::GeometryFeatureCursor(Geometry* geom) :
 FeatureCursor(NULL),
 _geom( geom )
@@ -155,6 +282,16 @@ GeometryFeatureCursor::nextFeature()
 
 //---------------------------------------------------------------------------
 
+namespace
+{
+    // replaces each feature with a private copy
+    void copyFeatures(FeatureList& features)
+    {
+        for (auto& feature : features)
+            feature = osg::clone(feature.get(), osg::CopyOp::DEEP_COPY_ALL);
+    }
+}
+
 FilteredFeatureCursor::FilteredFeatureCursor(
     FeatureCursor* cursor,
     FeatureFilterChain* chain) :
@@ -190,22 +327,40 @@ FilteredFeatureCursor::hasMore() const
     FilterContext temp_cx;
     FilterContext& cx = _user_cx == nullptr ? temp_cx : *_user_cx;
 
+    // Features from a cached tile are shared. Read-only filters run on
+    // them as they are, and only the ones that get past those are copied,
+    // right before the first filter that may modify them.
+    FeatureTileCursor* tileCursor = dynamic_cast<FeatureTileCursor*>(_cursor.get());
+
     while(_cursor->hasMore() && _cache.size() < chunkSize)
     {
         FeatureList local;
+        bool shared = tileCursor != nullptr;
 
         while(_cursor->hasMore() && local.size() < chunkSize)
         {
-            local.push_back(_cursor->nextFeature());
+            if (shared)
+                local.push_back(const_cast<Feature*>(tileCursor->nextSharedFeature()));
+            else
+                local.push_back(_cursor->nextFeature());
         }
 
         for(FeatureFilterChain::const_iterator filter = _chain->begin();
             filter != _chain->end();
             ++filter)
         {
+            if (shared && !filter->get()->isReadOnly())
+            {
+                copyFeatures(local);
+                shared = false;
+            }
             cx = filter->get()->push(local, cx);
         }
 
+        // the caller owns what nextFeature() returns
+        if (shared)
+            copyFeatures(local);
+
         std::copy(local.begin(), local.end(), std::back_inserter(_cache));
     }
 
@@ -219,3 +374,45 @@ FilteredFeatureCursor::nextFeature()
     _cache.pop_front();
     return feature;
 }
+
+unsigned
+FilteredFeatureCursor::fill(FeatureBatch& output, unsigned maxFeatures)
+{
+    unsigned count = 0u;
+
+    // features that hasMore() already filtered go first:
+    while (count < maxFeatures && !_cache.empty())
+    {
+        if (output.append(_cache.front().get()))
+            ++count;
+        _cache.pop_front();
+    }
+
+    const unsigned chunkSize = 500u;
+
+    FilterContext temp_cx;
+    FilterContext& cx = _user_cx == nullptr ? temp_cx : *_user_cx;
+
+    osg::ref_ptr<FeatureBatch> local = new FeatureBatch(output.getSchema());
+
+    while (count < maxFeatures && _cursor->hasMore())
+    {
+        local->clear();
+        _cursor->fill(*local, osg::minimum(chunkSize, maxFeatures - count));
+
+        for(FeatureFilterChain::const_iterator filter = _chain->begin();
+            filter != _chain->end();
+            ++filter)
+        {
+            cx = filter->get()->push(*local, cx);
+        }
+
+        for (unsigned row = 0; row < local->size(); ++row)
+        {
+            if (output.append(*local, row))
+                ++count;
+        }
+    }
+
+    return count;
+}
@@ -37,6 +37,7 @@ FeatureSource::Options::getConfig() const
     conf.set( "fid_attribute", fidAttribute() );
     conf.set( "rewind_polygons", rewindPolygons());
     conf.set( "vdatum", vdatum() );
+    conf.set( "l2_cache_budget_mb", l2CacheBudgetMB() );
 
     if (!filters().empty())
     {
@@ -63,6 +64,7 @@ FeatureSource::Options::fromConfig(const Config& conf)
     conf.get( "fid_attribute", fidAttribute() );
     conf.get( "rewind_polygons", rewindPolygons());
     conf.get( "vdatum", vdatum() );
+    conf.get( "l2_cache_budget_mb", l2CacheBudgetMB() );
 
     const Config& filtersConf = conf.child("filters");
     for(ConfigSet::const_iterator i = filtersConf.children().begin(); i != filtersConf.children().end(); ++i)
@@ -90,6 +92,7 @@ OE_LAYER_PROPERTY_IMPL(FeatureSource, bool, OpenWrite, openWrite);
 OE_LAYER_PROPERTY_IMPL(FeatureSource, GeoInterpolation, GeoInterpolation, geoInterp);
 OE_LAYER_PROPERTY_IMPL(FeatureSource, std::string, FIDAttribute, fidAttribute);
 OE_LAYER_PROPERTY_IMPL(FeatureSource, bool, RewindPolygons, rewindPolygons);
+OE_LAYER_PROPERTY_IMPL(FeatureSource, unsigned, L2CacheBudgetMB, l2CacheBudgetMB);
 
 void
 FeatureSource::init()
@@ -102,16 +105,20 @@ FeatureSource::init()
 Status
 FeatureSource::openImplementation()
 {
-    unsigned int l2CacheSize = 16u;
+    // An l2CacheSize of zero disables the cache. Otherwise the cache holds
+    // 16 tiles by default, or as many as fit when it has a memory budget.
+    std::size_t l2CacheBytes = (std::size_t)options().l2CacheBudgetMB().get() * 1024u * 1024u;
+
+    unsigned int l2CacheSize = l2CacheBytes > 0u ? 0u : 16u;
     if (options().l2CacheSize().isSet())
     {
         l2CacheSize = options().l2CacheSize().get();
     }
 
-    if (l2CacheSize > 0)
+    if (l2CacheSize > 0u || (l2CacheBytes > 0u && !options().l2CacheSize().isSet()))
     {
         // note: cannot use std::make_unique in C++11
-        _featuresCache = std::unique_ptr<FeaturesLRU>(new FeaturesLRU(l2CacheSize));
+        _featuresCache = std::unique_ptr<FeatureTileCache>(new FeatureTileCache(l2CacheSize, l2CacheBytes));
     }
 
     Status parent = Layer::openImplementation();
@@ -260,56 +267,50 @@ FeatureSource::createFeatureCursor(
 {
     osg::ref_ptr< FeatureCursor > cursor;
 
-    bool fromCache = false;
-
-    if (_featuresCache)
+    if (_featuresCache && query.tileKey().isSet())
     {
-        // Try reading from the cache first if we have a TileKey.
-        if (query.tileKey().isSet())
+        const TileKey& key = *query.tileKey();
+
+        // Only one thread fetches a given tile at a time. The others
+        // wait here and then share its result from the cache.
+        ScopedGate<TileKey> gate(_featuresGate, key);
+
+        osg::ref_ptr<const FeatureTile> tile;
         {
             ScopedMutexLock lk(_featuresCacheMutex);
-            FeaturesLRU::Record result;
-            _featuresCache->get(*query.tileKey(), result);
-            if (result.valid())
+            tile = _featuresCache->get(key);
+        }
+
+        if (!tile.valid())
+        {
+            osg::ref_ptr<FeatureCursor> source = createFeatureCursorImplementation(query, progress);
+            if (source.valid())
             {
-                FeatureList copy(result.value().size());
-                std::transform(result.value().begin(), result.value().end(), copy.begin(),
-                    [&](const osg::ref_ptr<Feature>& feature) {
-                        return osg::clone(feature.get(), osg::CopyOp::DEEP_COPY_ALL);
-                    });
-                cursor = new FeatureListCursor(copy);
-                fromCache = true;
+                FeatureList features;
+                source->fill(features);
+                tile = new FeatureTile(features);
+
+                // don't keep a tile that may be incomplete
+                if (progress == nullptr || !progress->isCanceled())
+                {
+                    ScopedMutexLock lk(_featuresCacheMutex);
+                    _featuresCache->insert(key, tile.get());
+                }
             }
         }
-    }
 
-    // Call the implementation if we didn't get a cursor from the cache.
-    if (!cursor.valid())
-    {
-        cursor = createFeatureCursorImplementation(query, progress);
+        // The tile is shared, so the cursor hands out copies that the
+        // caller and the filters can modify. Read-only filters see the
+        // shared features, and nothing they drop is copied.
+        if (tile.valid())
+        {
+            cursor = new FeatureTileCursor(tile.get());
+        }
     }
 
-    // Insert it into the cache if we read it from the source itself.
-    if (_featuresCache && !fromCache && cursor.valid() && query.tileKey().isSet())
+    else
     {
-        ScopedMutexLock lk(_featuresCacheMutex);
-        FeatureList features;
-        cursor->fill(features);
-
-#if 1
-        FeatureList copy(features.size());
-        std::transform(features.begin(), features.end(), copy.begin(),
-            [&](const osg::ref_ptr<Feature>& feature) {
-                return osg::clone(feature.get(), osg::CopyOp::DEEP_COPY_ALL);
-            });
-        _featuresCache->insert(*query.tileKey(), copy);
-#else
-        // original code: stored raw features in the cache, but they are not const.
-        // revisit if/when we refactor this
-        _featuresCache->insert(*query.tileKey(), features);
-#endif
-
-        cursor = new FeatureListCursor(features);
+        cursor = createFeatureCursorImplementation(query, progress);
     }
 
     if (cursor.valid() && filters)
@@ -318,6 +319,61 @@ FeatureSource::createFeatureCursor(
         return cursor.release();
 }
 
+//...................................................................
+
+FeatureSource::FeatureTileCache::FeatureTileCache(unsigned maxTiles, std::size_t maxBytes) :
+    _maxTiles(maxTiles),
+    _maxBytes(maxBytes),
+    _bytes(0u)
+{
+    //nop
+}
+
+const FeatureTile*
+FeatureSource::FeatureTileCache::get(const TileKey& key)
+{
+    auto i = _map.find(key);
+    if (i == _map.end())
+        return nullptr;
+
+    // move to the front of the LRU
+    _lru.splice(_lru.begin(), _lru, i->second.lru);
+    return i->second.tile.get();
+}
+
+void
+FeatureSource::FeatureTileCache::insert(const TileKey& key, const FeatureTile* tile)
+{
+    auto i = _map.find(key);
+    if (i != _map.end())
+        remove(i);
+
+    // a tile that would not fit by itself is not worth evicting everything for
+    if (_maxBytes > 0u && tile->getSizeInBytes() > _maxBytes)
+        return;
+
+    _lru.push_front(key);
+    Entry& entry = _map[key];
+    entry.tile = tile;
+    entry.lru = _lru.begin();
+    _bytes += tile->getSizeInBytes();
+
+    while (
+        (_maxTiles > 0u && _map.size() > _maxTiles) ||
+        (_maxBytes > 0u && _bytes > _maxBytes))
+    {
+        remove(_map.find(_lru.back()));
+    }
+}
+
+void
+FeatureSource::FeatureTileCache::remove(std::unordered_map<TileKey, Entry>::iterator i)
+{
+    _bytes -= i->second.tile->getSizeInBytes();
+    _lru.erase(i->second.lru);
+    _map.erase(i);
+}
+
 namespace
 {
     struct MultiCursor : public FeatureCursor
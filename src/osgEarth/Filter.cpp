@@ -40,6 +40,20 @@ FeatureFilter::~FeatureFilter()
 {
 }
 
+FilterContext
+FeatureFilter::push(FeatureBatch& input, FilterContext& context)
+{
+    FeatureList features;
+    input.createFeatures(features);
+
+    FilterContext output = push(features, context);
+
+    input.clear();
+    input.append(features);
+
+    return output;
+}
+
 /********************************************************************************/
 
 #undef LC
@@ -21,8 +21,10 @@
 #include <osgEarth/HeightFieldUtils>
 #include <osgEarth/FeatureCursor>
 #include <osgEarth/Containers>
-#include <osgEarth/rtree.h>
 #include <osgEarth/Metrics>
+#include <osgEarth/Threading>
+#include <atomic>
+#include <mutex>
 
 using namespace osgEarth;
 using namespace osgEarth::Contrib;
@@ -34,6 +36,8 @@ REGISTER_OSGEARTH_LAYER(flattened_elevation, FlatteningLayer);
 
 #define OE_TEST OE_DEBUG
 
+#define FLATTENING_ARENA "oe.flattening"
+
 namespace
 {
     // linear interpolation between a and b
@@ -403,9 +407,7 @@ namespace
 
     typedef std::vector< LineSegment > LineSegmentList;
 
-    typedef RTree<unsigned, double, 2> LineSegmentIndex;
-
-    void buildSegmentList(const MultiGeometry* geom, LineSegmentList& segments, LineSegmentIndex& index)
+    void buildSegmentList(const MultiGeometry* geom, LineSegmentList& segments)
     {
         for (unsigned int geomIndex = 0; geomIndex < geom->getNumComponents(); geomIndex++)
         {
@@ -419,19 +421,178 @@ namespace
                 for (int i = 0; i < part->size() - 1; ++i)
                 {
                     // AB is a candidate line segment:
-                    const osg::Vec3d& A = (*part)[i];
-                    const osg::Vec3d& B = (*part)[i + 1];
-                    segments.emplace_back(A, B, geomIndex);
+                    segments.emplace_back((*part)[i], (*part)[i + 1], geomIndex);
+                }
+            }
+        }
+    }
+
+    // Shortest distance (squared) from point P to a line segment. Also yields
+    // the parameter "t" [0..1] of the closest point on the segment.
+    double inline distanceToSegment2(const osg::Vec3d& P, const LineSegment& segment, double& t)
+    {
+        // vector from endpoint A to point P
+        osg::Vec3d AP = P - segment.A;
+
+        if (segment.length2 == 0.0)
+        {
+            // trivial case: zero-length segment
+            t = 0.0;
+            return AP.length2();
+        }
+
+        // Calculate parameter "t" [0..1] which will yield the closest point on AB to P.
+        // Clamping it means the closest point won't be beyond the endpoints of the segment.
+        t = clamp((AP * segment.AB) / segment.length2, 0.0, 1.0);
+
+        // measure the distance (squared) from P to the projected point on AB:
+        return (P - (segment.A + segment.AB * t)).length2();
+    }
+
+    // Width and height of a segment grid cell, in heightfield pixels
+    const unsigned SEGMENT_GRID_CELL_SIZE = 8u;
+
+    /**
+     * Bins line segments into square blocks of heightfield pixels. Each cell
+     * lists every segment whose flattening buffer can reach a pixel in that
+     * cell, so a pixel only has to consider the segments in its own cell.
+     * Binning is conservative: a cell may list a segment that ends up not
+     * touching any of its pixels, but never misses one that does.
+     */
+    struct SegmentGrid
+    {
+        unsigned numCellCols = 0u;
+        unsigned numCellRows = 0u;
 
-                    double min[2] = { osg::minimum(A.x(), B.x()), osg::minimum(A.y(), B.y()) };
-                    double max[2] = { osg::maximum(A.x(), B.x()), osg::maximum(A.y(), B.y()) };
+        // Segments of cell "c" are cellSegments[cellStart[c] .. cellStart[c+1]),
+        // in ascending order.
+        std::vector<unsigned> cellStart;
+        std::vector<unsigned> cellSegments;
+
+        unsigned cellOf(unsigned col, unsigned row) const
+        {
+            return (row / SEGMENT_GRID_CELL_SIZE) * numCellCols + (col / SEGMENT_GRID_CELL_SIZE);
+        }
+
+        bool empty(unsigned col, unsigned row) const
+        {
+            unsigned c = cellOf(col, row);
+            return cellStart[c] == cellStart[c + 1];
+        }
+
+        void build(const LineSegmentList& segments, const WidthsList& widths, const GeoExtent& ex,
+            unsigned cols, unsigned rows, double colInterval, double rowInterval)
+        {
+            numCellCols = (cols + SEGMENT_GRID_CELL_SIZE - 1) / SEGMENT_GRID_CELL_SIZE;
+            numCellRows = (rows + SEGMENT_GRID_CELL_SIZE - 1) / SEGMENT_GRID_CELL_SIZE;
+            cellStart.assign(numCellCols * numCellRows + 1, 0u);
+            cellSegments.clear();
+
+            // Every pixel in a cell is within half a cell diagonal of the cell's center:
+            double span = (double)(SEGMENT_GRID_CELL_SIZE - 1);
+            double halfDiagonal = 0.5 * sqrt(span*colInterval*span*colInterval + span*rowInterval*span*rowInterval);
+
+            // (cell, segment) pairs, in segment order
+            std::vector<std::pair<unsigned, unsigned>> bins;
+            osg::Vec3d center;
+            double t;
+
+            for (unsigned s = 0; s < segments.size(); ++s)
+            {
+                const LineSegment& segment = segments[s];
+                const Widths& w = widths[segment.geomIndex];
+                double radius = w.lineWidth * 0.5 + w.bufferWidth;
+
+                // range of pixels covered by the segment's buffered bounding box:
+                double xmin = (osg::minimum(segment.A.x(), segment.B.x()) - radius - ex.xMin()) / colInterval;
+                double xmax = (osg::maximum(segment.A.x(), segment.B.x()) + radius - ex.xMin()) / colInterval;
+                double ymin = (osg::minimum(segment.A.y(), segment.B.y()) - radius - ex.yMin()) / rowInterval;
+                double ymax = (osg::maximum(segment.A.y(), segment.B.y()) + radius - ex.yMin()) / rowInterval;
+
+                if (xmax < 0.0 || ymax < 0.0 || xmin > (double)(cols - 1) || ymin > (double)(rows - 1))
+                    continue;
+
+                unsigned cellColMin = (unsigned)osg::maximum(xmin, 0.0) / SEGMENT_GRID_CELL_SIZE;
+                unsigned cellColMax = (unsigned)osg::minimum(xmax, (double)(cols - 1)) / SEGMENT_GRID_CELL_SIZE;
+                unsigned cellRowMin = (unsigned)osg::maximum(ymin, 0.0) / SEGMENT_GRID_CELL_SIZE;
+                unsigned cellRowMax = (unsigned)osg::minimum(ymax, (double)(rows - 1)) / SEGMENT_GRID_CELL_SIZE;
+
+                double reach = radius + halfDiagonal;
+                double reach2 = reach * reach;
+
+                for (unsigned cy = cellRowMin; cy <= cellRowMax; ++cy)
+                {
+                    center.y() = ex.yMin() + ((double)(cy * SEGMENT_GRID_CELL_SIZE) + 0.5*span) * rowInterval;
 
-                    unsigned int segmentIndex = segments.size() - 1;
+                    for (unsigned cx = cellColMin; cx <= cellColMax; ++cx)
+                    {
+                        center.x() = ex.xMin() + ((double)(cx * SEGMENT_GRID_CELL_SIZE) + 0.5*span) * colInterval;
 
-                    index.Insert(min, max, segmentIndex);
+                        if (distanceToSegment2(center, segment, t) <= reach2)
+                        {
+                            unsigned c = cy * numCellCols + cx;
+                            bins.emplace_back(c, s);
+                            ++cellStart[c + 1];
+                        }
+                    }
                 }
             }
+
+            // Counting sort by cell; segments stay in ascending order within a cell.
+            for (unsigned c = 0; c < numCellCols * numCellRows; ++c)
+                cellStart[c + 1] += cellStart[c];
+
+            cellSegments.resize(bins.size());
+            std::vector<unsigned> next(cellStart.begin(), cellStart.end() - 1);
+            for (auto& bin : bins)
+                cellSegments[next[bin.first]++] = bin.second;
         }
+    };
+
+    /**
+     * Samples the source elevation at each point (in geomSRS) in one batch.
+     * Points with no data come back as NO_DATA_VALUE. Without a map SRS to
+     * batch in, falls back to sampling one point at a time.
+     */
+    void sampleElevations(std::vector<osg::Vec3d>& points, const SpatialReference* geomSRS, const SpatialReference* mapSRS,
+        ElevationPool* pool, ElevationPool::WorkingSet* workingSet, ProgressCallback* progress,
+        std::vector<float>& elevations)
+    {
+        elevations.assign(points.size(), NO_DATA_VALUE);
+
+        if (points.empty())
+            return;
+
+        if (mapSRS == nullptr)
+        {
+            static std::once_flag s_warnOnce;
+            std::call_once(s_warnOnce, []() {
+                OE_WARN << LC << "Map SRS unavailable; sampling elevation one point at a time" << std::endl;
+            });
+
+            GeoPoint EP(geomSRS, 0, 0, 0);
+            for (unsigned i = 0; i < points.size(); ++i)
+            {
+                EP.x() = points[i].x(), EP.y() = points[i].y();
+                elevations[i] = pool->getSample(EP, workingSet, progress).elevation();
+            }
+            return;
+        }
+
+        if (!geomSRS->isHorizEquivalentTo(mapSRS))
+            geomSRS->transform(points, mapSRS);
+
+        // W = 0 samples at the best available resolution, as getSample does.
+        std::vector<osg::Vec4d> mapPoints;
+        mapPoints.reserve(points.size());
+        for (auto& p : points)
+            mapPoints.emplace_back(p.x(), p.y(), NO_DATA_VALUE, 0.0);
+
+        if (pool->sampleMapCoords(mapPoints, workingSet, progress) < 0)
+            return;
+
+        for (unsigned i = 0; i < mapPoints.size(); ++i)
+            elevations[i] = mapPoints[i].z();
     }
 
     /**
@@ -449,267 +610,277 @@ namespace
      * source elevation into the heightfield as a starting point, and then sample that
      * modifiable heightfield as we go along.
      */
-    bool integrateLines(const TileKey& key, osg::HeightField* hf, LineSegmentList& segments, LineSegmentIndex& index, const SpatialReference* geomSRS,
-        WidthsList& widths, ElevationPool* pool, ElevationPool::WorkingSet* workingSet,
+    bool integrateLines(const TileKey& key, osg::HeightField* hf, LineSegmentList& segments, const SpatialReference* geomSRS,
+        const SpatialReference* mapSRS, WidthsList& widths, ElevationPool* pool, ElevationPool::WorkingSet* workingSet,
         bool fillAllPixels, ProgressCallback* progress)
     {
         OE_PROFILING_ZONE;
 
-        double maxBufferDistance = 0.0;
-        for (auto& w : widths)
-        {
-            double d = w.bufferWidth + w.lineWidth;
-            if (d > maxBufferDistance) maxBufferDistance = d;
-        }
-
-        bool wroteChanges = false;
-
         GeoExtent ex = key.getExtent();
         if (ex.getSRS() != geomSRS)
         {
             ex = ex.transform(geomSRS);
         }
 
-        double col_interval = ex.width() / (double)(hf->getNumColumns() - 1);
-        double row_interval = ex.height() / (double)(hf->getNumRows() - 1);
+        const unsigned cols = hf->getNumColumns();
+        const unsigned rows = hf->getNumRows();
 
-        osg::Vec3d P, PROJ;
-        GeoPoint EP(geomSRS, 0, 0, 0);
+        double col_interval = ex.width() / (double)(cols - 1);
+        double row_interval = ex.height() / (double)(rows - 1);
 
-        ElevationSample elevSample;
+        SegmentGrid grid;
+        grid.build(segments, widths, ex, cols, rows, col_interval, row_interval);
 
-        for (unsigned row = 0; row < hf->getNumRows(); ++row)
+        if (grid.cellSegments.empty() && !fillAllPixels)
         {
-            P.y() = ex.yMin() + (double)row * row_interval;
-
-            std::vector< unsigned int > hits;
+            return false;
+        }
 
-            double searchMin[2] = { ex.xMin() - maxBufferDistance, P.y() - maxBufferDistance };
-            double searchMax[2] = { ex.xMax() + maxBufferDistance, P.y() + maxBufferDistance };
-            index.Search(searchMin, searchMax, &hits, ~0u);
+        // Collect every point whose source elevation we need -- the endpoints
+        // of segments that reach this tile, and the pixels that might change --
+        // and sample them all at once.
+        std::vector<osg::Vec3d> points;
+        std::vector<unsigned> segmentPoint(segments.size(), ~0u);
+        std::vector<unsigned> pixelPoint(cols * rows, ~0u);
 
-            // If there are no hits just skip the whole row.
-            if (hits.size() == 0)
+        for (unsigned s : grid.cellSegments)
+        {
+            if (segmentPoint[s] == ~0u)
             {
-                continue;
+                segmentPoint[s] = points.size();
+                points.emplace_back(segments[s].A.x(), segments[s].A.y(), 0.0);
+                points.emplace_back(segments[s].B.x(), segments[s].B.y(), 0.0);
             }
+        }
 
-            for (unsigned col = 0; col < hf->getNumColumns(); ++col)
+        for (unsigned row = 0; row < rows; ++row)
+        {
+            for (unsigned col = 0; col < cols; ++col)
             {
-                P.x() = ex.xMin() + (double)col * col_interval;
-
-                // For each point, we need to find the closest line segments to that point
-                // because the elevation values on these line segments will be the flattening
-                // value. There may be more than one line segment that falls within the search
-                // radius; we will collect up to MaxSamples of these for each heightfield point.
-                static const unsigned Maxsamples = 4;
-                Samples samples;
-
-                unsigned int hitIndex = 0;
-                // What is the maximum number of hits we see in this area?
-                for (auto hit : hits)
+                if (fillAllPixels || !grid.empty(col, row))
                 {
-                    LineSegment& segment = segments[hit];
+                    pixelPoint[row * cols + col] = points.size();
+                    points.emplace_back(ex.xMin() + (double)col * col_interval, ex.yMin() + (double)row * row_interval, 0.0);
+                }
+            }
+        }
 
-                    const Widths& w = widths[segment.geomIndex];
+        std::vector<float> elevations;
+        sampleElevations(points, geomSRS, mapSRS, pool, workingSet, progress, elevations);
 
-                    double innerRadius = w.lineWidth * 0.5;
-                    double outerRadius = innerRadius + w.bufferWidth;
-                    double outerRadius2 = outerRadius * outerRadius;
+        for (unsigned s = 0; s < segments.size(); ++s)
+        {
+            if (segmentPoint[s] != ~0u)
+            {
+                segments[s].AElev = elevations[segmentPoint[s]];
+                segments[s].BElev = elevations[segmentPoint[s] + 1];
+            }
+        }
 
-                    // AB is a candidate line segment:
-                    const osg::Vec3d& A = segment.A;
-                    const osg::Vec3d& B = segment.B;
+        std::atomic<bool> wroteChanges(false);
 
-                    //osg::Vec3d AB = B - A;    // current segment AB
-                    const osg::Vec3d& AB = segment.AB;
+        // Rows only read shared state and write their own heightfield row,
+        // so they can run in parallel.
+        auto integrateRows = [&](unsigned firstRow, unsigned lastRow)
+        {
+            // For each point, we need to find the closest line segments to that point
+            // because the elevation values on these line segments will be the flattening
+            // value. There may be more than one line segment that falls within the search
+            // radius; we will collect up to MaxSamples of these for each heightfield point.
+            static const unsigned Maxsamples = 4;
+            Samples samples;
+            samples.reserve(Maxsamples);
 
-                    double t;                 // parameter [0..1] on segment AB
-                    double D2;                // shortest distance from point P to segment AB, squared
-                    //double L2 = AB.length2(); // length (squared) of segment AB
-                    double L2 = segment.length2; // length (squared) of segment AB
+            osg::Vec3d P;
 
-                    osg::Vec3d AP = P - A;    // vector from endpoint A to point P
+            for (unsigned row = firstRow; row < lastRow; ++row)
+            {
+                if (progress && progress->isCanceled())
+                    return;
 
-                    if (L2 == 0.0)
-                    {
-                        // trivial case: zero-length segment
-                        t = 0.0;
-                        D2 = AP.length2();
-                    }
-                    else
-                    {
-                        // Calculate parameter "t" [0..1] which will yield the closest point on AB to P.
-                        // Clamping it means the closest point won't be beyond the endpoints of the segment.
-                        t = clamp((AP * AB) / L2, 0.0, 1.0);
+                P.y() = ex.yMin() + (double)row * row_interval;
 
-                        // project our point P onto segment AB:
-                        PROJ.set(A + AB * t);
+                for (unsigned col = 0; col < cols; ++col)
+                {
+                    unsigned pixel = row * cols + col;
+                    if (pixelPoint[pixel] == ~0u)
+                        continue;
 
-                        // measure the distance (squared) from P to the projected point on AB:
-                        D2 = (P - PROJ).length2();
-                    }
+                    P.x() = ex.xMin() + (double)col * col_interval;
 
-                    // If the distance from our point to the line segment falls within
-                    // the maximum flattening distance, store it.
-                    if (D2 <= outerRadius2)
+                    samples.clear();
+
+                    unsigned cell = grid.cellOf(col, row);
+                    for (unsigned i = grid.cellStart[cell]; i < grid.cellStart[cell + 1]; ++i)
                     {
-                        // see if P is a new sample.
-                        Sample* b;
-                        if (samples.size() < Maxsamples)
-                        {
-                            // If we haven't collected the maximum number of samples yet,
-                            // just add this to the list:
-                            samples.emplace_back(std::move(Sample()));
-                            b = &samples.back();
-                        }
-                        else
-                        {
-                            // If we are maxed out on samples, find the farthest one we have so far
-                            // and replace it if the new point is closer:
-                            unsigned max_i = 0;
-                            for (unsigned i = 1; i < samples.size(); ++i)
-                                if (samples[i].D2 > samples[max_i].D2)
-                                    max_i = i;
+                        const LineSegment& segment = segments[grid.cellSegments[i]];
 
-                            b = &samples[max_i];
+                        const Widths& w = widths[segment.geomIndex];
 
-                            if (b->D2 < D2)
-                                b = 0L;
-                        }
+                        double innerRadius = w.lineWidth * 0.5;
+                        double outerRadius = innerRadius + w.bufferWidth;
+                        double outerRadius2 = outerRadius * outerRadius;
 
-                        if (b)
-                        {
-                            b->D2 = D2;
-                            b->A = A;
-                            b->B = B;
-                            b->T = t;
+                        double t;   // parameter [0..1] on segment AB
+                        double D2 = distanceToSegment2(P, segment, t);
 
-                            // Sample the segment start and end elevations if they haven't been previously set.
-                            if (segment.AElev == NO_DATA_VALUE)
+                        // If the distance from our point to the line segment falls within
+                        // the maximum flattening distance, store it.
+                        if (D2 <= outerRadius2)
+                        {
+                            // see if P is a new sample.
+                            Sample* b;
+                            if (samples.size() < Maxsamples)
                             {
-                                EP.x() = segment.A.x(), EP.y() = segment.A.y();
-                                segment.AElev = pool->getSample(EP, workingSet).elevation();
+                                // If we haven't collected the maximum number of samples yet,
+                                // just add this to the list:
+                                samples.emplace_back(Sample());
+                                b = &samples.back();
                             }
-
-                            if (segment.BElev == NO_DATA_VALUE)
+                            else
                             {
-                                EP.x() = segment.B.x(), EP.y() = segment.B.y();
-                                segment.BElev = pool->getSample(EP, workingSet).elevation();
-                            }
+                                // If we are maxed out on samples, find the farthest one we have so far
+                                // and replace it if the new point is closer:
+                                unsigned max_i = 0;
+                                for (unsigned j = 1; j < samples.size(); ++j)
+                                    if (samples[j].D2 > samples[max_i].D2)
+                                        max_i = j;
 
-                            b->AElev = segment.AElev;
-                            b->BElev = segment.BElev;
+                                b = &samples[max_i];
+
+                                if (b->D2 < D2)
+                                    b = 0L;
+                            }
 
-                            b->innerRadius = innerRadius;
-                            b->outerRadius = outerRadius;
+                            if (b)
+                            {
+                                b->D2 = D2;
+                                b->A = segment.A;
+                                b->B = segment.B;
+                                b->T = t;
+                                b->AElev = segment.AElev;
+                                b->BElev = segment.BElev;
+                                b->innerRadius = innerRadius;
+                                b->outerRadius = outerRadius;
+                            }
                         }
                     }
-                }
 
-                // Remove unnecessary sample points that lie on the endpoint of a segment
-                // that abuts another segment in our list.
-                for (unsigned i = 0; i < samples.size();) {
-                    if (!isSampleValid(&samples[i], samples)) {
-                        samples[i] = samples[samples.size() - 1];
-                        samples.resize(samples.size() - 1);
+                    // Remove unnecessary sample points that lie on the endpoint of a segment
+                    // that abuts another segment in our list.
+                    for (unsigned i = 0; i < samples.size();) {
+                        if (!isSampleValid(&samples[i], samples)) {
+                            samples[i] = samples[samples.size() - 1];
+                            samples.resize(samples.size() - 1);
+                        }
+                        else ++i;
                     }
-                    else ++i;
-                }
 
-                // Now that we are done searching for line segments close to our point,
-                // we will collect the elevations at our sample points and use them to
-                // create a new elevation value for our point.
-                if (samples.size() > 0)
-                {
                     // The original elevation at our point:
-                    //float elevP = pool->getElevation(P.x(), P.y());
+                    float elevP = elevations[pixelPoint[pixel]];
 
-                    EP.x() = P.x(), EP.y() = P.y();
+                    // Now that we are done searching for line segments close to our point,
+                    // we will use the elevations at our sample points to create a new
+                    // elevation value for our point.
+                    if (samples.size() > 0)
+                    {
+                        for (unsigned i = 0; i < samples.size(); ++i)
+                        {
+                            Sample& sample = samples[i];
 
-                    elevSample = pool->getSample(EP, workingSet);
+                            sample.D = sqrt(sample.D2);
 
-                    float elevP = elevSample.elevation().getValue();
+                            // Blend factor. 0 = distance is less than or equal to the inner radius;
+                            //               1 = distance is greater than or equal to the outer radius.
+                            double blend = clamp(
+                                (sample.D - sample.innerRadius) / (sample.outerRadius - sample.innerRadius),
+                                0.0, 1.0);
 
-                    for (unsigned i = 0; i < samples.size(); ++i)
-                    {
-                        Sample& sample = samples[i];
+                            if (sample.T == 0.0)
+                            {
+                                sample.elevPROJ = sample.AElev;
+                                if (sample.elevPROJ == NO_DATA_VALUE)
+                                    sample.elevPROJ = elevP;
+                            }
+                            else if (sample.T == 1.0)
+                            {
+                                sample.elevPROJ = sample.BElev;
+                                if (sample.elevPROJ == NO_DATA_VALUE)
+                                    sample.elevPROJ = elevP;
+                            }
+                            else
+                            {
+                                float elevA = sample.AElev;
+                                if (elevA == NO_DATA_VALUE)
+                                    elevA = elevP;
 
-                        sample.D = sqrt(sample.D2);
+                                float elevB = sample.BElev;
+                                if (elevB == NO_DATA_VALUE)
+                                    elevB = elevP;
 
-                        // Blend factor. 0 = distance is less than or equal to the inner radius;
-                        //               1 = distance is greater than or equal to the outer radius.
-                        double blend = clamp(
-                            (sample.D - sample.innerRadius) / (sample.outerRadius - sample.innerRadius),
-                            0.0, 1.0);
+                                // linear interpolation of height from point A to point B on the segment:
+                                sample.elevPROJ = mix(elevA, elevB, sample.T);
+                            }
 
-                        if (sample.T == 0.0)
-                        {
-                            sample.elevPROJ = sample.AElev;
-                            if (sample.elevPROJ == NO_DATA_VALUE)
-                                sample.elevPROJ = elevP;
+                            // smoothstep interpolation of along the buffer (perpendicular to the segment)
+                            // will gently integrate the new value into the existing terrain.
+                            sample.elev = smootherstep(sample.elevPROJ, elevP, blend);
                         }
-                        else if (sample.T == 1.0)
-                        {
-                            sample.elevPROJ = sample.BElev;
-                            if (sample.elevPROJ == NO_DATA_VALUE)
-                                sample.elevPROJ = elevP;
-                        }
-                        else
-                        {
-                            float elevA = sample.AElev;
-                            if (elevA == NO_DATA_VALUE)
-                                elevA = elevP;
-
-                            float elevB = sample.BElev;
-                            if (elevB == NO_DATA_VALUE)
-                                elevB = elevP;
 
-                            // linear interpolation of height from point A to point B on the segment:
-                            sample.elevPROJ = mix(elevA, elevB, sample.T);
-                        }
+                        // Finally, combine our new elevation values and set the new value in the output.
+                        float finalElev = interpolateSamplesIDW(samples);
+                        if (finalElev < FLT_MAX)
+                            hf->setHeight(col, row, finalElev);
+                        else
+                            hf->setHeight(col, row, elevP);
 
-                        // smoothstep interpolation of along the buffer (perpendicular to the segment)
-                        // will gently integrate the new value into the existing terrain.
-                        sample.elev = smootherstep(sample.elevPROJ, elevP, blend);
+                        wroteChanges = true;
                     }
 
-                    // Finally, combine our new elevation values and set the new value in the output.
-                    float finalElev = interpolateSamplesIDW(samples);
-                    if (finalElev < FLT_MAX)
-                        hf->setHeight(col, row, finalElev);
-                    else
+                    else if (fillAllPixels)
+                    {
+                        // No close segments were found, so just copy over the source data.
                         hf->setHeight(col, row, elevP);
 
-                    wroteChanges = true;
+                        // Note: do not set wroteChanges to true.
+                    }
                 }
+            }
+        };
 
-                else if (fillAllPixels)
-                {
-                    // No close segments were found, so just copy over the source data.
-                    EP.x() = P.x(), EP.y() = P.y();
-                    float h = pool->getSample(EP, workingSet).elevation();
-                    hf->setHeight(col, row, h);
+        // Hand out bands of rows, and do the first band on this thread.
+        const unsigned rowsPerJob = SEGMENT_GRID_CELL_SIZE * 4u;
 
-                    // Note: do not set wroteChanges to true.
-                }
-            }
+        JobGroup group;
+        Job job(JobArena::get(FLATTENING_ARENA), &group);
+        job.setName("oe.flattening.rows");
+
+        for (unsigned firstRow = rowsPerJob; firstRow < rows; firstRow += rowsPerJob)
+        {
+            unsigned lastRow = osg::minimum(firstRow + rowsPerJob, rows);
+            job.dispatch([&integrateRows, firstRow, lastRow](Cancelable*)
+            {
+                integrateRows(firstRow, lastRow);
+            });
         }
 
+        integrateRows(0u, osg::minimum(rowsPerJob, rows));
+
+        group.join();
+
         return wroteChanges;
     }
 
 
     bool integrate(const TileKey& key, osg::HeightField* hf, const MultiGeometry* geom, const SpatialReference* geomSRS,
-        WidthsList& widths, ElevationPool* pool, ElevationPool::WorkingSet* workingSet,
+        const SpatialReference* mapSRS, WidthsList& widths, ElevationPool* pool, ElevationPool::WorkingSet* workingSet,
         bool fillAllPixels, ProgressCallback* progress)
     {
         if (geom->isLinear())
         {
             LineSegmentList segments;
-            LineSegmentIndex index;
-            buildSegmentList(geom, segments, index);
-            return integrateLines(key, hf, segments, index, geomSRS, widths, pool, workingSet, fillAllPixels, progress);
+            buildSegmentList(geom, segments);
+            return integrateLines(key, hf, segments, geomSRS, mapSRS, widths, pool, workingSet, fillAllPixels, progress);
         }
         else
             return integratePolygons(key, hf, geom, geomSRS, widths, pool, workingSet, fillAllPixels, progress);
@@ -870,6 +1041,7 @@ FlatteningLayer::addedToMap(const Map* map)
     // Initialize the elevation pool with our map:
     OE_INFO << LC << "Attaching elevation pool to map\n";
     _pool->setMap(map);
+    _map = map;
 
     options().featureSource().addedToMap(map);
 
@@ -896,6 +1068,8 @@ FlatteningLayer::removedFromMap(const Map* map)
 {
     options().featureSource().removedFromMap(map);
 
+    _map = nullptr;
+
     ElevationLayer::removedFromMap(map);
 }
 
@@ -1157,11 +1331,16 @@ FlatteningLayer::createHeightFieldImplementation(const TileKey& key, ProgressCal
 
         bool fill = (options().fill() == true);
 
+        // Source elevations are sampled in the map's SRS:
+        osg::ref_ptr<const Map> map;
+        _map.lock(map);
+
         bool wrote_to_hf = integrate(
             key,
             hf.get(),
             &geoms,
             workingSRS,
+            map.valid() ? map->getSRS() : nullptr,
             widths,
             _pool.get(),
             &_elevWorkingSet,
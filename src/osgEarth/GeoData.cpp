@@ -23,6 +23,7 @@
 #include <osgEarth/Registry>
 #include <osgEarth/Terrain>
 #include <osgEarth/GDAL>
+#include <osgEarth/ImageReprojector>
 #include <osgEarth/Metrics>
 #include <osg/BoundingBox>
 
@@ -2120,14 +2121,26 @@ GeoImage::reproject(const SpatialReference* to_srs, const GeoExtent* to_extent,
         destExtent = getExtent().transform(to_srs);    
     }
 
-    osg::Image* resultImage = 0L;
-    if (getSRS()->isUserDefined() || to_srs->isUserDefined() || getImage()->r() > 1)
+    // GDAL will not recognize a custom projection and does not handle 3D images.
+    bool manual = getSRS()->isUserDefined() || to_srs->isUserDefined() || getImage()->r() > 1;
+
+    if (manual && (width == 0 || height == 0))
+    {
+        //If no width and height are specified, just use the minimum dimension for the image
+        width = osg::minimum(getImage()->s(), getImage()->t());
+        height = width;
+    }
+
+    // Try the native reprojector first. It caches the transform for each
+    // output tile, and falls back on the older paths for formats it can't handle.
+    osg::Image* resultImage = Util::ImageReprojector::instance().reproject(
+        getImage(), getExtent(), destExtent, width, height, useBilinearInterpolation);
+
+    if (resultImage == nullptr && manual)
     {
-        // if either of the SRS is a custom projection or it is a 3D image, we have to do a manual reprojection since
-        // GDAL will not recognize the SRS and does not handle 3D images.
         resultImage = manualReproject(getImage(), getExtent(), destExtent, useBilinearInterpolation, width, height);
     }
-    else
+    else if (resultImage == nullptr)
     {
         // otherwise use GDAL.
         resultImage = osgEarth::GDAL::reprojectImage(
@@ -36,6 +36,8 @@
 #include <osgEarth/ShaderUtils>
 #include <osgEarth/Utils>
 #include <osgEarth/Metrics>
+#include <osgEarth/StateSetCache>
+#include <osgEarth/Threading>
 
 #include <osg/MatrixTransform>
 #include <osg/Timer>
@@ -53,6 +55,8 @@ using namespace osgEarth::Util;
 
 //#define PROFILING 1
 
+#define GEOMETRY_COMPILER_ARENA "oe.geometrycompiler"
+
 //-----------------------------------------------------------------------
 
 GeometryCompilerOptions GeometryCompilerOptions::s_defaults(true);
@@ -77,7 +81,10 @@ _optimize              ( false ),
 _optimizeVertexOrdering( true ),
 _validate              ( false ),
 _maxPolyTilingAngle    ( 45.0f ),
-_useOSGTessellator     ( false )
+_useOSGTessellator     ( false ),
+_tessellationMethod    ( Tessellator::METHOD_AUTO ),
+_parallel              ( false ),
+_parallelChunkSize     ( 128u )
 {
     //nop
 }
@@ -97,7 +104,10 @@ _optimize              ( s_defaults.optimize().value() ),
 _optimizeVertexOrdering( s_defaults.optimizeVertexOrdering().value() ),
 _validate              ( s_defaults.validate().value() ),
 _maxPolyTilingAngle    ( s_defaults.maxPolygonTilingAngle().value() ),
-_useOSGTessellator     (s_defaults.useOSGTessellator().value())
+_useOSGTessellator     (s_defaults.useOSGTessellator().value()),
+_tessellationMethod    ( s_defaults.tessellationMethod().value() ),
+_parallel              ( s_defaults.parallel().value() ),
+_parallelChunkSize     ( s_defaults.parallelChunkSize().value() )
 {
     fromConfig(conf.getConfig());
 }
@@ -119,6 +129,11 @@ GeometryCompilerOptions::fromConfig( const Config& conf )
     conf.get( "validate", _validate );
     conf.get( "max_polygon_tiling_angle", _maxPolyTilingAngle );
     conf.get( "use_osg_tessellator", _useOSGTessellator);
+    conf.get( "tessellation_method", "auto",   _tessellationMethod, Tessellator::METHOD_AUTO );
+    conf.get( "tessellation_method", "sweep",  _tessellationMethod, Tessellator::METHOD_SWEEP );
+    conf.get( "tessellation_method", "earcut", _tessellationMethod, Tessellator::METHOD_EARCUT );
+    conf.get( "parallel", _parallel );
+    conf.get( "parallel_chunk_size", _parallelChunkSize );
 
     conf.get( "shader_policy", "disable",  _shaderPolicy, SHADERPOLICY_DISABLE );
     conf.get( "shader_policy", "inherit",  _shaderPolicy, SHADERPOLICY_INHERIT );
@@ -143,6 +158,11 @@ GeometryCompilerOptions::getConfig() const
     conf.set( "validate", _validate );
     conf.set( "max_polygon_tiling_angle", _maxPolyTilingAngle );
     conf.set( "use_osg_tessellator", _useOSGTessellator);
+    conf.set( "tessellation_method", "auto",   _tessellationMethod, Tessellator::METHOD_AUTO );
+    conf.set( "tessellation_method", "sweep",  _tessellationMethod, Tessellator::METHOD_SWEEP );
+    conf.set( "tessellation_method", "earcut", _tessellationMethod, Tessellator::METHOD_EARCUT );
+    conf.set( "parallel", _parallel );
+    conf.set( "parallel_chunk_size", _parallelChunkSize );
 
     conf.set( "shader_policy", "disable",  _shaderPolicy, SHADERPOLICY_DISABLE );
     conf.set( "shader_policy", "inherit",  _shaderPolicy, SHADERPOLICY_INHERIT );
@@ -151,6 +171,38 @@ GeometryCompilerOptions::getConfig() const
 }
 
 
+//-----------------------------------------------------------------------
+
+namespace
+{
+    // Funnels tagging calls from parallel chunks into a feature index,
+    // which is not thread safe.
+    class SerializedFeatureIndex : public FeatureIndexBuilder
+    {
+    public:
+        SerializedFeatureIndex(FeatureIndexBuilder* index) : _index(index) { }
+
+        ObjectID tagDrawable(osg::Drawable* drawable, Feature* feature) override {
+            Threading::ScopedMutexLock lock(_mutex);
+            return _index->tagDrawable(drawable, feature);
+        }
+
+        ObjectID tagAllDrawables(osg::Node* node, Feature* feature) override {
+            Threading::ScopedMutexLock lock(_mutex);
+            return _index->tagAllDrawables(node, feature);
+        }
+
+        ObjectID tagNode(osg::Node* node, Feature* feature) override {
+            Threading::ScopedMutexLock lock(_mutex);
+            return _index->tagNode(node, feature);
+        }
+
+    private:
+        FeatureIndexBuilder* _index;
+        Threading::Mutex _mutex;
+    };
+}
+
 //-----------------------------------------------------------------------
 
 GeometryCompiler::GeometryCompiler()
@@ -225,6 +277,12 @@ GeometryCompiler::compile(FeatureList&          workingSet,
 {
     OE_PROFILING_ZONE;
 
+    if (_options.parallel() == true &&
+        workingSet.size() > 2u * _options.parallelChunkSize().value())
+    {
+        return compileParallel(workingSet, style, context);
+    }
+
 #ifdef PROFILING
     osg::Timer_t p_start = osg::Timer::instance()->tick();
     unsigned p_features = workingSet.size();
@@ -439,6 +497,7 @@ GeometryCompiler::compile(FeatureList&          workingSet,
         filter.maxGranularity() = *_options.maxGranularity();
         filter.geoInterp()      = *_options.geoInterp();
         filter.useOSGTessellator() = *_options.useOSGTessellator();
+        filter.tessellationMethod() = *_options.tessellationMethod();
 
         if (_options.maxPolygonTilingAngle().isSet())
             filter.maxPolygonTilingAngle() = *_options.maxPolygonTilingAngle();
@@ -597,3 +656,155 @@ GeometryCompiler::compile(FeatureList&          workingSet,
 
     return resultGroup.release();
 }
+
+osg::Node*
+GeometryCompiler::compileParallel(FeatureList&          workingSet,
+                                  const Style&          style,
+                                  const FilterContext&  context)
+{
+    OE_PROFILING_ZONE;
+
+    FilterContext sharedCX = context;
+
+    // Default symbols come from the first feature in the list, and
+    // every chunk would pick its own; leave that case to the serial path.
+    if (!style.has<PointSymbol>() && !style.has<LineSymbol>() && !style.has<PolygonSymbol>() &&
+        !style.has<ExtrusionSymbol>() && !style.has<TextSymbol>() && !style.has<ModelSymbol>() &&
+        !style.has<IconSymbol>())
+    {
+        GeometryCompiler serial(_options);
+        serial.options().parallel() = false;
+        return serial.compile(workingSet, style, context);
+    }
+
+    // Each chunk runs the full filter chain; sharing state across
+    // chunks and optimizing happen once the results are merged.
+    GeometryCompilerOptions chunkOptions(_options);
+    chunkOptions.parallel() = false;
+    chunkOptions.optimizeStateSharing() = false;
+    chunkOptions.optimize() = false;
+    chunkOptions.validate() = false;
+
+    std::vector<FeatureList> chunks;
+    unsigned chunkSize = osg::maximum(_options.parallelChunkSize().value(), 1u);
+    while (!workingSet.empty())
+    {
+        chunks.emplace_back();
+        FeatureList::iterator end = workingSet.begin();
+        std::advance(end, osg::minimum((std::size_t)chunkSize, workingSet.size()));
+        chunks.back().splice(chunks.back().end(), workingSet, workingSet.begin(), end);
+    }
+
+    std::unique_ptr<SerializedFeatureIndex> index;
+    if (sharedCX.featureIndex())
+        index.reset(new SerializedFeatureIndex(sharedCX.featureIndex()));
+
+    bool shareState = (_options.optimizeStateSharing() == true);
+    bool sharedSession = (sharedCX.getSession() != nullptr);
+
+    std::vector<osg::ref_ptr<osg::Node>> results(chunks.size());
+
+    auto compileChunk = [&](unsigned i)
+    {
+        // The context's ResourceCache locks internally, so the chunks
+        // share it (and with it, the session's resources).
+        FilterContext chunkCX = sharedCX;
+        if (index)
+            chunkCX.setFeatureIndex(index.get());
+
+        GeometryCompiler compiler(chunkOptions);
+        results[i] = compiler.compile(chunks[i], style, chunkCX);
+
+        if (results[i].valid() && shareState)
+        {
+            // StateSetCache is not thread safe; use one per chunk.
+            osg::ref_ptr<StateSetCache> sscache = new StateSetCache();
+            if (sharedSession)
+                sscache->consolidateStateAttributes(results[i].get());
+            else
+                sscache->optimize(results[i].get());
+        }
+    };
+
+    // The calling thread compiles the first chunk while the arena
+    // works on the rest.
+    JobGroup group;
+    Job job(JobArena::get(GEOMETRY_COMPILER_ARENA), &group);
+    job.setName("oe.geometrycompiler.chunk");
+    for (unsigned i = 1; i < chunks.size(); ++i)
+    {
+        job.dispatch([&compileChunk, i](Cancelable*) { compileChunk(i); });
+    }
+    compileChunk(0u);
+    group.join();
+
+    // Merge the results into a single group:
+    osg::ref_ptr<osg::Group> resultGroup = new osg::Group();
+    for (auto& result : results)
+    {
+        if (!result.valid())
+            continue;
+
+        // hoist the children of plain chunk groups
+        osg::Group* chunkGroup = result->asGroup();
+        if (chunkGroup && chunkGroup->getStateSet() == nullptr)
+        {
+            for (unsigned c = 0; c < chunkGroup->getNumChildren(); ++c)
+                resultGroup->addChild(chunkGroup->getChild(c));
+        }
+        else
+        {
+            resultGroup->addChild(result.get());
+        }
+    }
+
+    // Hand the (munged) features back to the caller
+    for (auto& chunk : chunks)
+    {
+        workingSet.splice(workingSet.end(), chunk);
+    }
+
+    if (shareState)
+    {
+        if (sharedSession)
+        {
+            sharedCX.getSession()->getStateSetCache()->consolidateStateAttributes(resultGroup.get());
+        }
+        else
+        {
+            osg::ref_ptr<StateSetCache> sscache = new StateSetCache();
+            sscache->optimize(resultGroup.get());
+        }
+    }
+
+    if (_options.optimize() == true)
+    {
+        int optimizations =
+            osgUtil::Optimizer::FLATTEN_STATIC_TRANSFORMS |
+            osgUtil::Optimizer::REMOVE_REDUNDANT_NODES |
+            osgUtil::Optimizer::COMBINE_ADJACENT_LODS |
+            osgUtil::Optimizer::SHARE_DUPLICATE_STATE |
+            osgUtil::Optimizer::CHECK_GEOMETRY |
+            osgUtil::Optimizer::MERGE_GEODES |
+            osgUtil::Optimizer::STATIC_OBJECT_DETECTION;
+
+        osgUtil::Optimizer opt;
+        opt.optimize(resultGroup.get(), optimizations);
+
+        osgUtil::Optimizer::MergeGeometryVisitor mg;
+        mg.setTargetMaximumNumberOfVertices(Registry::instance()->getMaxNumberOfVertsPerDrawable());
+        resultGroup->accept(mg);
+
+        // merged drawables need new kdtrees
+        osg::ref_ptr< osg::KdTreeBuilder > kdTreeBuilder = new osg::KdTreeBuilder();
+        resultGroup->accept(*kdTreeBuilder.get());
+    }
+
+    if (_options.validate() == true)
+    {
+        osgEarth::GeometryValidator validator;
+        resultGroup->accept(validator);
+    }
+
+    return resultGroup.release();
+}
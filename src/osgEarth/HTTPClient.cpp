@@ -24,6 +24,11 @@
 #include <osgDB/ReadFile>
 #include <osgDB/FileNameUtils>
 #include <curl/curl.h>
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <thread>
 
 // Whether to use WinInet instead of cURL - CMAKE option
 #ifdef OSGEARTH_USE_WININET_FOR_HTTP
@@ -38,6 +43,7 @@
 
 using namespace osgEarth;
 using namespace osgEarth::Util;
+using namespace osgEarth::Threading;
 
 namespace osgEarth
 {
@@ -308,8 +314,9 @@ _response_code( rhs._response_code ),
 _parts( rhs._parts ),
 _mimeType( rhs._mimeType ),
 _canceled( rhs._canceled ),
-_duration_s(0.0),
-_lastModified(0u)
+_duration_s( rhs._duration_s ),
+_lastModified( rhs._lastModified ),
+_message( rhs._message )
 {
     //nop
 }
@@ -405,6 +412,10 @@ namespace
     static long                        s_connectTimeout = 0;
     static float                       s_retryDelay_s = 0.5f;
 
+    // asynchronous engine settings
+    static std::atomic<unsigned>       s_maxConnectionsPerHost(6u);
+    static std::atomic<bool>           s_useAsyncEngine(false);
+
     // HTTP debugging.
     static bool                        s_HTTP_DEBUG = false;
     static Threading::Mutex            s_HTTP_DEBUG_mutex;
@@ -420,156 +431,385 @@ namespace
 
 namespace
 {
-    class CURLImplementation : public HTTPClient::Implementation
+    // Reads the proxy host/port from the CURL proxy options in a read-options string
+    void readProxyOptions(const osgDB::Options* options, std::string& proxy_host, std::string& proxy_port)
     {
-    public:
-        CURLImplementation() : _curl_handle(0), _previousHttpAuthentication(0) { }
-
-        void initialize()
+        if ( options )
         {
-            _previousHttpAuthentication = 0L;
-
-            _curl_handle = curl_easy_init();
+            std::istringstream iss( options->getOptionString() );
+            std::string opt;
+            while( iss >> opt )
+            {
+                int index = opt.find('=');
+                if( opt.substr( 0, index ) == "OSG_CURL_PROXY" )
+                {
+                    proxy_host = opt.substr( index+1 );
+                }
+                else if ( opt.substr( 0, index ) == "OSG_CURL_PROXYPORT" )
+                {
+                    proxy_port = opt.substr( index+1 );
+                }
+            }
+        }
+    }
 
-            curl_easy_setopt( _curl_handle, CURLOPT_WRITEFUNCTION, StreamObjectReadCallback );
-            curl_easy_setopt( _curl_handle, CURLOPT_HEADERFUNCTION, StreamObjectHeaderCallback );
-            curl_easy_setopt( _curl_handle, CURLOPT_FOLLOWLOCATION, (void*)1 );
-            curl_easy_setopt( _curl_handle, CURLOPT_MAXREDIRS, (void*)5 );
-            curl_easy_setopt( _curl_handle, CURLOPT_PROGRESSFUNCTION, &CurlProgressCallback);
-            curl_easy_setopt( _curl_handle, CURLOPT_NOPROGRESS, (void*)0 ); //0=enable.
-            curl_easy_setopt( _curl_handle, CURLOPT_FILETIME, true );
+    // Resolves the proxy address ("host:port", or empty for none) and the
+    // proxy credentials from the global settings, the read options, and
+    // the environment, in that order of precedence.
+    std::string getProxyAddress(const osgDB::Options* options, std::string& proxy_auth)
+    {
+        std::string proxy_host;
+        std::string proxy_port = "8080";
 
-            // Enable automatic CURL decompression of known types. An empty string will automatically add all supported encoding types that are built into curl.
-            // Note that you must have curl built against zlib to support gzip or deflate encoding.
-            curl_easy_setopt( _curl_handle, CURLOPT_ENCODING, "");
+        //TODO: don't do all this proxy setup on every GET. Just do it once per client, or only when
+        // the proxy information changes.
 
-            osg::ref_ptr< ConfigHandler > curlConfigHandler = HTTPClient::getConfigHandler();
-            if (curlConfigHandler.valid()) {
-                curlConfigHandler->onInitialize(_curl_handle);
+        //Try to get the proxy settings from the global settings
+        if (s_proxySettings.isSet())
+        {
+            proxy_host = s_proxySettings.get().hostName();
+            std::stringstream buf;
+            buf << s_proxySettings.get().port();
+            proxy_port = buf.str();
+
+            std::string proxy_username = s_proxySettings.get().userName();
+            std::string proxy_password = s_proxySettings.get().password();
+            if (!proxy_username.empty() && !proxy_password.empty())
+            {
+                proxy_auth = proxy_username + std::string(":") + proxy_password;
             }
         }
 
-        ~CURLImplementation()
+        //Try to get the proxy settings from the local options that are passed in.
+        readProxyOptions( options, proxy_host, proxy_port );
+
+        optional< ProxySettings > proxySettings;
+        ProxySettings::fromOptions( options, proxySettings );
+        if (proxySettings.isSet())
         {
-            if (_curl_handle)
-                curl_easy_cleanup( _curl_handle );
-            _curl_handle = 0;
+            proxy_host = proxySettings.get().hostName();
+            proxy_port = toString<int>(proxySettings.get().port());
+            OE_DEBUG << LC << "Read proxy settings from options " << proxy_host << " " << proxy_port << std::endl;
         }
 
-        HTTPResponse doGet(
-            const HTTPRequest&    request,
-            const osgDB::Options* options,
-            ProgressCallback*     progress ) const
-        {            
-            OE_START_TIMER(http_get);
+        //Try to get the proxy settings from the environment variable
+        const char* proxyEnvAddress = getenv("OSG_CURL_PROXY");
+        if (proxyEnvAddress) //Env Proxy Settings
+        {
+            proxy_host = std::string(proxyEnvAddress);
 
-            std::string url = request.getURL();
+            const char* proxyEnvPort = getenv("OSG_CURL_PROXYPORT"); //Searching Proxy Port on Env
+            if (proxyEnvPort)
+            {
+                proxy_port = std::string( proxyEnvPort );
+            }
+        }
 
-            const osgDB::AuthenticationMap* authenticationMap = (options && options->getAuthenticationMap()) ?
-                options->getAuthenticationMap() :
-                osgDB::Registry::instance()->getAuthenticationMap();
+        const char* proxyEnvAuth = getenv("OSGEARTH_CURL_PROXYAUTH");
+        if (proxyEnvAuth)
+        {
+            proxy_auth = std::string(proxyEnvAuth);
+        }
 
-            std::string proxy_host;
-            std::string proxy_port = "8080";
-            std::string proxy_auth;
+        std::string proxy_addr;
+        if ( !proxy_host.empty() )
+        {
+            std::stringstream buf;
+            buf << proxy_host << ":" << proxy_port;
+            proxy_addr = buf.str();
+        }
+        return proxy_addr;
+    }
 
-            //TODO: don't do all this proxy setup on every GET. Just do it once per client, or only when
-            // the proxy information changes.
+    // Installs (or removes) the proxy server on a curl handle
+    void setCurlProxy(CURL* handle, const std::string& proxy_addr, const std::string& proxy_auth)
+    {
+        if ( !proxy_addr.empty() )
+        {
+            if ( s_HTTP_DEBUG )
+            {
+                OE_NOTICE << LC << "Using proxy: " << proxy_addr << std::endl;
+            }
+
+            //curl_easy_setopt( handle, CURLOPT_HTTPPROXYTUNNEL, 1 );
+            curl_easy_setopt( handle, CURLOPT_PROXY, proxy_addr.c_str() );
 
-            //Try to get the proxy settings from the global settings
-            if (s_proxySettings.isSet())
+            //Setup the proxy authentication if setup
+            if (!proxy_auth.empty())
             {
-                proxy_host = s_proxySettings.get().hostName();
-                std::stringstream buf;
-                buf << s_proxySettings.get().port();
-                proxy_port = buf.str();
-
-                std::string proxy_username = s_proxySettings.get().userName();
-                std::string proxy_password = s_proxySettings.get().password();
-                if (!proxy_username.empty() && !proxy_password.empty())
+                if ( s_HTTP_DEBUG )
                 {
-                    proxy_auth = proxy_username + std::string(":") + proxy_password;
+                    OE_NOTICE << LC << "Using proxy authentication " << proxy_auth << std::endl;
                 }
+
+                curl_easy_setopt( handle, CURLOPT_PROXYUSERPWD, proxy_auth.c_str());
             }
+        }
+        else
+        {
+            OE_DEBUG << LC << "Removing proxy settings" << std::endl;
+            curl_easy_setopt( handle, CURLOPT_PROXY, 0 );
+        }
+    }
+
+    // Applies the URL rewriter, if one is installed
+    std::string rewriteURL(const std::string& url)
+    {
+        osg::ref_ptr< URLRewriter > rewriter = HTTPClient::getURLRewriter();
+        if ( rewriter.valid() )
+        {
+            std::string newURL = rewriter->rewrite( url );
+            OE_DEBUG << LC << "Rewrote URL " << url << " to " << newURL << std::endl;
+            return newURL;
+        }
+        return url;
+    }
+
+    // Authentication details for a URL from the options or the registry
+    const osgDB::AuthenticationDetails* getAuthenticationDetails(const std::string& url, const osgDB::Options* options)
+    {
+        const osgDB::AuthenticationMap* authenticationMap = (options && options->getAuthenticationMap()) ?
+            options->getAuthenticationMap() :
+            osgDB::Registry::instance()->getAuthenticationMap();
 
-            //Try to get the proxy settings from the local options that are passed in.
-            readOptions( options, proxy_host, proxy_port );
+        return authenticationMap ?
+            authenticationMap->getAuthenticationDetails( url ) :
+            0;
+    }
+
+    // Builds the curl header list for a request. Free it with curl_slist_free_all.
+    curl_slist* makeCurlHeaders(const HTTPRequest& request)
+    {
+        struct curl_slist *headers=NULL;
+        for (HTTPRequest::Parameters::const_iterator itr = request.getHeaders().begin(); itr != request.getHeaders().end(); ++itr)
+        {
+            std::stringstream buf;
+            buf << osgEarth::toLower(itr->first) << ": " << itr->second;
+            headers = curl_slist_append(headers, buf.str().c_str());
+        }
+
+        // Disable the default Pragma: no-cache that curl adds by default.
+        headers = curl_slist_append(headers, "pragma: ");
+        return headers;
+    }
+
+    // Sets the options that every curl handle shares
+    void initCurlHandle(CURL* handle)
+    {
+        curl_easy_setopt( handle, CURLOPT_WRITEFUNCTION, StreamObjectReadCallback );
+        curl_easy_setopt( handle, CURLOPT_HEADERFUNCTION, StreamObjectHeaderCallback );
+        curl_easy_setopt( handle, CURLOPT_FOLLOWLOCATION, (void*)1 );
+        curl_easy_setopt( handle, CURLOPT_MAXREDIRS, (void*)5 );
+        curl_easy_setopt( handle, CURLOPT_FILETIME, true );
+
+        // Enable automatic CURL decompression of known types. An empty string will automatically add all supported encoding types that are built into curl.
+        // Note that you must have curl built against zlib to support gzip or deflate encoding.
+        curl_easy_setopt( handle, CURLOPT_ENCODING, "");
+
+        //Disable peer certificate verification to allow us to access in https servers where the peer certificate cannot be verified.
+        curl_easy_setopt( handle, CURLOPT_SSL_VERIFYPEER, (void*)0 );
+
+        osg::ref_ptr< ConfigHandler > curlConfigHandler = HTTPClient::getConfigHandler();
+        if (curlConfigHandler.valid()) {
+            curlConfigHandler->onInitialize(handle);
+        }
+    }
+
+    // Builds the response for a finished transfer on a curl handle.
+    HTTPResponse makeCurlResponse(
+        CURL*                handle,
+        CURLcode             res,
+        const std::string&   url,
+        const HTTPRequest&   request,
+        bool                 usedProxy,
+        HTTPResponse::Part*  part,
+        const StreamObject&  sp,
+        double               duration)
+    {
+        // check for cancel or timeout:
+        if (res == CURLE_ABORTED_BY_CALLBACK || res == CURLE_OPERATION_TIMEDOUT)
+        {
+            // CURLE_ABORTED_BY_CALLBACK means ProgressCallback cancelation.
+            HTTPResponse response;
+            response.setCanceled(true);
+            return response;
+        }
 
-            optional< ProxySettings > proxySettings;
-            ProxySettings::fromOptions( options, proxySettings );
-            if (proxySettings.isSet())
+        if (usedProxy)
+        {
+            long connect_code = 0L;
+            CURLcode r = curl_easy_getinfo(handle, CURLINFO_HTTP_CONNECTCODE, &connect_code);
+            if ( r != CURLE_OK )
             {
-                proxy_host = proxySettings.get().hostName();
-                proxy_port = toString<int>(proxySettings.get().port());
-                OE_DEBUG << LC << "Read proxy settings from options " << proxy_host << " " << proxy_port << std::endl;
+                OE_WARN << LC << "Proxy connect error: " << curl_easy_strerror(r) << std::endl;
+                return HTTPResponse(0);
             }
+        }
+
+        long response_code = 0L;
+        curl_easy_getinfo( handle, CURLINFO_RESPONSE_CODE, &response_code );
+
+        if (s_simResponseCode > 0)
+        {
+            unsigned hash = std::hash<double>()(osg::Timer::instance()->tick()) % 10;
+            if (hash == 0)
+                response_code = s_simResponseCode;
+        }
+
+        HTTPResponse response( response_code );
+
+        // read the response content type:
+        char* content_type_cp;
+
+        curl_easy_getinfo( handle, CURLINFO_CONTENT_TYPE, &content_type_cp );
+
+        if ( content_type_cp != NULL )
+        {
+            response.setMimeType(content_type_cp);
+        }
+
+        // read the file time:
+        response.setLastModified(getCurlFileTime( handle ));
 
-            //Try to get the proxy settings from the environment variable
-            const char* proxyEnvAddress = getenv("OSG_CURL_PROXY");
-            if (proxyEnvAddress) //Env Proxy Settings
+        if (res == CURLE_OK)
+        {
+            // check for multipart content
+            if (response.getMimeType().length() > 9 &&
+                ::strstr( response.getMimeType().c_str(), "multipart" ) == response.getMimeType().c_str() )
             {
-                proxy_host = std::string(proxyEnvAddress);
+                OE_DEBUG << LC << "detected multipart data; decoding..." << std::endl;
 
-                const char* proxyEnvPort = getenv("OSG_CURL_PROXYPORT"); //Searching Proxy Port on Env
-                if (proxyEnvPort)
+                //TODO: parse out the "wcs" -- this is WCS-specific
+                if ( !decodeMultipartStream( "wcs", part, response.getParts() ) )
                 {
-                    proxy_port = std::string( proxyEnvPort );
+                    // error decoding an invalid multipart stream.
+                    // should we do anything, or just leave the response empty?
                 }
             }
-
-            const char* proxyEnvAuth = getenv("OSGEARTH_CURL_PROXYAUTH");
-            if (proxyEnvAuth)
+            else
             {
-                proxy_auth = std::string(proxyEnvAuth);
+                for (Headers::const_iterator itr = sp._headers.begin(); itr != sp._headers.end(); ++itr)
+                {
+                    part->_headers[itr->first] = itr->second;
+                }
+
+                // Write the headers to the metadata
+                response.getParts().push_back( part );
             }
+        }
 
-            // Set up proxy server:
-            std::string proxy_addr;
-            if ( !proxy_host.empty() )
+        else
+        {
+            response.setMessage(curl_easy_strerror(res));
+
+            if (res == CURLE_GOT_NOTHING)
             {
-                std::stringstream buf;
-                buf << proxy_host << ":" << proxy_port;
-                std::string bufStr;
-                bufStr = buf.str();
-                proxy_addr = bufStr;
+                OE_DEBUG << LC << "CURLE_GOT_NOTHING for " << url << std::endl;
+            }
+        }
 
-                if ( s_HTTP_DEBUG )
-                {
-                    OE_NOTICE << LC << "Using proxy: " << proxy_addr << std::endl;
-                }
+        response.setDuration(duration);
 
-                //curl_easy_setopt( _curl_handle, CURLOPT_HTTPPROXYTUNNEL, 1 );
-                curl_easy_setopt( _curl_handle, CURLOPT_PROXY, proxy_addr.c_str() );
+        if ( s_HTTP_DEBUG )
+        {
+            TimeStamp filetime = getCurlFileTime(handle);
 
-                //Setup the proxy authentication if setup
-                if (!proxy_auth.empty())
-                {
-                    if ( s_HTTP_DEBUG )
-                    {
-                        OE_NOTICE << LC << "Using proxy authentication " << proxy_auth << std::endl;
-                    }
+            OE_NOTICE << LC
+                << "GET(" << response_code << ") " << response.getMimeType() << ": \""
+                << url << "\" (" << DateTime(filetime).asRFC1123() << ") t="
+                << std::setprecision(4) << response.getDuration() << "s" << std::endl;
 
-                    curl_easy_setopt( _curl_handle, CURLOPT_PROXYUSERPWD, proxy_auth.c_str());
-                }
+            for(HTTPRequest::Parameters::const_iterator itr = request.getHeaders().begin();
+                itr != request.getHeaders().end();
+                ++itr)
+            {
+                OE_NOTICE << LC << "    Header: " << itr->first << " = " << itr->second << std::endl;
             }
-            else
+
             {
-                OE_DEBUG << LC << "Removing proxy settings" << std::endl;
-                curl_easy_setopt( _curl_handle, CURLOPT_PROXY, 0 );
+                Threading::ScopedMutexLock lock(s_HTTP_DEBUG_mutex);
+                s_HTTP_DEBUG_request_count++;
+                s_HTTP_DEBUG_total_duration += response.getDuration();
+
+                if ( s_HTTP_DEBUG_request_count % 60 == 0 )
+                {
+                    OE_NOTICE << LC << "Average duration = " << s_HTTP_DEBUG_total_duration/(double)s_HTTP_DEBUG_request_count
+                        << std::endl;
+                }
             }
 
-            // Rewrite the url if the url rewriter is available
-            osg::ref_ptr< URLRewriter > rewriter = HTTPClient::getURLRewriter();
-            if ( rewriter.valid() )
+#if 0
+            // time details - almost 100% of the time is spent in
+            // STARTTRANSFER, which is the time until the first byte is received.
+            double td[7];
+
+            curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME,         &td[0]);
+            curl_easy_getinfo(handle, CURLINFO_NAMELOOKUP_TIME,    &td[1]);
+            curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME,       &td[2]);
+            curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME,    &td[3]);
+            curl_easy_getinfo(handle, CURLINFO_PRETRANSFER_TIME,   &td[4]);
+            curl_easy_getinfo(handle, CURLINFO_STARTTRANSFER_TIME, &td[5]);
+            curl_easy_getinfo(handle, CURLINFO_REDIRECT_TIME,      &td[6]);
+
+            for(int i=0; i<7; ++i)
             {
-                std::string oldURL = url;
-                url = rewriter->rewrite( oldURL );
-                OE_DEBUG << LC << "Rewrote URL " << oldURL << " to " << url << std::endl;
+                OE_NOTICE << LC
+                    << std::setprecision(4)
+                    << "TIMES: total=" <<td[0]
+                    << ", lookup=" <<td[1]<<" ("<<(int)((td[1]/td[0])*100)<<"%)"
+                    << ", connect=" <<td[2]<<" ("<<(int)((td[2]/td[0])*100)<<"%)"
+                    << ", appconn=" <<td[3]<<" ("<<(int)((td[3]/td[0])*100)<<"%)"
+                    << ", prexfer=" <<td[4]<<" ("<<(int)((td[4]/td[0])*100)<<"%)"
+                    << ", startxfer=" <<td[5]<<" ("<<(int)((td[5]/td[0])*100)<<"%)"
+                    << ", redir=" <<td[6]<<" ("<<(int)((td[6]/td[0])*100)<<"%)"
+                    << std::endl;
             }
+#endif
+        }
+
+        return response;
+    }
+
+    class CURLImplementation : public HTTPClient::Implementation
+    {
+    public:
+        CURLImplementation() : _curl_handle(0), _previousHttpAuthentication(0) { }
+
+        void initialize()
+        {
+            _previousHttpAuthentication = 0L;
+
+            _curl_handle = curl_easy_init();
+
+            initCurlHandle(_curl_handle);
+
+            curl_easy_setopt( _curl_handle, CURLOPT_PROGRESSFUNCTION, &CurlProgressCallback);
+            curl_easy_setopt( _curl_handle, CURLOPT_NOPROGRESS, (void*)0 ); //0=enable.
+        }
+
+        ~CURLImplementation()
+        {
+            if (_curl_handle)
+                curl_easy_cleanup( _curl_handle );
+            _curl_handle = 0;
+        }
+
+        HTTPResponse doGet(
+            const HTTPRequest&    request,
+            const osgDB::Options* options,
+            ProgressCallback*     progress ) const
+        {
+            OE_START_TIMER(http_get);
+
+            // Set up proxy server:
+            std::string proxy_auth;
+            std::string proxy_addr = getProxyAddress(options, proxy_auth);
+            setCurlProxy(_curl_handle, proxy_addr, proxy_auth);
+
+            // Rewrite the url if the url rewriter is available
+            std::string url = rewriteURL(request.getURL());
 
-            const osgDB::AuthenticationDetails* details = authenticationMap ?
-                authenticationMap->getAuthenticationDetails( url ) :
-                0;
+            const osgDB::AuthenticationDetails* details = getAuthenticationDetails(url, options);
 
             if (details)
             {
@@ -609,19 +849,7 @@ namespace
 
 
             // Set any headers
-            struct curl_slist *headers=NULL;
-            if (!request.getHeaders().empty())
-            {
-                for (HTTPRequest::Parameters::const_iterator itr = request.getHeaders().begin(); itr != request.getHeaders().end(); ++itr)
-                {
-                    std::stringstream buf;
-                    buf << osgEarth::toLower(itr->first) << ": " << itr->second;
-                    headers = curl_slist_append(headers, buf.str().c_str());
-                }
-            }
-
-            // Disable the default Pragma: no-cache that curl adds by default.
-            headers = curl_slist_append(headers, "pragma: ");
+            struct curl_slist *headers = makeCurlHeaders(request);
             curl_easy_setopt(_curl_handle, CURLOPT_HTTPHEADER, headers);
 
             osg::ref_ptr<HTTPResponse::Part> part = new HTTPResponse::Part();
@@ -636,7 +864,6 @@ namespace
             }
 
             CURLcode res;
-            long response_code = 0L;
 
             OE_START_TIMER(get_duration);
 
@@ -648,9 +875,6 @@ namespace
             curl_easy_setopt( _curl_handle, CURLOPT_WRITEDATA, (void*)&sp);
             curl_easy_setopt( _curl_handle, CURLOPT_HEADERDATA, (void*)&sp);
 
-            //Disable peer certificate verification to allow us to access in https servers where the peer certificate cannot be verified.
-            curl_easy_setopt( _curl_handle, CURLOPT_SSL_VERIFYPEER, (void*)0 );
-
             osg::ref_ptr< ConfigHandler > configHandler = HTTPClient::getConfigHandler();
             if (configHandler.valid()) {
                 configHandler->onGet(_curl_handle);
@@ -660,218 +884,515 @@ namespace
 
             curl_easy_setopt( _curl_handle, CURLOPT_WRITEDATA, (void*)0 );
             curl_easy_setopt( _curl_handle, CURLOPT_PROGRESSDATA, (void*)0);
+            curl_easy_setopt( _curl_handle, CURLOPT_ERRORBUFFER, (void*)0 );
 
-            // check for cancel or timeout:
-            if (res == CURLE_ABORTED_BY_CALLBACK || res == CURLE_OPERATION_TIMEDOUT)
+            HTTPResponse response = makeCurlResponse(
+                _curl_handle, res, url, request, !proxy_addr.empty(),
+                part.get(), sp, OE_STOP_TIMER(get_duration));
+
+            // Free the headers
+            curl_easy_setopt( _curl_handle, CURLOPT_HTTPHEADER, (void*)0 );
+            if (headers)
             {
-                // CURLE_ABORTED_BY_CALLBACK means ProgressCallback cancelation.
-                HTTPResponse response;
-                response.setCanceled(true);
-                return response;
+                curl_slist_free_all(headers);
             }
 
-            if (!proxy_addr.empty())
-            {
-                long connect_code = 0L;
-                CURLcode r = curl_easy_getinfo(_curl_handle, CURLINFO_HTTP_CONNECTCODE, &connect_code);
-                if ( r != CURLE_OK )
-                {
-                    OE_WARN << LC << "Proxy connect error: " << curl_easy_strerror(r) << std::endl;
+            return response;
+        }
 
-                    // Free the headers
-                    if (headers)
-                    {
-                        curl_slist_free_all(headers);
-                    }
+        void* getHandle() const
+        {
+            return _curl_handle;
+        }
 
-                    return HTTPResponse(0);
-                }
-            }
+        void setUserAgent(const std::string& value)
+        {
+            curl_easy_setopt( _curl_handle, CURLOPT_USERAGENT, value.c_str() );
+        }
 
-            curl_easy_getinfo( _curl_handle, CURLINFO_RESPONSE_CODE, &response_code );
+        void setTimeout(long value)
+        {
+            curl_easy_setopt( _curl_handle, CURLOPT_TIMEOUT, value );
+        }
 
-            if (s_simResponseCode > 0)
-            {
-                unsigned hash = std::hash<double>()(osg::Timer::instance()->tick()) % 10;
-                if (hash == 0)
-                    response_code = s_simResponseCode;
-            }
+        void setConnectTimeout(long value)
+        {
+            curl_easy_setopt( _curl_handle, CURLOPT_CONNECTTIMEOUT, value );
+        }
+
+    private:
+        void* _curl_handle;
+        mutable std::string _previousPassword;
+        mutable long _previousHttpAuthentication;
+    };
+}
+
+HTTPClient::Implementation*
+CURLHTTPImplementationFactory::create() const
+{
+    return new CURLImplementation();
+}
 
-            HTTPResponse response( response_code );
+//.........................................................................
+
+namespace
+{
+    // Copy of a response whose parts can be read independently of the
+    // original (a part's stream carries its own read position).
+    HTTPResponse cloneResponse(HTTPResponse& input)
+    {
+        HTTPResponse output(input);
+        output.getParts().clear();
+        for (auto& part : input.getParts())
+        {
+            osg::ref_ptr<HTTPResponse::Part> copy = new HTTPResponse::Part();
+            copy->_headers = part->_headers;
+            copy->_size = part->_size;
+            copy->_stream.str(part->_stream.str());
+            output.getParts().push_back(copy);
+        }
+        return output;
+    }
 
+    // "scheme://host:port" part of a URL, used to group transfers by server
+    std::string getHostKey(const std::string& url)
+    {
+        std::string::size_type start = url.find("://");
+        start = start == std::string::npos ? 0 : start + 3;
+        return toLower(url.substr(0, url.find_first_of("/?#", start)));
+    }
+
+    // One network transfer on the AsyncEngine, shared by every request
+    // for the same URL (and headers and credentials) while it is in flight.
+    struct AsyncTransfer
+    {
+        struct Waiter
+        {
+            Promise<HTTPResponse> promise;
+            osg::ref_ptr<ProgressCallback> progress;
+        };
+
+        AsyncTransfer(const HTTPRequest& r) :
+            request(r),
+            httpAuthentication(0L),
+            canceled(false),
+            handle(NULL),
+            headers(NULL),
+            startTime(0)
+        {
+            errorBuf[0] = 0;
+        }
+
+        HTTPRequest request;
+        std::string key;
+        std::string url;
+        std::string host;
+        std::string proxyAddr;
+        std::string proxyAuth;
+        std::string password;
+        std::string userAgent;
+        long httpAuthentication;
+        std::vector<Waiter> waiters;
+        bool canceled;
+
+        // valid while the transfer is running
+        CURL* handle;
+        curl_slist* headers;
+        osg::ref_ptr<HTTPResponse::Part> part;
+        std::unique_ptr<StreamObject> sp;
+        char errorBuf[CURL_ERROR_SIZE];
+        osg::Timer_t startTime;
+    };
+
+    /**
+     * Asynchronous transfer engine behind HTTPClient::getAsync.
+     *
+     * A single worker thread drives every transfer through one curl multi
+     * handle, so connections (and DNS and TLS sessions) stay cached and are
+     * reused between requests. Transfers wait in a queue until their host
+     * has a free slot, and a request for a URL that is already queued or
+     * running joins that transfer instead of starting another one.
+     */
+    class AsyncEngine
+    {
+    public:
+        using TransferPtr = std::shared_ptr<AsyncTransfer>;
+
+        //! Shared engine. Intentionally leaked, since the worker thread
+        //! may still be running when static destructors run.
+        static AsyncEngine& instance()
+        {
+            static AsyncEngine* s_engine = new AsyncEngine();
+            return *s_engine;
+        }
 
+        //! Queues a request (or joins an identical one in flight)
+        Future<HTTPResponse> get(
+            const HTTPRequest&    request,
+            const osgDB::Options* options,
+            ProgressCallback*     progress)
+        {
+            ++_requests;
 
-            // read the response content type:
-            char* content_type_cp;
+            TransferPtr t = std::make_shared<AsyncTransfer>(request);
 
-            curl_easy_getinfo( _curl_handle, CURLINFO_CONTENT_TYPE, &content_type_cp );
+            t->url = rewriteURL(request.getURL());
+            t->host = getHostKey(t->url);
+            t->proxyAddr = getProxyAddress(options, t->proxyAuth);
 
-            if ( content_type_cp != NULL )
+            const osgDB::AuthenticationDetails* details = getAuthenticationDetails(t->url, options);
+            if (details)
             {
-                response.setMimeType(content_type_cp);
+                t->password = details->username + ":" + details->password;
+                t->httpAuthentication = details->httpAuthentication;
             }
 
-            // read the file time:
-            response.setLastModified(getCurlFileTime( _curl_handle ));
+            // requests only share a transfer if the server would see
+            // exactly the same thing:
+            std::vector<std::string> headers;
+            for (auto& h : request.getHeaders())
+                headers.push_back(toLower(h.first) + ": " + h.second);
+            std::sort(headers.begin(), headers.end());
+
+            std::stringstream buf;
+            buf << t->url << '\n' << t->proxyAddr << '\n' << t->proxyAuth << '\n' << t->password << '\n';
+            for (auto& h : headers)
+                buf << h << '\n';
+            t->key = buf.str();
+
+            AsyncTransfer::Waiter waiter;
+            waiter.progress = progress;
+            Future<HTTPResponse> result = waiter.promise.getFuture();
 
-            if (res == CURLE_OK)
             {
-                // check for multipart content
-                if (response.getMimeType().length() > 9 &&
-                    ::strstr( response.getMimeType().c_str(), "multipart" ) == response.getMimeType().c_str() )
-                {
-                    OE_DEBUG << LC << "detected multipart data; decoding..." << std::endl;
+                ScopedMutexLock lock(_mutex);
 
-                    //TODO: parse out the "wcs" -- this is WCS-specific
-                    if ( !decodeMultipartStream( "wcs", part.get(), response.getParts() ) )
-                    {
-                        // error decoding an invalid multipart stream.
-                        // should we do anything, or just leave the response empty?
-                    }
+                auto i = _inflight.find(t->key);
+                if (i != _inflight.end())
+                {
+                    i->second->waiters.push_back(waiter);
+                    ++_coalesced;
                 }
                 else
                 {
-                    for (Headers::iterator itr = sp._headers.begin(); itr != sp._headers.end(); ++itr)
-                    {
-                        part->_headers[itr->first] = itr->second;
-                    }
-
-                    // Write the headers to the metadata
-                    response.getParts().push_back( part.get() );
+                    t->waiters.push_back(waiter);
+                    _inflight[t->key] = t;
+                    _queue.push_back(t);
                 }
             }
 
-            else
+            wake();
+
+            return result;
+        }
+
+        HTTPClient::AsyncStats getStats() const
+        {
+            HTTPClient::AsyncStats stats;
+            stats.requests = _requests;
+            stats.transfers = _transfers;
+            stats.coalesced = _coalesced;
+            stats.active = _activeCount;
+            return stats;
+        }
+
+    private:
+        AsyncEngine() :
+            _mutex("HTTPClient AsyncEngine(OE)"),
+            _requests(0u),
+            _transfers(0u),
+            _coalesced(0u),
+            _activeCount(0u)
+        {
+            _multi = curl_multi_init();
+
+            // size of the idle connection cache shared by all transfers
+            curl_multi_setopt(_multi, CURLMOPT_MAXCONNECTS, 64L);
+
+            _thread = std::thread([this]() { run(); });
+        }
+
+        void wake()
+        {
+            _wake.set();
+#if LIBCURL_VERSION_NUM >= 0x074400
+            curl_multi_wakeup(_multi);
+#endif
+        }
+
+        void run()
+        {
+            OE_THREAD_NAME("oe.HTTPClient");
+
+            osg::Timer_t lastPrune = osg::Timer::instance()->tick();
+
+            while (true)
             {
-                response.setMessage(curl_easy_strerror(res));
+                std::vector<TransferPtr> toStart;
+                std::vector<TransferPtr> toStop;
+                std::vector<AsyncTransfer::Waiter> canceled;
+
+                osg::Timer_t now = osg::Timer::instance()->tick();
+                bool prune = osg::Timer::instance()->delta_m(lastPrune, now) >= 20.0;
+                if (prune)
+                    lastPrune = now;
 
-                if (res == CURLE_GOT_NOTHING)
                 {
-                    OE_DEBUG << LC << "CURLE_GOT_NOTHING for " << url << std::endl;
-                }
-            }
+                    ScopedMutexLock lock(_mutex);
 
-            response.setDuration(OE_STOP_TIMER(get_duration));
+                    if (prune)
+                        pruneCanceled(toStop, canceled);
 
-            if ( s_HTTP_DEBUG )
-            {
-                TimeStamp filetime = getCurlFileTime(_curl_handle);
+                    // start queued transfers whose host has a free slot:
+                    unsigned maxPerHost = HTTPClient::getMaxConnectionsPerHost();
+                    for (auto i = _queue.begin(); i != _queue.end(); )
+                    {
+                        TransferPtr t = *i;
+                        if (t->canceled)
+                        {
+                            i = _queue.erase(i);
+                        }
+                        else if (_activePerHost[t->host] < maxPerHost)
+                        {
+                            ++_activePerHost[t->host];
+                            toStart.push_back(t);
+                            i = _queue.erase(i);
+                        }
+                        else ++i;
+                    }
+                }
 
-                OE_NOTICE << LC
-                    << "GET(" << response_code << ") " << response.getMimeType() << ": \""
-                    << url << "\" (" << DateTime(filetime).asRFC1123() << ") t="
-                    << std::setprecision(4) << response.getDuration() << "s" << std::endl;
+                for (auto& waiter : canceled)
+                {
+                    HTTPResponse response;
+                    response.setCanceled(true);
+                    waiter.promise.resolve(response);
+                }
 
-                for(HTTPRequest::Parameters::const_iterator itr = request.getHeaders().begin();
-                    itr != request.getHeaders().end(); 
-                    ++itr)
+                for (auto& t : toStop)
                 {
-                    OE_NOTICE << LC << "    Header: " << itr->first << " = " << itr->second << std::endl;
+                    _active.erase(t->handle);
+                    release(t.get());
                 }
 
+                for (auto& t : toStart)
                 {
-                    Threading::ScopedMutexLock lock(s_HTTP_DEBUG_mutex);
-                    s_HTTP_DEBUG_request_count++;
-                    s_HTTP_DEBUG_total_duration += response.getDuration();
+                    start(t);
+                }
+
+                int running = 0;
+                curl_multi_perform(_multi, &running);
 
-                    if ( s_HTTP_DEBUG_request_count % 60 == 0 )
+                int remaining = 0;
+                CURLMsg* msg;
+                while ((msg = curl_multi_info_read(_multi, &remaining)) != NULL)
+                {
+                    if (msg->msg == CURLMSG_DONE)
                     {
-                        OE_NOTICE << LC << "Average duration = " << s_HTTP_DEBUG_total_duration/(double)s_HTTP_DEBUG_request_count
-                            << std::endl;
+                        CURL* handle = msg->easy_handle;
+                        CURLcode res = msg->data.result;
+                        finish(handle, res);
                     }
                 }
 
-#if 0
-                // time details - almost 100% of the time is spent in
-                // STARTTRANSFER, which is the time until the first byte is received.
-                double td[7];
-
-                curl_easy_getinfo(_curl_handle, CURLINFO_TOTAL_TIME,         &td[0]);
-                curl_easy_getinfo(_curl_handle, CURLINFO_NAMELOOKUP_TIME,    &td[1]);
-                curl_easy_getinfo(_curl_handle, CURLINFO_CONNECT_TIME,       &td[2]);
-                curl_easy_getinfo(_curl_handle, CURLINFO_APPCONNECT_TIME,    &td[3]);
-                curl_easy_getinfo(_curl_handle, CURLINFO_PRETRANSFER_TIME,   &td[4]);
-                curl_easy_getinfo(_curl_handle, CURLINFO_STARTTRANSFER_TIME, &td[5]);
-                curl_easy_getinfo(_curl_handle, CURLINFO_REDIRECT_TIME,      &td[6]);
-
-                for(int i=0; i<7; ++i)
+                _activeCount = _active.size();
+
+                if (_active.empty())
                 {
-                    OE_NOTICE << LC
-                        << std::setprecision(4)
-                        << "TIMES: total=" <<td[0]
-                        << ", lookup=" <<td[1]<<" ("<<(int)((td[1]/td[0])*100)<<"%)"
-                        << ", connect=" <<td[2]<<" ("<<(int)((td[2]/td[0])*100)<<"%)"
-                        << ", appconn=" <<td[3]<<" ("<<(int)((td[3]/td[0])*100)<<"%)"
-                        << ", prexfer=" <<td[4]<<" ("<<(int)((td[4]/td[0])*100)<<"%)"
-                        << ", startxfer=" <<td[5]<<" ("<<(int)((td[5]/td[0])*100)<<"%)"
-                        << ", redir=" <<td[6]<<" ("<<(int)((td[6]/td[0])*100)<<"%)"
-                        << std::endl;
+                    // nothing on the wire; sleep until a request arrives.
+                    _wake.wait(100u);
+                    _wake.reset();
                 }
+                else
+                {
+#if LIBCURL_VERSION_NUM >= 0x074400
+                    curl_multi_poll(_multi, NULL, 0, 100, NULL);
+#else
+                    curl_multi_wait(_multi, NULL, 0, 10, NULL);
 #endif
+                }
             }
+        }
 
-            // Free the headers
-            if (headers)
+        // Drops waiters whose future was abandoned or whose progress callback
+        // canceled, and stops transfers nobody is waiting for anymore.
+        // Call with _mutex held.
+        void pruneCanceled(std::vector<TransferPtr>& toStop, std::vector<AsyncTransfer::Waiter>& canceled)
+        {
+            for (auto i = _inflight.begin(); i != _inflight.end(); )
             {
-                curl_slist_free_all(headers);
-            }            
+                TransferPtr t = i->second;
+                auto& waiters = t->waiters;
 
-            return response;
-        }
-        
-        void* getHandle() const
-        {
-            return _curl_handle;
-        }
+                for (auto w = waiters.begin(); w != waiters.end(); )
+                {
+                    if (w->promise.isAbandoned())
+                    {
+                        w = waiters.erase(w);
+                    }
+                    else if (w->progress.valid() && w->progress->isCanceled())
+                    {
+                        canceled.push_back(*w);
+                        w = waiters.erase(w);
+                    }
+                    else ++w;
+                }
 
-        void setUserAgent(const std::string& value)
-        {
-            curl_easy_setopt( _curl_handle, CURLOPT_USERAGENT, value.c_str() );
+                if (waiters.empty())
+                {
+                    t->canceled = true;
+                    if (t->handle)
+                        toStop.push_back(t);
+                    i = _inflight.erase(i);
+                }
+                else ++i;
+            }
         }
 
-        void setTimeout(long value)
+        void start(TransferPtr t)
         {
-            curl_easy_setopt( _curl_handle, CURLOPT_TIMEOUT, value );
-        }
+            t->handle = curl_easy_init();
+            CURL* handle = t->handle;
+
+            initCurlHandle(handle);
+
+            // Settings can change at any time, so read them for each transfer
+            // (the environment wins, as in the blocking path).
+            t->userAgent = s_userAgent;
+            const char* userAgentEnv = getenv("OSGEARTH_USERAGENT");
+            if (userAgentEnv)
+                t->userAgent = std::string(userAgentEnv);
+
+            long timeout = s_timeout;
+            const char* timeoutEnv = getenv("OSGEARTH_HTTP_TIMEOUT");
+            if (timeoutEnv)
+                timeout = osgEarth::as<long>(std::string(timeoutEnv), 0);
+
+            long connectTimeout = s_connectTimeout;
+            const char* connectTimeoutEnv = getenv("OSGEARTH_HTTP_CONNECTTIMEOUT");
+            if (connectTimeoutEnv)
+                connectTimeout = osgEarth::as<long>(std::string(connectTimeoutEnv), 0);
+
+            // No progress callback: a canceled request only stops its transfer
+            // the next time run() prunes, which happens between polls (up to
+            // 100ms apart), and only once every request sharing it is gone.
+            curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 1L);
+            curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+            curl_easy_setopt(handle, CURLOPT_USERAGENT, t->userAgent.c_str());
+            curl_easy_setopt(handle, CURLOPT_TIMEOUT, timeout);
+            curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, connectTimeout);
+
+            setCurlProxy(handle, t->proxyAddr, t->proxyAuth);
+
+            if (!t->password.empty())
+            {
+                curl_easy_setopt(handle, CURLOPT_USERPWD, t->password.c_str());
+#if LIBCURL_VERSION_NUM >= 0x070a07
+                if (t->httpAuthentication != 0)
+                    curl_easy_setopt(handle, CURLOPT_HTTPAUTH, t->httpAuthentication);
+#endif
+            }
 
-        void setConnectTimeout(long value)
-        {
-            curl_easy_setopt( _curl_handle, CURLOPT_CONNECTTIMEOUT, value );
+            t->headers = makeCurlHeaders(t->request);
+            curl_easy_setopt(handle, CURLOPT_HTTPHEADER, t->headers);
+
+            t->part = new HTTPResponse::Part();
+            t->sp.reset(new StreamObject(&t->part->_stream));
+
+            curl_easy_setopt(handle, CURLOPT_URL, t->url.c_str());
+            curl_easy_setopt(handle, CURLOPT_ERRORBUFFER, (void*)t->errorBuf);
+            curl_easy_setopt(handle, CURLOPT_WRITEDATA, (void*)t->sp.get());
+            curl_easy_setopt(handle, CURLOPT_HEADERDATA, (void*)t->sp.get());
+
+            osg::ref_ptr< ConfigHandler > configHandler = HTTPClient::getConfigHandler();
+            if (configHandler.valid()) {
+                configHandler->onGet(handle);
+            }
+
+            t->startTime = osg::Timer::instance()->tick();
+
+            _active[handle] = t;
+            curl_multi_add_handle(_multi, handle);
+            ++_transfers;
         }
 
-        void readOptions(const osgDB::Options* options, std::string& proxy_host, std::string& proxy_port) const
+        void finish(CURL* handle, CURLcode res)
         {
-            // try to set proxy host/port by reading the CURL proxy options
-            if ( options )
+            auto i = _active.find(handle);
+            if (i == _active.end())
+                return;
+
+            TransferPtr t = i->second;
+            _active.erase(i);
+
+            double duration = osg::Timer::instance()->delta_s(t->startTime, osg::Timer::instance()->tick());
+
+            if (res != CURLE_OK && t->errorBuf[0] != 0)
             {
-                std::istringstream iss( options->getOptionString() );
-                std::string opt;
-                while( iss >> opt )
-                {
-                    int index = opt.find('=');
-                    if( opt.substr( 0, index ) == "OSG_CURL_PROXY" )
-                    {
-                        proxy_host = opt.substr( index+1 );
-                    }
-                    else if ( opt.substr( 0, index ) == "OSG_CURL_PROXYPORT" )
-                    {
-                        proxy_port = opt.substr( index+1 );
-                    }
-                }
+                OE_DEBUG << LC << t->url << ": " << t->errorBuf << std::endl;
+            }
+
+            HTTPResponse response = makeCurlResponse(
+                handle, res, t->url, t->request, !t->proxyAddr.empty(),
+                t->part.get(), *t->sp, duration);
+
+            release(t.get());
+
+            std::vector<AsyncTransfer::Waiter> waiters;
+            {
+                ScopedMutexLock lock(_mutex);
+                auto j = _inflight.find(t->key);
+                if (j != _inflight.end() && j->second == t)
+                    _inflight.erase(j);
+                waiters.swap(t->waiters);
+            }
+
+            // every waiter gets its own copy of the response data:
+            for (unsigned w = 0; w < waiters.size(); ++w)
+            {
+                if (w + 1 < waiters.size())
+                    waiters[w].promise.resolve(cloneResponse(response));
+                else
+                    waiters[w].promise.resolve(response);
             }
         }
 
-    private:
-        void* _curl_handle;
-        mutable std::string _previousPassword;
-        mutable long _previousHttpAuthentication;
-    };
-}
+        void release(AsyncTransfer* t)
+        {
+            curl_multi_remove_handle(_multi, t->handle);
+            curl_easy_cleanup(t->handle);
+            t->handle = NULL;
 
-HTTPClient::Implementation*
-CURLHTTPImplementationFactory::create() const
-{
-    return new CURLImplementation();
+            if (t->headers)
+                curl_slist_free_all(t->headers);
+            t->headers = NULL;
+
+            t->sp.reset();
+            t->part = NULL;
+
+            auto h = _activePerHost.find(t->host);
+            if (h != _activePerHost.end() && --h->second == 0)
+                _activePerHost.erase(h);
+        }
+
+        // protects _inflight and _queue
+        Mutex _mutex;
+        std::unordered_map<std::string, TransferPtr> _inflight;
+        std::list<TransferPtr> _queue;
+
+        // worker thread only
+        CURLM* _multi;
+        std::unordered_map<CURL*, TransferPtr> _active;
+        std::unordered_map<std::string, unsigned> _activePerHost;
+
+        Event _wake;
+        std::thread _thread;
+
+        std::atomic<unsigned> _requests;
+        std::atomic<unsigned> _transfers;
+        std::atomic<unsigned> _coalesced;
+        std::atomic<unsigned> _activeCount;
+    };
 }
 
 #ifdef OSGEARTH_USE_WININET_FOR_HTTP
@@ -1284,6 +1805,17 @@ HTTPClient::initializeImpl()
     }
     OE_DEBUG << LC << "Setting retry delay to " << s_retryDelay_s << std::endl;
 
+    if (::getenv("OSGEARTH_HTTP_ASYNC"))
+    {
+        s_useAsyncEngine = true;
+    }
+
+    const char* maxConnectionsEnv = getenv("OSGEARTH_HTTP_MAX_CONNECTIONS_PER_HOST");
+    if (maxConnectionsEnv)
+    {
+        setMaxConnectionsPerHost(osgEarth::as<unsigned>(std::string(maxConnectionsEnv), 6u));
+    }
+
     _impl->initialize();
 
     _impl->setUserAgent(userAgent.c_str());
@@ -1349,6 +1881,36 @@ float HTTPClient::getRetryDelay()
     return s_retryDelay_s;
 }
 
+void HTTPClient::setMaxConnectionsPerHost(unsigned value)
+{
+    s_maxConnectionsPerHost = value > 0u ? value : 1u;
+}
+
+unsigned HTTPClient::getMaxConnectionsPerHost()
+{
+    return s_maxConnectionsPerHost;
+}
+
+void HTTPClient::setUseAsyncEngine(bool value)
+{
+    s_useAsyncEngine = value;
+}
+
+bool HTTPClient::getUseAsyncEngine()
+{
+    return s_useAsyncEngine;
+}
+
+HTTPClient::AsyncStats HTTPClient::getAsyncStats()
+{
+    if (dynamic_cast<CURLHTTPImplementationFactory*>(_implFactory) == NULL)
+    {
+        AsyncStats stats = { 0u, 0u, 0u, 0u };
+        return stats;
+    }
+    return AsyncEngine::instance().getStats();
+}
+
 URLRewriter* HTTPClient::getURLRewriter()
 {
     return s_rewriter.get();
@@ -1416,6 +1978,26 @@ HTTPClient::get( const std::string&    url,
     return getClient().doGet( url, options, progress);
 }
 
+Future<HTTPResponse>
+HTTPClient::getAsync(const HTTPRequest&    request,
+                     const osgDB::Options* options,
+                     ProgressCallback*     progress)
+{
+    HTTPClient& client = getClient();
+    client.initialize();
+
+    // The engine drives curl directly; any other implementation
+    // runs the request in place.
+    if (dynamic_cast<CURLHTTPImplementationFactory*>(_implFactory) == NULL)
+    {
+        Promise<HTTPResponse> promise;
+        promise.resolve(client._impl->doGet(request, options, progress));
+        return promise.getFuture();
+    }
+
+    return AsyncEngine::instance().get(request, options, progress);
+}
+
 ReadResult
 HTTPClient::readImage(const HTTPRequest&    request,
                       const osgDB::Options* options,
@@ -1465,7 +2047,21 @@ HTTPClient::doGet(const HTTPRequest&    request,
 
     initialize();
 
-    HTTPResponse response = _impl->doGet(request, options, progress);
+    HTTPResponse response;
+
+    if (s_useAsyncEngine && dynamic_cast<CURLHTTPImplementationFactory*>(_implFactory) != NULL)
+    {
+        Future<HTTPResponse> result = AsyncEngine::instance().get(request, options, progress);
+        response = result.join(progress);
+        if (!result.isAvailable())
+        {
+            response.setCanceled(true);
+        }
+    }
+    else
+    {
+        response = _impl->doGet(request, options, progress);
+    }
 
     OE_PROFILING_ZONE_TEXT(Stringify() << "response_code " << response.getCode());
     if (response.isCanceled())
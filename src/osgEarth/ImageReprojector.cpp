@@ -0,0 +1,476 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/ImageReprojector>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Metrics>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+#define LC "[ImageReprojector] "
+
+namespace
+{
+    // Grid nodes start this many pixels apart and get closer until the
+    // mesh is accurate enough.
+    const unsigned INITIAL_STEP = 32u;
+
+    // Interpolates the mesh to get the source coordinates of every pixel
+    // in output row "row", then converts them to source pixel units.
+    // The per-column cell lookup is the same for every row, so it's
+    // computed once up front (cell, cell1, weight).
+    void interpolateRow(
+        const ImageReprojector::WarpMesh& mesh,
+        unsigned row,
+        const std::vector<unsigned>& cell,
+        const std::vector<unsigned>& cell1,
+        const std::vector<double>& weight,
+        double srcMinX, double srcMinY, double srcDX, double srcDY,
+        std::vector<double>& nodeX, std::vector<double>& nodeY,
+        double* fx, double* fy)
+    {
+        unsigned j = row / mesh.step;
+        unsigned j1 = osg::minimum(j + 1u, mesh.numY - 1u);
+        j = osg::minimum(j, mesh.numY - 1u);
+        double t = 0.0;
+        if (j1 != j)
+        {
+            unsigned r0 = mesh.node(j, mesh.height), r1 = mesh.node(j1, mesh.height);
+            t = (double)(row - r0) / (double)(r1 - r0);
+        }
+
+        // interpolate the two node rows bracketing this pixel row:
+        const double* x0 = &mesh.x[j*mesh.numX];
+        const double* x1 = &mesh.x[j1*mesh.numX];
+        const double* y0 = &mesh.y[j*mesh.numX];
+        const double* y1 = &mesh.y[j1*mesh.numX];
+        for (unsigned i = 0; i < mesh.numX; ++i)
+        {
+            nodeX[i] = x0[i] + t * (x1[i] - x0[i]);
+            nodeY[i] = y0[i] + t * (y1[i] - y0[i]);
+        }
+
+        // then along the row:
+        for (unsigned c = 0; c < mesh.width; ++c)
+        {
+            double sx = nodeX[cell[c]] + weight[c] * (nodeX[cell1[c]] - nodeX[cell[c]]);
+            double sy = nodeY[cell[c]] + weight[c] * (nodeY[cell1[c]] - nodeY[cell[c]]);
+            fx[c] = (sx - srcMinX) / srcDX;
+            fy[c] = (sy - srcMinY) / srcDY;
+        }
+    }
+
+    // Row kernels for 8-bit images with N channels. (fx,fy) is the source
+    // location in pixel units, with (0,0) at the corner of the first pixel.
+    // Locations outside the source image are skipped.
+    template<int N>
+    void sampleRowBilinear(
+        const unsigned char* src, unsigned rowBytes, int s, int t,
+        const double* fx, const double* fy, unsigned count,
+        unsigned char* out)
+    {
+        for (unsigned c = 0; c < count; ++c, out += N)
+        {
+            double x = fx[c], y = fy[c];
+            if (!(x >= 0.0 && x <= (double)s && y >= 0.0 && y <= (double)t))
+                continue;
+
+            // sample relative to pixel centers, clamping to the edge
+            x = osg::clampBetween(x - 0.5, 0.0, (double)(s - 1));
+            y = osg::clampBetween(y - 0.5, 0.0, (double)(t - 1));
+            int x0 = (int)x, y0 = (int)y;
+            int x1 = osg::minimum(x0 + 1, s - 1);
+            int y1 = osg::minimum(y0 + 1, t - 1);
+            float wx = (float)(x - (double)x0);
+            float wy = (float)(y - (double)y0);
+
+            const unsigned char* a = src + y0*rowBytes;
+            const unsigned char* b = src + y1*rowBytes;
+            for (int k = 0; k < N; ++k)
+            {
+                float p = (float)a[x0*N + k], q = (float)a[x1*N + k];
+                float u = (float)b[x0*N + k], v = (float)b[x1*N + k];
+                float lower = p + wx * (q - p);
+                float upper = u + wx * (v - u);
+                out[k] = (unsigned char)(lower + wy * (upper - lower) + 0.5f);
+            }
+        }
+    }
+
+    template<int N>
+    void sampleRowNearest(
+        const unsigned char* src, unsigned rowBytes, int s, int t,
+        const double* fx, const double* fy, unsigned count,
+        unsigned char* out)
+    {
+        for (unsigned c = 0; c < count; ++c, out += N)
+        {
+            double x = fx[c], y = fy[c];
+            if (!(x >= 0.0 && x <= (double)s && y >= 0.0 && y <= (double)t))
+                continue;
+
+            int x0 = osg::minimum((int)x, s - 1);
+            int y0 = osg::minimum((int)y, t - 1);
+            const unsigned char* a = src + y0*rowBytes + x0*N;
+            for (int k = 0; k < N; ++k)
+                out[k] = a[k];
+        }
+    }
+
+    typedef void (*RowKernel)(
+        const unsigned char*, unsigned, int, int,
+        const double*, const double*, unsigned,
+        unsigned char*);
+
+    RowKernel getKernel(const osg::Image* image, bool bilinear)
+    {
+        if (image->getDataType() != GL_UNSIGNED_BYTE)
+            return nullptr;
+
+        unsigned n = osg::Image::computeNumComponents(image->getPixelFormat());
+        if (image->getPixelSizeInBits() != 8u * n)
+            return nullptr;
+
+        switch (n)
+        {
+        case 1: return bilinear ? sampleRowBilinear<1> : sampleRowNearest<1>;
+        case 2: return bilinear ? sampleRowBilinear<2> : sampleRowNearest<2>;
+        case 3: return bilinear ? sampleRowBilinear<3> : sampleRowNearest<3>;
+        case 4: return bilinear ? sampleRowBilinear<4> : sampleRowNearest<4>;
+        default: return nullptr;
+        }
+    }
+
+    // Same as the row kernels, for any format PixelReader/PixelWriter support
+    void sampleRowGeneric(
+        const ImageUtils::PixelReader& read, int layer, bool bilinear,
+        const double* fx, const double* fy, unsigned count,
+        osg::Vec4f* out)
+    {
+        const int s = read.s(), t = read.t();
+        osg::Vec4f p, q, u, v;
+
+        for (unsigned c = 0; c < count; ++c)
+        {
+            double x = fx[c], y = fy[c];
+            if (!(x >= 0.0 && x <= (double)s && y >= 0.0 && y <= (double)t))
+            {
+                out[c].set(0, 0, 0, 0);
+            }
+            else if (bilinear)
+            {
+                x = osg::clampBetween(x - 0.5, 0.0, (double)(s - 1));
+                y = osg::clampBetween(y - 0.5, 0.0, (double)(t - 1));
+                int x0 = (int)x, y0 = (int)y;
+                int x1 = osg::minimum(x0 + 1, s - 1);
+                int y1 = osg::minimum(y0 + 1, t - 1);
+                float wx = (float)(x - (double)x0);
+                float wy = (float)(y - (double)y0);
+                read(p, x0, y0, layer);
+                read(q, x1, y0, layer);
+                read(u, x0, y1, layer);
+                read(v, x1, y1, layer);
+                osg::Vec4f lower = p + (q - p) * wx;
+                osg::Vec4f upper = u + (v - u) * wx;
+                out[c] = lower + (upper - lower) * wy;
+            }
+            else
+            {
+                read(out[c], osg::minimum((int)x, s - 1), osg::minimum((int)y, t - 1), layer);
+            }
+        }
+    }
+}
+
+ImageReprojector::ImageReprojector(unsigned maxMeshes) :
+    _maxError(0.125),
+    _meshes(true, maxMeshes)
+{
+    //nop
+}
+
+ImageReprojector&
+ImageReprojector::instance()
+{
+    static ImageReprojector s_instance;
+    return s_instance;
+}
+
+ImageReprojector::WarpMesh*
+ImageReprojector::createMesh(
+    const SpatialReference* srcSRS,
+    const GeoExtent& destExtent,
+    unsigned width,
+    unsigned height,
+    double tolX,
+    double tolY) const
+{
+    OE_PROFILING_ZONE;
+
+    const SpatialReference* destSRS = destExtent.getSRS();
+    const double dx = destExtent.width() / (double)width;
+    const double dy = destExtent.height() / (double)height;
+
+    osg::ref_ptr<WarpMesh> mesh = new WarpMesh();
+    mesh->width = width;
+    mesh->height = height;
+    mesh->step = (tolX > 0.0 && tolY > 0.0) ? INITIAL_STEP : 1u;
+
+    std::vector<osg::Vec3d> nodes;
+    std::vector<osg::Vec3d> checks;
+
+    for(;;)
+    {
+        WarpMesh& m = *mesh.get();
+        m.numX = (width - 1u + m.step - 1u) / m.step + 1u;
+        m.numY = (height - 1u + m.step - 1u) / m.step + 1u;
+
+        // exact source locations of the grid nodes:
+        nodes.clear();
+        nodes.reserve(m.numX*m.numY);
+        for (unsigned j = 0; j < m.numY; ++j)
+        {
+            double y = destExtent.yMin() + ((double)m.node(j, height) + 0.5)*dy;
+            for (unsigned i = 0; i < m.numX; ++i)
+            {
+                double x = destExtent.xMin() + ((double)m.node(i, width) + 0.5)*dx;
+                nodes.push_back(osg::Vec3d(x, y, 0.0));
+            }
+        }
+
+        if (!destSRS->transform(nodes, srcSRS))
+            return nullptr;
+
+        bool finite = true;
+        for (unsigned k = 0; k < nodes.size() && finite; ++k)
+            finite = std::isfinite(nodes[k].x()) && std::isfinite(nodes[k].y());
+
+        if (finite)
+        {
+            m.x.resize(nodes.size());
+            m.y.resize(nodes.size());
+            for (unsigned k = 0; k < nodes.size(); ++k)
+            {
+                m.x[k] = nodes[k].x();
+                m.y[k] = nodes[k].y();
+            }
+
+            if (m.step == 1u)
+                return mesh.release();
+
+            // compare the exact location of each cell's center with the
+            // interpolated one (the average of the four corners):
+            checks.clear();
+            checks.reserve((m.numX - 1u)*(m.numY - 1u));
+            for (unsigned j = 0; j + 1u < m.numY; ++j)
+            {
+                double r = 0.5*(double)(m.node(j, height) + m.node(j + 1u, height));
+                double y = destExtent.yMin() + (r + 0.5)*dy;
+                for (unsigned i = 0; i + 1u < m.numX; ++i)
+                {
+                    double c = 0.5*(double)(m.node(i, width) + m.node(i + 1u, width));
+                    double x = destExtent.xMin() + (c + 0.5)*dx;
+                    checks.push_back(osg::Vec3d(x, y, 0.0));
+                }
+            }
+
+            if (checks.empty())
+                return mesh.release();
+
+            if (destSRS->transform(checks, srcSRS))
+            {
+                bool accurate = true;
+                unsigned k = 0;
+                for (unsigned j = 0; j + 1u < m.numY && accurate; ++j)
+                {
+                    for (unsigned i = 0; i + 1u < m.numX && accurate; ++i, ++k)
+                    {
+                        unsigned a = j*m.numX + i, b = a + m.numX;
+                        double x = 0.25*(m.x[a] + m.x[a + 1] + m.x[b] + m.x[b + 1]);
+                        double y = 0.25*(m.y[a] + m.y[a + 1] + m.y[b] + m.y[b + 1]);
+                        accurate =
+                            fabs(x - checks[k].x()) <= tolX &&
+                            fabs(y - checks[k].y()) <= tolY;
+                    }
+                }
+
+                if (accurate)
+                    return mesh.release();
+            }
+        }
+
+        if (m.step == 1u)
+            return nullptr;
+
+        m.step /= 2u;
+    }
+}
+
+osg::ref_ptr<const ImageReprojector::WarpMesh>
+ImageReprojector::getMesh(
+    const osg::Image* image,
+    const GeoExtent& srcExtent,
+    const GeoExtent& destExtent,
+    unsigned width,
+    unsigned height) const
+{
+    // the mesh error is measured in source coordinates:
+    double tolX = _maxError * srcExtent.width() / (double)image->s();
+    double tolY = _maxError * srcExtent.height() / (double)image->t();
+
+    const SpatialReference::Key& srcKey = srcExtent.getSRS()->getKey();
+    const SpatialReference::Key& destKey = destExtent.getSRS()->getKey();
+
+    char buf[256];
+    snprintf(buf, sizeof(buf), "|%.17g,%.17g,%.17g,%.17g|%u,%u|%.9g,%.9g",
+        destExtent.xMin(), destExtent.yMin(), destExtent.xMax(), destExtent.yMax(),
+        width, height, tolX, tolY);
+
+    std::string key =
+        srcKey.horizLower + ';' + srcKey.vertLower + '|' +
+        destKey.horizLower + ';' + destKey.vertLower + buf;
+
+    LRUCache<std::string, osg::ref_ptr<const WarpMesh> >::Record record;
+    if (_meshes.get(key, record))
+        return record.value();
+
+    osg::ref_ptr<const WarpMesh> mesh = createMesh(srcExtent.getSRS(), destExtent, width, height, tolX, tolY);
+    if (mesh.valid())
+    {
+        _meshes.insert(key, mesh);
+        OE_DEBUG << LC << "New " << width << "x" << height << " mesh with step " << mesh->step << std::endl;
+    }
+    return mesh;
+}
+
+osg::Image*
+ImageReprojector::reproject(
+    const osg::Image* image,
+    const GeoExtent& srcExtent,
+    const GeoExtent& destExtent,
+    unsigned width,
+    unsigned height,
+    bool bilinear) const
+{
+    OE_PROFILING_ZONE;
+
+    if (image == nullptr || image->s() < 1 || image->t() < 1 || image->r() < 1 ||
+        !srcExtent.isValid() || !destExtent.isValid() ||
+        srcExtent.width() <= 0.0 || srcExtent.height() <= 0.0 ||
+        ImageUtils::isCompressed(image))
+    {
+        return nullptr;
+    }
+
+    RowKernel kernel = getKernel(image, bilinear);
+
+    if (kernel == nullptr &&
+        (!ImageUtils::PixelReader::supports(image) ||
+         !ImageUtils::PixelWriter::supports(image->getPixelFormat(), image->getDataType())))
+    {
+        return nullptr;
+    }
+
+    if (width == 0u || height == 0u)
+    {
+        // like GDALSuggestedWarpOutput: keep the number of pixels along
+        // the diagonal of the source extent.
+        GeoExtent ex = srcExtent.transform(destExtent.getSRS());
+        if (!ex.isValid() || ex.width() <= 0.0 || ex.height() <= 0.0)
+            return nullptr;
+
+        double diagonal = sqrt(ex.width()*ex.width() + ex.height()*ex.height());
+        double pixels = sqrt((double)image->s()*(double)image->s() + (double)image->t()*(double)image->t());
+        double res = diagonal / pixels;
+        width = osg::maximum(1u, (unsigned)(ex.width() / res + 0.5));
+        height = osg::maximum(1u, (unsigned)(ex.height() / res + 0.5));
+    }
+
+    osg::ref_ptr<const WarpMesh> mesh = getMesh(image, srcExtent, destExtent, width, height);
+    if (!mesh.valid())
+        return nullptr;
+
+    osg::ref_ptr<osg::Image> result = new osg::Image();
+    result->allocateImage(width, height, image->r(), image->getPixelFormat(), image->getDataType());
+    result->setInternalTextureFormat(image->getInternalTextureFormat());
+    memset(result->data(), 0, result->getTotalSizeInBytes());
+
+    // column lookups, shared by all rows:
+    std::vector<unsigned> cell(width), cell1(width);
+    std::vector<double> weight(width);
+    for (unsigned c = 0; c < width; ++c)
+    {
+        unsigned i = osg::minimum(c / mesh->step, mesh->numX - 1u);
+        unsigned i1 = osg::minimum(i + 1u, mesh->numX - 1u);
+        unsigned c0 = mesh->node(i, width), c1 = mesh->node(i1, width);
+        cell[c] = i;
+        cell1[c] = i1;
+        weight[c] = c1 > c0 ? (double)(c - c0) / (double)(c1 - c0) : 0.0;
+    }
+
+    std::vector<double> nodeX(mesh->numX), nodeY(mesh->numX);
+    std::vector<double> fx(width), fy(width);
+
+    const double srcDX = srcExtent.width() / (double)image->s();
+    const double srcDY = srcExtent.height() / (double)image->t();
+
+    if (kernel)
+    {
+        const unsigned rowBytes = image->getRowStepInBytes();
+
+        for (unsigned row = 0; row < height; ++row)
+        {
+            interpolateRow(*mesh.get(), row, cell, cell1, weight,
+                srcExtent.xMin(), srcExtent.yMin(), srcDX, srcDY,
+                nodeX, nodeY, &fx[0], &fy[0]);
+
+            for (int layer = 0; layer < image->r(); ++layer)
+            {
+                kernel(
+                    image->data(0, 0, layer), rowBytes, image->s(), image->t(),
+                    &fx[0], &fy[0], width,
+                    result->data(0, row, layer));
+            }
+        }
+    }
+    else
+    {
+        ImageUtils::PixelReader read(image);
+        ImageUtils::PixelWriter write(result.get());
+        std::vector<osg::Vec4f> colors(width);
+
+        for (unsigned row = 0; row < height; ++row)
+        {
+            interpolateRow(*mesh.get(), row, cell, cell1, weight,
+                srcExtent.xMin(), srcExtent.yMin(), srcDX, srcDY,
+                nodeX, nodeY, &fx[0], &fy[0]);
+
+            for (int layer = 0; layer < image->r(); ++layer)
+            {
+                sampleRowGeneric(read, layer, bilinear, &fx[0], &fy[0], width, &colors[0]);
+                write.writeRow(&colors[0], 0, row, width, layer);
+            }
+        }
+    }
+
+    return result.release();
+}
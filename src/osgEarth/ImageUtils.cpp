@@ -29,6 +29,10 @@
 
 #define LC "[ImageUtils] "
 
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT 0x140B
+#endif
+
 
 #if defined(OSG_GLES1_AVAILABLE) || defined(OSG_GLES2_AVAILABLE) || defined(OSG_GLES3_AVAILABLE)
 #    define GL_RGB8_INTERNAL  GL_RGB8_OES
@@ -220,40 +224,68 @@ ImageUtils::resizeImage(const osg::Image* input,
         PixelReader read( input );
         PixelWriter write( output.get() );
 
-        osg::Vec4 color;
+        // Column lookups are the same for every row, so compute them once.
+        std::vector<float> input_cols(out_s);
+        std::vector<int> colMins(out_s), colMaxs(out_s), nearestCols(out_s);
 
-        for( unsigned int output_row=0; output_row < out_t; output_row++ )
+        for( unsigned int output_col = 0; output_col < out_s; output_col++ )
         {
-            // get an appropriate input row
-            float output_row_ratio = (float)output_row/(float)out_t;
-            float input_row = output_row_ratio * (float)in_t;
-            if ( input_row >= input->t() ) input_row = in_t-1;
-            else if ( input_row < 0 ) input_row = 0;
+            float output_col_ratio = (float)output_col/(float)out_s;
+            float input_col =  output_col_ratio * (float)in_s;
+            if ( input_col >= (int)in_s ) input_col = in_s-1;
+            else if ( input_col < 0 ) input_col = 0.0f;
+
+            int colMin = osg::maximum((int)floor(input_col), 0);
+            int colMax = osg::maximum(osg::minimum((int)ceil(input_col), (int)(input->s()-1)), 0);
+            if (colMin > colMax) colMin = colMax;
+
+            input_cols[output_col] = input_col;
+            colMins[output_col] = colMin;
+            colMaxs[output_col] = colMax;
+
+            nearestCols[output_col] = (input_col-(int)input_col) <= (ceil(input_col)-input_col) ?
+                (int)input_col :
+                osg::minimum( 1+(int)input_col, (int)in_s-1 );
+        }
+
+        // Work a row at a time through the span API.
+        std::vector<osg::Vec4f> minRow(in_s), maxRow(in_s), outRow(out_s);
 
-            for( unsigned int output_col = 0; output_col < out_s; output_col++ )
+        for(int layer=0; layer<input->r(); ++layer)
+        {
+            for( unsigned int output_row=0; output_row < out_t; output_row++ )
             {
-                float output_col_ratio = (float)output_col/(float)out_s;
-                float input_col =  output_col_ratio * (float)in_s;
-                if ( input_col >= (int)in_s ) input_col = in_s-1;
-                else if ( input_col < 0 ) input_col = 0.0f;
+                // get an appropriate input row
+                float output_row_ratio = (float)output_row/(float)out_t;
+                float input_row = output_row_ratio * (float)in_t;
+                if ( input_row >= input->t() ) input_row = in_t-1;
+                else if ( input_row < 0 ) input_row = 0;
 
-                for(int layer=0; layer<input->r(); ++layer)
+                if (bilinear)
                 {
-                    if (bilinear)
+                    // Do a bilinear interpolation for the image
+                    int rowMin = osg::maximum((int)floor(input_row), 0);
+                    int rowMax = osg::maximum(osg::minimum((int)ceil(input_row), (int)(input->t()-1)), 0);
+                    if (rowMin > rowMax) rowMin = rowMax;
+
+                    read.readRow(minRow.data(), 0, rowMin, in_s, layer);
+                    if (rowMax != rowMin)
+                        read.readRow(maxRow.data(), 0, rowMax, in_s, layer);
+                    else
+                        maxRow = minRow;
+
+                    for( unsigned int output_col = 0; output_col < out_s; output_col++ )
                     {
-                        // Do a bilinear interpolation for the image
-                        int rowMin = osg::maximum((int)floor(input_row), 0);
-                        int rowMax = osg::maximum(osg::minimum((int)ceil(input_row), (int)(input->t()-1)), 0);
-                        int colMin = osg::maximum((int)floor(input_col), 0);
-                        int colMax = osg::maximum(osg::minimum((int)ceil(input_col), (int)(input->s()-1)), 0);
+                        float input_col = input_cols[output_col];
+                        int colMin = colMins[output_col];
+                        int colMax = colMaxs[output_col];
 
-                        if (rowMin > rowMax) rowMin = rowMax;
-                        if (colMin > colMax) colMin = colMax;
+                        const osg::Vec4f& urColor = maxRow[colMax];
+                        const osg::Vec4f& llColor = minRow[colMin];
+                        const osg::Vec4f& ulColor = maxRow[colMin];
+                        const osg::Vec4f& lrColor = minRow[colMax];
 
-                        osg::Vec4 urColor = read(colMax, rowMax, layer);
-                        osg::Vec4 llColor = read(colMin, rowMin, layer);
-                        osg::Vec4 ulColor = read(colMin, rowMax, layer);
-                        osg::Vec4 lrColor = read(colMax, rowMin, layer);
+                        osg::Vec4f& color = outRow[output_col];
 
                         if ((colMax == colMin) && (rowMax == rowMin))
                         {
@@ -278,25 +310,23 @@ ImageUtils::resizeImage(const osg::Image* input,
                             color = r1 * ((double)rowMax - input_row) + r2 * (input_row - (double)rowMin);
                         }
                     }
-                    else
-                    {
-                        // nearest neighbor:
-                        int col = (input_col-(int)input_col) <= (ceil(input_col)-input_col) ?
-                            (int)input_col :
-                            osg::minimum( 1+(int)input_col, (int)in_s-1 );
-
-                        int row = (input_row-(int)input_row) <= (ceil(input_row)-input_row) ?
-                            (int)input_row :
-                            osg::minimum( 1+(int)input_row, (int)in_t-1 );
+                }
+                else
+                {
+                    // nearest neighbor:
+                    int row = (input_row-(int)input_row) <= (ceil(input_row)-input_row) ?
+                        (int)input_row :
+                        osg::minimum( 1+(int)input_row, (int)in_t-1 );
 
-                        read(color, col, row, layer); // read pixel from mip level 0.
+                    read.readRow(minRow.data(), 0, row, in_s, layer); // read pixels from mip level 0.
 
-                        // old code
-                        //color = read( (int)input_col, (int)input_row, layer ); // read pixel from mip level 0
+                    for( unsigned int output_col = 0; output_col < out_s; output_col++ )
+                    {
+                        outRow[output_col] = minRow[nearestCols[output_col]];
                     }
-
-                    write( color, output_col, output_row, layer, mipmapLevel ); // write to target mip level
                 }
+
+                write.writeRow(outRow.data(), 0, output_row, out_s, layer, mipmapLevel); // write to target mip level
             }
         }
     }
@@ -450,6 +480,95 @@ ImageUtils::bicubicUpsample(const osg::Image* source,
     return true;
 }
 
+namespace
+{
+    // Populates mipmap levels 1..N of an image whose level 0 data and
+    // mipmap offsets are already in place, using a 2x2 box filter over
+    // row spans. Where a level has an odd size, the last row or column
+    // of the destination takes in three source rows or columns instead,
+    // so none is dropped. Returns false for formats it does not handle
+    // so the caller can fall back on gluScaleImage.
+    bool boxFilterMipmaps(osg::Image* image, int numLevels)
+    {
+        GLenum format = image->getPixelFormat();
+        GLenum type = image->getDataType();
+
+        bool formatOK =
+            format == GL_RED || format == GL_RG || format == GL_RGB || format == GL_RGBA ||
+            format == GL_BGR || format == GL_BGRA || format == GL_LUMINANCE ||
+            format == GL_LUMINANCE_ALPHA || format == GL_ALPHA;
+
+        bool typeOK =
+            type == GL_UNSIGNED_BYTE || type == GL_UNSIGNED_SHORT ||
+            type == GL_FLOAT || type == GL_HALF_FLOAT;
+
+        if (!formatOK || !typeOK)
+            return false;
+
+        // Writers truncate integer data, so bias by half a step to round instead.
+        const float bias =
+            type == GL_UNSIGNED_BYTE ? 0.5f / 255.0f : // normalized
+            type == GL_UNSIGNED_SHORT ? 0.5f :
+            0.0f;
+        const osg::Vec4f biasVec(bias, bias, bias, bias);
+
+        for (int level = 1; level < numLevels; ++level)
+        {
+            int sw = osg::maximum(image->s() >> (level - 1), 1);
+            int sh = osg::maximum(image->t() >> (level - 1), 1);
+            int dw = osg::maximum(image->s() >> level, 1);
+            int dh = osg::maximum(image->t() >> level, 1);
+
+            // Wrap each level in an image so the reader and writer can address it.
+            osg::ref_ptr<osg::Image> src = new osg::Image();
+            src->setImage(sw, sh, 1, image->getInternalTextureFormat(), format, type,
+                image->getMipmapData(level - 1), osg::Image::NO_DELETE, image->getPacking());
+
+            osg::ref_ptr<osg::Image> dst = new osg::Image();
+            dst->setImage(dw, dh, 1, image->getInternalTextureFormat(), format, type,
+                image->getMipmapData(level), osg::Image::NO_DELETE, image->getPacking());
+
+            ImageUtils::PixelReader read(src.get());
+            ImageUtils::PixelWriter write(dst.get());
+
+            std::vector<osg::Vec4f> row0(sw), row1(sw), row2(sw), out(dw);
+
+            bool oddS = sw > 1 && (sw & 1) != 0;
+            bool oddT = sh > 1 && (sh & 1) != 0;
+
+            for (int t = 0; t < dh; ++t)
+            {
+                bool lastT = oddT && t == dh - 1;
+
+                read.readRow(row0.data(), 0, osg::minimum(2 * t, sh - 1), sw);
+                read.readRow(row1.data(), 0, osg::minimum(2 * t + 1, sh - 1), sw);
+                if (lastT)
+                    read.readRow(row2.data(), 0, 2 * t + 2, sw);
+
+                for (int s = 0; s < dw; ++s)
+                {
+                    bool lastS = oddS && s == dw - 1;
+
+                    int s0 = osg::minimum(2 * s, sw - 1);
+                    int s1 = osg::minimum(2 * s + 1, sw - 1);
+                    osg::Vec4f sum = row0[s0] + row0[s1] + row1[s0] + row1[s1];
+                    if (lastS)
+                        sum += row0[s1 + 1] + row1[s1 + 1];
+                    if (lastT)
+                        sum += row2[s0] + row2[s1] + (lastS ? row2[s1 + 1] : osg::Vec4f());
+
+                    float taps = (lastS ? 3.0f : 2.0f) * (lastT ? 3.0f : 2.0f);
+                    out[s] = sum / taps + biasVec;
+                }
+
+                write.writeRow(out.data(), 0, t, dw);
+            }
+        }
+
+        return true;
+    }
+}
+
 const osg::Image*
 ImageUtils::mipmapImage(const osg::Image* input)
 {
@@ -521,25 +640,28 @@ ImageUtils::mipmapImage(const osg::Image* input)
     output->setMipmapLevels(mipOffsets);
 
     // now, populate the image levels.
-    osg::PixelStorageModes psm;
-    psm.pack_alignment = input->getPacking();
-    psm.pack_row_length = input->getRowLength();
-    psm.unpack_alignment = input->getPacking();
-
-    for(int level=1; level<numLevels; ++level)
-    {
-        // OSG-custom gluScaleImage that does not require a graphics context
-        GLint status = gluScaleImage(
-            &psm,
-            output->getPixelFormat(),
-            output->s(),
-            output->t(),
-            output->getDataType(),
-            output->data(),
-            output->s() >> level,
-            output->t() >> level,
-            output->getDataType(),
-            output->getMipmapData(level));
+    if (boxFilterMipmaps(output, numLevels) == false)
+    {
+        osg::PixelStorageModes psm;
+        psm.pack_alignment = input->getPacking();
+        psm.pack_row_length = input->getRowLength();
+        psm.unpack_alignment = input->getPacking();
+
+        for(int level=1; level<numLevels; ++level)
+        {
+            // OSG-custom gluScaleImage that does not require a graphics context
+            GLint status = gluScaleImage(
+                &psm,
+                output->getPixelFormat(),
+                output->s(),
+                output->t(),
+                output->getDataType(),
+                output->data(),
+                output->s() >> level,
+                output->t() >> level,
+                output->getDataType(),
+                output->getMipmapData(level));
+        }
     }
 
     return output;
@@ -613,25 +735,28 @@ ImageUtils::mipmapImageInPlace(osg::Image* input)
     input->setMipmapLevels(mipOffsets);
 
     // now, populate the image levels.
-    osg::PixelStorageModes psm;
-    psm.pack_alignment = input->getPacking();
-    psm.pack_row_length = input->getRowLength();
-    psm.unpack_alignment = input->getPacking();
-
-    for(int level=1; level<numLevels; ++level)
-    {
-        // OSG-custom gluScaleImage that does not require a graphics context
-        GLint status = gluScaleImage(
-            &psm,
-            input->getPixelFormat(),
-            input->s(),
-            input->t(),
-            input->getDataType(),
-            input->data(),
-            input->s() >> level,
-            input->t() >> level,
-            input->getDataType(),
-            input->getMipmapData(level));
+    if (boxFilterMipmaps(input, numLevels) == false)
+    {
+        osg::PixelStorageModes psm;
+        psm.pack_alignment = input->getPacking();
+        psm.pack_row_length = input->getRowLength();
+        psm.unpack_alignment = input->getPacking();
+
+        for(int level=1; level<numLevels; ++level)
+        {
+            // OSG-custom gluScaleImage that does not require a graphics context
+            GLint status = gluScaleImage(
+                &psm,
+                input->getPixelFormat(),
+                input->s(),
+                input->t(),
+                input->getDataType(),
+                input->data(),
+                input->s() >> level,
+                input->t() >> level,
+                input->getDataType(),
+                input->getMipmapData(level));
+        }
     }
 }
 
@@ -919,23 +1044,35 @@ ImageUtils::mix(osg::Image* dest, const osg::Image* src, float a)
     bool srcHasAlpha = hasAlphaChannel(src);
     bool destHasAlpha = hasAlphaChannel(dest);
 
-    osg::Vec4 src_value, dest_value;
     PixelReader read_src(src), read_dest(dest);
     PixelWriter write_dest(dest);
-    ImageIterator i(src);
 
-    i.forEachPixel([&]() {
-        read_src(src_value, i.s(), i.t());
-        read_dest(dest_value, i.s(), i.t());
-        float sa = srcHasAlpha ? a * src_value.a() : a;
-        float da = destHasAlpha ? dest_value.a() : 1.0f;
-        dest_value.set(
-            dest_value.r()*(1.0f - sa) + src_value.r()*sa,
-            dest_value.g()*(1.0f - sa) + src_value.g()*sa,
-            dest_value.b()*(1.0f - sa) + src_value.b()*sa,
-            osg::maximum(sa, da));
-        write_dest(dest_value, i.s(), i.t());
-        });
+    const int width = src->s();
+    std::vector<osg::Vec4f> src_row(width), dest_row(width);
+
+    for (int r = 0; r < src->r(); ++r)
+    {
+        for (int t = 0; t < src->t(); ++t)
+        {
+            read_src.readRow(src_row.data(), 0, t, width, r);
+            read_dest.readRow(dest_row.data(), 0, t, width, r);
+
+            for (int s = 0; s < width; ++s)
+            {
+                const osg::Vec4f& src_value = src_row[s];
+                osg::Vec4f& dest_value = dest_row[s];
+                float sa = srcHasAlpha ? a * src_value.a() : a;
+                float da = destHasAlpha ? dest_value.a() : 1.0f;
+                dest_value.set(
+                    dest_value.r()*(1.0f - sa) + src_value.r()*sa,
+                    dest_value.g()*(1.0f - sa) + src_value.g()*sa,
+                    dest_value.b()*(1.0f - sa) + src_value.b()*sa,
+                    osg::maximum(sa, da));
+            }
+
+            write_dest.writeRow(dest_row.data(), 0, t, width, r);
+        }
+    }
 
     return true;
 }
@@ -1352,15 +1489,18 @@ ImageUtils::convert(const osg::Image* image, GLenum pixelFormat, GLenum dataType
     else
         result->setInternalTextureFormat( pixelFormat );
 
-    // copy image to result
+    // copy image to result, one row at a time
     PixelReader read(image);
     PixelWriter write(result);
-    osg::Vec4 value;
-    ImageIterator iter(read);
-    iter.forEachPixel([&]() {
-        read(value, iter.s(), iter.t());
-        write(value, iter.s(), iter.t());
-    });
+    std::vector<osg::Vec4f> row(image->s());
+    for (int r = 0; r < image->r(); ++r)
+    {
+        for (int t = 0; t < image->t(); ++t)
+        {
+            read.readRow(row.data(), 0, t, image->s(), r);
+            write.writeRow(row.data(), 0, t, image->s(), r);
+        }
+    }
 
     return result;
 }
@@ -1604,6 +1744,95 @@ namespace
         static double scale(bool norm) { return 1.0; }
     };
 
+    // IEEE 754 half-precision float (GL_HALF_FLOAT) conversions
+    inline float halfToFloat(GLushort h)
+    {
+        unsigned sign = (unsigned)(h & 0x8000u) << 16;
+        unsigned exp = (h >> 10) & 0x1fu;
+        unsigned mant = h & 0x3ffu;
+        unsigned bits;
+
+        if (exp == 0u)
+        {
+            if (mant == 0u)
+            {
+                bits = sign; // zero
+            }
+            else
+            {
+                // subnormal; normalize it
+                exp = 127u - 15u + 1u;
+                while ((mant & 0x400u) == 0u)
+                {
+                    mant <<= 1;
+                    --exp;
+                }
+                bits = sign | (exp << 23) | ((mant & 0x3ffu) << 13);
+            }
+        }
+        else if (exp == 31u)
+        {
+            bits = sign | 0x7f800000u | (mant << 13); // inf/nan
+        }
+        else
+        {
+            bits = sign | ((exp + 127u - 15u) << 23) | (mant << 13);
+        }
+
+        float f;
+        ::memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    inline GLushort floatToHalf(float f)
+    {
+        unsigned bits;
+        ::memcpy(&bits, &f, sizeof(bits));
+
+        unsigned sign = (bits >> 16) & 0x8000u;
+        unsigned fexp = (bits >> 23) & 0xffu;
+        unsigned mant = bits & 0x7fffffu;
+        int exp = (int)fexp - 127 + 15;
+
+        if (fexp == 0xffu)
+            return (GLushort)(sign | 0x7c00u | (mant ? 0x200u : 0u)); // inf/nan
+
+        if (exp >= 31)
+            return (GLushort)(sign | 0x7c00u); // overflow to inf
+
+        if (exp <= 0)
+        {
+            if (exp < -10)
+                return (GLushort)sign; // underflow to zero
+
+            // subnormal, round to nearest
+            mant |= 0x800000u;
+            unsigned shift = (unsigned)(14 - exp);
+            unsigned h = mant >> shift;
+            if ((mant >> (shift - 1u)) & 1u)
+                ++h;
+            return (GLushort)(sign | h);
+        }
+
+        // round to nearest; a carry into the exponent is still correct
+        unsigned h = sign | ((unsigned)exp << 10) | (mant >> 13);
+        if (mant & 0x1000u)
+            ++h;
+        return (GLushort)h;
+    }
+    // Storage type for a GL_HALF_FLOAT component
+    struct HalfFloat
+    {
+        HalfFloat(float value) : bits(floatToHalf(value)) { }
+        operator float() const { return halfToFloat(bits); }
+        GLushort bits;
+    };
+
+    template<> struct GLTypeTraits<HalfFloat>
+    {
+        static double scale(bool norm) { return 1.0; }
+    };
+
     // The Reader function that performs the read.
     template<int Format, typename T> struct ColorReader;
     template<int Format, typename T> struct ColorWriter;
@@ -1987,6 +2216,8 @@ namespace
             return &ColorReader<GLFormat, GLuint>::read;
         case GL_FLOAT:
             return &ColorReader<GLFormat, GLfloat>::read;
+        case GL_HALF_FLOAT:
+            return &ColorReader<GLFormat, HalfFloat>::read;
         case GL_UNSIGNED_SHORT_5_5_5_1:
             return &ColorReader<GL_UNSIGNED_SHORT_5_5_5_1, GLushort>::read;
         case GL_UNSIGNED_BYTE_3_3_2:
@@ -2041,6 +2272,120 @@ namespace
             break;
         }
     }
+
+    // Reads a run of pixels. The generic version binds the per-pixel
+    // reader at compile time so there is no indirect call per pixel.
+    template<int Format, typename T>
+    struct RowReader
+    {
+        static void read(const ImageUtils::PixelReader* ia, osg::Vec4f* out, int s, int t, int count, int r)
+        {
+            for (int i = 0; i < count; ++i)
+                ColorReader<Format, T>::read(ia, out[i], s + i, t, r, 0);
+        }
+    };
+
+    // Common formats get straight loops over contiguous memory so the
+    // compiler can vectorize the conversion. Results match ColorReader exactly.
+    template<>
+    struct RowReader<GL_RGBA, GLubyte>
+    {
+        static void read(const ImageUtils::PixelReader* ia, osg::Vec4f* out, int s, int t, int count, int r)
+        {
+            const GLubyte* ptr = ia->data(s, t, r, 0);
+            const double scale = GLTypeTraits<GLubyte>::scale(ia->_normalized);
+            float* f = out->ptr();
+            for (int i = 0; i < count * 4; ++i)
+                f[i] = (float)((double)ptr[i] * scale);
+        }
+    };
+
+    template<>
+    struct RowReader<GL_RED, GLfloat>
+    {
+        static void read(const ImageUtils::PixelReader* ia, osg::Vec4f* out, int s, int t, int count, int r)
+        {
+            const GLfloat* ptr = (const GLfloat*)ia->data(s, t, r, 0);
+            for (int i = 0; i < count; ++i)
+                out[i].set(ptr[i], ptr[i], ptr[i], 1.0f);
+        }
+    };
+
+    template<>
+    struct RowReader<GL_RG, HalfFloat>
+    {
+        static void read(const ImageUtils::PixelReader* ia, osg::Vec4f* out, int s, int t, int count, int r)
+        {
+            const GLushort* ptr = (const GLushort*)ia->data(s, t, r, 0);
+            for (int i = 0; i < count; ++i, ptr += 2)
+                out[i].set(halfToFloat(ptr[0]), halfToFloat(ptr[1]), 0.0f, 1.0f);
+        }
+    };
+
+    template<int GLFormat>
+    inline ImageUtils::PixelReader::RowReaderFunc
+    chooseRowReader(GLenum dataType)
+    {
+        switch (dataType)
+        {
+        case GL_BYTE:
+            return &RowReader<GLFormat, GLbyte>::read;
+        case GL_UNSIGNED_BYTE:
+            return &RowReader<GLFormat, GLubyte>::read;
+        case GL_SHORT:
+            return &RowReader<GLFormat, GLshort>::read;
+        case GL_UNSIGNED_SHORT:
+            return &RowReader<GLFormat, GLushort>::read;
+        case GL_INT:
+            return &RowReader<GLFormat, GLint>::read;
+        case GL_UNSIGNED_INT:
+            return &RowReader<GLFormat, GLuint>::read;
+        case GL_FLOAT:
+            return &RowReader<GLFormat, GLfloat>::read;
+        case GL_HALF_FLOAT:
+            return &RowReader<GLFormat, HalfFloat>::read;
+        case GL_UNSIGNED_SHORT_5_5_5_1:
+            return &RowReader<GL_UNSIGNED_SHORT_5_5_5_1, GLushort>::read;
+        case GL_UNSIGNED_BYTE_3_3_2:
+            return &RowReader<GL_UNSIGNED_BYTE_3_3_2, GLubyte>::read;
+        case GL_UNSIGNED_INT_8_8_8_8_REV:
+            return &RowReader<GLFormat, GLubyte>::read;
+        default:
+            return &RowReader<0, GLbyte>::read;
+        }
+    }
+
+    inline ImageUtils::PixelReader::RowReaderFunc
+    getRowReader( GLenum pixelFormat, GLenum dataType )
+    {
+        switch( pixelFormat )
+        {
+        case GL_DEPTH_COMPONENT:
+            return chooseRowReader<GL_DEPTH_COMPONENT>(dataType);
+        case GL_LUMINANCE:
+            return chooseRowReader<GL_LUMINANCE>(dataType);
+        case GL_RED:
+            return chooseRowReader<GL_RED>(dataType);
+        case GL_ALPHA:
+            return chooseRowReader<GL_ALPHA>(dataType);
+        case GL_LUMINANCE_ALPHA:
+            return chooseRowReader<GL_LUMINANCE_ALPHA>(dataType);
+        case GL_RG:
+            return chooseRowReader<GL_RG>(dataType);
+        case GL_RGB:
+            return chooseRowReader<GL_RGB>(dataType);
+        case GL_RGBA:
+            return chooseRowReader<GL_RGBA>(dataType);
+        case GL_BGR:
+            return chooseRowReader<GL_BGR>(dataType);
+        case GL_BGRA:
+            return chooseRowReader<GL_BGRA>(dataType);
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            return &RowReader<GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GLubyte>::read;
+        default:
+            return &RowReader<0, GLbyte>::read;
+        }
+    }
 }
 
 ImageUtils::PixelReader::PixelReader() :
@@ -2076,6 +2421,7 @@ ImageUtils::PixelReader::setImage(const osg::Image* image)
             OE_WARN << "[PixelReader] No reader found for pixel format " << std::hex << _image->getPixelFormat() << std::endl;
             _read = &ColorReader<0,GLbyte>::read;
         }
+        _readRow = getRowReader( _image->getPixelFormat(), dataType );
     }
 }
 
@@ -2443,6 +2789,8 @@ namespace
             return &ColorWriter<GLFormat, GLuint>::write;
         case GL_FLOAT:
             return &ColorWriter<GLFormat, GLfloat>::write;
+        case GL_HALF_FLOAT:
+            return &ColorWriter<GLFormat, HalfFloat>::write;
         case GL_UNSIGNED_SHORT_5_5_5_1:
             return &ColorWriter<GL_UNSIGNED_SHORT_5_5_5_1, GLushort>::write;
         case GL_UNSIGNED_BYTE_3_3_2:
@@ -2491,6 +2839,114 @@ namespace
             break;
         }
     }
+
+    // Writes a run of pixels; see RowReader.
+    template<int Format, typename T>
+    struct RowWriter
+    {
+        static void write(const ImageUtils::PixelWriter* iw, const osg::Vec4f* in, int s, int t, int count, int r, int m)
+        {
+            for (int i = 0; i < count; ++i)
+                ColorWriter<Format, T>::write(iw, in[i], s + i, t, r, m);
+        }
+    };
+
+    template<>
+    struct RowWriter<GL_RGBA, GLubyte>
+    {
+        static void write(const ImageUtils::PixelWriter* iw, const osg::Vec4f* in, int s, int t, int count, int r, int m)
+        {
+            GLubyte* ptr = iw->data(s, t, r, m);
+            const double scale = GLTypeTraits<GLubyte>::scale(iw->_normalized);
+            const float* f = in->ptr();
+            for (int i = 0; i < count * 4; ++i)
+                ptr[i] = (GLubyte)(f[i] / scale);
+        }
+    };
+
+    template<>
+    struct RowWriter<GL_RED, GLfloat>
+    {
+        static void write(const ImageUtils::PixelWriter* iw, const osg::Vec4f* in, int s, int t, int count, int r, int m)
+        {
+            GLfloat* ptr = (GLfloat*)iw->data(s, t, r, m);
+            for (int i = 0; i < count; ++i)
+                ptr[i] = in[i].r();
+        }
+    };
+
+    template<>
+    struct RowWriter<GL_RG, HalfFloat>
+    {
+        static void write(const ImageUtils::PixelWriter* iw, const osg::Vec4f* in, int s, int t, int count, int r, int m)
+        {
+            GLushort* ptr = (GLushort*)iw->data(s, t, r, m);
+            for (int i = 0; i < count; ++i, ptr += 2)
+            {
+                ptr[0] = floatToHalf(in[i].r());
+                ptr[1] = floatToHalf(in[i].g());
+            }
+        }
+    };
+
+    template<int GLFormat>
+    inline ImageUtils::PixelWriter::RowWriterFunc chooseRowWriter(GLenum dataType)
+    {
+        switch (dataType)
+        {
+        case GL_BYTE:
+            return &RowWriter<GLFormat, GLbyte>::write;
+        case GL_UNSIGNED_BYTE:
+            return &RowWriter<GLFormat, GLubyte>::write;
+        case GL_SHORT:
+            return &RowWriter<GLFormat, GLshort>::write;
+        case GL_UNSIGNED_SHORT:
+            return &RowWriter<GLFormat, GLushort>::write;
+        case GL_INT:
+            return &RowWriter<GLFormat, GLint>::write;
+        case GL_UNSIGNED_INT:
+            return &RowWriter<GLFormat, GLuint>::write;
+        case GL_FLOAT:
+            return &RowWriter<GLFormat, GLfloat>::write;
+        case GL_HALF_FLOAT:
+            return &RowWriter<GLFormat, HalfFloat>::write;
+        case GL_UNSIGNED_SHORT_5_5_5_1:
+            return &RowWriter<GL_UNSIGNED_SHORT_5_5_5_1, GLushort>::write;
+        case GL_UNSIGNED_BYTE_3_3_2:
+            return &RowWriter<GL_UNSIGNED_BYTE_3_3_2, GLubyte>::write;
+        default:
+            return &RowWriter<0, GLbyte>::write;
+        }
+    }
+
+    inline ImageUtils::PixelWriter::RowWriterFunc getRowWriter(GLenum pixelFormat, GLenum dataType)
+    {
+        switch( pixelFormat )
+        {
+        case GL_DEPTH_COMPONENT:
+            return chooseRowWriter<GL_DEPTH_COMPONENT>(dataType);
+        case GL_LUMINANCE:
+            return chooseRowWriter<GL_LUMINANCE>(dataType);
+        case GL_RED:
+            return chooseRowWriter<GL_RED>(dataType);
+        case GL_ALPHA:
+            return chooseRowWriter<GL_ALPHA>(dataType);
+        case GL_LUMINANCE_ALPHA:
+            return chooseRowWriter<GL_LUMINANCE_ALPHA>(dataType);
+        case GL_RG:
+            return chooseRowWriter<GL_RG>(dataType);
+        case GL_RGB:
+            return chooseRowWriter<GL_RGB>(dataType);
+        case GL_RGBA:
+            return chooseRowWriter<GL_RGBA>(dataType);
+        case GL_BGR:
+            return chooseRowWriter<GL_BGR>(dataType);
+        case GL_BGRA:
+            return chooseRowWriter<GL_BGRA>(dataType);
+        default:
+            return &RowWriter<0, GLbyte>::write;
+        }
+    }
 }
 
 ImageUtils::PixelWriter::PixelWriter(osg::Image* image) :
@@ -2509,6 +2965,7 @@ _image(image)
             OE_WARN << "[PixelWriter] No writer found for pixel format " << std::hex << _image->getPixelFormat() << std::endl;
             _writer = &ColorWriter<0, GLbyte>::write;
         }
+        _rowWriter = getRowWriter( _image->getPixelFormat(), dataType );
     }
 }
 
@@ -22,6 +22,7 @@
 #include <osgEarth/XmlUtils>
 #include <osgEarth/StringUtils>
 #include <osgEarth/ImageToHeightFieldConverter>
+#include <osgEarth/Metrics>
 #include <osgDB/FileUtils>
 #include <sstream>
 #include <iomanip>
@@ -50,6 +51,45 @@ namespace
         }
         return rw;
     }
+
+    const char* SELECT_TILE_SQL =
+        "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
+
+    const char* INSERT_TILE_SQL =
+        "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
+
+    // number of tile writes per transaction unless set otherwise
+    const unsigned DEFAULT_WRITE_BATCH_SIZE = 256u;
+
+    // Runs the tile query on a connection, preparing the statement on first
+    // use and leaving it reset for the next call. Returns the sqlite3 code.
+    int selectTile(sqlite3* database, void*& statement, int z, int x, int y, std::string& out)
+    {
+        sqlite3_stmt* select = (sqlite3_stmt*)statement;
+        if (select == NULL)
+        {
+            int rc = sqlite3_prepare_v2(database, SELECT_TILE_SQL, -1, &select, 0L);
+            if (rc != SQLITE_OK)
+                return rc;
+            statement = select;
+        }
+
+        sqlite3_bind_int(select, 1, z);
+        sqlite3_bind_int(select, 2, x);
+        sqlite3_bind_int(select, 3, y);
+
+        int rc = sqlite3_step(select);
+        if (rc == SQLITE_ROW)
+        {
+            // the pointer returned from _blob gets freed internally by sqlite
+            const char* data = (const char*)sqlite3_column_blob(select, 0);
+            int dataLen = sqlite3_column_bytes(select, 0);
+            out.assign(data, dataLen);
+        }
+
+        sqlite3_reset(select);
+        return rc;
+    }
 }
 
 //...................................................................
@@ -139,6 +179,13 @@ MBTilesImageLayer::openImplementation()
     return Status::NoError;
 }
 
+Status
+MBTilesImageLayer::closeImplementation()
+{
+    _driver.close();
+    return ImageLayer::closeImplementation();
+}
+
 void
 MBTilesImageLayer::setDataExtents(const DataExtentList& values)
 {
@@ -252,6 +299,13 @@ MBTilesElevationLayer::openImplementation()
     return Status::NoError;
 }
 
+Status
+MBTilesElevationLayer::closeImplementation()
+{
+    _driver.close();
+    return ElevationLayer::closeImplementation();
+}
+
 void
 MBTilesElevationLayer::setDataExtents(const DataExtentList& values)
 {
@@ -327,16 +381,58 @@ MBTiles::Driver::Driver() :
     _maxLevel(19),
     _forceRGB(false),
     _database(NULL),
-    _mutex("MBTiles Driver(OE)")
+    _readWrite(false),
+    _mutex("MBTiles Driver(OE)"),
+    _selectTile(NULL),
+    _insertTile(NULL),
+    _transactionOpen(false),
+    _pendingWrites(0u),
+    _writeBatchSize(DEFAULT_WRITE_BATCH_SIZE),
+    _readers("MBTiles Driver Readers(OE)"),
+    _connectionsMutex("MBTiles Driver Connections(OE)")
 {
     //nop
 }
 
 Driver::~Driver()
 {
+    close();
+}
+
+void
+MBTiles::Driver::close()
+{
+    Threading::ScopedWriteLock closeLock(_connectionsMutex);
+
+    {
+        Threading::ScopedMutexLock lock(_readers);
+        for (auto& i : _readers)
+        {
+            Connection& conn = i.second;
+            if (conn._selectTile)
+                sqlite3_finalize((sqlite3_stmt*)conn._selectTile);
+            if (conn._database)
+                sqlite3_close_v2((sqlite3*)conn._database);
+        }
+    }
+    _readers.clear();
+
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
+
+    commit();
+
+    if (_selectTile)
+        sqlite3_finalize((sqlite3_stmt*)_selectTile);
+    _selectTile = NULL;
+
+    if (_insertTile)
+        sqlite3_finalize((sqlite3_stmt*)_insertTile);
+    _insertTile = NULL;
+
     sqlite3* database = (sqlite3*)_database;
     if (database)
         sqlite3_close_v2(database);
+    _database = NULL;
 }
 
 Status
@@ -362,6 +458,8 @@ MBTiles::Driver::open(
     }
 
     bool readWrite = isWritingRequested;
+    _readWrite = readWrite;
+    _filename = fullFilename;
 
     bool isNewDatabase = readWrite && !osgDB::fileExists(fullFilename);
 
@@ -618,13 +716,36 @@ MBTiles::Driver::readMaxLevel()
     return result;
 }
 
+MBTiles::Driver::Connection&
+MBTiles::Driver::getReadConnection() const
+{
+    // One connection per thread, opened on first use. Each is only ever
+    // used by its own thread, so SQLITE_OPEN_NOMUTEX is safe here.
+    Connection& conn = _readers.get();
+    if (conn._database == NULL)
+    {
+        sqlite3* database = NULL;
+        int rc = sqlite3_open_v2(_filename.c_str(), &database, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, 0L);
+        if (rc != SQLITE_OK)
+        {
+            OE_WARN << LC << "Failed to open read connection: " << sqlite3_errmsg(database) << std::endl;
+            sqlite3_close_v2(database);
+        }
+        else
+        {
+            conn._database = database;
+        }
+    }
+    return conn;
+}
+
 ReadResult
 MBTiles::Driver::read(
     const TileKey& key,
     ProgressCallback* progress,
     const osgDB::Options* readOptions) const
 {
-    Threading::ScopedMutexLock exclusiveLock(_mutex);
+    OE_PROFILING_ZONE;
 
     int z = key.getLevelOfDetail();
     int x = key.getTileX();
@@ -645,69 +766,81 @@ MBTiles::Driver::read(
     key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
     y  = numRows - y - 1;
 
-    sqlite3* database = (sqlite3*)_database;
-
     //Get the image
-    sqlite3_stmt* select = NULL;
-    std::string query = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
-    int rc = sqlite3_prepare_v2( database, query.c_str(), -1, &select, 0L );
-    if ( rc != SQLITE_OK )
-    {
-        OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(database) << std::endl;
-        return ReadResult::RESULT_READER_ERROR;
-    }
+    std::string dataBuffer;
+    int rc;
 
-    bool valid = true;
-
-    sqlite3_bind_int( select, 1, z );
-    sqlite3_bind_int( select, 2, x );
-    sqlite3_bind_int( select, 3, y );
-
-    osg::Image* result = NULL;
-    rc = sqlite3_step( select );
-    if ( rc == SQLITE_ROW)
     {
-        // the pointer returned from _blob gets freed internally by sqlite, supposedly
-        const char* data = (const char*)sqlite3_column_blob( select, 0 );
-        int dataLen = sqlite3_column_bytes( select, 0 );
+        Threading::ScopedReadLock sharedLock(_connectionsMutex);
 
-        std::string dataBuffer( data, dataLen );
+        // closed:
+        if (_database == NULL)
+            return ReadResult::RESULT_READER_ERROR;
 
-        // decompress if necessary:
-        if ( _compressor.valid() )
+        if (_readWrite)
         {
-            std::istringstream inputStream(dataBuffer);
-            std::string value;
-            if ( !_compressor->decompress(inputStream, value) )
-            {
-                OE_WARN << LC << "Decompression failed" << std::endl;
-                valid = false;
-            }
-            else
+            // a writable database reads through its own connection so that
+            // it sees tiles written in the current (uncommitted) batch
+            Threading::ScopedMutexLock exclusiveLock(_mutex);
+            rc = selectTile((sqlite3*)_database, _selectTile, z, x, y, dataBuffer);
+            if (rc != SQLITE_ROW && rc != SQLITE_DONE)
             {
-                dataBuffer = value;
+                OE_WARN << LC << "Failed to query tile: " << sqlite3_errmsg((sqlite3*)_database) << std::endl;
+                return ReadResult::RESULT_READER_ERROR;
             }
         }
-
-        // decode the raw image data:
-        if ( valid )
+        else
         {
-            std::istringstream inputStream(dataBuffer);
-            result = ImageUtils::readStream(inputStream, _dbOptions.get());
-            // If we couldn't load the image automatically try the reader instead.
-            if (!result && _rw.valid())
+            Connection& conn = getReadConnection();
+            if (conn._database == NULL)
+                return ReadResult::RESULT_READER_ERROR;
+
+            rc = selectTile((sqlite3*)conn._database, conn._selectTile, z, x, y, dataBuffer);
+            if (rc != SQLITE_ROW && rc != SQLITE_DONE)
             {
-                result = _rw->readImage(inputStream, _dbOptions.get()).takeImage();
+                OE_WARN << LC << "Failed to query tile: " << sqlite3_errmsg((sqlite3*)conn._database) << std::endl;
+                return ReadResult::RESULT_READER_ERROR;
             }
         }
     }
-    else
+
+    if (rc != SQLITE_ROW)
     {
-        OE_DEBUG << LC << "SQL QUERY failed for " << query << ": " << std::endl;
-        valid = false;
+        OE_DEBUG << LC << "SQL QUERY failed for " << SELECT_TILE_SQL << ": " << std::endl;
+        return ReadResult::RESULT_NOT_FOUND;
     }
 
-    sqlite3_finalize( select );
+    // decode outside of any lock:
+    bool valid = true;
+    osg::Image* result = NULL;
+
+    // decompress if necessary:
+    if ( _compressor.valid() )
+    {
+        std::istringstream inputStream(dataBuffer);
+        std::string value;
+        if ( !_compressor->decompress(inputStream, value) )
+        {
+            OE_WARN << LC << "Decompression failed" << std::endl;
+            valid = false;
+        }
+        else
+        {
+            dataBuffer = value;
+        }
+    }
+
+    // decode the raw image data:
+    if ( valid )
+    {
+        std::istringstream inputStream(dataBuffer);
+        result = ImageUtils::readStream(inputStream, _dbOptions.get());
+        // If we couldn't load the image automatically try the reader instead.
+        if (!result && _rw.valid())
+        {
+            result = _rw->readImage(inputStream, _dbOptions.get()).takeImage();
+        }
+    }
 
     return ReadResult(result);
 }
@@ -722,7 +855,7 @@ MBTiles::Driver::write(
     if (!key.valid() || !image)
         return Status::AssertionFailure;
 
-    Threading::ScopedMutexLock exclusiveLock(_mutex);
+    OE_PROFILING_ZONE;
 
     // encode the data stream:
     std::stringstream buf;
@@ -765,16 +898,37 @@ MBTiles::Driver::write(
     key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
     y = numRows - y - 1;
 
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
+
     sqlite3* database = (sqlite3*)_database;
 
-    // Prep the insert statement:
-    sqlite3_stmt* insert = NULL;
-    std::string query = "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
-    int rc = sqlite3_prepare_v2(database, query.c_str(), -1, &insert, 0L);
-    if (rc != SQLITE_OK)
+    // Prep the insert statement once and reuse it:
+    sqlite3_stmt* insert = (sqlite3_stmt*)_insertTile;
+    int rc;
+    if (insert == NULL)
     {
-        return Status(Status::GeneralError, Stringify()
-            << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(database));
+        rc = sqlite3_prepare_v2(database, INSERT_TILE_SQL, -1, &insert, 0L);
+        if (rc != SQLITE_OK)
+        {
+            return Status(Status::GeneralError, Stringify()
+                << "Failed to prepare SQL: " << INSERT_TILE_SQL << "; " << sqlite3_errmsg(database));
+        }
+        _insertTile = insert;
+    }
+
+    // Group writes into transactions; committing every tile costs a
+    // journal sync per tile.
+    if (!_transactionOpen)
+    {
+        char* errorMsg = 0L;
+        if (SQLITE_OK != sqlite3_exec(database, "BEGIN TRANSACTION", 0L, 0L, &errorMsg))
+        {
+            Status status(Status::GeneralError, Stringify()
+                << "Failed to begin transaction: " << (errorMsg ? errorMsg : sqlite3_errmsg(database)));
+            sqlite3_free(errorMsg);
+            return status;
+        }
+        _transactionOpen = true;
     }
 
     // bind parameters:
@@ -786,23 +940,33 @@ MBTiles::Driver::write(
     sqlite3_bind_blob(insert, 4, value.c_str(), value.length(), SQLITE_STATIC);
 
     // run the sql.
-    bool ok = true;
     int tries = 0;
     do {
         rc = sqlite3_step(insert);
     } while (++tries < 100 && (rc == SQLITE_BUSY || rc == SQLITE_LOCKED));
 
+    sqlite3_reset(insert);
+
     if (SQLITE_OK != rc && SQLITE_DONE != rc)
     {
+        // some errors make sqlite roll the whole transaction back:
+        if (sqlite3_get_autocommit(database) != 0)
+        {
+            _transactionOpen = false;
+            _pendingWrites = 0u;
+        }
+
 #if SQLITE_VERSION_NUMBER >= 3007015
-        return Status(Status::GeneralError, Stringify()<<"Failed query: " << query << "(" << rc << ")" << sqlite3_errstr(rc) << "; " << sqlite3_errmsg(database));
+        return Status(Status::GeneralError, Stringify()<<"Failed query: " << INSERT_TILE_SQL << "(" << rc << ")" << sqlite3_errstr(rc) << "; " << sqlite3_errmsg(database));
 #else
-        return Status(Status::GeneralError, Stringify()<< "Failed query: " << query << "(" << rc << ")" << rc << "; " << sqlite3_errmsg(database));
+        return Status(Status::GeneralError, Stringify()<< "Failed query: " << INSERT_TILE_SQL << "(" << rc << ")" << rc << "; " << sqlite3_errmsg(database));
 #endif
-        ok = false;
     }
 
-    sqlite3_finalize(insert);
+    if (++_pendingWrites >= _writeBatchSize)
+    {
+        commit();
+    }
 
     // adjust the max level if necessary
     if (key.getLOD() > _maxLevel)
@@ -819,6 +983,36 @@ MBTiles::Driver::write(
     return Status::NoError;
 }
 
+void
+MBTiles::Driver::flush()
+{
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
+    commit();
+}
+
+void
+MBTiles::Driver::commit()
+{
+    // called with _mutex held
+    if (_transactionOpen && _database != NULL)
+    {
+        sqlite3* database = (sqlite3*)_database;
+        char* errorMsg = 0L;
+        if (SQLITE_OK != sqlite3_exec(database, "COMMIT TRANSACTION", 0L, 0L, &errorMsg))
+        {
+            OE_WARN << LC << "Failed to commit " << _pendingWrites << " tiles: " << (errorMsg ? errorMsg : "") << std::endl;
+            sqlite3_free(errorMsg);
+
+            // a busy database leaves the transaction open, to retry
+            // on the next commit:
+            if (sqlite3_get_autocommit(database) == 0)
+                return;
+        }
+        _transactionOpen = false;
+        _pendingWrites = 0u;
+    }
+}
+
 bool
 MBTiles::Driver::getMetaData(const std::string& key, std::string& value)
 {
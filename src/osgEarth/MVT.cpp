@@ -24,11 +24,17 @@
 #include <osgEarth/FileUtils>
 #include <osgEarth/GeoData>
 #include <osgEarth/FeatureSource>
+#include <osgEarth/Endian>
 #include <osgDB/Registry>
-#include <list>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <stdio.h>
 #include <stdlib.h>
-#include "vector_tile.pb.h"
+
+#ifdef OSGEARTH_HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 #ifdef OSGEARTH_HAVE_SQLITE3
 #include <sqlite3.h>
@@ -46,14 +52,6 @@ using namespace osgEarth::MVT;
 
 namespace osgEarth { namespace MVT
 {
-    // https://github.com/mapbox/mapnik-vector-tile/blob/master/examples/c%2B%2B/tileinfo.cpp
-    enum CommandType {
-        SEG_END    = 0,
-        SEG_MOVETO = 1,
-        SEG_LINETO = 2,
-        SEG_CLOSE = (0x40 | 0x0f)
-    };
-
     enum eGeomType {
         Unknown = 0,
         Point = 1,
@@ -61,133 +59,429 @@ namespace osgEarth { namespace MVT
         Polygon = 3
     };
 
-    int zig_zag_decode(int n)
-    {
-        return (n >> 1) ^ (-(n & 1));
-    }
+    // Field numbers from vector_tile.proto
+    enum {
+        TILE_LAYERS = 3,
+
+        LAYER_NAME = 1,
+        LAYER_FEATURES = 2,
+        LAYER_KEYS = 3,
+        LAYER_VALUES = 4,
+        LAYER_EXTENT = 5,
+
+        FEATURE_TAGS = 2,
+        FEATURE_TYPE = 3,
+        FEATURE_GEOMETRY = 4,
+
+        VALUE_STRING = 1,
+        VALUE_FLOAT = 2,
+        VALUE_DOUBLE = 3,
+        VALUE_INT = 4,
+        VALUE_UINT = 5,
+        VALUE_SINT = 6,
+        VALUE_BOOL = 7
+    };
 
-    Geometry* decodeLine(const mapnik::vector::tile_feature& feature, const TileKey& key, unsigned int tileres)
+    /**
+     * Walks a protocol buffers message in place, one field at a time,
+     * without building any message objects. Length-delimited fields come
+     * back as readers over the same memory.
+     * https://developers.google.com/protocol-buffers/docs/encoding
+     */
+    class PbfReader
     {
-        unsigned int length = 0;
-        int cmd = -1;
-        const int cmd_bits = 3;
+    public:
+        enum WireType {
+            VARINT = 0,
+            FIXED64 = 1,
+            BYTES = 2,
+            FIXED32 = 5
+        };
+
+        PbfReader() :
+            _ptr(nullptr), _end(nullptr), _ok(true), _field(0u), _type(0u) { }
+
+        PbfReader(const unsigned char* data, std::size_t length) :
+            _ptr(data), _end(data + length), _ok(true), _field(0u), _type(0u) { }
+
+        //! Moves to the next field. False at the end of the message or on error.
+        bool next()
+        {
+            if (!more())
+                return false;
+
+            std::uint64_t key = varint();
+            _field = (unsigned)(key >> 3);
+            _type = (unsigned)(key & 0x7);
+            if (_field == 0u)
+                fail();
+            return _ok;
+        }
 
-        int x = 0;
-        int y = 0;
+        //! Field number and wire type of the current field
+        unsigned field() const { return _field; }
+        unsigned type() const { return _type; }
+
+        //! Whether there is more data to read (e.g. in a packed field)
+        bool more() const { return _ok && _ptr < _end; }
+
+        //! False if the data was malformed
+        bool ok() const { return _ok; }
 
-        std::vector< osg::ref_ptr< osgEarth::LineString > > lines;
-        osg::ref_ptr< osgEarth::LineString > currentLine;
+        const char* data() const { return _ptr ? (const char*)_ptr : ""; }
+        std::size_t size() const { return _end - _ptr; }
 
-        for (int k = 0; k < feature.geometry_size();)
+        std::uint64_t varint()
         {
-            if (!length)
+            std::uint64_t value = 0u;
+            for (unsigned shift = 0u; shift < 64u && _ptr < _end; shift += 7u)
             {
-                unsigned int cmd_length = feature.geometry(k++);
-                cmd = cmd_length & ((1 << cmd_bits) - 1);
-                length = cmd_length >> cmd_bits;
+                unsigned char byte = *_ptr++;
+                value |= (std::uint64_t)(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0)
+                    return value;
             }
-            if (length > 0)
-            {
-                length--;
+            fail();
+            return 0u;
+        }
 
-                if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
-                {
-                    if (cmd == SEG_MOVETO)
-                    {
-                        currentLine = new osgEarth::LineString;
-                        lines.push_back( currentLine.get() );
-                    }
-                    int px = feature.geometry(k++);
-                    int py = feature.geometry(k++);
-                    px = zig_zag_decode(px);
-                    py = zig_zag_decode(py);
+        std::int64_t svarint()
+        {
+            std::uint64_t n = varint();
+            return (std::int64_t)(n >> 1) ^ -(std::int64_t)(n & 1);
+        }
 
-                    x += px;
-                    y += py;
+        float fixed32()
+        {
+            std::uint32_t bits = 0u;
+            if (advance(4u, &bits))
+                bits = le32toh(bits);
+            float value;
+            ::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
 
-                    double width = key.getExtent().width();
-                    double height = key.getExtent().height();
+        double fixed64()
+        {
+            std::uint64_t bits = 0u;
+            if (advance(8u, &bits))
+                bits = le64toh(bits);
+            double value;
+            ::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
 
-                    double geoX = key.getExtent().xMin() + (width/(double)tileres) * (double)x;
-                    double geoY = key.getExtent().yMax() - (height/(double)tileres) * (double)y;
+        //! Length-delimited field (string, bytes, sub-message or packed array)
+        PbfReader bytes()
+        {
+            std::uint64_t length = varint();
+            if (!_ok || length > (std::uint64_t)(_end - _ptr))
+            {
+                fail();
+                return PbfReader();
+            }
+            PbfReader result(_ptr, (std::size_t)length);
+            _ptr += length;
+            return result;
+        }
 
-                    if (currentLine.valid())
-                    {
-                        currentLine->push_back(geoX, geoY, 0);
-                    }
-                }
+        //! Skips over the current field
+        void skip()
+        {
+            switch (_type)
+            {
+            case VARINT: varint(); break;
+            case FIXED64: advance(8u, nullptr); break;
+            case BYTES: bytes(); break;
+            case FIXED32: advance(4u, nullptr); break;
+            default: fail();
             }
         }
 
-        currentLine = 0;
+    private:
+        const unsigned char* _ptr;
+        const unsigned char* _end;
+        bool _ok;
+        unsigned _field;
+        unsigned _type;
 
-        if (lines.size() == 0)
+        bool advance(std::size_t n, void* out)
         {
-            return 0;
+            if ((std::size_t)(_end - _ptr) < n)
+            {
+                fail();
+                return false;
+            }
+            if (out)
+                ::memcpy(out, _ptr, n);
+            _ptr += n;
+            return true;
         }
-        else if (lines.size() == 1)
+
+        void fail()
         {
-            // Just return a simple LineString
-            return lines[0].release();
+            _ok = false;
+            _ptr = _end;
         }
-        else
+    };
+
+    // How a layer's key is used when decoding attributes
+    enum {
+        KEY_KEEP = 1 << 0,  // set as a feature attribute
+        KEY_HEIGHT = 1 << 1 // "other_tags" string that may carry a height
+    };
+
+    /**
+     * Working memory for decoding tiles. There is one per thread, and
+     * all of it keeps its capacity from tile to tile.
+     */
+    struct Scratch
+    {
+        std::vector<unsigned char> inflated;
+        std::string layerName;
+        std::string lowerCaseKey;
+        std::string string;
+        std::vector<PbfReader> features;
+        std::vector<PbfReader> keys;
+        std::vector<PbfReader> values;
+        std::vector<std::string> keyNames;
+        std::vector<unsigned char> keyFlags;
+        std::vector<osg::Vec3d> coords;
+        std::vector<unsigned> parts;
+
+#ifdef OSGEARTH_HAVE_ZLIB
+        z_stream zs;
+        bool zsValid;
+
+        Scratch() : zsValid(false) { }
+        ~Scratch() { if (zsValid) inflateEnd(&zs); }
+#endif
+    };
+
+    // Maps tile coordinates to the tile's extent
+    struct TileTransform
+    {
+        double xMin, yMax, xScale, yScale;
+
+        TileTransform(const TileKey& key, unsigned tileres)
         {
-            // Return a multilinestring
-            MultiGeometry* multi = new MultiGeometry;
-            for (unsigned int i = 0; i < lines.size(); i++)
-            {
-                multi->add(lines[i].get());
-            }
-            return multi;
+            const GeoExtent& extent = key.getExtent();
+            double res = tileres > 0u ? (double)tileres : 4096.0;
+            xMin = extent.xMin();
+            yMax = extent.yMax();
+            xScale = extent.width() / res;
+            yScale = extent.height() / res;
+        }
+
+        osg::Vec3d operator()(int x, int y) const
+        {
+            return osg::Vec3d(xMin + xScale * (double)x, yMax - yScale * (double)y, 0.0);
+        }
+    };
+
+    bool isCompressed(const unsigned char* data, std::size_t length)
+    {
+        if (length < 2)
+            return false;
+
+        // gzip
+        if (data[0] == 0x1f && data[1] == 0x8b)
+            return true;
+
+        // zlib (deflate, with header checksum)
+        return (data[0] & 0x0f) == 8 && ((data[0] << 8) | data[1]) % 31 == 0;
+    }
+
+    // Inflates a zlib or gzip buffer into scratch.inflated. "length" gets
+    // the number of bytes inflated.
+    bool inflate(const unsigned char* data, std::size_t size, Scratch& scratch, std::size_t& length)
+    {
+        std::vector<unsigned char>& out = scratch.inflated;
+
+#ifdef OSGEARTH_HAVE_ZLIB
+        z_stream& zs = scratch.zs;
+        if (!scratch.zsValid)
+        {
+            ::memset(&zs, 0, sizeof(zs));
+            // 15+32: detect the zlib or gzip header automatically
+            if (inflateInit2(&zs, 15 + 32) != Z_OK)
+                return false;
+            scratch.zsValid = true;
+        }
+        else if (inflateReset(&zs) != Z_OK)
+        {
+            return false;
+        }
+
+        if (out.size() < size * 4u)
+            out.resize(std::max(size * 4u, (std::size_t)65536u));
+
+        zs.next_in = const_cast<Bytef*>(data);
+        zs.avail_in = (uInt)size;
+
+        length = 0u;
+        int rc = Z_OK;
+        do
+        {
+            if (length == out.size())
+                out.resize(out.size() * 2u);
+
+            zs.next_out = out.data() + length;
+            zs.avail_out = (uInt)(out.size() - length);
+            rc = ::inflate(&zs, Z_NO_FLUSH);
+            length = out.size() - zs.avail_out;
         }
+        while (rc == Z_OK || (rc == Z_BUF_ERROR && zs.avail_out == 0u));
+
+        return rc == Z_STREAM_END;
+
+#else
+        osg::ref_ptr< osgDB::BaseCompressor> compressor = osgDB::Registry::instance()->getObjectWrapperManager()->findCompressor("zlib");
+        if (!compressor.valid())
+            return false;
+
+        std::stringstream in(std::string((const char*)data, size));
+        if (!compressor->decompress(in, scratch.string))
+            return false;
+
+        if (out.size() < scratch.string.size())
+            out.resize(scratch.string.size());
+        ::memcpy(out.data(), scratch.string.data(), scratch.string.size());
+        length = scratch.string.size();
+        return true;
+#endif
     }
 
-    Geometry* decodePoint(const mapnik::vector::tile_feature& feature, const TileKey& key, unsigned int tileres)
+    //! Signed area of a ring (positive when counter-clockwise)
+    double getSignedArea(const osg::Vec3d* ring, unsigned size)
     {
-        unsigned int length = 0;
-        int cmd = -1;
-        const int cmd_bits = 3;
+        double sum = 0.0;
+        for (unsigned i = 0, j = size - 1; i < size; j = i++)
+        {
+            sum += ring[j].x() * ring[i].y() - ring[i].x() * ring[j].y();
+        }
+        return 0.5 * sum;
+    }
+
+    // Decodes the geometry command stream of a feature into scratch.coords.
+    // scratch.parts gets a [begin, end) pair for each part: each MoveTo
+    // starts a new line, and each ClosePath ends a polygon ring.
+    // https://github.com/mapbox/vector-tile-spec/tree/master/2.1#43-geometry-encoding
+    void decodeCommands(PbfReader geometry, eGeomType type, const TileTransform& xform, Scratch& scratch)
+    {
+        std::vector<osg::Vec3d>& coords = scratch.coords;
+        std::vector<unsigned>& parts = scratch.parts;
+        coords.clear();
+        parts.clear();
+
+        // every parameter pair is at least two bytes
+        coords.reserve(geometry.size() / 2u);
 
         int x = 0;
         int y = 0;
+        bool open = false;
 
-        osgEarth::PointSet *geometry = new osgEarth::PointSet();
-
-        for (int k = 0; k < feature.geometry_size();)
+        while (geometry.more())
         {
-            if (!length)
+            unsigned cmd_length = (unsigned)geometry.varint();
+            unsigned cmd = cmd_length & ((1 << CMD_BITS) - 1);
+            unsigned length = cmd_length >> CMD_BITS;
+
+            if (cmd == CMD_MOVETO || cmd == CMD_LINETO)
             {
-                unsigned int cmd_length = feature.geometry(k++);
-                cmd = cmd_length & ((1 << cmd_bits) - 1);
-                length = cmd_length >> cmd_bits;
+                for (; length > 0u && geometry.more(); --length)
+                {
+                    x += (int)geometry.svarint();
+                    y += (int)geometry.svarint();
+
+                    if (type == Point)
+                    {
+                        coords.push_back(xform(x, y));
+                    }
+                    else if (type == Polygon)
+                    {
+                        if (!open)
+                        {
+                            parts.push_back((unsigned)coords.size());
+                            open = true;
+                        }
+                        coords.push_back(xform(x, y));
+                    }
+                    else
+                    {
+                        if (cmd == CMD_MOVETO)
+                        {
+                            if (open)
+                                parts.push_back((unsigned)coords.size());
+                            parts.push_back((unsigned)coords.size());
+                            open = true;
+                        }
+
+                        // points before the first MoveTo belong to no line
+                        if (open)
+                            coords.push_back(xform(x, y));
+                    }
+                }
             }
-            if (length > 0)
+            else if (cmd == CMD_CLOSEPATH)
             {
-                length--;
-                if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
+                if (type == Polygon && open)
                 {
-                    int px = feature.geometry(k++);
-                    int py = feature.geometry(k++);
-                    px = zig_zag_decode(px);
-                    py = zig_zag_decode(py);
+                    parts.push_back((unsigned)coords.size());
+                    open = false;
+                }
+            }
+        }
 
-                    x += px;
-                    y += py;
+        // a line ends with the data, but a ring must be closed
+        if (open && type != Polygon)
+            parts.push_back((unsigned)coords.size());
+    }
 
-                    double width = key.getExtent().width();
-                    double height = key.getExtent().height();
+    Geometry* decodePoint(PbfReader geometry, const TileTransform& xform, Scratch& scratch)
+    {
+        decodeCommands(geometry, Point, xform, scratch);
+        if (scratch.coords.empty())
+            return nullptr;
 
-                    double geoX = key.getExtent().xMin() + (width/(double)tileres) * (double)x;
-                    double geoY = key.getExtent().yMax() - (height/(double)tileres) * (double)y;
-                    geometry->push_back(geoX, geoY, 0);
-                }
+        osgEarth::PointSet* pointSet = new osgEarth::PointSet();
+        pointSet->assign(scratch.coords.begin(), scratch.coords.end());
+        return pointSet;
+    }
+
+    Geometry* decodeLine(PbfReader geometry, const TileTransform& xform, Scratch& scratch)
+    {
+        decodeCommands(geometry, LineString, xform, scratch);
+
+        const std::vector<osg::Vec3d>& coords = scratch.coords;
+        const std::vector<unsigned>& parts = scratch.parts;
+
+        if (parts.empty())
+        {
+            return nullptr;
+        }
+        else if (parts.size() == 2)
+        {
+            // Just return a simple LineString
+            osgEarth::LineString* line = new osgEarth::LineString();
+            line->assign(coords.begin() + parts[0], coords.begin() + parts[1]);
+            return line;
+        }
+        else
+        {
+            // Return a multilinestring
+            MultiGeometry* multi = new MultiGeometry();
+            for (unsigned i = 0; i < parts.size(); i += 2)
+            {
+                osgEarth::LineString* line = new osgEarth::LineString();
+                line->assign(coords.begin() + parts[i], coords.begin() + parts[i + 1]);
+                multi->add(line);
             }
+            return multi;
         }
-
-        return geometry;
     }
 
-    Geometry* decodePolygon(const mapnik::vector::tile_feature& feature, const  TileKey& key, unsigned int tileres)
+    Geometry* decodePolygon(PbfReader geometry, const TileTransform& xform, Scratch& scratch)
     {
         /*
          https://github.com/mapbox/vector-tile-spec/tree/master/2.1
@@ -196,99 +490,59 @@ namespace osgEarth { namespace MVT
          The rings are in sequence and you must check the orientation of the ring to know if it's an exterior ring (new polygon) or an
          interior ring (inner polygon of the current polygon).
          */
+        decodeCommands(geometry, Polygon, xform, scratch);
 
-
-        unsigned int length = 0;
-        int cmd = -1;
-        const int cmd_bits = 3;
-
-        int x = 0;
-        int y = 0;
+        const std::vector<osg::Vec3d>& coords = scratch.coords;
+        const std::vector<unsigned>& parts = scratch.parts;
 
         // The list of polygons we've collected
         std::vector< osg::ref_ptr< osgEarth::Polygon > > polygons;
 
-        osg::ref_ptr< osgEarth::Polygon > currentPolygon;
+        osgEarth::Polygon* currentPolygon = nullptr;
 
-        osg::ref_ptr< osgEarth::Ring > currentRing;
-
-        for (int k = 0; k < feature.geometry_size();)
+        for (unsigned i = 0; i < parts.size(); i += 2)
         {
-            if (!length)
+            unsigned begin = parts[i];
+            unsigned size = parts[i + 1] - begin;
+            if (size < 3)
+                continue;
+
+            // The orientation is the opposite of what we want for features. Clockwise (in
+            // map coordinates) means exterior ring, counter clockwise means interior.
+            double area = getSignedArea(&coords[begin], size);
+
+            // Clockwise means exterior ring.  Start a new polygon and add the ring.
+            if (area < 0.0)
             {
-                unsigned int cmd_length = feature.geometry(k++);
-                cmd = cmd_length & ((1 << cmd_bits) - 1);
-                length = cmd_length >> cmd_bits;
+                currentPolygon = new osgEarth::Polygon(size);
+                currentPolygon->assign(coords.begin() + begin, coords.begin() + begin + size);
+
+                // osgearth orientations are reversed from mvt
+                currentPolygon->rewind(Geometry::ORIENTATION_CCW);
+                polygons.push_back(currentPolygon);
             }
-            if (length > 0)
+
+            // Counter clockwise means a hole, add it to the existing polygon.
+            else if (area > 0.0)
             {
-                length--;
-                if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
+                if (currentPolygon)
                 {
-                    if (!currentRing)
-                    {
-                        currentRing = new osgEarth::Ring();
-                    }
-
-                    int px = feature.geometry(k++);
-                    int py = feature.geometry(k++);
-                    px = zig_zag_decode(px);
-                    py = zig_zag_decode(py);
-
-                    x += px;
-                    y += py;
+                    osgEarth::Ring* ring = new osgEarth::Ring(size);
+                    ring->assign(coords.begin() + begin, coords.begin() + begin + size);
 
-                    double width = key.getExtent().width();
-                    double height = key.getExtent().height();
-
-                    double geoX = key.getExtent().xMin() + (width/(double)tileres) * (double)x;
-                    double geoY = key.getExtent().yMax() - (height/(double)tileres) * (double)y;
-                    currentRing->push_back(geoX, geoY, 0);
+                    // osgearth orientations are reversed from mvt
+                    ring->rewind(Geometry::ORIENTATION_CW);
+                    currentPolygon->getHoles().push_back(ring);
                 }
-                else if (cmd == (SEG_CLOSE & ((1 << cmd_bits) - 1)))
+                else
                 {
-                    // The orientation is the opposite of what we want for features.  clockwise means exterior ring, counter clockwise means interior
-
-                    // Figure out what to do with the ring based on the orientation of the ring
-                    Geometry::Orientation orientation = currentRing->getOrientation();
-                    // Close the ring.
-                    currentRing->close();
-
-                    // Clockwise means exterior ring.  Start a new polygon and add the ring.
-                    if (orientation == Geometry::ORIENTATION_CW)
-                    {
-                        // osgearth orientations are reversed from mvt
-                        currentRing->rewind(Geometry::ORIENTATION_CCW);
-
-                        currentPolygon = new osgEarth::Polygon(&currentRing->asVector());
-                        polygons.push_back(currentPolygon.get());
-                    }
-                    else if (orientation == Geometry::ORIENTATION_CCW)
-                    // Counter clockwise means a hole, add it to the existing polygon.
-                    {
-                        if (currentPolygon.valid())
-                        {
-                            // osgearth orientations are reversed from mvt
-                            currentRing->rewind(Geometry::ORIENTATION_CW);
-                            currentPolygon->getHoles().push_back( currentRing );
-                        }
-                        else
-                        {
-                            // this means we encountered a "hole" without a parent outer ring,
-                            // discard for now -gw
-                            OE_INFO << LC << "Discarding improperly wound polygon (hole without an outer ring)\n";
-                        }
-                    }
-
-                    // Start a new ring
-                    currentRing = 0;
+                    // this means we encountered a "hole" without a parent outer ring,
+                    // discard for now -gw
+                    OE_INFO << LC << "Discarding improperly wound polygon (hole without an outer ring)\n";
                 }
             }
         }
 
-        currentRing = 0;
-        currentPolygon = 0;
-
         if (polygons.size() == 0)
         {
             return 0;
@@ -310,154 +564,297 @@ namespace osgEarth { namespace MVT
         }
     }
 
-    bool readTile(std::istream& in, const TileKey& key, FeatureList& features)
+    // Special path for getting heights from our test dataset.
+    void setHeightFromOtherTags(const std::string& other_tags, Feature* feature)
     {
-        features.clear();
+        StringTokenizer tok("=>");
+        StringVector tized;
+        tok.tokenize(other_tags, tized);
+        if (tized.size() == 3)
+        {
+            if (tized[0] == "height")
+            {
+                std::string value = tized[2];
+                // Remove quotes from the height
+                float height = as<float>(value, FLT_MAX);
+                if (height != FLT_MAX)
+                {
+                    feature->set("height", height);
+                }
+            }
+        }
+    }
 
-        // Get the compressor
-        osg::ref_ptr< osgDB::BaseCompressor> compressor = osgDB::Registry::instance()->getObjectWrapperManager()->findCompressor("zlib");
-        if (!compressor.valid())
+    void readValue(PbfReader value, const std::string& key, unsigned flags, Feature* feature, Scratch& scratch)
+    {
+        bool keep = (flags & KEY_KEEP) != 0;
+
+        while (value.next())
         {
-            return false;
+            unsigned type = value.type();
+
+            if (value.field() == VALUE_STRING && type == PbfReader::BYTES)
+            {
+                PbfReader str = value.bytes();
+                scratch.string.assign(str.data(), str.size());
+                if (keep)
+                    feature->set(key, scratch.string);
+                if (flags & KEY_HEIGHT)
+                    setHeightFromOtherTags(scratch.string, feature);
+            }
+            else if (value.field() == VALUE_FLOAT && type == PbfReader::FIXED32)
+            {
+                float f = value.fixed32();
+                if (keep)
+                    feature->set(key, f);
+            }
+            else if (value.field() == VALUE_DOUBLE && type == PbfReader::FIXED64)
+            {
+                double d = value.fixed64();
+                if (keep)
+                    feature->set(key, d);
+            }
+            else if ((value.field() == VALUE_INT || value.field() == VALUE_UINT) && type == PbfReader::VARINT)
+            {
+                long long n = (long long)value.varint();
+                if (keep)
+                    feature->set(key, n);
+            }
+            else if (value.field() == VALUE_SINT && type == PbfReader::VARINT)
+            {
+                long long n = (long long)value.svarint();
+                if (keep)
+                    feature->set(key, n);
+            }
+            else if (value.field() == VALUE_BOOL && type == PbfReader::VARINT)
+            {
+                bool b = value.varint() != 0u;
+                if (keep)
+                    feature->set(key, b);
+            }
+            else
+            {
+                value.skip();
+            }
         }
+    }
+
+    bool readLayer(
+        PbfReader layer,
+        const TileKey& key,
+        const ReadOptions* options,
+        Scratch& scratch,
+        FeatureList& features)
+    {
+        PbfReader name;
+        unsigned extent = 4096u;
 
-        // Decompress the tile
-        std::string original((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-        in.seekg (0, std::ios::beg);
-        std::string value;
-        if (!compressor->decompress(in, value))
+        scratch.features.clear();
+        scratch.keys.clear();
+        scratch.values.clear();
+
+        // Index the layer first; features refer to keys and values by number.
+        while (layer.next())
         {
-            value = original;
+            unsigned field = layer.field();
+            bool bytes = layer.type() == PbfReader::BYTES;
+
+            if (field == LAYER_NAME && bytes)
+                name = layer.bytes();
+            else if (field == LAYER_FEATURES && bytes)
+                scratch.features.push_back(layer.bytes());
+            else if (field == LAYER_KEYS && bytes)
+                scratch.keys.push_back(layer.bytes());
+            else if (field == LAYER_VALUES && bytes)
+                scratch.values.push_back(layer.bytes());
+            else if (field == LAYER_EXTENT && layer.type() == PbfReader::VARINT)
+                extent = (unsigned)layer.varint();
+            else
+                layer.skip();
         }
 
+        if (!layer.ok())
+            return false;
+
+        std::string& layerName = scratch.layerName;
+        layerName.assign(name.data(), name.size());
+
+        if (options && !options->layers.empty() && options->layers.count(layerName) == 0)
+            return true;
+
+        const std::unordered_set<std::string>* attributes =
+            options && !options->attributes.empty() ? &options->attributes : nullptr;
 
-        mapnik::vector::tile tile;
+        bool wantHeight = attributes == nullptr || attributes->count("height") > 0;
 
-        if (tile.ParseFromString(value))
+        // Decide once per layer which keys to decode:
+        unsigned numKeys = scratch.keys.size();
+        unsigned numValues = scratch.values.size();
+
+        if (scratch.keyNames.size() < numKeys)
+            scratch.keyNames.resize(numKeys);
+        scratch.keyFlags.assign(numKeys, 0);
+
+        for (unsigned i = 0; i < numKeys; ++i)
         {
-            for (int i = 0; i < tile.layers().size(); i++)
-            {
-                const mapnik::vector::tile_layer &layer = tile.layers().Get(i);
+            std::string& keyName = scratch.keyNames[i];
+            keyName.assign(scratch.keys[i].data(), scratch.keys[i].size());
 
-                for (int j = 0; j < layer.features().size(); j++)
-                {
-                    const mapnik::vector::tile_feature &feature = layer.features().Get(j);
+            unsigned char flags = 0;
+            if (attributes)
+            {
+                std::string& lower = scratch.lowerCaseKey;
+                lower = keyName;
+                for (auto& c : lower)
+                    c = ::tolower(c);
+                if (attributes->count(lower) > 0)
+                    flags |= KEY_KEEP;
+            }
+            else
+            {
+                flags |= KEY_KEEP;
+            }
 
-                    osg::ref_ptr< Feature > oeFeature = new Feature(0, key.getProfile()->getSRS());
+            if (wantHeight && keyName == "other_tags")
+                flags |= KEY_HEIGHT;
 
-                    // Set the layer name as "mvt_layer" so we can filter it later
-                    oeFeature->set("mvt_layer", layer.name());
+            scratch.keyFlags[i] = flags;
+        }
 
-                    // Read attributes
-                    for (int k = 0; k < feature.tags().size(); k+=2)
-                    {
-                        std::string key = layer.keys().Get(feature.tags().Get(k));
-                        mapnik::vector::tile_value value = layer.values().Get(feature.tags().Get(k+1));
+        TileTransform xform(key, extent);
+        const SpatialReference* srs = key.getProfile()->getSRS();
 
-                        if (value.has_bool_value())
-                        {
-                            oeFeature->set(key, value.bool_value());
-                        }
-                        else if (value.has_double_value())
-                        {
-                            oeFeature->set(key, value.double_value());
-                        }
-                        else if (value.has_float_value())
-                        {
-                            oeFeature->set(key, value.float_value());
-                        }
-                        else if (value.has_int_value())
-                        {
-                            oeFeature->set(key, (long long)value.int_value());
-                        }
-                        else if (value.has_sint_value())
-                        {
-                            oeFeature->set(key, (long long)value.sint_value());
-                        }
-                        else if (value.has_string_value())
-                        {
-                            oeFeature->set(key, value.string_value());
-                        }
-                        else if (value.has_uint_value())
-                        {
-                            oeFeature->set(key, (long long)value.uint_value());
-                        }
+        for (PbfReader& feature : scratch.features)
+        {
+            PbfReader tags;
+            PbfReader geometry;
+            eGeomType geomType = Unknown;
 
-                        // Special path for getting heights from our test dataset.
-                        if (key == "other_tags")
-                        {
-                            std::string other_tags = value.string_value();
-
-                            StringTokenizer tok("=>");
-                            StringVector tized;
-                            tok.tokenize(other_tags, tized);
-                            if (tized.size() == 3)
-                            {
-                                if (tized[0] == "height")
-                                {
-                                    std::string value = tized[2];
-                                    // Remove quotes from the height
-                                    float height = as<float>(value, FLT_MAX);
-                                    if (height != FLT_MAX)
-                                    {
-                                        oeFeature->set("height", height);
-                                    }
-                                }
-                            }
-                        }
-                    }
+            while (feature.next())
+            {
+                unsigned field = feature.field();
+                bool bytes = feature.type() == PbfReader::BYTES;
+
+                if (field == FEATURE_TAGS && bytes)
+                    tags = feature.bytes();
+                else if (field == FEATURE_TYPE && feature.type() == PbfReader::VARINT)
+                    geomType = static_cast<eGeomType>(feature.varint());
+                else if (field == FEATURE_GEOMETRY && bytes)
+                    geometry = feature.bytes();
+                else
+                    feature.skip();
+            }
 
+            if (!feature.ok())
+                return false;
 
+            // Decode the geometry first, since a feature without one is dropped.
+            osg::ref_ptr< osgEarth::Geometry > oeGeometry;
 
-                    osg::ref_ptr< osgEarth::Geometry > geometry;
+            if (geomType == Polygon)
+            {
+                oeGeometry = decodePolygon(geometry, xform, scratch);
+            }
+            else if (geomType == Point)
+            {
+                oeGeometry = decodePoint(geometry, xform, scratch);
 
-                    eGeomType geomType = static_cast<eGeomType>(feature.type());
-                    if (geomType == MVT::Polygon)
-                    {
-                        geometry = decodePolygon(feature, key, layer.extent());
-                    }
-                    else if (geomType == MVT::LineString)
+                // This is a bit of a hack, but if a point is outside of the extents we remove it.
+                // Lines and Polygons that extend outside of the tileset we keep though b/c we assume that they are just slightly going outside of the
+                // extent.  Should probably make this an option somewhere.
+                if (oeGeometry.valid())
+                {
+                    if (!key.getExtent().contains(oeGeometry->getBounds().center()))
                     {
-                        geometry = decodeLine(feature, key, layer.extent());
+                        oeGeometry = NULL;
                     }
-                    else if (geomType == MVT::Point)
-                    {
-                        geometry = decodePoint(feature, key, layer.extent());
+                }
+            }
+            else
+            {
+                oeGeometry = decodeLine(geometry, xform, scratch);
+            }
 
-                        // This is a bit of a hack, but if a point is outside of the extents we remove it.
-                        // Lines and Polygons that extend outside of the tileset we keep though b/c we assume that they are just slightly going outside of the
-                        // extent.  Should probably make this an option somewhere.
-                        if (geometry)
-                        {
-                            if (!key.getExtent().contains(geometry->getBounds().center()))
-                            {
-                                geometry = NULL;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        geometry = decodeLine(feature, key, layer.extent());
-                    }
+            if (!oeGeometry.valid())
+                continue;
 
-                    if (geometry)
-                    {
-                        oeFeature->setGeometry( geometry.get() );
-                        features.push_back(oeFeature.get());
-                    }
+            osg::ref_ptr< Feature > oeFeature = new Feature(oeGeometry.get(), srs);
+
+            // Set the layer name as "mvt_layer" so we can filter it later
+            oeFeature->set("mvt_layer", layerName);
 
+            // Read attributes
+            while (tags.more())
+            {
+                unsigned k = (unsigned)tags.varint();
+                unsigned v = (unsigned)tags.varint();
+                if (!tags.ok() || k >= numKeys || v >= numValues)
+                    break;
+
+                unsigned flags = scratch.keyFlags[k];
+                if (flags != 0)
+                {
+                    readValue(scratch.values[v], scratch.keyNames[k], flags, oeFeature.get(), scratch);
                 }
             }
+
+            features.push_back(oeFeature.get());
         }
-        else
+
+        return true;
+    }
+
+    bool readTile(const char* data, std::size_t length, const TileKey& key, FeatureList& features, const ReadOptions* options)
+    {
+        features.clear();
+
+        static thread_local Scratch scratch;
+
+        const unsigned char* buffer = (const unsigned char*)data;
+        std::size_t size = length;
+
+        // Inflate the tile; if that fails, try reading it as is.
+        if (isCompressed(buffer, length))
+        {
+            std::size_t inflated = 0u;
+            if (inflate(buffer, length, scratch, inflated))
+            {
+                buffer = scratch.inflated.data();
+                size = inflated;
+            }
+        }
+
+        PbfReader tile(buffer, size);
+        bool ok = true;
+
+        while (ok && tile.next())
+        {
+            if (tile.field() == TILE_LAYERS && tile.type() == PbfReader::BYTES)
+            {
+                ok = readLayer(tile.bytes(), key, options, scratch, features);
+            }
+            else
+            {
+                tile.skip();
+            }
+        }
+
+        if (!ok || !tile.ok())
         {
-            OE_WARN << "Failed to parse mvt" << key.str() << std::endl;
+            OE_WARN << LC << "Failed to parse mvt " << key.str() << std::endl;
+            features.clear();
             return false;
         }
 
         return true;
     }
 
+    bool readTile(std::istream& in, const TileKey& key, FeatureList& features)
+    {
+        std::string buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        return readTile(buffer.data(), buffer.size(), key, features, nullptr);
+    }
+
 }} // namespace osgEarth::MVT
 
 //........................................................................
@@ -467,6 +864,8 @@ MVTFeatureSourceOptions::getConfig() const
 {
     Config conf = FeatureSource::Options::getConfig();
     conf.set("url", url());
+    conf.set("layers", layers());
+    conf.set("attributes", attributes());
     return conf;
 }
 
@@ -474,6 +873,8 @@ void
 MVTFeatureSourceOptions::fromConfig(const Config& conf)
 {
     conf.get("url", url());
+    conf.get("layers", layers());
+    conf.get("attributes", attributes());
 }
 
 //........................................................................
@@ -481,6 +882,8 @@ MVTFeatureSourceOptions::fromConfig(const Config& conf)
 REGISTER_OSGEARTH_LAYER(mvtfeatures, MVTFeatureSource);
 
 OE_LAYER_PROPERTY_IMPL(MVTFeatureSource, URI, URL, url);
+OE_LAYER_PROPERTY_IMPL(MVTFeatureSource, std::string, Layers, layers);
+OE_LAYER_PROPERTY_IMPL(MVTFeatureSource, std::string, Attributes, attributes);
 
 
 Status
@@ -501,6 +904,29 @@ MVTFeatureSource::openImplementation()
 
     setFeatureProfile(createFeatureProfile());
 
+    // Only decode the layers and attributes we were asked for:
+    _readOptions = MVT::ReadOptions();
+
+    StringTokenizer tok(", ", "");
+    tok.keepEmpties() = false;
+    StringVector names;
+
+    if (options().layers().isSet())
+    {
+        tok.tokenize(options().layers().get(), names);
+        _readOptions.layers.insert(names.begin(), names.end());
+    }
+
+    if (options().attributes().isSet())
+    {
+        tok.tokenize(options().attributes().get(), names);
+        for (auto& name : names)
+            _readOptions.attributes.insert(toLower(name));
+
+        if (!_readOptions.attributes.empty() && options().fidAttribute().isSet())
+            _readOptions.attributes.insert(toLower(options().fidAttribute().get()));
+    }
+
     return Status::NoError;
 }
 
@@ -512,12 +938,6 @@ MVTFeatureSource::init()
     _minLevel = 0u;
     _maxLevel = 14u;
     _database = 0L;
-
-    _compressor = osgDB::Registry::instance()->getObjectWrapperManager()->findCompressor("zlib");
-    if (!_compressor.valid())
-    {
-        OE_WARN << LC << "Failed to get zlib compressor" << std::endl;
-    }
 }
 
 FeatureCursor*
@@ -565,9 +985,7 @@ MVTFeatureSource::createFeatureCursorImplementation(const Query& query, Progress
         // the pointer returned from _blob gets freed internally by sqlite, supposedly
         const char* data = (const char*)sqlite3_column_blob(select, 0);
         int dataLen = sqlite3_column_bytes(select, 0);
-        std::string dataBuffer(data, dataLen);
-        std::stringstream in(dataBuffer);
-        MVT::readTile(in, key, features);
+        MVT::readTile(data, dataLen, key, features, &_readOptions);
     }
     else
     {
@@ -655,10 +1073,9 @@ MVTFeatureSource::iterateTiles(int zoomLevel, int limit, int offset, const GeoEx
         // the pointer returned from _blob gets freed internally by sqlite, supposedly
         const char* data = (const char*)sqlite3_column_blob(select, 3);
         int dataLen = sqlite3_column_bytes(select, 3);
-        std::string dataBuffer(data, dataLen);
-        std::stringstream in(dataBuffer);
 
         FeatureList features;
+        MVT::readTile(data, dataLen, key, features, &_readOptions);
 
         // If we have any features and we have an fid attribute, override the fid of the features
         if (options().fidAttribute().isSet())
@@ -672,9 +1089,6 @@ MVTFeatureSource::iterateTiles(int zoomLevel, int limit, int offset, const GeoEx
             }
         }
 
-
-        MVT::readTile(in, key, features);
-
         // apply filters before returning.
         applyFilters(features, key.getExtent());
 
@@ -17,6 +17,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarth/MemCache>
+#include <osg/Image>
+#include <osg/Shape>
+#include <unordered_map>
+#include <atomic>
+#include <cfloat>
+#include <cstdlib>
 
 using namespace osgEarth;
 
@@ -128,8 +134,392 @@ namespace
 
 //------------------------------------------------------------------------
 
+namespace
+{
+    // Relative cost of re-creating an object after eviction. Elevation
+    // usually takes a fetch, a decode, and a resample/composite; imagery
+    // is typically a fetch and a decode.
+    const double COST_HEIGHTFIELD = 4.0;
+    const double COST_IMAGE       = 1.0;
+    const double COST_OTHER       = 1.0;
+
+    size_t getSizeInBytes(const osg::Object* object)
+    {
+        const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+        if (image)
+            return sizeof(osg::Image) + image->getTotalSizeInBytesIncludingMipmaps();
+
+        const osg::HeightField* hf = dynamic_cast<const osg::HeightField*>(object);
+        if (hf)
+            return sizeof(osg::HeightField) + hf->getNumColumns()*hf->getNumRows()*sizeof(float);
+
+        const StringObject* str = dynamic_cast<const StringObject*>(object);
+        if (str)
+            return sizeof(StringObject) + str->getString().size();
+
+        return 1024u;
+    }
+
+    double getCost(const osg::Object* object)
+    {
+        if (dynamic_cast<const osg::HeightField*>(object))
+            return COST_HEIGHTFIELD;
+        if (dynamic_cast<const osg::Image*>(object))
+            return COST_IMAGE;
+        return COST_OTHER;
+    }
+
+    /**
+     * Process-wide store shared by every bin of every budgeted MemCache.
+     * Keys are spread across shards so concurrent readers rarely contend.
+     *
+     * Eviction is GreedyDual-Size: each entry carries a priority
+     * H = L + cost/size that is refreshed on every hit. The entry with the
+     * lowest H is evicted first and L rises to that H, which ages every
+     * entry that has not been touched since.
+     */
+    class BudgetedStore
+    {
+    public:
+        enum { NUM_SHARDS = 16 };
+
+        BudgetedStore() :
+            _budget(0u),
+            _bytes(0u),
+            _inflation(0.0),
+            _sequence(0u),
+            _nextBinUID(0u),
+            _hits(0u),
+            _misses(0u),
+            _evictions(0u)
+        {
+            const char* env = ::getenv("OSGEARTH_L2_CACHE_BUDGET_MB");
+            if (env)
+            {
+                _budget = (size_t)as<unsigned>(std::string(env), 0u) * 1048576u;
+                OE_INFO << LC << "L2 cache budget set from environment = " << env << " MB" << std::endl;
+            }
+        }
+
+        unsigned newBinUID()
+        {
+            return _nextBinUID++;
+        }
+
+        bool get(unsigned bin, const std::string& name, osg::ref_ptr<const osg::Object>& object, Config& meta)
+        {
+            Key key(bin, name);
+            Shard& shard = getShard(key);
+            {
+                Threading::ScopedMutexLock lock(shard._mutex);
+                auto i = shard._entries.find(key);
+                if (i != shard._entries.end())
+                {
+                    Entry& entry = i->second;
+                    shard._queue.erase(entry._rank);
+                    entry._rank = rank(entry);
+                    shard._queue[entry._rank] = key;
+                    object = entry._object;
+                    meta = entry._meta;
+                    ++_hits;
+                    return true;
+                }
+            }
+            ++_misses;
+            return false;
+        }
+
+        bool has(unsigned bin, const std::string& name)
+        {
+            Key key(bin, name);
+            Shard& shard = getShard(key);
+            Threading::ScopedMutexLock lock(shard._mutex);
+            return shard._entries.find(key) != shard._entries.end();
+        }
+
+        void put(unsigned bin, const std::string& name, const osg::Object* object, const Config& meta)
+        {
+            Key key(bin, name);
+            Shard& shard = getShard(key);
+            osg::ref_ptr<const osg::Object> replaced;
+            {
+                Threading::ScopedMutexLock lock(shard._mutex);
+                Entry& entry = shard._entries[key];
+                if (entry._object.valid())
+                {
+                    shard._queue.erase(entry._rank);
+                    _bytes -= entry._bytes;
+                    replaced = entry._object;
+                }
+                entry._object = object;
+                entry._meta = meta;
+                entry._bytes = getSizeInBytes(object);
+                entry._cost = getCost(object);
+                entry._rank = rank(entry);
+                shard._queue[entry._rank] = key;
+                _bytes += entry._bytes;
+            }
+            evictToBudget();
+        }
+
+        void remove(unsigned bin, const std::string& name)
+        {
+            Key key(bin, name);
+            Shard& shard = getShard(key);
+            osg::ref_ptr<const osg::Object> removed;
+            Threading::ScopedMutexLock lock(shard._mutex);
+            auto i = shard._entries.find(key);
+            if (i != shard._entries.end())
+            {
+                removed = i->second._object;
+                shard._queue.erase(i->second._rank);
+                _bytes -= i->second._bytes;
+                shard._entries.erase(i);
+            }
+        }
+
+        void purge(unsigned bin)
+        {
+            for (unsigned s = 0; s < NUM_SHARDS; ++s)
+            {
+                Shard& shard = _shards[s];
+                Threading::ScopedMutexLock lock(shard._mutex);
+                for (auto i = shard._entries.begin(); i != shard._entries.end(); )
+                {
+                    if (i->first._bin == bin)
+                    {
+                        shard._queue.erase(i->second._rank);
+                        _bytes -= i->second._bytes;
+                        i = shard._entries.erase(i);
+                    }
+                    else ++i;
+                }
+            }
+        }
+
+        void setBudget(size_t bytes)
+        {
+            _budget = bytes;
+            evictToBudget();
+        }
+
+        size_t getBudget() const
+        {
+            return _budget;
+        }
+
+        MemCache::Stats getStats()
+        {
+            MemCache::Stats stats;
+            stats.entries = 0u;
+            for (unsigned s = 0; s < NUM_SHARDS; ++s)
+            {
+                Threading::ScopedMutexLock lock(_shards[s]._mutex);
+                stats.entries += _shards[s]._entries.size();
+            }
+            stats.bytes = _bytes;
+            stats.budget = _budget;
+            stats.hits = _hits;
+            stats.misses = _misses;
+            stats.evictions = _evictions;
+            return stats;
+        }
+
+    private:
+        struct Key
+        {
+            Key() : _bin(0u) { }
+            Key(unsigned bin, const std::string& name) : _bin(bin), _name(name) { }
+            bool operator == (const Key& rhs) const {
+                return _bin == rhs._bin && _name == rhs._name;
+            }
+            unsigned _bin;
+            std::string _name;
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const {
+                return std::hash<std::string>()(key._name) ^ ((size_t)key._bin * 0x9e3779b9u);
+            }
+        };
+
+        // priority first; the sequence number keeps ranks unique
+        typedef std::pair<double, unsigned long long> Rank;
+
+        struct Entry
+        {
+            Entry() : _bytes(0u), _cost(0.0) { }
+            osg::ref_ptr<const osg::Object> _object;
+            Config _meta;
+            size_t _bytes;
+            double _cost;
+            Rank _rank;
+        };
+
+        struct Shard
+        {
+            Threading::Mutex _mutex;
+            std::unordered_map<Key, Entry, KeyHash> _entries;
+            std::map<Rank, Key> _queue;
+        };
+
+        Shard& getShard(const Key& key)
+        {
+            return _shards[KeyHash()(key) % NUM_SHARDS];
+        }
+
+        Rank rank(const Entry& entry)
+        {
+            // scale to cost per MB to keep the numbers readable
+            double h = _inflation + entry._cost * 1048576.0 / (double)std::max(entry._bytes, (size_t)1u);
+            return Rank(h, _sequence++);
+        }
+
+        void evictToBudget()
+        {
+            while (_bytes > _budget)
+            {
+                // locate the shard holding the lowest-priority entry:
+                int victim = -1;
+                double lowest = DBL_MAX;
+                for (unsigned s = 0; s < NUM_SHARDS; ++s)
+                {
+                    Threading::ScopedMutexLock lock(_shards[s]._mutex);
+                    if (!_shards[s]._queue.empty() &&
+                        _shards[s]._queue.begin()->first.first < lowest)
+                    {
+                        lowest = _shards[s]._queue.begin()->first.first;
+                        victim = s;
+                    }
+                }
+
+                if (victim < 0)
+                    break;
+
+                // release the object outside the lock
+                osg::ref_ptr<const osg::Object> doomed;
+                {
+                    Shard& shard = _shards[victim];
+                    Threading::ScopedMutexLock lock(shard._mutex);
+                    if (shard._queue.empty())
+                        continue;
+
+                    auto q = shard._queue.begin();
+                    auto e = shard._entries.find(q->second);
+                    double h = q->first.first;
+                    doomed = e->second._object;
+                    _bytes -= e->second._bytes;
+                    shard._entries.erase(e);
+                    shard._queue.erase(q);
+                    ++_evictions;
+
+                    double L = _inflation;
+                    while (h > L && !_inflation.compare_exchange_weak(L, h));
+                }
+            }
+        }
+
+        Shard _shards[NUM_SHARDS];
+        std::atomic<size_t> _budget;
+        std::atomic<size_t> _bytes;
+        std::atomic<double> _inflation;
+        std::atomic<unsigned long long> _sequence;
+        std::atomic<unsigned> _nextBinUID;
+        std::atomic<unsigned long long> _hits;
+        std::atomic<unsigned long long> _misses;
+        std::atomic<unsigned long long> _evictions;
+    };
+
+    // Intentionally leaked: bins may be released during static destruction.
+    BudgetedStore& getBudgetedStore()
+    {
+        static BudgetedStore* s_store = new BudgetedStore();
+        return *s_store;
+    }
+
+    struct BudgetedMemCacheBin : public CacheBin
+    {
+        BudgetedMemCacheBin(const std::string& id) :
+            CacheBin(id, true),
+            _store(getBudgetedStore()),
+            _uid(_store.newBinUID())
+        {
+            //nop
+        }
+
+        virtual ~BudgetedMemCacheBin()
+        {
+            _store.purge(_uid);
+        }
+
+        ReadResult readObject(const std::string& key, const osgDB::Options*)
+        {
+            osg::ref_ptr<const osg::Object> object;
+            Config meta;
+            if (_store.get(_uid, key, object, meta))
+                return ReadResult(const_cast<osg::Object*>(object.get()), meta);
+            else
+                return ReadResult();
+        }
+
+        ReadResult readImage(const std::string& key, const osgDB::Options* readOptions)
+        {
+            return readObject(key, readOptions);
+        }
+
+        ReadResult readString(const std::string& key, const osgDB::Options* readOptions)
+        {
+            return readObject(key, readOptions);
+        }
+
+        bool write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options*)
+        {
+            if (!object)
+                return false;
+            _store.put(_uid, key, object, meta);
+            return true;
+        }
+
+        bool remove(const std::string& key)
+        {
+            _store.remove(_uid, key);
+            return true;
+        }
+
+        bool touch(const std::string& key)
+        {
+            osg::ref_ptr<const osg::Object> dummy;
+            Config meta;
+            return _store.get(_uid, key, dummy, meta);
+        }
+
+        RecordStatus getRecordStatus(const std::string& key)
+        {
+            return _store.has(_uid, key) ? STATUS_OK : STATUS_NOT_FOUND;
+        }
+
+        bool purge()
+        {
+            _store.purge(_uid);
+            return true;
+        }
+
+        std::string getHashedKey(const std::string& key) const
+        {
+            return key;
+        }
+
+        BudgetedStore& _store;
+        unsigned _uid;
+    };
+}
+
+//------------------------------------------------------------------------
+
 MemCache::MemCache( unsigned maxBinSize ) :
-_maxBinSize( osg::maximum(maxBinSize, 1u) )
+_maxBinSize( osg::maximum(maxBinSize, 1u) ),
+_budgeted( getBudgetedStore().getBudget() > 0u )
 {
     //nop
 }
@@ -137,7 +527,10 @@ _maxBinSize( osg::maximum(maxBinSize, 1u) )
 CacheBin*
 MemCache::addBin( const std::string& binID )
 {
-    return _bins.getOrCreate( binID, new MemCacheBin(binID, _maxBinSize) );
+    if (_budgeted)
+        return _bins.getOrCreate( binID, new BudgetedMemCacheBin(binID) );
+    else
+        return _bins.getOrCreate( binID, new MemCacheBin(binID, _maxBinSize) );
 }
 
 CacheBin*
@@ -158,7 +551,10 @@ MemCache::getOrCreateDefaultBin()
         // double check
         if ( !_defaultBin.valid() )
         {
-            _defaultBin = new MemCacheBin("__default", _maxBinSize);
+            if (_budgeted)
+                _defaultBin = new BudgetedMemCacheBin("__default");
+            else
+                _defaultBin = new MemCacheBin("__default", _maxBinSize);
         }
     }
 
@@ -169,7 +565,36 @@ MemCache::getOrCreateDefaultBin()
 void
 MemCache::dumpStats(const std::string& binID)
 {
+    if (_budgeted)
+    {
+        Stats stats = getGlobalStats();
+        double queries = (double)(stats.hits + stats.misses);
+        OE_INFO << LC << "hit ratio = " << (queries > 0.0 ? (double)stats.hits / queries : 0.0)
+            << ", bytes = " << stats.bytes << "/" << stats.budget
+            << ", entries = " << stats.entries
+            << ", evictions = " << stats.evictions << std::endl;
+        return;
+    }
+
     MemCacheBin* bin = static_cast<MemCacheBin*>(getBin(binID));
     CacheStats stats = bin->_lru.getStats();
     OE_INFO << LC << "hit ratio = " << stats._hitRatio << std::endl;
 }
+
+void
+MemCache::setGlobalBudget(size_t bytes)
+{
+    getBudgetedStore().setBudget(bytes);
+}
+
+size_t
+MemCache::getGlobalBudget()
+{
+    return getBudgetedStore().getBudget();
+}
+
+MemCache::Stats
+MemCache::getGlobalStats()
+{
+    return getBudgetedStore().getStats();
+}
@@ -28,6 +28,8 @@
 #include <gdal.h>
 #include <queue>
 #include <list>
+#include <algorithm>
+#include <thread>
 
 #define LC "[OGRFeatureSource] "
 
@@ -84,6 +86,116 @@ namespace osgEarth { namespace OGR
 
 //........................................................................
 
+OGR::HandlePool::HandlePool(
+    const std::string& source,
+    const std::string& driver,
+    const std::string& layer,
+    unsigned maxIdle) :
+
+    _source(source),
+    _driver(driver),
+    _layer(layer),
+    _maxIdle(maxIdle),
+    _closed(false)
+{
+    _mutex.setName("OE.OGRFeatureSource.handles");
+}
+
+OGR::HandlePool::~HandlePool()
+{
+    close();
+}
+
+bool
+OGR::HandlePool::acquire(Handles& out)
+{
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        if (_closed)
+            return false;
+
+        if (!_idle.empty())
+        {
+            out = _idle.back();
+            _idle.pop_back();
+            return true;
+        }
+    }
+
+    // Open outside the lock; opening a GeoPackage or a database
+    // connection can take a while.
+    const char* driverList[2] = {
+        _driver.c_str(),
+        nullptr
+    };
+
+    out.ds = GDALOpenEx(
+        _source.c_str(),
+        GDAL_OF_VECTOR | GDAL_OF_READONLY,
+        _driver.empty() ? nullptr : driverList,
+        nullptr,
+        nullptr);
+
+    out.layer = out.ds ? openLayer(out.ds, _layer) : nullptr;
+
+    if (!out.layer)
+    {
+        destroy(out);
+        out = Handles();
+        return false;
+    }
+
+    return true;
+}
+
+void
+OGR::HandlePool::release(const Handles& handles)
+{
+    if (!handles.ds)
+        return;
+
+    // leave the layer the way the next cursor expects to find it
+    if (handles.layer)
+    {
+        OGR_L_SetSpatialFilter(handles.layer, nullptr);
+        OGR_L_ResetReading(handles.layer);
+    }
+
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        if (!_closed && _idle.size() < _maxIdle)
+        {
+            _idle.push_back(handles);
+            return;
+        }
+    }
+
+    destroy(handles);
+}
+
+void
+OGR::HandlePool::close()
+{
+    std::vector<Handles> idle;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        _closed = true;
+        idle.swap(_idle);
+    }
+
+    for (auto& handles : idle)
+        destroy(handles);
+}
+
+void
+OGR::HandlePool::destroy(const Handles& handles)
+{
+    if (handles.ds)
+        OGRReleaseDataSource(handles.ds);
+}
+
+//........................................................................
+
 OGR::OGRFeatureCursor::OGRFeatureCursor(
     OGRDataSourceH dsHandle,
     OGRLayerH layerHandle,
@@ -93,7 +205,8 @@ OGR::OGRFeatureCursor::OGRFeatureCursor(
     const FeatureFilterChain* filters,
     bool rewindPolygons,
     unsigned chunkSize,
-    ProgressCallback* progress) :
+    ProgressCallback* progress,
+    HandlePool* pool) :
 
 FeatureCursor     ( progress ),
 _source           ( source ),
@@ -107,6 +220,7 @@ _nextHandleToQueue( 0L ),
 _resultSetEndReached(false),
 _profile          ( profile ),
 _filters          ( filters ),
+_pool             ( pool ),
 _rewindPolygons   ( rewindPolygons )
 {
     std::string expr;
@@ -230,8 +344,17 @@ OGR::OGRFeatureCursor::~OGRFeatureCursor()
     if ( _spatialFilter )
         OGR_G_DestroyGeometry( _spatialFilter );
 
-    if ( _dsHandle )
+    if ( _pool.valid() )
+    {
+        HandlePool::Handles handles;
+        handles.ds = _dsHandle;
+        handles.layer = _layerHandle;
+        _pool->release( handles );
+    }
+    else if ( _dsHandle )
+    {
         OGRReleaseDataSource( _dsHandle );
+    }
 }
 
 bool
@@ -424,6 +547,12 @@ OGRFeatureSource::closeImplementation()
         _layerHandle = 0L;
     }
 
+    if (_handlePool.valid())
+    {
+        _handlePool->close();
+        _handlePool = nullptr;
+    }
+
     if (_dsHandle)
     {
         OGRReleaseDataSource(_dsHandle);
@@ -631,6 +760,13 @@ OGRFeatureSource::openImplementation()
         //Get the feature count
         _featureCount = OGR_L_GetFeatureCount(_layerHandle, 1);
 
+        // Cursors borrow their read handles from a pool, so concurrent queries
+        // each get a dataset of their own without reopening the source every
+        // time. A writable source keeps no idle handles, so a query always
+        // sees the latest edits.
+        unsigned maxIdle = _writable ? 0u : std::max(2u, std::thread::hardware_concurrency());
+        _handlePool = new OGR::HandlePool(_source, driverName, options().layer().get(), maxIdle);
+
         // establish the feature schema:
         initSchema();
 
@@ -785,6 +921,9 @@ OGRFeatureSource::create(const FeatureProfile* profile,
 
     _geometryType = geometryType;
 
+    // reads always reopen the new datasource, so they see what's been written
+    _handlePool = new OGR::HandlePool(_source, driverName, options().layer().get(), 0u);
+
     setStatus(Status::NoError);
     return getStatus();
 }
@@ -818,31 +957,11 @@ OGRFeatureSource::createFeatureCursorImplementation(const Query& query, Progress
     }
     else
     {
-        OGRDataSourceH dsHandle = 0L;
-        OGRLayerH layerHandle = 0L;
-
-        const char* openOptions[2] = {
-            "OGR_GPKG_INTEGRITY_CHECK=NO",
-            nullptr
-        };
-
-        dsHandle = GDALOpenEx(
-            _source.c_str(),
-            GDAL_OF_VECTOR | GDAL_OF_READONLY,
-            nullptr,
-            nullptr, //openOptions,
-            nullptr);
-
-        // open the handles safely:
         // Each cursor requires its own DS handle so that multi-threaded access will work.
-        // The cursor impl will dispose of the new DS handle.
-        //dsHandle = OGROpenShared(_source.c_str(), 0, &_ogrDriverHandle);
-        if (dsHandle)
-        {
-            layerHandle = OGR::openLayer(dsHandle, options().layer().get());
-        }
+        // The cursor borrows one from the pool and gives it back when it's done.
+        OGR::HandlePool::Handles handles;
 
-        if (dsHandle && layerHandle)
+        if (_handlePool.valid() && _handlePool->acquire(handles))
         {
             Query newQuery(query);
             if (options().query().isSet())
@@ -854,24 +973,20 @@ OGRFeatureSource::createFeatureCursorImplementation(const Query& query, Progress
 
             // cursor is responsible for the OGR handles.
             return new OGR::OGRFeatureCursor(
-                dsHandle,
-                layerHandle,
+                handles.ds,
+                handles.layer,
                 this,
                 getFeatureProfile(),
                 newQuery,
                 getFilters(),
                 _options->rewindPolygons().get(),
                 0, // default chunksize
-                progress
+                progress,
+                _handlePool.get()
                 );
         }
         else
         {
-            if (dsHandle)
-            {
-                OGRReleaseDataSource(dsHandle);
-            }
-
             return 0L;
         }
     }
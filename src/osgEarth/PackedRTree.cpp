@@ -0,0 +1,324 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarth/PackedRTree>
+#include <osg/Math>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <ostream>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    // Serialized layout, in native byte order:
+    // Header, then Box[numNodes], then uint32[numNodes]
+    struct Header
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t numItems;
+        std::uint32_t nodeSize;
+        std::uint32_t numNodes;
+        std::uint32_t reserved;
+    };
+
+    const char MAGIC[4] = { 'O', 'E', 'P', 'R' };
+    const std::uint32_t VERSION = 1u;
+
+    // Position of (x, y) along a Hilbert curve filling a 65536x65536 grid
+    inline std::uint32_t hilbert(std::uint32_t x, std::uint32_t y)
+    {
+        const std::uint32_t n = 1u << 16;
+        std::uint32_t d = 0u;
+        for (std::uint32_t s = n >> 1; s > 0u; s >>= 1)
+        {
+            std::uint32_t rx = (x & s) ? 1u : 0u;
+            std::uint32_t ry = (y & s) ? 1u : 0u;
+            d += s * s * ((3u * rx) ^ ry);
+            if (ry == 0u)
+            {
+                if (rx == 1u)
+                {
+                    x = n - 1u - x;
+                    y = n - 1u - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+
+    inline bool intersects(const PackedRTree::Box& a, const PackedRTree::Box& b)
+    {
+        return a.xmin <= b.xmax && a.xmax >= b.xmin && a.ymin <= b.ymax && a.ymax >= b.ymin;
+    }
+}
+
+PackedRTree::PackedRTree() :
+    _numItems(0u),
+    _nodeSize(16u),
+    _numNodes(0u),
+    _boxes(nullptr),
+    _indices(nullptr)
+{
+}
+
+void
+PackedRTree::reset()
+{
+    _numItems = 0u;
+    _numNodes = 0u;
+    _levelBounds.clear();
+    _boxes = nullptr;
+    _indices = nullptr;
+    _itemPositions.clear();
+    _ownedBoxes.clear();
+    _ownedIndices.clear();
+}
+
+void
+PackedRTree::computeLevels()
+{
+    _levelBounds.clear();
+    _numNodes = 0u;
+    if (_numItems == 0u)
+        return;
+
+    unsigned count = _numItems;
+    _numNodes = count;
+    _levelBounds.push_back(_numNodes);
+    do
+    {
+        count = (count + _nodeSize - 1u) / _nodeSize;
+        _numNodes += count;
+        _levelBounds.push_back(_numNodes);
+    }
+    while (count > 1u);
+}
+
+void
+PackedRTree::build(const std::vector<Box>& boxes, unsigned nodeSize)
+{
+    _numItems = boxes.size();
+    _nodeSize = osg::clampBetween(nodeSize, 2u, 65535u);
+    computeLevels();
+
+    _ownedBoxes.resize(_numNodes);
+    _ownedIndices.resize(_numNodes);
+    _boxes = _ownedBoxes.data();
+    _indices = _ownedIndices.data();
+    _itemPositions.resize(_numItems);
+
+    if (_numItems == 0u)
+        return;
+
+    Box bounds = boxes[0];
+    for (auto& box : boxes)
+    {
+        bounds.xmin = std::min(bounds.xmin, box.xmin);
+        bounds.ymin = std::min(bounds.ymin, box.ymin);
+        bounds.xmax = std::max(bounds.xmax, box.xmax);
+        bounds.ymax = std::max(bounds.ymax, box.ymax);
+    }
+
+    // sort the items by the Hilbert value of their centers
+    double width = bounds.xmax - bounds.xmin;
+    double height = bounds.ymax - bounds.ymin;
+    double sx = width > 0.0 ? 65535.0 / width : 0.0;
+    double sy = height > 0.0 ? 65535.0 / height : 0.0;
+
+    std::vector<std::pair<std::uint32_t, std::uint32_t> > order(_numItems);
+    for (unsigned i = 0; i < _numItems; ++i)
+    {
+        const Box& box = boxes[i];
+        std::uint32_t x = (std::uint32_t)(sx * (0.5*(box.xmin + box.xmax) - bounds.xmin));
+        std::uint32_t y = (std::uint32_t)(sy * (0.5*(box.ymin + box.ymax) - bounds.ymin));
+        order[i] = std::make_pair(hilbert(x, y), (std::uint32_t)i);
+    }
+    std::sort(order.begin(), order.end());
+
+    for (unsigned i = 0; i < _numItems; ++i)
+    {
+        _ownedBoxes[i] = boxes[order[i].second];
+        _ownedIndices[i] = order[i].second;
+        _itemPositions[order[i].second] = i;
+    }
+
+    // pack each level into the next one up
+    unsigned pos = 0u;
+    unsigned parent = _numItems;
+    for (unsigned level = 0; level + 1 < _levelBounds.size(); ++level)
+    {
+        unsigned end = _levelBounds[level];
+        while (pos < end)
+        {
+            Box node = _ownedBoxes[pos];
+            unsigned first = pos;
+            unsigned last = std::min(pos + _nodeSize, end);
+            for (++pos; pos < last; ++pos)
+            {
+                const Box& child = _ownedBoxes[pos];
+                node.xmin = std::min(node.xmin, child.xmin);
+                node.ymin = std::min(node.ymin, child.ymin);
+                node.xmax = std::max(node.xmax, child.xmax);
+                node.ymax = std::max(node.ymax, child.ymax);
+            }
+            _ownedBoxes[parent] = node;
+            _ownedIndices[parent] = first;
+            ++parent;
+        }
+    }
+}
+
+bool
+PackedRTree::attach(const void* data, std::size_t size)
+{
+    reset();
+
+    if (data == nullptr || size < sizeof(Header) || (reinterpret_cast<std::uintptr_t>(data) & 7u) != 0u)
+        return false;
+
+    Header header;
+    ::memcpy(&header, data, sizeof(Header));
+    if (::memcmp(header.magic, MAGIC, 4) != 0 ||
+        header.version != VERSION ||
+        header.nodeSize < 2u)
+    {
+        return false;
+    }
+
+    _numItems = header.numItems;
+    _nodeSize = header.nodeSize;
+    computeLevels();
+    if (_numNodes != header.numNodes ||
+        size < sizeof(Header) + (std::size_t)_numNodes * (sizeof(Box) + sizeof(std::uint32_t)))
+    {
+        reset();
+        return false;
+    }
+
+    const char* bytes = static_cast<const char*>(data);
+    _boxes = reinterpret_cast<const Box*>(bytes + sizeof(Header));
+    _indices = reinterpret_cast<const std::uint32_t*>(bytes + sizeof(Header) + _numNodes * sizeof(Box));
+
+    // validate the indices so a damaged file can't send a search out of bounds:
+    // leaves must hold each item once, and other nodes must point into the level below.
+    const std::uint32_t unset = std::numeric_limits<std::uint32_t>::max();
+    _itemPositions.assign(_numItems, unset);
+    for (unsigned i = 0; i < _numItems; ++i)
+    {
+        if (_indices[i] >= _numItems || _itemPositions[_indices[i]] != unset)
+        {
+            reset();
+            return false;
+        }
+        _itemPositions[_indices[i]] = i;
+    }
+    for (unsigned level = 1; level < _levelBounds.size(); ++level)
+    {
+        unsigned childBegin = level > 1 ? _levelBounds[level - 2] : 0u;
+        unsigned childEnd = _levelBounds[level - 1];
+        for (unsigned i = childEnd; i < _levelBounds[level]; ++i)
+        {
+            if (_indices[i] < childBegin || _indices[i] >= childEnd)
+            {
+                reset();
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+std::size_t
+PackedRTree::getSerializedSize() const
+{
+    return sizeof(Header) + (std::size_t)_numNodes * (sizeof(Box) + sizeof(std::uint32_t));
+}
+
+void
+PackedRTree::write(std::ostream& out) const
+{
+    Header header;
+    ::memcpy(header.magic, MAGIC, 4);
+    header.version = VERSION;
+    header.numItems = _numItems;
+    header.nodeSize = _nodeSize;
+    header.numNodes = _numNodes;
+    header.reserved = 0u;
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    if (_numNodes > 0u)
+    {
+        out.write(reinterpret_cast<const char*>(_boxes), _numNodes * sizeof(Box));
+        out.write(reinterpret_cast<const char*>(_indices), _numNodes * sizeof(std::uint32_t));
+    }
+}
+
+const PackedRTree::Box&
+PackedRTree::getItemBox(unsigned index) const
+{
+    return _boxes[_itemPositions[index]];
+}
+
+void
+PackedRTree::search(const Box& query, std::vector<unsigned>& results) const
+{
+    if (_numItems == 0u)
+        return;
+
+    // pairs of (first node of a group, level of the group)
+    std::vector<unsigned> stack;
+    stack.reserve(64);
+
+    unsigned nodeIndex = _numNodes - 1u;
+    unsigned level = _levelBounds.size() - 1u;
+
+    while (true)
+    {
+        unsigned end = std::min(nodeIndex + _nodeSize, _levelBounds[level]);
+        for (unsigned pos = nodeIndex; pos < end; ++pos)
+        {
+            if (!intersects(query, _boxes[pos]))
+                continue;
+
+            if (nodeIndex < _numItems)
+            {
+                results.push_back(_indices[pos]);
+            }
+            else
+            {
+                stack.push_back(_indices[pos]);
+                stack.push_back(level - 1u);
+            }
+        }
+
+        if (stack.empty())
+            break;
+
+        level = stack.back(); stack.pop_back();
+        nodeIndex = stack.back(); stack.pop_back();
+    }
+}
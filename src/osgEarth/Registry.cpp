@@ -191,6 +191,15 @@ _blacklist("Reg.BlackList(OE)")
 
     // Default concurrency for async image layers
     JobArena::setConcurrency("oe.layer.async", 4u);
+
+    // Default concurrency for parallel feature compilation
+    JobArena::setConcurrency("oe.geometrycompiler", Threading::getConcurrency());
+
+    // Default concurrency for batched elevation sampling
+    JobArena::setConcurrency("oe.elevationpool", Threading::getConcurrency());
+
+    // Default concurrency for parallel heightfield flattening
+    JobArena::setConcurrency("oe.flattening", Threading::getConcurrency());
 }
 
 Registry::~Registry()
@@ -255,9 +264,7 @@ Registry::releaseGLObjects(osg::State* state) const
     }
 
     // Clear out the VirtualProgram shared program repository
-    _programRepo.lock();
     _programRepo.releaseGLObjects(state);
-    _programRepo.unlock();
 }
 
 void
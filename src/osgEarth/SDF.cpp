@@ -22,6 +22,9 @@
 #include "FeatureSource"
 #include "FeatureRasterizer"
 #include "Session"
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 using namespace osgEarth;
 using namespace osgEarth::Util;
@@ -32,6 +35,62 @@ namespace
         return (x & (x - 1)) == 0;
     }
 
+    constexpr float NODATA = 32767.0f;
+
+    // Seeds a nearest-neighbor field from a raster: pixels with data point
+    // to themselves, and all others are NODATA.
+    osg::Image* seedNearestNeighborField(
+        const GeoImage& inputRaster,
+        bool inverted,
+        GeoImage& nnfield)
+    {
+        const osg::Image* raster = inputRaster.getImage();
+
+        // Convert pixels to local coordinates relative to the lower-left corner of extent
+        if (!nnfield.valid())
+        {
+            osg::Image* image = new osg::Image();
+            image->allocateImage(raster->s(), raster->t(), 1, GL_RG, GL_FLOAT);
+            image->setInternalTextureFormat(GL_RG16F);
+            nnfield = std::move(GeoImage(image, inputRaster.getExtent()));
+        }
+
+        // actually need to write to the GeoImage, and that's OK.
+        osg::Image* nnimage = const_cast<osg::Image*>(nnfield.getImage());
+
+        ImageUtils::PixelReader read_raster(raster);
+        ImageUtils::PixelWriter write_nnf(nnimage);
+
+        const osg::Vec4f nodata(NODATA, NODATA, NODATA, NODATA);
+        std::vector<osg::Vec4f> row(raster->s());
+
+        for (int t = 0; t < raster->t(); ++t)
+        {
+            read_raster.readRow(row.data(), 0, t, raster->s());
+            for (int s = 0; s < raster->s(); ++s)
+            {
+                float a = row[s].a();
+                if ((!inverted && a >= 0.5f) || (inverted && a <= 0.5f))
+                    row[s].set((float)s, (float)t, 0.0f, 0.0f);
+                else
+                    row[s] = nodata;
+            }
+            write_nnf.writeRow(row.data(), 0, t, raster->s());
+        }
+
+        return nnimage;
+    }
+
+    // Working memory for the CPU distance transform, kept per thread
+    // so that generating a tile doesn't allocate.
+    struct EDTScratch
+    {
+        std::vector<int> nearestRow; // nearest site in the pixel's column
+        std::vector<float> g;        // squared distance to that site
+        std::vector<int> v;          // sites in the lower envelope
+        std::vector<float> z;        // where each envelope parabola takes over
+    };
+
     // https://www.comp.nus.edu.sg/~tants/jfa/i3d06.pdf
     const char* jfa_cs = R"(
     #version 430
@@ -185,47 +244,19 @@ SDFGenerator::createNearestNeighborField(
     GeoImage& nnfield,
     Cancelable* progress) const
 {
-    // Convert pixels to local coordinates relative to the lower-left corner of extent
-    if (!nnfield.valid())
-    {
-        osg::Image* image = new osg::Image();
-        image->allocateImage(inputRaster.getImage()->s(), inputRaster.getImage()->t(), 1, GL_RG, GL_FLOAT);
-        image->setInternalTextureFormat(GL_RG16F);
-        nnfield = std::move(GeoImage(image, inputRaster.getExtent()));
-    }
-
-    // actually need to write to the GeoImage, and that's OK.
-    osg::Image* nnimage = const_cast<osg::Image*>(nnfield.getImage());
-
-    ImageUtils::PixelReader read_raster(inputRaster.getImage());
-    ImageUtils::PixelWriter write_nnf(nnimage);
+    OE_SOFT_ASSERT_AND_RETURN(inputRaster.valid(), false);
 
-    constexpr float NODATA = 32767.0f;
-    osg::Vec4f nodata(NODATA, NODATA, NODATA, NODATA);
-    osg::Vec4f pixel, coord;
-    GeoImageIterator iter(inputRaster);
-    iter.forEachPixel([&]()
-        {
-            read_raster(pixel, iter.s(), iter.t());
-            if ((!inverted && pixel.a() >= 0.5f) || (inverted && pixel.a() <= 0.5f))
-                coord.set((float)iter.s(), (float)iter.t(), 0.0f, 0.0f);
-            else
-                coord = nodata;
-            
-            write_nnf(coord, iter.s(), iter.t());
-        }
-    );
+    osg::Image* nnimage = seedNearestNeighborField(inputRaster, inverted, nnfield);
 
     if (_useGPU && GPUJobArena::arena().getGraphicsContext().valid())
     {
         compute_nnf_on_gpu(nnimage);
+        return true;
     }
     else
     {
-        compute_nnf_on_cpu(nnimage);
+        return compute_nnf_on_cpu(nnimage, nullptr, progress);
     }
-
-    return true;
 }
 
 void
@@ -305,6 +336,71 @@ SDFGenerator::createDistanceField(
 }
 
 
+bool
+SDFGenerator::createDistanceField(
+    const GeoImage& inputRaster,
+    bool inverted,
+    GeoImage& nnfield,
+    GeoImage& sdf,
+    float span,
+    float lo,
+    float hi,
+    Cancelable* progress) const
+{
+    OE_SOFT_ASSERT_AND_RETURN(inputRaster.valid(), false);
+    OE_SOFT_ASSERT_AND_RETURN(sdf.valid(), false);
+
+    const osg::Image* raster = inputRaster.getImage();
+
+    bool sameGrid =
+        sdf.getExtent() == inputRaster.getExtent() &&
+        sdf.getImage()->s() == raster->s() &&
+        sdf.getImage()->t() == raster->t();
+
+    // The GPU path and a differently-sized SDF both need the two steps.
+    if (!sameGrid || (_useGPU && GPUJobArena::arena().getGraphicsContext().valid()))
+    {
+        if (!createNearestNeighborField(inputRaster, inverted, nnfield, progress))
+            return false;
+
+        createDistanceField(nnfield, sdf, span, lo, hi, progress);
+        return true;
+    }
+
+    osg::Image* nnimage = seedNearestNeighborField(inputRaster, inverted, nnfield);
+
+    const int w = nnimage->s();
+    const int h = nnimage->t();
+
+    std::vector<float> distances(w*h);
+    if (!compute_nnf_on_cpu(nnimage, distances.data(), progress))
+        return false;
+
+    // That's OK.
+    osg::Image* sdfimage = const_cast<osg::Image*>(sdf.getImage());
+
+    ImageUtils::PixelReader read_sdf(sdfimage);
+    ImageUtils::PixelWriter write_sdf(sdfimage);
+
+    float cellSize = 1.0f / (float)(w - 1);
+    std::vector<osg::Vec4f> row(w);
+
+    for (int t = 0; t < h; ++t)
+    {
+        read_sdf.readRow(row.data(), 0, t, w);
+        for (int s = 0; s < w; ++s)
+        {
+            float d = unitremap(distances[t*w + s] * cellSize * span, lo, hi);
+            if (d < row[s].r())
+                row[s].r() = d;
+        }
+        write_sdf.writeRow(row.data(), 0, t, w);
+    }
+
+    return true;
+}
+
+
 void
 SDFGenerator::compute_nnf_on_gpu(osg::Image* image) const
 {
@@ -333,67 +429,124 @@ SDFGenerator::NNFSession::renderImplementation(osg::State* state)
     }
 }
 
-void
-SDFGenerator::compute_nnf_on_cpu(osg::Image* buf) const
+bool
+SDFGenerator::compute_nnf_on_cpu(osg::Image* buf, float* distances, Cancelable* progress) const
 {
-    // Jump-Flood algorithm for computing discrete voronoi
-    // https://www.comp.nus.edu.sg/~tants/jfa/i3d06.pdf
-    osg::Vec4f pixel_points_to;
-    osg::Vec4f remote;
-    osg::Vec4f remote_points_to;
-    ImageUtils::PixelReader readBuf(buf);
-    ImageUtils::PixelWriter writeBuf(buf);
-    int n = buf->s();
-    constexpr float NODATA = 32767;
-
-    for (int L = n / 2; L >= 1; L /= 2)
+    // Exact Euclidean distance transform, computed separably: first the
+    // nearest site within each column, then the nearest of those along each
+    // row using the lower envelope of parabolas. Rows (and columns) are
+    // independent of each other.
+    // Felzenszwalb & Huttenlocher, "Distance Transforms of Sampled Functions"
+    // http://cs.brown.edu/people/pfelzens/papers/dt-final.pdf
+    OE_SOFT_ASSERT_AND_RETURN(buf->getPixelFormat() == GL_RG && buf->getDataType() == GL_FLOAT, false);
+
+    const int w = buf->s();
+    const int h = buf->t();
+    constexpr float INF = std::numeric_limits<float>::infinity();
+
+    static thread_local EDTScratch scratch;
+    scratch.nearestRow.resize(w*h);
+    scratch.g.resize(w*h);
+    scratch.v.resize(w);
+    scratch.z.resize(w + 1);
+
+    int* nearestRow = scratch.nearestRow.data();
+    float* g = scratch.g.data();
+    int* v = scratch.v.data();
+    float* z = scratch.z.data();
+
+    // Columns: sweep down, tracking the last site seen in each column, then
+    // sweep back up keeping whichever is closer. Each step handles a whole
+    // row, so the inner loops vectorize.
+    for (int t = 0; t < h; ++t)
     {
-        ImageUtils::ImageIterator iter(readBuf);
-        iter.forEachPixel([&]()
-            {
-                readBuf(pixel_points_to, iter.s(), iter.t());
+        const float* in = reinterpret_cast<const float*>(buf->data(0, t));
+        int* row = &nearestRow[t*w];
+        const int* above = t > 0 ? &nearestRow[(t - 1)*w] : nullptr;
 
-                // no data at this pixel yet? skip it; there is nothing to propagate.
-                if (pixel_points_to.x() != NODATA)
-                {
-                    for (int s = iter.s() - L; s <= iter.s() + L; s += L)
-                    {
-                        if (s < 0 || s >= readBuf.s())
-                            continue;
-
-                        remote[0] = (float)s;
-
-                        for (int t = iter.t() - L; t <= iter.t() + L; t += L)
-                        {
-                            if (t < 0 || t >= readBuf.t())
-                                continue;
-                            if (s == iter.s() && t == iter.t())
-                                continue;
-
-                            remote[1] = (float)t;
-
-                            // fetch the coords the remote pixel points to:
-                            readBuf(remote_points_to, s, t);
-
-                            if (remote_points_to.x() == NODATA) // remote is unset? Just copy
-                            {
-                                writeBuf(pixel_points_to, s, t);
-                            }
-                            else
-                            {
-                                // compare the distances and pick the closest.
-                                float d_existing = distanceSquared2D(remote, remote_points_to);
-                                float d_possible = distanceSquared2D(remote, pixel_points_to);
-
-                                if (d_possible < d_existing)
-                                {
-                                    writeBuf(pixel_points_to, s, t);
-                                }
-                            }
-                        }
-                    }
-                }
+        for (int s = 0; s < w; ++s)
+            row[s] = in[2 * s] != NODATA ? t : above ? above[s] : -1;
+    }
+
+    for (int t = h - 2; t >= 0; --t)
+    {
+        int* row = &nearestRow[t*w];
+        const int* below = &nearestRow[(t + 1)*w];
+
+        for (int s = 0; s < w; ++s)
+        {
+            if (below[s] >= 0 && (row[s] < 0 || below[s] - t < t - row[s]))
+                row[s] = below[s];
+        }
+    }
+
+    for (int t = 0; t < h; ++t)
+    {
+        const int* row = &nearestRow[t*w];
+        float* gt = &g[t*w];
+
+        for (int s = 0; s < w; ++s)
+            gt[s] = row[s] >= 0 ? (float)((t - row[s])*(t - row[s])) : INF;
+    }
+
+    // Rows: the squared distance to the nearest site is the lower envelope
+    // of the parabolas (s - q)^2 + g(q) rooted at each column q.
+    for (int t = 0; t < h; ++t)
+    {
+        if (progress && progress->isCanceled())
+            return false;
+
+        const float* gt = &g[t*w];
+        float* out = reinterpret_cast<float*>(buf->data(0, t));
+
+        // build the envelope:
+        int k = -1;
+        for (int q = 0; q < w; ++q)
+        {
+            if (gt[q] == INF)
+                continue;
+
+            float fq = gt[q] + (float)(q*q);
+            float x = -INF;
+            while (k >= 0)
+            {
+                int p = v[k];
+                x = (fq - (gt[p] + (float)(p*p))) / (float)(2 * (q - p));
+                if (x > z[k])
+                    break;
+                --k;
             }
-        );
+            ++k;
+            v[k] = q;
+            z[k] = k == 0 ? -INF : x;
+            z[k + 1] = INF;
+        }
+
+        // no sites anywhere in the image
+        if (k < 0)
+        {
+            if (distances)
+                std::fill(&distances[t*w], &distances[t*w] + w, NODATA);
+            continue;
+        }
+
+        // then read the nearest site for each pixel off of it. A site's own
+        // entry never changes, so it's safe to overwrite the field as we go.
+        k = 0;
+        for (int s = 0; s < w; ++s)
+        {
+            while (z[k + 1] < (float)s)
+                ++k;
+
+            int p = v[k];
+            const float* site = reinterpret_cast<const float*>(buf->data(p, nearestRow[t*w + p]));
+            out[2 * s + 0] = site[0];
+            out[2 * s + 1] = site[1];
+
+            if (distances)
+                distances[t*w + s] = sqrtf((float)((s - p)*(s - p)) + gt[p]);
+        }
     }
+
+    return true;
 }
@@ -80,6 +80,21 @@ ScriptEngine::run(
     return true;
 }
 
+bool
+ScriptEngine::run(
+    const std::string& code,
+    const FeatureBatch& features,
+    std::vector<ScriptResult>& results,
+    FilterContext const* context)
+{
+    for (unsigned row = 0; row < features.size(); ++row)
+    {
+        osg::ref_ptr<Feature> feature = features.createFeature(row);
+        results.emplace_back(run(code, feature.get(), context));
+    }
+    return true;
+}
+
 //------------------------------------------------------------------------
 
 #undef  LC
@@ -108,3 +108,36 @@ ScriptFilter::push( FeatureList& input, FilterContext& context )
     input.swap(output);
     return context;
 }
+
+FilterContext
+ScriptFilter::push( FeatureBatch& input, FilterContext& context )
+{
+    if ( !isSupported() )
+    {
+        OE_WARN << "ScriptFilter support not enabled" << std::endl;
+        return context;
+    }
+
+    if (!_engine.valid())
+    {
+        OE_WARN << "No scripting engine\n";
+        return context;
+    }
+
+    std::vector<ScriptResult> results;
+    results.reserve(input.size());
+
+    std::vector<bool> keep(input.size(), false);
+
+    if (_engine->run(_expression.get(), input, results, &context) &&
+        results.size() == input.size())
+    {
+        for (unsigned row = 0; row < input.size(); ++row)
+        {
+            keep[row] = results[row].asBool();
+        }
+    }
+
+    input.select(keep);
+    return context;
+}
@@ -335,8 +335,7 @@ TFSFeatureSource::getFeatures(const std::string& buffer, const TileKey& key, con
     if (mimeType == "application/x-protobuf" || mimeType == "binary/octet-stream")
     {
 #ifdef OSGEARTH_HAVE_MVT
-        std::stringstream in(buffer);
-        return MVT::readTile(in, key, features);
+        return MVT::readTile(buffer.data(), buffer.size(), key, features);
 #else
         if (getStatus().isOK())
         {
@@ -66,6 +66,11 @@ TerrainOptions::getConfig() const
     conf.set( "priority_scale", priorityScale() );
     conf.set( "texture_compression", textureCompression());
     conf.set( "concurrency", concurrency());
+    conf.set( "prefetch", prefetch());
+    conf.set( "prefetch_frames", prefetchFrames());
+    conf.set( "prefetch_budget", prefetchBudget());
+    conf.set( "prefetch_cache_size", prefetchCacheSize());
+    conf.set( "share_edited_geometry", shareEditedGeometry());
 
     return conf;
 }
@@ -105,6 +110,11 @@ TerrainOptions::fromConfig(const Config& conf)
     priorityScale().init(1.0f);
     textureCompression().setDefault("");
     concurrency().setDefault(4u);
+    prefetch().setDefault(false);
+    prefetchFrames().setDefault(30u);
+    prefetchBudget().setDefault(16u);
+    prefetchCacheSize().setDefault(256u);
+    shareEditedGeometry().setDefault(false);
 
 
     conf.get( "tile_size", _tileSize );
@@ -141,6 +151,11 @@ TerrainOptions::fromConfig(const Config& conf)
     conf.get( "priority_scale", priorityScale());
     conf.get( "texture_compression", textureCompression());
     conf.get( "concurrency", concurrency());
+    conf.get( "prefetch", prefetch());
+    conf.get( "prefetch_frames", prefetchFrames());
+    conf.get( "prefetch_budget", prefetchBudget());
+    conf.get( "prefetch_cache_size", prefetchCacheSize());
+    conf.get( "share_edited_geometry", shareEditedGeometry());
 
     // report on deprecated usage
     const std::string deprecated_keys[] = {
@@ -198,6 +213,11 @@ OE_PROPERTY_IMPL(TerrainOptionsAPI, unsigned, MergesPerFrame, mergesPerFrame);
 OE_PROPERTY_IMPL(TerrainOptionsAPI, float, PriorityScale, priorityScale);
 OE_PROPERTY_IMPL(TerrainOptionsAPI, std::string, TextureCompressionMethod, textureCompression);
 OE_PROPERTY_IMPL(TerrainOptionsAPI, unsigned, Concurrency, concurrency);
+OE_PROPERTY_IMPL(TerrainOptionsAPI, bool, Prefetch, prefetch);
+OE_PROPERTY_IMPL(TerrainOptionsAPI, unsigned, PrefetchFrames, prefetchFrames);
+OE_PROPERTY_IMPL(TerrainOptionsAPI, unsigned, PrefetchBudget, prefetchBudget);
+OE_PROPERTY_IMPL(TerrainOptionsAPI, unsigned, PrefetchCacheSize, prefetchCacheSize);
+OE_PROPERTY_IMPL(TerrainOptionsAPI, bool, ShareEditedGeometry, shareEditedGeometry);
 
 void
 TerrainOptionsAPI::setDriver(const std::string& value)
@@ -21,6 +21,9 @@
 */
 #include <iterator>
 #include <limits.h>
+#include <algorithm>
+#include <cmath>
+#include <set>
 #include <osgEarth/Tessellator>
 
 #ifdef OSGEARTH_CXX11
@@ -244,6 +247,526 @@ void rotateToXY(std::vector<std::vector<osg::Vec3d>>& polygon)
     }
 }
 
+// Monotone-partition tessellator (de Berg et al., ch. 3). A sweep from
+// top to bottom adds diagonals that split the polygon into y-monotone
+// pieces, which are then triangulated in linear time: O(n log n) in
+// total, regardless of the number of holes.
+//
+// Vertices that share a location (a ring touching itself or a hole
+// touching the outer ring) are ordered by index, which keeps the sweep
+// consistent. Input that still defeats it (crossing edges) is detected
+// and reported so the caller can fall back on earcut.
+class SweepTessellator
+{
+public:
+    template<typename Polygon>
+    bool tessellate(
+        const Polygon& polygon,
+        std::vector<uint32_t>& out_indices)
+    {
+        out_indices.clear();
+        if (!link(polygon))
+            return false;
+
+        if (_numVerts == 0)
+            return true;
+
+        if (!partition())
+            return false;
+
+        return triangulate(out_indices);
+    }
+
+private:
+    enum VertexType { START, END, SPLIT, MERGE, REGULAR };
+
+    struct Vertex
+    {
+        double x, y;
+        int prev, next;
+        int rank;        // position in the sweep (shared by copies)
+        uint32_t index;  // index in the input
+    };
+
+    struct Edge
+    {
+        double ux, uy, lx, ly; // upper and lower end points
+        int rank;              // sweep rank of the upper end point
+        mutable int owner;     // vertex the edge starts at
+    };
+
+    static double cross(double ax, double ay, double bx, double by, double px, double py)
+    {
+        return (bx - ax)*(py - ay) - (by - ay)*(px - ax);
+    }
+
+    // Orders the edges crossing the sweep line from left to right.
+    // Edges never cross, so comparing the later upper end point
+    // against the other edge is enough.
+    struct EdgeLess
+    {
+        bool operator()(const Edge& a, const Edge& b) const
+        {
+            if (a.rank >= b.rank)
+            {
+                // is a to the left of b?
+                double s = cross(b.ux, b.uy, b.lx, b.ly, a.ux, a.uy);
+                if (s == 0.0)
+                    s = cross(b.ux, b.uy, b.lx, b.ly, a.lx, a.ly);
+                return s < 0.0;
+            }
+            else
+            {
+                // is b to the right of a?
+                double s = cross(a.ux, a.uy, a.lx, a.ly, b.ux, b.uy);
+                if (s == 0.0)
+                {
+                    // a vertex touching an edge (see findLeftEdge) is
+                    // on the edge's inside, which is its right
+                    if (b.ux == b.lx && b.uy == b.ly)
+                        return true;
+                    s = cross(a.ux, a.uy, a.lx, a.ly, b.lx, b.ly);
+                }
+                return s > 0.0;
+            }
+        }
+    };
+
+    typedef std::set<Edge, EdgeLess> EdgeSet;
+
+    std::vector<Vertex> _verts;
+    std::vector<int> _order;
+    std::vector<char> _types;
+    std::vector<int> _helpers;
+    std::vector<EdgeSet::iterator> _edgeIters;
+    std::vector<int> _chain;
+    std::vector<char> _sides;
+    std::vector<int> _stack;
+    std::vector<char> _visited;
+    EdgeSet _edges;
+    int _numVerts;
+    double _area;
+
+    // true if vertex a comes before vertex b in the sweep
+    bool above(int a, int b) const
+    {
+        const Vertex& va = _verts[a];
+        const Vertex& vb = _verts[b];
+        if (va.y != vb.y) return va.y > vb.y;
+        if (va.x != vb.x) return va.x < vb.x;
+        return va.rank >= 0 && vb.rank >= 0 ? va.rank < vb.rank : a < b;
+    }
+
+    bool convex(int p, int v, int n) const
+    {
+        return cross(_verts[p].x, _verts[p].y, _verts[v].x, _verts[v].y, _verts[n].x, _verts[n].y) > 0.0;
+    }
+
+    // Links each ring into a cycle, outer ring counter-clockwise and
+    // holes clockwise, so that the interior is always on the left.
+    template<typename Polygon>
+    bool link(const Polygon& polygon)
+    {
+        unsigned total = 0u;
+        for (auto& ring : polygon)
+            total += ring.size();
+
+        // each diagonal adds two vertices, and there's at most one
+        // diagonal per input vertex
+        _verts.clear();
+        _verts.reserve(3 * total);
+        _area = 0.0;
+
+        // work relative to the first point, to keep the precision of
+        // the orientation tests with large (e.g. projected) coordinates
+        double ox = 0.0, oy = 0.0;
+        if (!polygon.empty() && !polygon.front().empty())
+            ox = polygon.front().front().x(), oy = polygon.front().front().y();
+
+        uint32_t base = 0u;
+        for (unsigned r = 0; r < polygon.size(); base += polygon[r].size(), ++r)
+        {
+            const typename Polygon::value_type& ring = polygon[r];
+            int first = (int)_verts.size();
+
+            for (unsigned i = 0; i < ring.size(); ++i)
+            {
+                // skip repeated points, including a closing point
+                double x = ring[i].x() - ox, y = ring[i].y() - oy;
+                if (_verts.size() > (unsigned)first &&
+                    _verts.back().x == x && _verts.back().y == y)
+                    continue;
+                if (i + 1 == ring.size() && _verts.size() > (unsigned)first &&
+                    _verts[first].x == x && _verts[first].y == y)
+                    continue;
+
+                Vertex v;
+                v.x = x, v.y = y;
+                v.rank = -1;
+                v.index = base + i;
+                _verts.push_back(v);
+            }
+
+            int count = (int)_verts.size() - first;
+            double area = 0.0;
+            for (int i = 0, j = count - 1; i < count; j = i++)
+            {
+                const Vertex& a = _verts[first + j];
+                const Vertex& b = _verts[first + i];
+                area += (a.x - b.x) * (a.y + b.y);
+            }
+            area *= 0.5;
+
+            if (count < 3)
+            {
+                // nothing to fill
+                _verts.resize(first);
+                continue;
+            }
+
+            if (area == 0.0)
+            {
+                // a line, or a ring crossing itself
+                return false;
+            }
+
+            bool reverse = (r == 0) ? (area < 0.0) : (area > 0.0);
+            for (int i = 0; i < count; ++i)
+            {
+                int prev = first + (i + count - 1) % count;
+                int next = first + (i + 1) % count;
+                _verts[first + i].prev = reverse ? next : prev;
+                _verts[first + i].next = reverse ? prev : next;
+            }
+
+            _area += (r == 0) ? fabs(area) : -fabs(area);
+        }
+
+        _numVerts = (int)_verts.size();
+        return _numVerts == 0 || _area > 0.0;
+    }
+
+    // Splits the rings into monotone pieces by adding diagonals.
+    bool partition()
+    {
+        const int n = _numVerts;
+
+        _order.resize(n);
+        for (int i = 0; i < n; ++i)
+            _order[i] = i;
+        std::sort(_order.begin(), _order.end(), [this](int a, int b) { return above(a, b); });
+        for (int i = 0; i < n; ++i)
+            _verts[_order[i]].rank = i;
+
+        _types.resize(3 * n);
+        _helpers.assign(3 * n, -1);
+        _edges.clear();
+        _edgeIters.assign(3 * n, _edges.end());
+
+        for (int i = 0; i < n; ++i)
+        {
+            const int p = _verts[i].prev, nx = _verts[i].next;
+            bool pBelow = above(i, p), nBelow = above(i, nx);
+            if (pBelow && nBelow)
+                _types[i] = convex(p, i, nx) ? START : SPLIT;
+            else if (!pBelow && !nBelow)
+                _types[i] = convex(p, i, nx) ? END : MERGE;
+            else
+                _types[i] = REGULAR;
+        }
+
+        for (int k = 0; k < n; ++k)
+        {
+            int v = _order[k];
+            int v2 = v; // copy of v that owns the edge leaving v
+            EdgeSet::iterator left;
+
+            switch (_types[v])
+            {
+            case START:
+                if (!insertEdge(v))
+                    return false;
+                _helpers[v] = v;
+                break;
+
+            case END:
+                if (!closeEdge(v, v2))
+                    return false;
+                break;
+
+            case SPLIT:
+                if (!findLeftEdge(v, left))
+                    return false;
+                addDiagonal(v, _helpers[left->owner]);
+                v2 = (int)_verts.size() - 2;
+                _helpers[left->owner] = v;
+                if (!insertEdge(v2))
+                    return false;
+                _helpers[v2] = v2;
+                break;
+
+            case MERGE:
+                if (!closeEdge(v, v2))
+                    return false;
+                if (!findLeftEdge(v, left))
+                    return false;
+                if (_types[_helpers[left->owner]] == MERGE)
+                    addDiagonal(v2, _helpers[left->owner]);
+                _helpers[left->owner] = v2;
+                break;
+
+            case REGULAR:
+                if (above(_verts[v].prev, v))
+                {
+                    // interior to the right: going down the left side
+                    if (!closeEdge(v, v2) || !insertEdge(v2))
+                        return false;
+                    _helpers[v2] = v2;
+                }
+                else
+                {
+                    if (!findLeftEdge(v, left))
+                        return false;
+                    if (_types[_helpers[left->owner]] == MERGE)
+                        addDiagonal(v, _helpers[left->owner]);
+                    _helpers[left->owner] = v;
+                }
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool insertEdge(int v)
+    {
+        const Vertex& a = _verts[v];
+        const Vertex& b = _verts[a.next];
+        Edge e;
+        e.ux = a.x, e.uy = a.y, e.lx = b.x, e.ly = b.y;
+        e.rank = a.rank;
+        e.owner = v;
+
+        // an equal edge means overlapping or crossing edges
+        std::pair<EdgeSet::iterator, bool> result = _edges.insert(e);
+        _edgeIters[v] = result.second ? result.first : _edges.end();
+        return result.second;
+    }
+
+    // Removes the edge ending at v, connecting v to the edge's helper
+    // if that's a merge vertex. v2 is the vertex that now owns the
+    // edge leaving v.
+    bool closeEdge(int v, int& v2)
+    {
+        int p = _verts[v].prev;
+        if (_helpers[p] < 0 || _edgeIters[p] == _edges.end())
+            return false;
+        _edges.erase(_edgeIters[p]);
+        _edgeIters[p] = _edges.end();
+        if (_types[_helpers[p]] == MERGE)
+        {
+            addDiagonal(v, _helpers[p]);
+            v2 = (int)_verts.size() - 2;
+        }
+        return true;
+    }
+
+    // Edge directly to the left of vertex v. The query is a point edge,
+    // which sorts after all the edges it's on.
+    bool findLeftEdge(int v, EdgeSet::iterator& result)
+    {
+        Edge query;
+        query.ux = query.lx = _verts[v].x;
+        query.uy = query.ly = _verts[v].y;
+        query.rank = _verts[v].rank;
+        result = _edges.lower_bound(query);
+        if (result == _edges.begin())
+            return false;
+        --result;
+        return _helpers[result->owner] >= 0;
+    }
+
+    // Adds the diagonal a-b, which splits a cycle in two (or joins a
+    // hole to the cycle around it). a and b keep the edges coming in;
+    // new copies of a and b take over the edges going out.
+    void addDiagonal(int a, int b)
+    {
+        int a2 = (int)_verts.size();
+        int b2 = a2 + 1;
+        _verts.push_back(_verts[a]);
+        _verts.push_back(_verts[b]);
+
+        _verts[_verts[a].next].prev = a2;
+        _verts[_verts[b].next].prev = b2;
+        _verts[a].next = b2;
+        _verts[b2].prev = a;
+        _verts[b].next = a2;
+        _verts[a2].prev = b;
+
+        moveOutgoing(a, a2);
+        moveOutgoing(b, b2);
+    }
+
+    void moveOutgoing(int from, int to)
+    {
+        _types[to] = _types[from];
+        _helpers[to] = _helpers[from];
+        _edgeIters[to] = _edgeIters[from];
+        if (_edgeIters[to] != _edges.end())
+            _edgeIters[to]->owner = to;
+        _edgeIters[from] = _edges.end();
+    }
+
+    // Triangulates each monotone piece, and checks that the triangles
+    // cover the polygon exactly.
+    bool triangulate(std::vector<uint32_t>& out)
+    {
+        const int count = (int)_verts.size();
+        out.reserve(3 * (_numVerts - 2));
+        _visited.assign(count, 0);
+        double area = 0.0;
+
+        for (int start = 0; start < count; ++start)
+        {
+            if (_visited[start])
+                continue;
+
+            _chain.clear();
+            int v = start;
+            do {
+                _visited[v] = 1;
+                _chain.push_back(v);
+                v = _verts[v].next;
+            } while (v != start && (int)_chain.size() <= count);
+
+            if (v != start || !triangulateMonotone(out, area))
+                return false;
+        }
+
+        return fabs(area - _area) <= 1e-6 * _area;
+    }
+
+    // Standard stack-based triangulation of a y-monotone polygon,
+    // after merging its left and right chains into sweep order.
+    bool triangulateMonotone(std::vector<uint32_t>& out, double& area)
+    {
+        const int n = (int)_chain.size();
+        if (n < 3)
+            return false;
+
+        int top = 0, bottom = 0;
+        for (int i = 1; i < n; ++i)
+        {
+            if (above(_chain[i], _chain[top])) top = i;
+            if (above(_chain[bottom], _chain[i])) bottom = i;
+        }
+
+        // the cycle goes down the left chain and up the right one
+        for (int i = top; i != bottom; i = (i + 1) % n)
+            if (!above(_chain[i], _chain[(i + 1) % n]))
+                return false;
+        for (int i = bottom; i != top; i = (i + 1) % n)
+            if (!above(_chain[(i + 1) % n], _chain[i]))
+                return false;
+
+        // merge the chains; 1 = left chain, -1 = right chain
+        _order.resize(n);
+        _sides.resize(n);
+        _order[0] = top;
+        _sides[top] = 0;
+        int left = (top + 1) % n, right = (top + n - 1) % n;
+        for (int i = 1; i < n - 1; ++i)
+        {
+            if (left == bottom || (right != bottom && above(_chain[right], _chain[left])))
+            {
+                _order[i] = right;
+                _sides[right] = -1;
+                right = (right + n - 1) % n;
+            }
+            else
+            {
+                _order[i] = left;
+                _sides[left] = 1;
+                left = (left + 1) % n;
+            }
+        }
+        _order[n - 1] = bottom;
+        _sides[bottom] = 0;
+
+        _stack.resize(n);
+        _stack[0] = _order[0];
+        _stack[1] = _order[1];
+        int sp = 2;
+
+        for (int i = 2; i < n - 1; ++i)
+        {
+            int v = _order[i];
+            if (_sides[v] != _sides[_stack[sp - 1]])
+            {
+                // opposite chain: fan to everything on the stack
+                for (int j = 0; j < sp - 1; ++j)
+                {
+                    if (_sides[v] == 1)
+                        emit(_stack[j + 1], _stack[j], v, out, area);
+                    else
+                        emit(_stack[j], _stack[j + 1], v, out, area);
+                }
+                _stack[0] = _order[i - 1];
+                _stack[1] = v;
+                sp = 2;
+            }
+            else
+            {
+                // same chain: cut off as many convex corners as possible
+                --sp;
+                while (sp > 0)
+                {
+                    int a = _stack[sp - 1], b = _stack[sp];
+                    if (_sides[v] == 1 ? convex(_chain[v], _chain[a], _chain[b]) :
+                                         convex(_chain[v], _chain[b], _chain[a]))
+                    {
+                        if (_sides[v] == 1)
+                            emit(v, a, b, out, area);
+                        else
+                            emit(v, b, a, out, area);
+                        --sp;
+                    }
+                    else break;
+                }
+                ++sp;
+                _stack[sp++] = v;
+            }
+        }
+
+        int v = _order[n - 1];
+        for (int j = 0; j < sp - 1; ++j)
+        {
+            if (_sides[_stack[j + 1]] == 1)
+                emit(_stack[j], _stack[j + 1], v, out, area);
+            else
+                emit(_stack[j + 1], _stack[j], v, out, area);
+        }
+        return true;
+    }
+
+    // a, b, c are positions in _chain, in counter-clockwise order
+    void emit(int a, int b, int c, std::vector<uint32_t>& out, double& area)
+    {
+        const Vertex& va = _verts[_chain[a]];
+        const Vertex& vb = _verts[_chain[b]];
+        const Vertex& vc = _verts[_chain[c]];
+        area += 0.5 * fabs(cross(va.x, va.y, vb.x, vb.y, vc.x, vc.y));
+        out.push_back(va.index);
+        out.push_back(vb.index);
+        out.push_back(vc.index);
+    }
+};
+
+}
+
+Tessellator::Tessellator() :
+    _method(METHOD_AUTO)
+{
+    //nop
 }
 
 
@@ -348,9 +871,20 @@ Tessellator::tessellateGeometry(osg::Geometry &geom)
         polygon.push_back(ring);
     }
 
+    std::vector<uint32_t> indices;
+    bool swept = false;
+    if (_method != METHOD_EARCUT)
+    {
+        static thread_local SweepTessellator sweep;
+        swept = sweep.tessellate(polygon, indices);
+        if (!swept && _method == METHOD_SWEEP)
+            return false;
+    }
+
     // The index type. Defaults to uint32_t, but you can also pass uint16_t if you know that your
     // data won't have more than 65536 vertices.
-    std::vector<uint32_t> indices = mapbox::earcut<uint32_t>(polygon);
+    if (!swept)
+        indices = mapbox::earcut<uint32_t>(polygon);
     // Remove the existing primitive sets
     geom.removePrimitiveSet(0, geom.getNumPrimitiveSets());
     osg::DrawElementsUInt* drawElements = new osg::DrawElementsUInt(GL_TRIANGLES);
@@ -592,6 +1126,20 @@ Tessellator::tessellate2D(
     }
 
     // tessellate:
+    if (_method != METHOD_EARCUT)
+    {
+        // one per thread, so the scratch memory is reused across calls
+        static thread_local SweepTessellator sweep;
+
+        if (sweep.tessellate(polygon, out_indices))
+            return true;
+
+        if (_method == METHOD_SWEEP)
+            return false;
+
+        OE_DEBUG << LC << "Sweep tessellation failed; falling back on ear clipping" << std::endl;
+    }
+
     out_indices = mapbox::earcut<uint32_t>(polygon);
 
     return true;
@@ -20,8 +20,10 @@
 #include <osgDB/Options>
 #include "Utils"
 #include "Metrics"
+#include <algorithm>
 #include <cstdlib>
 #include <climits>
+#include <cmath>
 
 #ifdef _WIN32
 #   include <Windows.h>
@@ -545,18 +547,51 @@ JobGroup::join(Cancelable* cancelable)
 Mutex JobArena::_arenas_mutex("OE:JobArena");
 std::unordered_map<std::string, std::shared_ptr<JobArena>> JobArena::_arenas;
 std::unordered_map<std::string, unsigned> JobArena::_arenaSizes;
+std::unordered_map<std::string, JobArena::Scheduler> JobArena::_arenaSchedulers;
 std::string JobArena::_defaultArenaName = "oe.default";
 JobArena::Metrics JobArena::_allMetrics;
 
+namespace
+{
+    JobArena::Scheduler initialDefaultScheduler()
+    {
+        const char* value = ::getenv("OSGEARTH_JOB_SCHEDULER");
+        if (value && ciEquals(value, "work_stealing"))
+            return JobArena::SCHEDULER_WORK_STEALING;
+        return JobArena::SCHEDULER_PRIORITY;
+    }
+
+    // Worker queue index of the current thread, if it belongs to a
+    // work-stealing arena. Jobs dispatched from a worker go to its own queue.
+    thread_local const JobArena* tls_workerArena = nullptr;
+    thread_local unsigned tls_workerIndex = 0u;
+}
+
+JobArena::Scheduler JobArena::_defaultScheduler = initialDefaultScheduler();
+
 #define OE_ARENA_DEFAULT_SIZE 2u
 
-JobArena::JobArena(const std::string& name, unsigned concurrency, const Type& type) :
+JobArena::JobArena(const std::string& name, unsigned concurrency, const Type& type, const Scheduler& scheduler) :
     _name(name),
     _targetConcurrency(concurrency),
     _type(type),
+    _scheduler(type == THREAD_POOL ? scheduler : SCHEDULER_PRIORITY),
+    _nextWorkerQueue(0u),
+    _nextWorkerIndex(0u),
+    _numQueued(0),
+    _numSleeping(0),
     _done(false),
     _queueMutex("OE.JobArena[" + name + "]")
 {
+    if (_scheduler == SCHEDULER_WORK_STEALING)
+    {
+        // Queues are allocated once so they can be accessed without a lock.
+        // If concurrency later exceeds the queue count, threads share queues.
+        unsigned numQueues = std::max(std::max(concurrency, 1u), getConcurrency());
+        for (unsigned i = 0; i < numQueues; ++i)
+            _workerQueues.emplace_back(new WorkerQueue());
+    }
+
     // find a slot in the stats
     int new_index = -1;
     for (int i = 0; i < 512 && new_index < 0; ++i)
@@ -617,7 +652,10 @@ JobArena::get(const std::string& name_)
         auto iter = _arenaSizes.find(name);
         unsigned numThreads = iter != _arenaSizes.end() ? iter->second : OE_ARENA_DEFAULT_SIZE;
 
-        arena = std::make_shared<JobArena>(name, numThreads);
+        auto s_iter = _arenaSchedulers.find(name);
+        Scheduler scheduler = s_iter != _arenaSchedulers.end() ? s_iter->second : _defaultScheduler;
+
+        arena = std::make_shared<JobArena>(name, numThreads, THREAD_POOL, scheduler);
     }
     return arena.get();
 }
@@ -685,6 +723,26 @@ JobArena::setConcurrency(const std::string& name, unsigned value)
     }
 }
 
+void
+JobArena::setScheduler(const std::string& name, const Scheduler& value)
+{
+    ScopedMutexLock lock(_arenas_mutex);
+    _arenaSchedulers[name] = value;
+
+    if (_arenas.find(name) != _arenas.end())
+    {
+        OE_WARN << LC << "Arena \"" << name << "\" is already running; "
+            << "scheduler change will not take effect" << std::endl;
+    }
+}
+
+void
+JobArena::setDefaultScheduler(const Scheduler& value)
+{
+    ScopedMutexLock lock(_arenas_mutex);
+    _defaultScheduler = value;
+}
+
 void
 JobArena::dispatch(
     const Job& job,
@@ -700,7 +758,11 @@ JobArena::dispatch(
 
     if (_type == THREAD_POOL)
     {
-        if (_targetConcurrency > 0)
+        if (_targetConcurrency > 0 && _scheduler == SCHEDULER_WORK_STEALING)
+        {
+            pushWorkStealing(QueuedJob(job, delegate, sema));
+        }
+        else if (_targetConcurrency > 0)
         {
             std::lock_guard<Mutex> lock(_queueMutex);
             _queue.emplace_back(job, delegate, sema);
@@ -826,6 +888,222 @@ JobArena::runJobs()
     }
 }
 
+void
+JobArena::pushWorkStealing(QueuedJob&& job)
+{
+    // popFrom re-checks a dynamic priority when the job comes up.
+    int bucket = priorityBucket(job._job.getPriority());
+
+    // Jobs dispatched from one of our own workers stay local to that worker.
+    unsigned index = (tls_workerArena == this) ?
+        tls_workerIndex :
+        _nextWorkerQueue++;
+
+    _metrics->numJobsPending++;
+
+    WorkerQueue& queue = *_workerQueues[index % _workerQueues.size()];
+    {
+        ScopedMutexLock lock(queue._mutex);
+        queue._buckets[bucket].emplace_back(std::move(job));
+        queue._occupied |= (1u << bucket);
+        _numQueued++;
+    }
+
+    // Only touch the shared mutex if someone might be asleep.
+    if (_numSleeping > 0)
+    {
+        std::lock_guard<Mutex> lock(_queueMutex);
+        _block.notify_one();
+    }
+}
+
+bool
+JobArena::popFrom(WorkerQueue& queue, bool fromBack, QueuedJob& output)
+{
+    ScopedMutexLock lock(queue._mutex);
+
+    for (;;)
+    {
+        std::uint32_t occupied = queue._occupied;
+        if (occupied == 0u)
+            return false;
+
+        // highest occupied bucket:
+        int bucket = NUM_PRIORITY_BUCKETS - 1;
+        while ((occupied & (1u << bucket)) == 0u)
+            --bucket;
+
+        std::deque<QueuedJob>& jobs = queue._buckets[bucket];
+        QueuedJob& next = fromBack ? jobs.back() : jobs.front();
+
+        // A job with a priority function may have lost priority while
+        // it waited. If so, refile it and look again. Jobs only move
+        // to lower buckets here, so this terminates.
+        int current = bucket;
+        if (next._job._priorityFunc != nullptr)
+            current = priorityBucket(next._job._priorityFunc());
+
+        if (current < bucket)
+            queue._buckets[current].emplace_back(std::move(next));
+        else
+            output = std::move(next);
+
+        if (fromBack)
+            jobs.pop_back();
+        else
+            jobs.pop_front();
+
+        if (jobs.empty())
+            queue._occupied &= ~(1u << bucket);
+
+        if (current < bucket)
+        {
+            queue._occupied |= (1u << current);
+            continue;
+        }
+
+        _numQueued--;
+        return true;
+    }
+}
+
+int
+JobArena::priorityBucket(float priority)
+{
+    // Buckets, low to high:
+    // (-inf,-2^14] ... (-2,-1] (-1,0) | [0,1) [1,2) ... [2^14,inf)
+    const int half = NUM_PRIORITY_BUCKETS / 2;
+
+    int octave = 0;
+    float magnitude = fabs(priority);
+    if (magnitude >= 1.0f)
+    {
+        if (std::isfinite(magnitude))
+        {
+            int exponent;
+            frexp(magnitude, &exponent);
+            octave = std::min(exponent, half - 1);
+        }
+        else
+        {
+            octave = half - 1;
+        }
+    }
+
+    // NaN compares false and lands just below zero
+    return priority >= 0.0f ? half + octave : half - 1 - octave;
+}
+
+bool
+JobArena::popWorkStealing(unsigned workerIndex, QueuedJob& output)
+{
+    const unsigned numQueues = _workerQueues.size();
+    const unsigned home = workerIndex % numQueues;
+
+    // Peek (without locking) for the queue holding the highest priority
+    // bucket. Prefer our own queue on a tie for cache locality.
+    auto topBucket = [](std::uint32_t occupied) {
+        int b = -1;
+        for (; occupied != 0u; occupied >>= 1) ++b;
+        return b;
+    };
+
+    int bestBucket = topBucket(_workerQueues[home]->_occupied);
+    unsigned best = home;
+    for (unsigned i = 1; i < numQueues; ++i)
+    {
+        unsigned victim = (home + i) % numQueues;
+        int b = topBucket(_workerQueues[victim]->_occupied);
+        if (b > bestBucket)
+        {
+            bestBucket = b;
+            best = victim;
+        }
+    }
+
+    if (bestBucket >= 0 && popFrom(*_workerQueues[best], best == home, output))
+        return true;
+
+    // Peek lost a race; fall back to anything we can find.
+    for (unsigned i = 0; i < numQueues; ++i)
+    {
+        unsigned victim = (home + i) % numQueues;
+        if (popFrom(*_workerQueues[victim], victim == home, output))
+            return true;
+    }
+
+    return false;
+}
+
+void
+JobArena::runJobsWorkStealing(unsigned workerIndex)
+{
+    tls_workerArena = this;
+    tls_workerIndex = workerIndex;
+
+    while (!_done)
+    {
+        QueuedJob next;
+
+        if (popWorkStealing(workerIndex, next))
+        {
+            _metrics->numJobsRunning++;
+            _metrics->numJobsPending--;
+
+            auto t0 = std::chrono::steady_clock::now();
+
+            bool job_executed = next._delegate();
+
+            auto duration = std::chrono::steady_clock::now() - t0;
+
+            if (job_executed)
+            {
+                if (_allMetrics._report != nullptr)
+                {
+                    if (duration >= _allMetrics._reportMinDuration)
+                    {
+                        _allMetrics._report(Metrics::Report(next._job, _name, duration));
+                    }
+                }
+            }
+            else
+            {
+                _metrics->numJobsCanceled++;
+            }
+
+            if (next._groupsema != nullptr)
+            {
+                next._groupsema->release();
+            }
+
+            _metrics->numJobsRunning--;
+        }
+        else
+        {
+            // Nothing to do; sleep until a job arrives. Incrementing
+            // _numSleeping before checking _numQueued pairs with the
+            // dispatcher doing the reverse, so a wakeup is never lost.
+            std::unique_lock<Mutex> lock(_queueMutex);
+            _numSleeping++;
+            _block.wait(lock, [this] {
+                return _numQueued > 0 || _done == true;
+                });
+            _numSleeping--;
+        }
+
+        // See if we no longer need this thread because the
+        // target concurrency has been reduced
+        ScopedMutexLock quitLock(_quitMutex);
+        if (_targetConcurrency < _metrics->concurrency)
+        {
+            _metrics->concurrency--;
+            break;
+        }
+    }
+
+    tls_workerArena = nullptr;
+}
+
 void
 JobArena::startThreads()
 {
@@ -843,7 +1121,10 @@ JobArena::startThreads()
 
                 OE_THREAD_NAME(_name.c_str());
 
-                runJobs();
+                if (_scheduler == SCHEDULER_WORK_STEALING)
+                    runJobsWorkStealing(_nextWorkerIndex++);
+                else
+                    runJobs();
 
                 // exit thread here
                 //OE_INFO << LC << "Thread " << std::this_thread::get_id() << " exiting" << std::endl;
@@ -871,6 +1152,24 @@ void JobArena::stopThreads()
         }
         _queue.clear();
 
+        for (auto& queue : _workerQueues)
+        {
+            ScopedMutexLock queueLock(queue->_mutex);
+            for (auto& bucket : queue->_buckets)
+            {
+                for (auto& queuedjob : bucket)
+                {
+                    if (queuedjob._groupsema != nullptr)
+                    {
+                        queuedjob._groupsema->reset();
+                    }
+                }
+                bucket.clear();
+            }
+            queue->_occupied = 0u;
+        }
+        _numQueued = 0;
+
         //while (_queue.empty() == false)
         //{
         //    if (_queue.back()._groupsema != nullptr)
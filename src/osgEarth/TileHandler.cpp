@@ -39,3 +39,24 @@ std::string TileHandler::getProcessString() const
 {
     return "";
 }
+
+/*****************************************************************************************/
+
+bool StagedTileHandler::encodeTile(const TileKey& key, osg::ref_ptr<osg::Referenced>& data)
+{
+    return true;
+}
+
+bool StagedTileHandler::writeTile(const TileKey& key, osg::ref_ptr<osg::Referenced>& data)
+{
+    return true;
+}
+
+bool StagedTileHandler::handleTile(const TileKey& key, const TileVisitor& tv)
+{
+    osg::ref_ptr<osg::Referenced> data;
+    return
+        readTile(key, data) &&
+        encodeTile(key, data) &&
+        writeTile(key, data);
+}
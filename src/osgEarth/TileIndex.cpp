@@ -30,13 +30,134 @@
 
 #include <osgDB/FileUtils>
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define LC "[TileIndex] "
+
 using namespace osgEarth;
 using namespace osgEarth::Contrib;
+using namespace osgEarth::Util;
 using namespace std;
 
 #define OGR_SCOPED_LOCK GDAL_SCOPED_LOCK
 
-TileIndex::TileIndex()
+namespace
+{
+    // Sidecar layout, in native byte order, with each section 8-byte aligned:
+    // SidecarHeader, SRS WKT, PackedRTree, uint32 location offsets[numItems+1], location chars
+    struct SidecarHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t numItems;
+        std::uint32_t srsSize;
+        std::uint64_t treeOffset;
+        std::uint64_t treeSize;
+        std::uint64_t locationsOffset;
+        std::uint64_t locationsSize;
+    };
+
+    const char SIDECAR_MAGIC[4] = { 'O', 'E', 'T', 'I' };
+    const std::uint32_t SIDECAR_VERSION = 1u;
+
+    inline std::uint64_t align8(std::uint64_t value)
+    {
+        return (value + 7u) & ~(std::uint64_t)7u;
+    }
+}
+
+struct TileIndex::MappedFile
+{
+    const void* _data;
+    std::size_t _size;
+#ifdef _WIN32
+    HANDLE _file;
+    HANDLE _map;
+#endif
+
+    MappedFile() : _data(nullptr), _size(0)
+    {
+#ifdef _WIN32
+        _file = INVALID_HANDLE_VALUE;
+        _map = NULL;
+#endif
+    }
+
+    bool open(const std::string& filename)
+    {
+#ifdef _WIN32
+        _file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (_file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+            return false;
+        _map = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (_map == NULL)
+            return false;
+        _data = MapViewOfFile(_map, FILE_MAP_READ, 0, 0, 0);
+        _size = (std::size_t)size.QuadPart;
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* data = ::mmap(nullptr, (std::size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+            return false;
+        _data = data;
+        _size = (std::size_t)info.st_size;
+#endif
+        return _data != nullptr;
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (_data) UnmapViewOfFile(_data);
+        if (_map != NULL) CloseHandle(_map);
+        if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+#else
+        if (_data) ::munmap(const_cast<void*>(_data), _size);
+#endif
+    }
+};
+
+TileIndex::Snapshot::~Snapshot()
+{
+    //nop - here so that MappedFile is complete
+}
+
+std::string
+TileIndex::Snapshot::getLocation(unsigned index) const
+{
+    return std::string(
+        _locations + _locationOffsets[index],
+        _locationOffsets[index + 1] - _locationOffsets[index]);
+}
+
+TileIndex::TileIndex() :
+    _dirty(false),
+    _writeMutex("TileIndex.write(OE)")
 {
 }
 
@@ -45,6 +166,12 @@ TileIndex::~TileIndex()
 
 }
 
+std::string
+TileIndex::getSidecarFilename(const std::string& filename)
+{
+    return filename + ".oeindex";
+}
+
 TileIndex*
 TileIndex::load(const std::string& filename)
 {        
@@ -53,22 +180,260 @@ TileIndex::load(const std::string& filename)
         return 0;
     }
 
+    osg::ref_ptr<TileIndex> index = new TileIndex();
+    index->_filename = filename;
+
+    // Use the sidecar if it's up to date; otherwise read the shapefile.
+    if (!index->loadSidecar())
+    {
+        if (!index->openFeatures() || !index->readFeatures())
+        {
+            OE_NOTICE << "Can't load " << filename << std::endl;
+            return 0;
+        }
+    }
+
+    return index.release();
+}
+
+bool
+TileIndex::openFeatures()
+{
     //Load up an index file
     osg::ref_ptr<OGRFeatureSource> features = new OGRFeatureSource();
-    features->setURL(filename);
+    features->setURL(_filename);
     features->setBuildSpatialIndex(true);
     features->setOpenWrite(true);
 
     if (features->open().isError())
     {
-        OE_NOTICE << "Can't load " << filename << std::endl;
-        return 0;
+        return false;
     }
 
-    TileIndex* index = new TileIndex();
-    index->_features = features.get();
-    index->_filename = filename;
-    return index;
+    _features = features.get();
+    if (!_srs.valid() && _features->getFeatureProfile())
+    {
+        _srs = _features->getFeatureProfile()->getSRS();
+    }
+    return true;
+}
+
+bool
+TileIndex::readFeatures()
+{
+    osg::ref_ptr< osgEarth::FeatureCursor> cursor = _features->createFeatureCursor( osgEarth::Query(), 0L );
+
+    while (cursor.valid() && cursor->hasMore())
+    {
+        osg::ref_ptr< osgEarth::Feature> feature = cursor->nextFeature();
+        if (feature.valid() && feature->getGeometry())
+        {
+            Bounds bounds = feature->getGeometry()->getBounds();
+            PackedRTree::Box box = { bounds.xMin(), bounds.yMin(), bounds.xMax(), bounds.yMax() };
+            _addedBoxes.push_back(box);
+            _addedLocations.push_back(feature->getString("location"));
+        }
+    }
+
+    _dirty = true;
+    rebuild();
+    return _srs.valid();
+}
+
+bool
+TileIndex::loadSidecar()
+{
+    std::string sidecar = getSidecarFilename(_filename);
+    if (!osgDB::fileExists(sidecar) ||
+        getLastModifiedTime(sidecar) < getLastModifiedTime(_filename))
+    {
+        return false;
+    }
+
+    std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+    snapshot->_mapping.reset(new MappedFile());
+    if (!snapshot->_mapping->open(sidecar) ||
+        !attach(*snapshot, snapshot->_mapping->_data, snapshot->_mapping->_size))
+    {
+        OE_WARN << LC << "Ignoring invalid index " << sidecar << std::endl;
+        return false;
+    }
+
+    _srs = snapshot->_srs.get();
+    std::atomic_store(&_snapshot, std::shared_ptr<const Snapshot>(snapshot));
+    OE_INFO << LC << "Mapped " << snapshot->_tree.getNumItems() << " entries from " << sidecar << std::endl;
+    return true;
+}
+
+bool
+TileIndex::attach(Snapshot& snapshot, const void* data, std::size_t size)
+{
+    SidecarHeader header;
+    if (size < sizeof(header))
+        return false;
+
+    ::memcpy(&header, data, sizeof(header));
+    if (::memcmp(header.magic, SIDECAR_MAGIC, 4) != 0 ||
+        header.version != SIDECAR_VERSION ||
+        sizeof(header) + (std::uint64_t)header.srsSize > size ||
+        header.treeOffset % 8u != 0u ||
+        header.treeOffset + header.treeSize > size ||
+        header.locationsOffset % 8u != 0u ||
+        header.locationsOffset + header.locationsSize > size ||
+        header.locationsSize < ((std::uint64_t)header.numItems + 1u) * sizeof(std::uint32_t))
+    {
+        return false;
+    }
+
+    const char* bytes = static_cast<const char*>(data);
+
+    std::string wkt(bytes + sizeof(header), header.srsSize);
+    osg::ref_ptr<const SpatialReference> srs = SpatialReference::create(wkt);
+    if (!srs.valid())
+        return false;
+
+    if (!snapshot._tree.attach(bytes + header.treeOffset, (std::size_t)header.treeSize) ||
+        snapshot._tree.getNumItems() != header.numItems)
+    {
+        return false;
+    }
+
+    const std::uint32_t* offsets = reinterpret_cast<const std::uint32_t*>(bytes + header.locationsOffset);
+    const char* locations = reinterpret_cast<const char*>(offsets + header.numItems + 1u);
+    std::uint64_t charsSize = header.locationsSize - ((std::uint64_t)header.numItems + 1u) * sizeof(std::uint32_t);
+    for (unsigned i = 0; i < header.numItems; ++i)
+    {
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] > charsSize)
+            return false;
+    }
+
+    snapshot._srs = srs.get();
+    snapshot._locationOffsets = offsets;
+    snapshot._locations = locations;
+    snapshot._data = data;
+    snapshot._dataSize = size;
+    return true;
+}
+
+std::shared_ptr<const TileIndex::Snapshot>
+TileIndex::getSnapshot()
+{
+    if (_dirty.load(std::memory_order_acquire))
+        rebuild();
+
+    return std::atomic_load(&_snapshot);
+}
+
+void
+TileIndex::rebuild()
+{
+    Threading::ScopedMutexLock writeLock(_writeMutex);
+
+    // Several readers can see _dirty at once, but only the first one in
+    // rebuilds; the rest find it clear and use the new snapshot. add()
+    // sets it under the same lock, so no entry is missed.
+    if (!_dirty.load(std::memory_order_relaxed))
+        return;
+
+    // Readers keep using the current snapshot while we build the next one
+    std::shared_ptr<const Snapshot> current = std::atomic_load(&_snapshot);
+
+    // Collect everything: what's in the current index plus the new entries
+    std::vector<PackedRTree::Box> boxes;
+    std::vector<std::string> locations;
+    unsigned numExisting = current ? current->_tree.getNumItems() : 0u;
+    boxes.reserve(numExisting + _addedBoxes.size());
+    locations.reserve(numExisting + _addedLocations.size());
+    for (unsigned i = 0; i < numExisting; ++i)
+    {
+        boxes.push_back(current->_tree.getItemBox(i));
+        locations.push_back(current->getLocation(i));
+    }
+    boxes.insert(boxes.end(), _addedBoxes.begin(), _addedBoxes.end());
+    locations.insert(locations.end(), _addedLocations.begin(), _addedLocations.end());
+
+    PackedRTree tree;
+    tree.build(boxes);
+    std::ostringstream treeBuf;
+    tree.write(treeBuf);
+    std::string treeBytes = treeBuf.str();
+
+    std::string wkt = _srs.valid() ? _srs->getWKT() : std::string();
+
+    std::vector<std::uint32_t> offsets;
+    offsets.reserve(locations.size() + 1u);
+    std::string chars;
+    offsets.push_back(0u);
+    for (auto& location : locations)
+    {
+        chars += location;
+        offsets.push_back((std::uint32_t)chars.size());
+    }
+
+    SidecarHeader header;
+    ::memcpy(header.magic, SIDECAR_MAGIC, 4);
+    header.version = SIDECAR_VERSION;
+    header.numItems = (std::uint32_t)locations.size();
+    header.srsSize = (std::uint32_t)wkt.size();
+    header.treeOffset = align8(sizeof(header) + wkt.size());
+    header.treeSize = treeBytes.size();
+    header.locationsOffset = align8(header.treeOffset + header.treeSize);
+    header.locationsSize = offsets.size() * sizeof(std::uint32_t) + chars.size();
+
+    std::size_t size = (std::size_t)(header.locationsOffset + header.locationsSize);
+    std::vector<std::uint64_t> image((size + 7u) / 8u, 0u);
+    char* bytes = reinterpret_cast<char*>(image.data());
+    ::memcpy(bytes, &header, sizeof(header));
+    ::memcpy(bytes + sizeof(header), wkt.data(), wkt.size());
+    ::memcpy(bytes + header.treeOffset, treeBytes.data(), treeBytes.size());
+    ::memcpy(bytes + header.locationsOffset, offsets.data(), offsets.size() * sizeof(std::uint32_t));
+    ::memcpy(bytes + header.locationsOffset + offsets.size() * sizeof(std::uint32_t), chars.data(), chars.size());
+
+    std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>();
+    next->_image.swap(image);
+    if (!attach(*next, next->_image.data(), size))
+    {
+        OE_WARN << LC << "Failed to build the index for " << _filename << std::endl;
+        next = nullptr;
+    }
+
+    // The old snapshot goes away with its last reader
+    std::atomic_store(&_snapshot, std::shared_ptr<const Snapshot>(next));
+
+    _addedBoxes.clear();
+    _addedLocations.clear();
+
+    // after the store, so a reader that sees it clear also sees the snapshot
+    _dirty.store(false, std::memory_order_release);
+}
+
+bool
+TileIndex::writeSidecar()
+{
+    std::shared_ptr<const Snapshot> snapshot = getSnapshot();
+    if (!snapshot)
+        return false;
+
+    std::string sidecar = getSidecarFilename(_filename);
+    std::string temp = sidecar + ".tmp";
+    {
+        std::ofstream out(temp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        out.write(static_cast<const char*>(snapshot->_data), snapshot->_dataSize);
+        if (!out.good())
+        {
+            OE_WARN << LC << "Failed to write " << temp << std::endl;
+            return false;
+        }
+    }
+
+    // rename does not replace an existing file on every platform
+    if (std::rename(temp.c_str(), sidecar.c_str()) != 0)
+    {
+        std::remove(sidecar.c_str());
+        if (std::rename(temp.c_str(), sidecar.c_str()) != 0)
+            return false;
+    }
+    return true;
 }
 
 TileIndex*
@@ -77,6 +442,9 @@ TileIndex::create( const std::string& filename, const osgEarth::SpatialReference
     // Make sure the registry is loaded since that is where the OGR/GDAL registration happens
     osgEarth::Registry::instance();
 
+    // A sidecar left over from an older index would describe the wrong data
+    std::remove( getSidecarFilename(filename).c_str() );
+
     OGR_SCOPED_LOCK;
 
     OGRSFDriverH driver = OGRGetDriverByName( "ESRI Shapefile" );    
@@ -106,20 +474,24 @@ void
 TileIndex::getFiles(const osgEarth::GeoExtent& extent, std::vector< std::string >& files)
 {            
     files.clear();
-    osgEarth::Query query;    
 
-    GeoExtent transformed = extent.transform( _features->getFeatureProfile()->getSRS() );
-    query.bounds() = transformed.bounds();
-    osg::ref_ptr< osgEarth::FeatureCursor> cursor = _features->createFeatureCursor( query, 0L );
+    std::shared_ptr<const Snapshot> snapshot = getSnapshot();
+    if (!snapshot || snapshot->_tree.getNumItems() == 0u)
+        return;
+
+    GeoExtent transformed = extent.transform( snapshot->_srs.get() );
+    PackedRTree::Box query = { transformed.xMin(), transformed.yMin(), transformed.xMax(), transformed.yMax() };
 
-    while (cursor->hasMore())
+    std::vector<unsigned> hits;
+    snapshot->_tree.search(query, hits);
+
+    // report in the order the files were added
+    std::sort(hits.begin(), hits.end());
+
+    for (unsigned hit : hits)
     {
-        osg::ref_ptr< osgEarth::Feature> feature = cursor->nextFeature();
-        if (feature.valid())
-        {
-            std::string location = getFullPath(_filename, feature->getString("location"));
-            files.push_back( location );
-        }
+        std::string location = getFullPath(_filename, snapshot->getLocation(hit));
+        files.push_back( location );
     }    
 }
 
@@ -138,6 +510,22 @@ bool TileIndex::add( const std::string& filename, const GeoExtent& extent )
     const SpatialReference* wgs84 = SpatialReference::create("epsg:4326");
     feature->transform( wgs84 );
 
-    return _features->insertFeature( feature.get() );    
+    Threading::ScopedMutexLock lock(_writeMutex);
+
+    if (!_features.valid() && !openFeatures())
+    {
+        return false;
+    }
+
+    if (!_features->insertFeature( feature.get() ))
+    {
+        return false;
+    }
+
+    Bounds bounds = feature->getGeometry()->getBounds();
+    PackedRTree::Box box = { bounds.xMin(), bounds.yMin(), bounds.xMax(), bounds.yMax() };
+    _addedBoxes.push_back(box);
+    _addedLocations.push_back(filename);
+    _dirty = true;
     return true;
 }
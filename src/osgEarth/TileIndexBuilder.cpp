@@ -93,6 +93,12 @@ void TileIndexBuilder::build(const std::string& indexFilename, const SpatialRefe
         }
     }
 
+    // Save the in-memory index so loading it doesn't have to read the shapefile
+    if (index.valid() && !index->writeSidecar())
+    {
+        OE_WARN << "Failed to write " << TileIndex::getSidecarFilename(indexFilename) << std::endl;
+    }
+
     osg::Timer_t end = osg::Timer::instance()->tick();    
 }
 
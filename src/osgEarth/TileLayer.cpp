@@ -387,7 +387,10 @@ TileLayer::setUpL2Cache(unsigned minSize)
     if (l2CacheSize > 0)
     {
         _memCache = new MemCache(l2CacheSize);
-        OE_INFO << LC << "L2 cache size = " << l2CacheSize << std::endl;
+        if (_memCache->isBudgeted())
+            OE_INFO << LC << "L2 cache shares a global budget of " << MemCache::getGlobalBudget() << " bytes" << std::endl;
+        else
+            OE_INFO << LC << "L2 cache size = " << l2CacheSize << std::endl;
     }
 }
 
@@ -19,6 +19,11 @@
 #include <osgEarth/TileVisitor>
 #include <osgEarth/CacheEstimator>
 #include <osgEarth/FileUtils>
+#include <osgDB/FileUtils>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
 #include <thread>
 
 #if OSG_VERSION_GREATER_OR_EQUAL(3,5,10)
@@ -28,6 +33,8 @@
 #define OS_SYSTEM system
 #endif
 
+#define LC "[TileVisitor] "
+
 using namespace osgEarth;
 using namespace osgEarth::Util;
 
@@ -63,10 +70,22 @@ void TileVisitor::addExtent( const GeoExtent& extent )
 }
 
 void TileVisitor::addDataExtent(const GeoExtent& extent)
+{
+    addDataExtent(DataExtent(extent));
+}
+
+void TileVisitor::addDataExtent(const DataExtent& extent)
 {
     double min[2] = { extent.xMin(), extent.yMin() };
     double max[2] = { extent.xMax(), extent.yMax() };
-    _dataExtentIndex.Insert(min, max, _dataExtentIndex.Count());
+    _dataExtentIndex.Insert(min, max, _dataExtents.size());
+    _dataExtents.push_back(extent);
+}
+
+void TileVisitor::clearDataExtents()
+{
+    _dataExtentIndex.RemoveAll();
+    _dataExtents.clear();
 }
 
 bool TileVisitor::intersects( const GeoExtent& extent )
@@ -85,26 +104,69 @@ bool TileVisitor::intersects( const GeoExtent& extent )
     return false;
 }
 
-bool TileVisitor::hasData(const TileKey& key)
+void TileVisitor::findDataExtents(const TileKey& key, std::vector<unsigned>& hits)
 {
     GeoExtent extent = key.getExtent();
+    double min[2] = { extent.xMin(), extent.yMin() };
+    double max[2] = { extent.xMax(), extent.yMax() };
+    _dataExtentIndex.Search(min, max, &hits, (int)_dataExtents.size());
+}
 
-    // Check the data extents index to see if we might have data in this area.
-    if (_dataExtentIndex.Count() > 0)
+bool TileVisitor::hasData(const TileKey& key)
+{
+    if (_dataExtents.empty())
     {
-        double min[2] = { extent.xMin(), extent.yMin() };
-        double max[2] = { extent.xMax(), extent.yMax() };
-        std::vector< unsigned int > hits;
-        if (_dataExtentIndex.Search(min, max, &hits, 1) == 0)
+        return true;
+    }
+
+    // Only rule out the subtree if no data extent in the area
+    // reaches down to this level.
+    std::vector< unsigned int > hits;
+    findDataExtents(key, hits);
+
+    unsigned lod = key.getLevelOfDetail();
+    for (auto i : hits)
+    {
+        const DataExtent& de = _dataExtents[i];
+        if (!de.maxLevel().isSet() || lod <= de.maxLevel().get())
         {
-            return false;
+            return true;
         }
     }
 
-    // Check the tile handler
-    if (_tileHandler.valid())
+    return false;
+}
+
+bool TileVisitor::shouldProcess(const TileKey& key)
+{
+    unsigned lod = key.getLevelOfDetail();
+    if (lod < _minLevel)
     {
-        _tileHandler->hasData(key);
+        return false;
+    }
+
+    // Skip keys above the min level of every data extent here;
+    // their children may still have data.
+    if (!_dataExtents.empty())
+    {
+        std::vector< unsigned int > hits;
+        findDataExtents(key, hits);
+
+        bool inRange = false;
+        for (auto i : hits)
+        {
+            const DataExtent& de = _dataExtents[i];
+            if ((!de.minLevel().isSet() || lod >= de.minLevel().get()) &&
+                (!de.maxLevel().isSet() || lod <= de.maxLevel().get()))
+            {
+                inRange = true;
+                break;
+            }
+        }
+        if (!inRange)
+        {
+            return false;
+        }
     }
 
     return true;
@@ -165,7 +227,7 @@ void TileVisitor::processKey( const TileKey& key )
     key.getTileXY(x, y);
     lod = key.getLevelOfDetail();
 
-    // Only process this key if it has a chance of succeeding.
+    // Skip the whole subtree if nothing under it can have data.
     if (!hasData(key))
     {
         return;
@@ -176,8 +238,9 @@ void TileVisitor::processKey( const TileKey& key )
     // If the key intersects the extent attempt to traverse
     if (intersects(key.getExtent()))
     {
-        // If the lod is less than the min level don't do anything but do traverse the children.
-        if (lod < _minLevel)
+        // If the key is above the min level (or otherwise has nothing of its own)
+        // don't do anything but do traverse the children.
+        if (!shouldProcess(key))
         {
             traverseChildren = true;
         }
@@ -309,6 +372,409 @@ bool MultithreadedTileVisitor::handleTile(const TileKey& key)
 
 /*****************************************************************************************/
 
+namespace
+{
+    const char PROGRESS_BITMAP_MAGIC[4] = { 'O', 'E', 'P', 'B' };
+    const std::uint32_t PROGRESS_BITMAP_VERSION = 1u;
+}
+
+ProgressBitmap::Block::Block()
+{
+    for (unsigned i = 0; i < 64; ++i)
+        _bits[i] = 0u;
+}
+
+ProgressBitmap::ProgressBitmap() :
+    _mutex("ProgressBitmap(OE)")
+{
+}
+
+std::uint64_t ProgressBitmap::blockID(unsigned lod, unsigned bx, unsigned by)
+{
+    // 6 bits of LOD and 29 bits of block index per axis covers
+    // every tile of every LOD a profile can address.
+    return
+        ((std::uint64_t)lod << 58) |
+        ((std::uint64_t)(bx & 0x1FFFFFFF) << 29) |
+        ((std::uint64_t)(by & 0x1FFFFFFF));
+}
+
+bool ProgressBitmap::isSet(const TileKey& key) const
+{
+    return isSet(key.getLevelOfDetail(), key.getTileX(), key.getTileY());
+}
+
+bool ProgressBitmap::isSet(unsigned lod, unsigned x, unsigned y) const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    auto i = _blocks.find(blockID(lod, x >> 6, y >> 6));
+    if (i == _blocks.end())
+        return false;
+    // one 64-bit word per row of the block
+    return ((i->second._bits[y & 63] >> (x & 63)) & 1u) != 0u;
+}
+
+void ProgressBitmap::set(const TileKey& key)
+{
+    set(key.getLevelOfDetail(), key.getTileX(), key.getTileY());
+}
+
+void ProgressBitmap::set(unsigned lod, unsigned x, unsigned y)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    Block& block = _blocks[blockID(lod, x >> 6, y >> 6)];
+    block._bits[y & 63] |= (std::uint64_t)1u << (x & 63);
+}
+
+std::uint64_t ProgressBitmap::count() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    std::uint64_t total = 0u;
+    for (auto& i : _blocks)
+    {
+        for (unsigned w = 0; w < 64; ++w)
+        {
+            for (std::uint64_t bits = i.second._bits[w]; bits != 0u; bits &= bits - 1u)
+                ++total;
+        }
+    }
+    return total;
+}
+
+void ProgressBitmap::clear()
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _blocks.clear();
+}
+
+bool ProgressBitmap::load(const std::string& filename)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _blocks.clear();
+
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!in.is_open())
+        return false;
+
+    // Layout, in native byte order:
+    // magic[4], version(u32), numBlocks(u64), then per block: id(u64), bits(u64 x 64)
+    char magic[4];
+    std::uint32_t version = 0u;
+    std::uint64_t numBlocks = 0u;
+    in.read(magic, 4);
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&numBlocks), sizeof(numBlocks));
+    if (!in.good() ||
+        std::string(magic, 4) != std::string(PROGRESS_BITMAP_MAGIC, 4) ||
+        version != PROGRESS_BITMAP_VERSION)
+    {
+        OE_WARN << LC << filename << " is not a valid progress file" << std::endl;
+        return false;
+    }
+
+    for (std::uint64_t i = 0; i < numBlocks; ++i)
+    {
+        std::uint64_t id;
+        Block block;
+        in.read(reinterpret_cast<char*>(&id), sizeof(id));
+        in.read(reinterpret_cast<char*>(block._bits), sizeof(block._bits));
+        if (!in.good())
+        {
+            OE_WARN << LC << filename << " is truncated" << std::endl;
+            _blocks.clear();
+            return false;
+        }
+        _blocks[id] = block;
+    }
+
+    return true;
+}
+
+bool ProgressBitmap::save(const std::string& filename) const
+{
+    std::string temp = filename + ".tmp";
+    {
+        std::ofstream out(temp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+            return false;
+
+        Threading::ScopedMutexLock lock(_mutex);
+        std::uint64_t numBlocks = _blocks.size();
+        out.write(PROGRESS_BITMAP_MAGIC, 4);
+        out.write(reinterpret_cast<const char*>(&PROGRESS_BITMAP_VERSION), sizeof(PROGRESS_BITMAP_VERSION));
+        out.write(reinterpret_cast<const char*>(&numBlocks), sizeof(numBlocks));
+        for (auto& i : _blocks)
+        {
+            out.write(reinterpret_cast<const char*>(&i.first), sizeof(i.first));
+            out.write(reinterpret_cast<const char*>(i.second._bits), sizeof(i.second._bits));
+        }
+        if (!out.good())
+            return false;
+    }
+
+    // rename does not replace an existing file on every platform
+    if (std::rename(temp.c_str(), filename.c_str()) != 0)
+    {
+        std::remove(filename.c_str());
+        if (std::rename(temp.c_str(), filename.c_str()) != 0)
+            return false;
+    }
+    return true;
+}
+
+/*****************************************************************************************/
+
+namespace
+{
+    const char* STAGE_NAMES[PipelinedTileVisitor::NUM_STAGES] = { "read", "encode", "write" };
+}
+
+void PipelinedTileVisitor::StageGate::acquire(unsigned capacity)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _cv.wait(_mutex, [this, capacity]() { return _count < capacity; });
+    ++_count;
+}
+
+void PipelinedTileVisitor::StageGate::release()
+{
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        --_count;
+    }
+    _cv.notify_one();
+}
+
+PipelinedTileVisitor::PipelinedTileVisitor() :
+    _queueSize(256u),
+    _checkpointInterval(60.0),
+    _lastCheckpoint(0),
+    _start(0),
+    _elapsed(0.0)
+{
+    unsigned n = Threading::getConcurrency();
+    _stages[STAGE_READ]._numThreads = n;
+    _stages[STAGE_ENCODE]._numThreads = n;
+    // most tile stores are single-writer
+    _stages[STAGE_WRITE]._numThreads = 1u;
+
+    for (unsigned i = 0; i < NUM_STAGES; ++i)
+    {
+        _stages[i]._tiles = 0u;
+        _stages[i]._failed = 0u;
+        _stages[i]._busyMicros = 0u;
+    }
+}
+
+PipelinedTileVisitor::PipelinedTileVisitor(TileHandler* handler) :
+    PipelinedTileVisitor()
+{
+    setTileHandler(handler);
+}
+
+void PipelinedTileVisitor::setNumThreads(Stage stage, unsigned numThreads)
+{
+    _stages[stage]._numThreads = osg::maximum(numThreads, 1u);
+}
+
+unsigned PipelinedTileVisitor::getNumThreads(Stage stage) const
+{
+    return _stages[stage]._numThreads;
+}
+
+void PipelinedTileVisitor::run(const Profile* mapProfile)
+{
+    for (unsigned i = 0; i < NUM_STAGES; ++i)
+    {
+        StageState& stage = _stages[i];
+        stage._tiles = 0u;
+        stage._failed = 0u;
+        stage._busyMicros = 0u;
+        stage._arena = std::make_shared<JobArena>(
+            std::string("oe.pipeline.") + STAGE_NAMES[i],
+            stage._numThreads);
+    }
+
+    _done.clear();
+    if (!_checkpointFile.empty() && osgDB::fileExists(_checkpointFile))
+    {
+        if (_done.load(_checkpointFile))
+        {
+            OE_INFO << LC << "Resuming from " << _checkpointFile
+                << " with " << _done.count() << " tiles done" << std::endl;
+        }
+    }
+
+    _start = osg::Timer::instance()->tick();
+    _lastCheckpoint = _start;
+
+    // Produce the tiles; this blocks whenever the read stage is full.
+    TileVisitor::run(mapProfile);
+
+    _group.join();
+
+    _elapsed = osg::Timer::instance()->delta_s(_start, osg::Timer::instance()->tick());
+
+    if (!_checkpointFile.empty())
+    {
+        checkpoint();
+    }
+
+    OE_INFO << LC << "Pipeline throughput:\n" << getThroughputReport() << std::endl;
+
+    for (unsigned i = 0; i < NUM_STAGES; ++i)
+    {
+        _stages[i]._arena = nullptr;
+    }
+}
+
+bool PipelinedTileVisitor::handleTile(const TileKey& key)
+{
+    // Done in a previous run; still visit the children since
+    // they may not be.
+    if (_done.isSet(key))
+    {
+        incrementProgress(1);
+        return true;
+    }
+
+    if (!_checkpointFile.empty() &&
+        osg::Timer::instance()->delta_s(_lastCheckpoint, osg::Timer::instance()->tick()) >= _checkpointInterval)
+    {
+        checkpoint();
+    }
+
+    dispatch(STAGE_READ, key, nullptr);
+
+    // Like the MultithreadedTileVisitor we can't wait for the
+    // result, so always traverse the children.
+    return true;
+}
+
+void PipelinedTileVisitor::dispatch(Stage stage, const TileKey& key, osg::ref_ptr<osg::Referenced> data)
+{
+    // blocks while the stage is full, which holds back the previous stage
+    _stages[stage]._gate.acquire(_queueSize);
+
+    auto delegate = [this, stage, key, data](Cancelable*)
+    {
+        osg::ref_ptr<osg::Referenced> stageData = data;
+        bool canceled = _progress.valid() && _progress->isCanceled();
+
+        if (!canceled)
+        {
+            bool ok = runStage(stage, key, stageData);
+
+            if (ok && stage + 1 < NUM_STAGES)
+            {
+                dispatch((Stage)(stage + 1), key, stageData);
+            }
+            else
+            {
+                // A tile with no data is as done as a written one.
+                // Encode and write failures are left to retry on resume.
+                if (ok || stage == STAGE_READ)
+                {
+                    finish(key);
+                }
+                incrementProgress(1);
+            }
+        }
+
+        _stages[stage]._gate.release();
+    };
+
+    Job job(_stages[stage]._arena.get(), &_group);
+    job.setName(STAGE_NAMES[stage]);
+    job.dispatch(delegate);
+}
+
+bool PipelinedTileVisitor::runStage(Stage stage, const TileKey& key, osg::ref_ptr<osg::Referenced>& data)
+{
+    StagedTileHandler* staged = dynamic_cast<StagedTileHandler*>(_tileHandler.get());
+
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+
+    bool ok = false;
+    if (stage == STAGE_READ)
+    {
+        if (staged)
+            ok = staged->readTile(key, data);
+        else if (_tileHandler.valid())
+            ok = _tileHandler->handleTile(key, *this);
+    }
+    else if (stage == STAGE_ENCODE)
+    {
+        ok = staged ? staged->encodeTile(key, data) : true;
+    }
+    else
+    {
+        ok = staged ? staged->writeTile(key, data) : true;
+    }
+
+    osg::Timer_t t1 = osg::Timer::instance()->tick();
+
+    StageState& state = _stages[stage];
+    state._busyMicros += (std::uint64_t)osg::Timer::instance()->delta_u(t0, t1);
+    if (ok)
+        ++state._tiles;
+    else
+        ++state._failed;
+
+    return ok;
+}
+
+void PipelinedTileVisitor::finish(const TileKey& key)
+{
+    _done.set(key);
+}
+
+void PipelinedTileVisitor::checkpoint()
+{
+    _lastCheckpoint = osg::Timer::instance()->tick();
+    if (!_done.save(_checkpointFile))
+    {
+        OE_WARN << LC << "Failed to save checkpoint to " << _checkpointFile << std::endl;
+    }
+}
+
+PipelinedTileVisitor::StageStats PipelinedTileVisitor::getStageStats(Stage stage) const
+{
+    const StageState& state = _stages[stage];
+    StageStats stats;
+    stats.tiles = state._tiles;
+    stats.failed = state._failed;
+    stats.busySeconds = 1.0e-6 * (double)state._busyMicros;
+    stats.tilesPerSecond = _elapsed > 0.0 ? (double)stats.tiles / _elapsed : 0.0;
+    return stats;
+}
+
+std::string PipelinedTileVisitor::getThroughputReport() const
+{
+    std::stringstream buf;
+    buf << std::fixed << std::setprecision(1);
+    for (unsigned i = 0; i < NUM_STAGES; ++i)
+    {
+        StageStats stats = getStageStats((Stage)i);
+        unsigned numThreads = _stages[i]._numThreads;
+
+        // how much of the run the stage's threads spent working;
+        // the busiest stage is the bottleneck.
+        double utilization = _elapsed > 0.0 ?
+            100.0 * stats.busySeconds / (_elapsed * (double)numThreads) : 0.0;
+
+        buf << "  " << std::left << std::setw(7) << STAGE_NAMES[i] << std::right
+            << stats.tilesPerSecond << " tiles/s, "
+            << stats.tiles << " tiles, "
+            << stats.failed << " rejected, "
+            << numThreads << " threads, "
+            << utilization << "% busy\n";
+    }
+    return buf.str();
+}
+
+/*****************************************************************************************/
+
 TaskList::TaskList(const Profile* profile):
 _profile( profile )
 {
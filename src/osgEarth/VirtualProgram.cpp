@@ -118,9 +118,19 @@ namespace
 #define LC "[ProgramRepo] "
 
 ProgramRepo::ProgramRepo() :
-    Threading::Mutexed<osg::Referenced>("ProgramRepo(OE)"),
-    _releaseUnusedPrograms(true)
-{
+    _mutex("ProgramRepo(OE)"),
+    _releaseUnusedPrograms(true),
+    _statsFrame(0u),
+    _lookups(0u),
+    _misses(0u),
+    _links(0u),
+    _statsMutex("ProgramRepo Stats(OE)")
+{
+    _lastStats.frameNumber = 0u;
+    _lastStats.lookups = 0u;
+    _lastStats.misses = 0u;
+    _lastStats.links = 0u;
+
     const char* value = ::getenv("OSGEARTH_PROGRAM_BINARY_CACHE_PATH");
     if (value)
         setProgramBinaryCacheLocation(value);
@@ -131,18 +141,65 @@ ProgramRepo::~ProgramRepo()
     releaseGLObjects(NULL);
 }
 
+std::uint64_t
+ProgramRepo::hash(const ProgramKey& key)
+{
+    std::uint64_t h = 0xcbf29ce484222325ull;
+    for (ProgramKey::const_iterator i = key.begin(); i != key.end(); ++i)
+    {
+        h = (h ^ (std::uint64_t)(*i)) * 0x9e3779b97f4a7c15ull;
+        h ^= (h >> 32);
+    }
+    return h;
+}
+
+void
+ProgramRepo::count(unsigned frameNumber, std::atomic<unsigned>& counter)
+{
+    if (frameNumber > _statsFrame)
+    {
+        // first call in a new frame: roll the counters over
+        Threading::ScopedMutexLock lock(_statsMutex);
+        if (frameNumber > _statsFrame)
+        {
+            _lastStats.frameNumber = _statsFrame;
+            _lastStats.lookups = _lookups.exchange(0u);
+            _lastStats.misses = _misses.exchange(0u);
+            _lastStats.links = _links.exchange(0u);
+            _statsFrame = frameNumber;
+        }
+    }
+    ++counter;
+}
+
+ProgramRepo::Stats
+ProgramRepo::getStats() const
+{
+    Threading::ScopedMutexLock lock(_statsMutex);
+    return _lastStats;
+}
+
+unsigned
+ProgramRepo::getNumPrograms() const
+{
+    Threading::ScopedReadLock lock(_mutex);
+    std::set<const Entry*> entries;
+    for (ProgramMap::const_iterator i = _db.begin(); i != _db.end(); ++i)
+        entries.insert(i->second._entry.get());
+    return entries.size();
+}
+
 void
 ProgramRepo::setReleaseUnusedPrograms(bool value)
 {
-    lock();
+    Threading::ScopedWriteLock lock(_mutex);
     _releaseUnusedPrograms = value;
-    unlock();
 }
 
 void
 ProgramRepo::setProgramBinaryCacheLocation(const std::string& folder)
 {
-    lock();
+    Threading::ScopedWriteLock lock(_mutex);
     if (osgDB::makeDirectory(folder) == true)
     {
         _programBinaryCacheFolder = folder;
@@ -151,7 +208,6 @@ ProgramRepo::setProgramBinaryCacheLocation(const std::string& folder)
     {
         OE_WARN << LC << "Failed to access program binary cache location " << folder << std::endl;
     }
-    unlock();
 }
 
 bool
@@ -161,71 +217,94 @@ ProgramRepo::isProgramBinaryCachingActive() const
 }
 
 osg::ref_ptr<osg::Program>
-ProgramRepo::use(const ProgramKey& key, unsigned frameNumber, UID user)
+ProgramRepo::use(const ProgramKey& key, std::uint64_t keyHash, unsigned frameNumber, UID user)
 {
-    ProgramMap::iterator i = _db.find(key);
-    if (i != _db.end())
+    count(frameNumber, _lookups);
+
+    Threading::ScopedReadLock lock(_mutex);
+
+    std::pair<ProgramMap::iterator, ProgramMap::iterator> range = _db.equal_range(keyHash);
+    for (ProgramMap::iterator i = range.first; i != range.second; ++i)
     {
-        Entry* e = i->second.get();
-        e->_frameLastUsed = frameNumber;
-        e->_users.insert(user);
+        if (i->second._key == key)
+        {
+            Entry* e = i->second._entry.get();
+            e->_frameLastUsed = frameNumber;
 
-        //OE_TEST << LC << "PR USE prog=" << e->_program.get() << " user=" << (user) << " total=" << e->_users.size() << std::endl;
+            Threading::ScopedMutexLock usersLock(e->_usersMutex);
+            e->_users.insert(user);
+
+            //OE_TEST << LC << "PR USE prog=" << e->_program.get() << " user=" << (user) << " total=" << e->_users.size() << std::endl;
 
-        return e->_program;
+            return e->_program;
+        }
     }
+
+    count(frameNumber, _misses);
     return 0L;
 }
 
 void
 ProgramRepo::release(UID user, osg::State* state)
 {
+    Threading::ScopedWriteLock lock(_mutex);
+
     if (user <= 0 || _releaseUnusedPrograms == false)
         return;
 
     for (ProgramMap::iterator i = _db.begin(); i != _db.end(); )
     {
-        Entry* e = i->second.get();
-        bool increment = true;
+        Entry* e = i->second._entry.get();
 
-        if (e->_users.find(user) != e->_users.end())
+        // remove "user" from the users list:
+        if (e->_users.erase(user) > 0 && e->_users.empty())
         {
-            // remove "user" from the users list:
-            e->_users.erase(user);
-
-            //OE_TEST << LC << "PR REL prog=" << (e->_program.get()) << " user=" << (user) << " total=" << e->_users.size() << std::endl;
+            // release the GL memory
+            e->_program->releaseGLObjects(state);
 
-            if (e->_users.empty())
-            {
-                // release the GL memory
-                e->_program->releaseGLObjects(state);
-
-                OE_TEST << LC << "Released program " << e->_program->getName() << "; dbsize=" << _db.size() - 1 << std::endl;
-
-                // remove from the repo
-                _db.erase(i++);
-                increment = false;
-            }
+            OE_TEST << LC << "Released program " << e->_program->getName() << "; dbsize=" << _db.size() - 1 << std::endl;
         }
 
-        if (increment)
+        // remove from the repo, along with any other keys sharing the entry
+        if (e->_users.empty())
+            i = _db.erase(i);
+        else
             ++i;
     }
 }
 
 void
-ProgramRepo::add(const ProgramKey& key, osg::ref_ptr<osg::Program>& in_out, unsigned frameNumber, UID user)
+ProgramRepo::add(const ProgramKey& key, std::uint64_t keyHash, osg::ref_ptr<osg::Program>& in_out, unsigned frameNumber, UID user)
 {
+    Threading::ScopedWriteLock lock(_mutex);
+
+    // Another thread may have added this key since our lookup:
+    std::pair<ProgramMap::iterator, ProgramMap::iterator> range = _db.equal_range(keyHash);
+    for (ProgramMap::iterator i = range.first; i != range.second; ++i)
+    {
+        if (i->second._key == key)
+        {
+            Entry* e = i->second._entry.get();
+            in_out = e->_program.get();
+            e->_frameLastUsed = frameNumber;
+            e->_users.insert(user);
+            return;
+        }
+    }
+
+    Slot slot;
+    slot._key = key;
+
     // First try to find an entry with an equivalent program:
     for (ProgramMap::iterator i = _db.begin(); i != _db.end(); ++i)
     {
-        osg::ref_ptr<Entry>& e = i->second;
+        osg::ref_ptr<Entry>& e = i->second._entry;
 
         // same pointer? do nothing but update the user
         if (e->_program.get() == in_out.get())
         {
-            osg::ref_ptr<Entry>& newEntry = _db[key];
-            newEntry = e.get();
+            slot._entry = e.get();
+            _db.insert(std::make_pair(keyHash, slot));
             in_out = e->_program.get();
             e->_users.insert(user);
 
@@ -238,8 +317,8 @@ ProgramRepo::add(const ProgramKey& key, osg::ref_ptr<osg::Program>& in_out, unsi
         // and let input go out of scope
         else if (e->_program->compare(*in_out.get()) == 0)
         {
-            osg::ref_ptr<Entry>& newEntry = _db[key];
-            newEntry = e.get();
+            slot._entry = e.get();
+            _db.insert(std::make_pair(keyHash, slot));
             in_out = e->_program.get();
             e->_users.insert(user);
 
@@ -249,11 +328,11 @@ ProgramRepo::add(const ProgramKey& key, osg::ref_ptr<osg::Program>& in_out, unsi
         }
     }
 
-    osg::ref_ptr<Entry>& newEntry = _db[key];
-    newEntry = new Entry();
-    newEntry->_program = in_out.get();
-    newEntry->_frameLastUsed = frameNumber;
-    newEntry->_users.insert(user);
+    slot._entry = new Entry();
+    slot._entry->_program = in_out.get();
+    slot._entry->_frameLastUsed = frameNumber;
+    slot._entry->_users.insert(user);
+    _db.insert(std::make_pair(keyHash, slot));
 }
 
 void
@@ -265,20 +344,21 @@ ProgramRepo::prune(unsigned frameNumber, osg::State* state)
 void
 ProgramRepo::resizeGLObjectBuffers(unsigned maxSize)
 {
+    Threading::ScopedReadLock lock(_mutex);
     for (ProgramMap::iterator i = _db.begin(); i != _db.end(); ++i)
     {
-        i->second->_program->resizeGLObjectBuffers(maxSize);
+        i->second._entry->_program->resizeGLObjectBuffers(maxSize);
     }
 }
 
 void
 ProgramRepo::releaseGLObjects(osg::State* state) const
 {
+    Threading::ScopedWriteLock lock(_mutex);
     OE_TEST << LC << "Main release, size=" << _db.size() << std::endl;
-    // First try to find an entry with an equivalent program:
     for (ProgramMap::iterator i = _db.begin(); i != _db.end(); ++i)
     {
-        osg::ref_ptr<Entry>& e = i->second;
+        osg::ref_ptr<Entry>& e = i->second._entry;
         e->_program->releaseGLObjects(state);
         OE_TEST << LC << "...released program " << e->_program->getName() << std::endl;
     }
@@ -294,6 +374,8 @@ ProgramRepo::linkProgram(
 {
     OE_PROFILING_ZONE_NAMED("link");
 
+    count(state.getFrameStamp() ? state.getFrameStamp()->getFrameNumber() : 0u, _links);
+
     if (isProgramBinaryCachingActive())
     {
         bool readFromCache = false;
@@ -1049,9 +1131,7 @@ VirtualProgram::~VirtualProgram()
 #ifdef USE_PROGRAM_REPO
     if (Registry::instance())
     {
-        Registry::programRepo().lock();
         Registry::programRepo().release(_id, 0L);
-        Registry::programRepo().unlock();
     }
 #endif
 
@@ -1153,9 +1233,7 @@ void
 VirtualProgram::resizeGLObjectBuffers(unsigned maxSize)
 {
 #ifdef USE_PROGRAM_REPO
-    Registry::programRepo().lock();
     Registry::programRepo().resizeGLObjectBuffers(maxSize);
-    Registry::programRepo().unlock();
 #endif
 
     // Resize shaders in the PolyShader
@@ -1177,9 +1255,7 @@ VirtualProgram::releaseGLObjects(osg::State* state) const
     OE_TEST << LC << "VP::RGLO (" << _id << ") " << getName() << " (" << (_lastUsedProgram[0].get()) << ") state=" << (uintptr_t)state << std::endl;
 
 #ifdef USE_PROGRAM_REPO
-    Registry::programRepo().lock();
     Registry::programRepo().release(_id, state);
-    Registry::programRepo().unlock();
 #endif
 
 #ifdef USE_LAST_USED_PROGRAM
@@ -1424,9 +1500,7 @@ VirtualProgram::setInheritShaders(bool value)
 #ifdef USE_PROGRAM_REPO
         // clear the program cache please
         {
-            Registry::programRepo().lock();
             Registry::programRepo().release(_id, 0L);
-            Registry::programRepo().unlock();
         }
 #endif
 
@@ -1595,10 +1669,10 @@ VirtualProgram::apply(osg::State& state) const
         unsigned frameNumber = state.getFrameStamp() ? state.getFrameStamp()->getFrameNumber() : 0;
 
 #ifdef USE_PROGRAM_REPO
-        // LOCK the program repo to look up the program.
-        Registry::programRepo().lock();
-
-        program = Registry::programRepo().use(local.programKey, frameNumber, _id);
+        // look up the program. Only the hash goes into the map search;
+        // the full key breaks ties.
+        std::uint64_t keyHash = ProgramRepo::hash(local.programKey);
+        program = Registry::programRepo().use(local.programKey, keyHash, frameNumber, _id);
 #endif
 
         if (!program.valid())
@@ -1653,13 +1727,13 @@ VirtualProgram::apply(osg::State& state) const
 #ifdef USE_PROGRAM_REPO
             // Adds this program to the repo, or finds an equivalent pre-existing program
             // in the repo and associates this program key with it.
-            Registry::programRepo().add(local.programKey, program, frameNumber, _id);
+            keyHash = ProgramRepo::hash(local.programKey);
+            Registry::programRepo().add(local.programKey, keyHash, program, frameNumber, _id);
 
             // purge expired programs.
             Registry::programRepo().prune(frameNumber, &state);
 #endif
         }
-        Registry::programRepo().unlock();
         key = local.programKey;
     }
 
@@ -28,7 +28,6 @@
 #define LC "[XYZFeatureSource] " << getName() << " : "
 
 using namespace osgEarth;
-#define OGR_SCOPED_LOCK GDAL_SCOPED_LOCK
 
 //........................................................................
 
@@ -199,8 +198,7 @@ XYZFeatureSource::getFeatures(const std::string& buffer, const TileKey& key, con
     if (mimeType == "application/x-protobuf" || mimeType == "binary/octet-stream" || mimeType == "application/octet-stream")
     {
 #ifdef OSGEARTH_HAVE_MVT
-        std::stringstream in(buffer);
-        return MVT::readTile(in, key, features);
+        return MVT::readTile(buffer.data(), buffer.size(), key, features);
 #else
         if (getStatus().isOK())
         {
@@ -212,8 +210,8 @@ XYZFeatureSource::getFeatures(const std::string& buffer, const TileKey& key, con
     }
     else
     {
-        // find the right driver for the given mime type
-        OGR_SCOPED_LOCK;
+        // No GDAL lock needed: the datasource is created and destroyed
+        // locally, and OGR datasets are safe to use from one thread at a time.
 
         // find the right driver for the given mime type
         OGRSFDriverH ogrDriver =
@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include "FileSystemCache"
+#include "PackFile"
 #include <osgEarth/Cache>
 #include <osgEarth/StringUtils>
 #include <osgEarth/Threading>
@@ -27,10 +28,12 @@
 #include <osgEarth/Registry>
 #include <osgEarth/NetworkMonitor>
 #include <osgEarth/Metrics>
+#include <osgEarth/DateTime>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
 #include <osgDB/WriteFile>
 #include <fstream>
+#include <sstream>
 #include <sys/stat.h>
 
 using namespace osgEarth;
@@ -127,6 +130,12 @@ namespace
 
         const osgDB::Options* mergeOptions(const osgDB::Options* in);
 
+        std::shared_ptr<PackFile> getPack();
+
+        ReadResult readFromPack(const std::string& key, const osgDB::Options* dbo);
+
+        bool writeToPack(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* dbo);
+
         bool                              _ok;
         bool                              _binPathExists;
         std::string                       _metaPath;       // full path to the bin's metadata file
@@ -138,6 +147,10 @@ namespace
         // pool for asynchronous writes
         std::shared_ptr<JobArena> _jobArena;
 
+        // record storage when the pack_files option is set
+        std::shared_ptr<PackFile> _pack;
+        Mutex _packMutex;
+
     public:
         // cache for objects waiting to be written; this supports reading from
         // the cache before the object has been asynchronously written to disk.
@@ -331,7 +344,8 @@ namespace
         _options(options),
         _ok(true),
         _fileGate("CacheBinFileGate(OE)"),
-        _writeCacheRWM("CacheBinWriteL2(OE)")
+        _writeCacheRWM("CacheBinWriteL2(OE)"),
+        _packMutex("CacheBinPack(OE)")
     {
         _binPath = osgDB::concatPaths(rootPath, binID);
         _metaPath = osgDB::concatPaths(_binPath, "osgearth_cacheinfo.json");
@@ -379,12 +393,163 @@ namespace
         }
     }
 
+    std::shared_ptr<PackFile>
+    FileSystemCacheBin::getPack()
+    {
+        ScopedMutexLock lock(_packMutex);
+        if (!_pack)
+        {
+            _pack = std::make_shared<PackFile>(
+                _binPath,
+                (std::size_t)_options.packFileSize().get() * 1048576u,
+                _jobArena);
+        }
+        return _pack;
+    }
+
+    ReadResult
+    FileSystemCacheBin::readFromPack(const std::string& key, const osgDB::Options* readOptions)
+    {
+        OE_PROFILING_ZONE;
+
+        if (_jobArena)
+        {
+            // first check the write-pending cache (see readObject)
+            ScopedReadLock lock(_writeCacheRWM);
+
+            auto i = _writeCache.find(key);
+            if (i != _writeCache.end())
+            {
+                ReadResult rr(
+                    const_cast<osg::Object*>(i->second.object.get()),
+                    i->second.meta);
+
+                rr.setLastModifiedTime(DateTime().asTimeStamp());
+                return rr;
+            }
+        }
+
+        PackFile::Record record;
+        if (!getPack()->read(key, record))
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+        osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
+
+        // deserialize straight out of the mapped pack
+        MemoryStreamBuf buf(record.data, record.length);
+        std::istream in(&buf);
+
+        osgDB::ReaderWriter::ReadResult r;
+        if (record.type == PackFile::TYPE_IMAGE)
+        {
+            osg::ref_ptr<osgDB::ReaderWriter> image_rw =
+                osgDB::Registry::instance()->getReaderWriterForExtension(_options.format().get());
+
+            if (!image_rw.valid())
+                return ReadResult(Stringify() << "Unknown image format \"" << _options.format().get() << "\"");
+
+            r = image_rw->readImage(in, dbo.get());
+        }
+        else
+        {
+            r = _rw->readObject(in, dbo.get());
+        }
+
+        if (!r.success())
+            return ReadResult(r.message());
+
+        ReadResult rr(r.getObject(), record.meta);
+        rr.setLastModifiedTime(record.timestamp);
+
+        if (_s_debug)
+            OE_NOTICE << LC << "Read \"" << key << "\" from pack in cache bin [" << getID() << "]" << std::endl;
+
+        return rr;
+    }
+
+    bool
+    FileSystemCacheBin::writeToPack(
+        const std::string& key,
+        const osg::Object* object,
+        const Config& meta,
+        const osgDB::Options* writeOptions)
+    {
+        // another process has the bin; it already warned about that
+        std::shared_ptr<PackFile> pack = getPack();
+        if (!pack->isOpen())
+            return false;
+
+        std::stringstream buf;
+        PackFile::RecordType type;
+        bool writeOK = false;
+        std::string message;
+
+        if (dynamic_cast<const osg::Image*>(object))
+        {
+            const osg::Image* image = static_cast<const osg::Image*>(object);
+            type = PackFile::TYPE_IMAGE;
+
+            osg::ref_ptr<osgDB::ReaderWriter> image_rw =
+                osgDB::Registry::instance()->getReaderWriterForExtension(_options.format().get());
+
+            if (image->isCompressed())
+            {
+                OE_SOFT_ASSERT(image->isCompressed() == false);
+            }
+            else if (image_rw.valid())
+            {
+                osgDB::ReaderWriter::WriteResult r = image_rw->writeImage(*image, buf, writeOptions);
+                writeOK = r.success();
+                message = r.message();
+            }
+        }
+        else if (dynamic_cast<const osg::Node*>(object))
+        {
+            type = PackFile::TYPE_NODE;
+            osgDB::ReaderWriter::WriteResult r = _rw->writeNode(*static_cast<const osg::Node*>(object), buf, writeOptions);
+            writeOK = r.success();
+            message = r.message();
+        }
+        else
+        {
+            type = PackFile::TYPE_OBJECT;
+            osgDB::ReaderWriter::WriteResult r = _rw->writeObject(*object, buf, writeOptions);
+            writeOK = r.success();
+            message = r.message();
+        }
+
+        if (writeOK)
+        {
+            writeOK = pack->write(key, type, buf.str(), meta);
+        }
+
+        if (!writeOK)
+        {
+            OE_WARN << LC << "FAILED to write \"" << key << "\" to pack in cache bin \"" <<
+                getID() << "\"; msg = \"" << message << "\"" << std::endl;
+        }
+
+        return writeOK;
+    }
+
     ReadResult
     FileSystemCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
     {
         if ( !binValidForReading() )
             return ReadResult(ReadResult::RESULT_NOT_FOUND);
 
+        if (_options.packFiles() == true)
+        {
+            ReadResult rr = readFromPack(key, readOptions);
+
+            // compressed cache data means there was an internal error
+            OE_SOFT_ASSERT_AND_RETURN(
+                rr.getImage() == nullptr || rr.getImage()->isCompressed() == false,
+                ReadResult());
+
+            return rr;
+        }
+
         // mangle "key" into a legal path name
         URI fileURI( key, _metaPath );
         //std::string path = fileURI.full() + OSG_EXT;
@@ -471,6 +636,9 @@ namespace
         if ( !binValidForReading() )
             return ReadResult(ReadResult::RESULT_NOT_FOUND);
 
+        if (_options.packFiles() == true)
+            return readFromPack(key, readOptions);
+
         // mangle "key" into a legal path name
         URI fileURI( key, _metaPath );
         std::string path = fileURI.full() + OSG_EXT;
@@ -592,6 +760,36 @@ namespace
         osg::ref_ptr<const osg::Object> object(raw_object);
         osg::ref_ptr<const osgDB::Options> writeOptions(dbo);
 
+        if (_options.packFiles() == true)
+        {
+            auto pack_write_op = [=](Cancelable*)
+            {
+                OE_PROFILING_ZONE_NAMED("OE FS Cache Pack Write");
+
+                writeToPack(key, object.get(), meta, writeOptions.get());
+
+                // the pack index is already updated, so readers can move on
+                ScopedWriteLock lock(_writeCacheRWM);
+                _writeCache.erase(key);
+            };
+
+            if (_jobArena != nullptr)
+            {
+                _writeCacheRWM.write_lock();
+                WriteCacheRecord& record = _writeCache[key];
+                record.meta = meta;
+                record.object = object;
+                _writeCacheRWM.write_unlock();
+
+                Job(_jobArena.get()).dispatch(pack_write_op);
+                return true;
+            }
+            else
+            {
+                return writeToPack(key, object.get(), meta, writeOptions.get());
+            }
+        }
+
         auto write_op = [=](Cancelable*)
         {
             OE_PROFILING_ZONE_NAMED("OE FS Cache Write");
@@ -690,6 +888,9 @@ namespace
         if ( !binValidForReading() )
             return STATUS_NOT_FOUND;
 
+        if (_options.packFiles() == true)
+            return getPack()->exists(key) ? STATUS_OK : STATUS_NOT_FOUND;
+
         URI fileURI( key, _metaPath );
         std::string path( fileURI.full() + OSG_EXT );
         if ( !osgDB::fileExists(path) )
@@ -702,6 +903,10 @@ namespace
     FileSystemCacheBin::remove(const std::string& key)
     {
         if ( !binValidForReading() ) return false;
+
+        if (_options.packFiles() == true)
+            return getPack()->remove(key);
+
         URI fileURI( key, _metaPath );
         std::string path( fileURI.full() + OSG_EXT );
 
@@ -714,6 +919,10 @@ namespace
     FileSystemCacheBin::touch(const std::string& key)
     {
         if ( !binValidForReading() ) return false;
+
+        if (_options.packFiles() == true)
+            return getPack()->touch(key);
+
         URI fileURI( key, _metaPath );
         std::string path( fileURI.full() + OSG_EXT );
 
@@ -771,6 +980,10 @@ namespace
         if ( !binValidForReading() )
             return false;
 
+        // a handful of unlinks instead of one per record
+        if (_options.packFiles() == true)
+            return getPack()->clear();
+
         std::string binDir = osgDB::getFilePath( _metaPath );
         return purgeDirectory( binDir );
     }
@@ -0,0 +1,1387 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "PackFile"
+#include <osgEarth/Notify>
+#include <osgEarth/Metrics>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <tuple>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#   ifndef WIN32_LEAN_AND_MEAN
+#       define WIN32_LEAN_AND_MEAN
+#   endif
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/file.h>
+#   include <sys/mman.h>
+#   include <unistd.h>
+#endif
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+
+#define LC "[PackFile] "
+
+namespace
+{
+    const std::uint32_t RECORD_MAGIC  = 0x5250454F; // "OEPR"
+    const std::uint32_t INDEX_MAGIC   = 0x4950454F; // "OEPI"
+    const std::uint32_t INDEX_VERSION = 1u;
+    const std::uint32_t TOMBSTONE     = 0xFFFFFFFF;
+    const std::uint32_t TYPE_REMOVED  = 0xFF;
+
+    // number of index changes to hold in memory before writing a new index run
+    const std::size_t MAX_OVERLAY = 65536u;
+
+    struct RecordHeader
+    {
+        std::uint32_t magic;
+        std::uint32_t type;
+        std::uint32_t keyLength;
+        std::uint32_t metaLength;
+        std::uint64_t payloadLength;
+        std::int64_t timestamp;
+    };
+
+    struct IndexHeader
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint64_t count;
+    };
+
+    std::uint64_t getFileSize(const std::string& path)
+    {
+#ifdef _WIN32
+        struct _stat64 s;
+        if (::_stat64(path.c_str(), &s) != 0)
+            return 0u;
+#else
+        struct stat s;
+        if (::stat(path.c_str(), &s) != 0)
+            return 0u;
+#endif
+        return (std::uint64_t)s.st_size;
+    }
+
+    std::int64_t now()
+    {
+        return (std::int64_t)::time(nullptr);
+    }
+
+    // fseek with a 64-bit offset; packs can grow past 2GB
+    int seek64(std::FILE* file, std::uint64_t offset)
+    {
+#ifdef _WIN32
+        return ::_fseeki64(file, (__int64)offset, SEEK_SET);
+#else
+        return ::fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+    }
+
+    const std::intptr_t NO_LOCK = -1;
+
+    // Takes an exclusive advisory lock on the file at "path", creating it
+    // if necessary. The OS drops the lock when the handle closes, or when
+    // the process dies. Returns NO_LOCK if someone else holds it.
+    std::intptr_t lockFile(const std::string& path)
+    {
+#ifdef _WIN32
+        HANDLE handle = ::CreateFileA(
+            path.c_str(),
+            GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr,
+            OPEN_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL,
+            nullptr);
+
+        if (handle == INVALID_HANDLE_VALUE)
+            return NO_LOCK;
+
+        OVERLAPPED overlapped = {};
+        if (!::LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &overlapped))
+        {
+            ::CloseHandle(handle);
+            return NO_LOCK;
+        }
+        return (std::intptr_t)handle;
+#else
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+            return NO_LOCK;
+
+        if (::flock(fd, LOCK_EX | LOCK_NB) != 0)
+        {
+            ::close(fd);
+            return NO_LOCK;
+        }
+        return (std::intptr_t)fd;
+#endif
+    }
+
+    void unlockFile(std::intptr_t lock)
+    {
+#ifdef _WIN32
+        ::CloseHandle((HANDLE)lock);
+#else
+        ::close((int)lock);
+#endif
+    }
+
+    // Calls func(header, offset, length, key) for each intact record in
+    // a pack, starting at "offset". Returns the offset just past the last
+    // intact record, which is the end of the pack unless its tail is torn.
+    template<typename FUNC>
+    std::uint64_t scanRecords(const MappedFile& pack, std::uint64_t offset, FUNC&& func)
+    {
+        RecordHeader header;
+        while (offset + sizeof(RecordHeader) <= pack.size())
+        {
+            ::memcpy(&header, pack.data() + offset, sizeof(RecordHeader));
+
+            if (header.magic != RECORD_MAGIC || header.payloadLength > pack.size())
+                break;
+
+            std::uint64_t length =
+                sizeof(RecordHeader) + header.keyLength + header.metaLength + header.payloadLength;
+
+            if (offset + length > pack.size())
+                break;
+
+            func(header, offset, length, std::string(pack.data() + offset + sizeof(RecordHeader), header.keyLength));
+
+            offset += length;
+        }
+        return offset;
+    }
+}
+
+//........................................................................
+
+std::shared_ptr<MappedFile>
+MappedFile::open(const std::string& path)
+{
+    std::shared_ptr<MappedFile> file(new MappedFile());
+
+#ifdef _WIN32
+    HANDLE handle = ::CreateFileA(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+
+    if (handle == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    file->_handle = handle;
+
+    LARGE_INTEGER size;
+    if (!::GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+        return nullptr;
+
+    HANDLE mapping = ::CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+        return nullptr;
+
+    file->_mapping = mapping;
+
+    void* data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr)
+        return nullptr;
+
+    file->_data = static_cast<const char*>(data);
+    file->_size = (std::size_t)size.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat s;
+    if (::fstat(fd, &s) != 0 || s.st_size == 0)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+
+    void* data = ::mmap(nullptr, (std::size_t)s.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+        return nullptr;
+
+    file->_data = static_cast<const char*>(data);
+    file->_size = (std::size_t)s.st_size;
+#endif
+
+    return file;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (_data)
+        ::UnmapViewOfFile(_data);
+    if (_mapping)
+        ::CloseHandle(_mapping);
+    if (_handle)
+        ::CloseHandle(_handle);
+#else
+    if (_data)
+        ::munmap(const_cast<char*>(_data), _size);
+#endif
+}
+
+//........................................................................
+
+MemoryStreamBuf::MemoryStreamBuf(const char* data, std::size_t length)
+{
+    // the buffer is never written to; std::streambuf just wants char*
+    char* begin = const_cast<char*>(data);
+    setg(begin, begin, begin + length);
+}
+
+MemoryStreamBuf::pos_type
+MemoryStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if ((which & std::ios_base::in) == 0)
+        return pos_type(off_type(-1));
+
+    char* target =
+        dir == std::ios_base::beg ? eback() + off :
+        dir == std::ios_base::cur ? gptr() + off :
+        egptr() + off;
+
+    if (target < eback() || target > egptr())
+        return pos_type(off_type(-1));
+
+    setg(eback(), target, egptr());
+    return pos_type(target - eback());
+}
+
+MemoryStreamBuf::pos_type
+MemoryStreamBuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+//........................................................................
+
+const PackFile::IndexEntry*
+PackFile::Run::begin() const
+{
+    return reinterpret_cast<const IndexEntry*>(file->data() + sizeof(IndexHeader));
+}
+
+const PackFile::IndexEntry*
+PackFile::Run::end() const
+{
+    return begin() + (file->size() - sizeof(IndexHeader)) / sizeof(IndexEntry);
+}
+
+//........................................................................
+
+PackFile::PackFile(
+    const std::string& path,
+    std::size_t maxPackSize,
+    std::shared_ptr<JobArena> arena) :
+
+    _path(path),
+    _maxPackSize(std::max(maxPackSize, (std::size_t)1048576u)),
+    _arena(arena),
+    _lock(NO_LOCK),
+    _mutex("PackFile(OE)"),
+    _nextGeneration(0u),
+    _journal(nullptr),
+    _appendMutex("PackFile.append(OE)"),
+    _current(nullptr),
+    _currentPack(0u),
+    _currentSize(0u),
+    _mergeMutex("PackFile.merge(OE)")
+{
+    open();
+}
+
+PackFile::~PackFile()
+{
+    flush();
+
+    if (_current)
+        std::fclose(_current);
+
+    if (_journal)
+        std::fclose(_journal);
+
+    if (_lock != NO_LOCK)
+        unlockFile(_lock);
+}
+
+std::uint64_t
+PackFile::hashKey(const std::string& key)
+{
+    // FNV-1a; the hash is persisted, so it must not vary across runs
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : key)
+    {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::uint32_t
+PackFile::packOf(const IndexEntry& entry)
+{
+    return entry.pack == TOMBSTONE ? entry.reserved : entry.pack;
+}
+
+std::string
+PackFile::packName(std::uint32_t pack) const
+{
+    char buf[32];
+    sprintf(buf, "pack_%05u.dat", pack);
+    return osgDB::concatPaths(_path, buf);
+}
+
+std::string
+PackFile::runName(std::uint32_t generation) const
+{
+    char buf[32];
+    sprintf(buf, "index_%05u.idx", generation);
+    return osgDB::concatPaths(_path, buf);
+}
+
+void
+PackFile::open()
+{
+    osgDB::makeDirectory(_path);
+
+    // only one process at a time may use the packs:
+    _lock = lockFile(osgDB::concatPaths(_path, "pack.lock"));
+    if (_lock == NO_LOCK)
+    {
+        OE_WARN << LC << "Cache bin " << _path << " is in use by another process; "
+            "pack storage is disabled for this bin" << std::endl;
+        return;
+    }
+
+    // find the existing packs and index runs:
+    bool hasPacks = false;
+    bool runsOK = true;
+    std::vector<std::uint32_t> generations;
+    std::uint32_t lastPack = 0u;
+    osgDB::DirectoryContents files = osgDB::getDirectoryContents(_path);
+    for (auto& name : files)
+    {
+        unsigned number;
+        if (sscanf(name.c_str(), "pack_%u.dat", &number) == 1 &&
+            name == osgDB::getSimpleFileName(packName(number)))
+        {
+            _packs[number].bytes = getFileSize(osgDB::concatPaths(_path, name));
+            lastPack = hasPacks ? std::max(lastPack, (std::uint32_t)number) : number;
+            hasPacks = true;
+        }
+
+        else if (sscanf(name.c_str(), "index_%u.idx", &number) == 1 &&
+            name == osgDB::getSimpleFileName(runName(number)))
+        {
+            // map the run and make sure it is intact:
+            Run run;
+            run.generation = number;
+            run.file = MappedFile::open(runName(number));
+
+            IndexHeader header;
+            bool ok = run.file && run.file->size() >= sizeof(IndexHeader);
+            if (ok)
+            {
+                ::memcpy(&header, run.file->data(), sizeof(IndexHeader));
+                ok =
+                    header.magic == INDEX_MAGIC &&
+                    header.version == INDEX_VERSION &&
+                    run.file->size() == sizeof(IndexHeader) + header.count*sizeof(IndexEntry);
+            }
+
+            if (ok)
+                _runs.push_back(run);
+            else
+                runsOK = false;
+
+            generations.push_back(number);
+            _nextGeneration = std::max(_nextGeneration, (std::uint32_t)number + 1u);
+        }
+
+        else if (osgDB::getFileExtension(name) == "tmp")
+        {
+            // left over from an index write that never finished
+            ::remove(osgDB::concatPaths(_path, name).c_str());
+        }
+    }
+
+    if (!runsOK)
+    {
+        OE_WARN << LC << "Index in " << _path << " is damaged; rebuilding it" << std::endl;
+        _runs.clear();
+        for (auto generation : generations)
+            ::remove(runName(generation).c_str());
+    }
+
+    // newest run first:
+    std::sort(_runs.begin(), _runs.end(),
+        [](const Run& lhs, const Run& rhs) { return lhs.generation > rhs.generation; });
+
+    std::string journalName = osgDB::concatPaths(_path, "pack.journal");
+    bool rewrite = false;
+
+    // Reads the changes made since the newest run was written
+    auto readJournal = [&](const std::function<void(const IndexEntry&)>& func)
+    {
+        std::FILE* in = std::fopen(journalName.c_str(), "rb");
+        if (in)
+        {
+            IndexEntry entry;
+            while (std::fread(&entry, sizeof(IndexEntry), 1, in) == 1)
+                func(entry);
+            std::fclose(in);
+
+            // a torn entry at the end would misalign everything appended after it
+            rewrite = rewrite || (getFileSize(journalName) % sizeof(IndexEntry)) != 0u;
+        }
+    };
+
+    if (!_runs.empty() || !hasPacks)
+    {
+        readJournal([&](const IndexEntry& entry) {
+            _overlay[entry.hash] = entry;
+        });
+    }
+    else
+    {
+        // Packs are visited in any order, and compaction copies records into
+        // newer packs, so order records by time first, then by position.
+        auto position = [](const IndexEntry& e) {
+            return std::make_tuple(e.timestamp, packOf(e), e.offset);
+        };
+
+        // no usable index, so recover it from the records themselves
+        for (auto& p : _packs)
+        {
+            std::shared_ptr<MappedFile> pack = MappedFile::open(packName(p.first));
+            if (!pack)
+                continue;
+
+            scanRecords(*pack, 0u, [&](const RecordHeader& header, std::uint64_t offset, std::uint64_t length, const std::string& key)
+            {
+                IndexEntry entry;
+                entry.hash = hashKey(key);
+                entry.pack = header.type == TYPE_REMOVED ? TOMBSTONE : p.first;
+                // remember a tombstone's pack so ordering still works
+                entry.reserved = header.type == TYPE_REMOVED ? p.first : 0u;
+                entry.offset = offset;
+                entry.length = length;
+                entry.timestamp = header.timestamp;
+
+                auto i = _overlay.find(entry.hash);
+                if (i == _overlay.end() || position(entry) > position(i->second))
+                    _overlay[entry.hash] = entry;
+            });
+        }
+
+        // The journal still has what the packs don't: touched timestamps.
+        // It can be older than the packs, so it only wins where it is newer.
+        readJournal([&](const IndexEntry& entry) {
+            if (_packs.count(packOf(entry)) == 0u)
+                return;
+            auto i = _overlay.find(entry.hash);
+            if (i == _overlay.end() || position(entry) >= position(i->second))
+                _overlay[entry.hash] = entry;
+        });
+
+        OE_INFO << LC << "Recovered " << _overlay.size() << " records in " << _path << std::endl;
+        rewrite = true;
+    }
+
+    // Tally the live bytes in each pack. Tombstones count too, so the
+    // pack that holds one is not deleted while it is still needed.
+    forEachEntry([&](const IndexEntry& entry) {
+        auto i = _packs.find(packOf(entry));
+        if (i != _packs.end())
+            i->second.live += entry.length;
+    }, true);
+
+    // delete packs with nothing left in them (e.g. from an unfinished compaction)
+    for (auto i = _packs.begin(); i != _packs.end(); )
+    {
+        if (i->second.live == 0u && i->first != lastPack)
+        {
+            ::remove(packName(i->first).c_str());
+            i = _packs.erase(i);
+        }
+        else ++i;
+    }
+
+    // Appends go to the end of the last pack, so make sure it doesn't end in
+    // a partial record (from a crash mid-write). Records past the last one
+    // in the index were never indexed, so only they need checking.
+    _currentPack = lastPack;
+    if (hasPacks)
+    {
+        std::uint64_t indexed = 0u;
+        forEachEntry([&](const IndexEntry& entry) {
+            if (packOf(entry) == lastPack)
+                indexed = std::max(indexed, entry.offset + entry.length);
+        }, true);
+
+        PackInfo& info = _packs[lastPack];
+        bool torn = false;
+        if (indexed < info.bytes)
+        {
+            std::shared_ptr<MappedFile> pack = MappedFile::open(packName(lastPack));
+            torn = !pack || scanRecords(*pack, indexed, [](const RecordHeader&, std::uint64_t, std::uint64_t, const std::string&) { }) != info.bytes;
+        }
+
+        if (torn)
+        {
+            OE_WARN << LC << packName(lastPack) << " ends in a partial record; starting a new pack" << std::endl;
+        }
+
+        // start a new pack rather than append to a torn or full one:
+        if (torn || info.bytes >= _maxPackSize)
+        {
+            ++_currentPack;
+        }
+    }
+
+    _current = std::fopen(packName(_currentPack).c_str(), "ab");
+    _currentSize = _packs[_currentPack].bytes;
+
+    if (rewrite)
+        rewriteJournal();
+    else
+        _journal = std::fopen(journalName.c_str(), "ab");
+
+    if (!_current || !_journal)
+    {
+        OE_WARN << LC << "Failed to open pack files for writing in " << _path << std::endl;
+    }
+
+    // a recovered index goes straight to disk
+    if (_runs.empty() && !_overlay.empty())
+    {
+        flush();
+    }
+}
+
+const PackFile::IndexEntry*
+PackFile::find(std::uint64_t hash) const
+{
+    // newest changes first:
+    auto i = _overlay.find(hash);
+    if (i != _overlay.end())
+        return &i->second;
+
+    if (_frozen)
+    {
+        auto j = _frozen->find(hash);
+        if (j != _frozen->end())
+            return &j->second;
+    }
+
+    for (auto& run : _runs)
+    {
+        const IndexEntry* e = std::lower_bound(run.begin(), run.end(), hash,
+            [](const IndexEntry& lhs, std::uint64_t rhs) { return lhs.hash < rhs; });
+
+        if (e != run.end() && e->hash == hash)
+            return e;
+    }
+
+    return nullptr;
+}
+
+bool
+PackFile::lookup(std::uint64_t hash, IndexEntry& out) const
+{
+    const IndexEntry* e = find(hash);
+    if (!e)
+        return false;
+
+    out = *e;
+    return out.pack != TOMBSTONE;
+}
+
+std::uint32_t
+PackFile::firstPack() const
+{
+    std::uint32_t first = TOMBSTONE;
+    for (auto& p : _packs)
+        first = std::min(first, p.first);
+    return first;
+}
+
+void
+PackFile::forEachEntry(const std::function<void(const IndexEntry&)>& func, bool tombstones) const
+{
+    auto shadowed = [&](std::uint64_t hash) {
+        return _overlay.count(hash) > 0u || (_frozen && _frozen->count(hash) > 0u);
+    };
+
+    // Runs are sorted by hash, so walk them all together. On a tie the
+    // newest run (lowest index) wins and older copies are skipped.
+    std::vector<const IndexEntry*> heads, ends;
+    for (auto& run : _runs)
+    {
+        heads.push_back(run.begin());
+        ends.push_back(run.end());
+    }
+
+    for (;;)
+    {
+        int newest = -1;
+        for (unsigned r = 0; r < heads.size(); ++r)
+        {
+            if (heads[r] != ends[r] && (newest < 0 || heads[r]->hash < heads[newest]->hash))
+                newest = r;
+        }
+
+        if (newest < 0)
+            break;
+
+        const IndexEntry& entry = *heads[newest]++;
+
+        for (unsigned r = newest + 1; r < heads.size(); ++r)
+        {
+            if (heads[r] != ends[r] && heads[r]->hash == entry.hash)
+                ++heads[r];
+        }
+
+        if ((tombstones || entry.pack != TOMBSTONE) && !shadowed(entry.hash))
+            func(entry);
+    }
+
+    if (_frozen)
+    {
+        for (auto& i : *_frozen)
+        {
+            if ((tombstones || i.second.pack != TOMBSTONE) && _overlay.count(i.first) == 0u)
+                func(i.second);
+        }
+    }
+
+    for (auto& i : _overlay)
+    {
+        if (tombstones || i.second.pack != TOMBSTONE)
+            func(i.second);
+    }
+}
+
+std::shared_ptr<MappedFile>
+PackFile::getMapping(std::uint32_t pack, std::uint64_t end)
+{
+    ScopedMutexLock lock(_mutex);
+
+    auto i = _packs.find(pack);
+    if (i == _packs.end())
+        return nullptr;
+
+    // the current pack grows, so remap it when a read runs past the end
+    PackInfo& info = i->second;
+    if (!info.mapping || info.mapping->size() < end)
+    {
+        info.mapping = MappedFile::open(packName(pack));
+    }
+
+    if (!info.mapping || info.mapping->size() < end)
+        return nullptr;
+
+    return info.mapping;
+}
+
+bool
+PackFile::read(const std::string& key, Record& out)
+{
+    OE_PROFILING_ZONE;
+
+    IndexEntry entry;
+    {
+        ScopedMutexLock lock(_mutex);
+        if (!lookup(hashKey(key), entry))
+            return false;
+    }
+
+    std::shared_ptr<MappedFile> mapping = getMapping(entry.pack, entry.offset + entry.length);
+    if (!mapping)
+        return false;
+
+    const char* ptr = mapping->data() + entry.offset;
+
+    RecordHeader header;
+    ::memcpy(&header, ptr, sizeof(RecordHeader));
+
+    if (header.magic != RECORD_MAGIC ||
+        header.type == TYPE_REMOVED ||
+        sizeof(RecordHeader) + header.keyLength + header.metaLength + header.payloadLength != entry.length)
+    {
+        OE_WARN << LC << "Corrupt record for \"" << key << "\" in " << packName(entry.pack) << std::endl;
+        return false;
+    }
+
+    // a hash collision looks like a miss
+    ptr += sizeof(RecordHeader);
+    if (header.keyLength != key.length() || ::memcmp(ptr, key.data(), key.length()) != 0)
+        return false;
+
+    ptr += header.keyLength;
+    out.meta = Config();
+    if (header.metaLength > 0u)
+        out.meta.fromJSON(std::string(ptr, header.metaLength));
+
+    ptr += header.metaLength;
+    out.mapping = mapping;
+    out.data = ptr;
+    out.length = (std::size_t)header.payloadLength;
+    out.type = (RecordType)header.type;
+    out.timestamp = (TimeStamp)entry.timestamp;
+
+    return true;
+}
+
+bool
+PackFile::append(const char* record, std::size_t length, std::uint32_t& pack, std::uint64_t& offset)
+{
+    ScopedMutexLock lock(_appendMutex);
+
+    if (!_current)
+        return false;
+
+    if (std::fwrite(record, 1, length, _current) != length || std::fflush(_current) != 0)
+    {
+        // put the pack back where it was so the next record starts cleanly
+        std::fclose(_current);
+        _current = std::fopen(packName(_currentPack).c_str(), "r+b");
+        if (_current && seek64(_current, _currentSize) != 0)
+        {
+            std::fclose(_current);
+            _current = nullptr;
+        }
+        return false;
+    }
+
+    pack = _currentPack;
+    offset = _currentSize;
+    _currentSize += length;
+
+    // roll over to a new pack once this one is full:
+    if (_currentSize >= _maxPackSize)
+    {
+        std::fclose(_current);
+        ++_currentPack;
+        _current = std::fopen(packName(_currentPack).c_str(), "ab");
+        _currentSize = 0u;
+    }
+
+    return true;
+}
+
+void
+PackFile::journal(const IndexEntry& entry)
+{
+    if (_journal)
+    {
+        std::fwrite(&entry, sizeof(IndexEntry), 1, _journal);
+        std::fflush(_journal);
+    }
+}
+
+void
+PackFile::rewriteJournal()
+{
+    // called with _mutex held (or before the store is shared)
+    if (_journal)
+        std::fclose(_journal);
+
+    _journal = std::fopen(osgDB::concatPaths(_path, "pack.journal").c_str(), "wb");
+    if (_journal)
+    {
+        for (auto& i : _overlay)
+            std::fwrite(&i.second, sizeof(IndexEntry), 1, _journal);
+        std::fflush(_journal);
+    }
+}
+
+bool
+PackFile::update(const IndexEntry& entry, const IndexEntry* expected)
+{
+    std::uint32_t compactable = TOMBSTONE;
+    bool writeOverlay = false;
+    {
+        ScopedMutexLock lock(_mutex);
+
+        // a tombstone being replaced counts as well, since it takes up space
+        const IndexEntry* found = find(entry.hash);
+        IndexEntry old;
+        if (found)
+            old = *found;
+
+        if (expected && (!found ||
+            old.pack != expected->pack || old.reserved != expected->reserved || old.offset != expected->offset))
+        {
+            // the record changed while it was being moved; the new copy is dead
+            PackInfo& info = _packs[packOf(entry)];
+            info.bytes = std::max(info.bytes, entry.offset + entry.length);
+            return false;
+        }
+
+        if (found)
+        {
+            // the old pack may be gone already, if this is a tombstone
+            // that outlived it
+            auto i = _packs.find(packOf(old));
+            if (i != _packs.end())
+            {
+                PackInfo& info = i->second;
+                info.live -= std::min(info.live, old.length);
+
+                if (i->first != _currentPack && !info.compacting && info.live < info.bytes/2u)
+                {
+                    info.compacting = true;
+                    compactable = i->first;
+                }
+            }
+        }
+
+        PackInfo& info = _packs[packOf(entry)];
+        info.bytes = std::max(info.bytes, entry.offset + entry.length);
+        info.live += entry.length;
+
+        _overlay[entry.hash] = entry;
+        journal(entry);
+        writeOverlay = freezeOverlay();
+    }
+
+    if (compactable != TOMBSTONE)
+        scheduleCompaction(compactable);
+
+    if (writeOverlay)
+        scheduleIndexWrite();
+
+    return true;
+}
+
+bool
+PackFile::freezeOverlay()
+{
+    // Hand a full overlay off to be written as a new run. Writers carry
+    // on with a fresh overlay and readers check both in the meantime.
+    // Call with _mutex held.
+    if (_overlay.size() >= MAX_OVERLAY && !_frozen)
+    {
+        _frozen = std::make_shared<const Overlay>(std::move(_overlay));
+        _overlay.clear();
+        return true;
+    }
+    return false;
+}
+
+bool
+PackFile::write(const std::string& key, RecordType type, const std::string& payload, const Config& meta)
+{
+    OE_PROFILING_ZONE;
+
+    std::string metaJSON = meta.empty() ? std::string() : meta.toJSON();
+
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.type = (std::uint32_t)type;
+    header.keyLength = (std::uint32_t)key.length();
+    header.metaLength = (std::uint32_t)metaJSON.length();
+    header.payloadLength = payload.length();
+    header.timestamp = now();
+
+    std::string record;
+    record.reserve(sizeof(RecordHeader) + key.length() + metaJSON.length() + payload.length());
+    record.append(reinterpret_cast<const char*>(&header), sizeof(RecordHeader));
+    record.append(key);
+    record.append(metaJSON);
+    record.append(payload);
+
+    IndexEntry entry;
+    entry.hash = hashKey(key);
+    entry.reserved = 0u;
+    entry.length = record.length();
+    entry.timestamp = header.timestamp;
+
+    if (!append(record.data(), record.length(), entry.pack, entry.offset))
+        return false;
+
+    return update(entry, nullptr);
+}
+
+bool
+PackFile::remove(const std::string& key)
+{
+    if (!exists(key))
+        return false;
+
+    // record the removal in the pack too, so a recovered index honors it
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.type = TYPE_REMOVED;
+    header.keyLength = (std::uint32_t)key.length();
+    header.metaLength = 0u;
+    header.payloadLength = 0u;
+    header.timestamp = now();
+
+    std::string record;
+    record.append(reinterpret_cast<const char*>(&header), sizeof(RecordHeader));
+    record.append(key);
+
+    IndexEntry entry;
+    entry.hash = hashKey(key);
+    entry.length = record.length();
+    entry.timestamp = header.timestamp;
+
+    std::uint32_t pack;
+    if (!append(record.data(), record.length(), pack, entry.offset))
+        return false;
+
+    entry.pack = TOMBSTONE;
+    entry.reserved = pack;
+
+    return update(entry, nullptr);
+}
+
+bool
+PackFile::touch(const std::string& key)
+{
+    // Only the index has the new timestamp. Like any other change it goes
+    // to the journal now and to an index run once the overlay is written.
+    bool writeOverlay = false;
+    {
+        ScopedMutexLock lock(_mutex);
+
+        IndexEntry entry;
+        if (!lookup(hashKey(key), entry))
+            return false;
+
+        entry.timestamp = now();
+        _overlay[entry.hash] = entry;
+        journal(entry);
+        writeOverlay = freezeOverlay();
+    }
+
+    if (writeOverlay)
+        scheduleIndexWrite();
+
+    return true;
+}
+
+bool
+PackFile::exists(const std::string& key)
+{
+    ScopedMutexLock lock(_mutex);
+    IndexEntry entry;
+    return lookup(hashKey(key), entry);
+}
+
+bool
+PackFile::clear()
+{
+    ScopedMutexLock mergeLock(_mergeMutex);
+    ScopedMutexLock appendLock(_appendMutex);
+    ScopedMutexLock lock(_mutex);
+
+    // never delete packs that belong to another process
+    if (!isOpen())
+        return false;
+
+    bool ok = true;
+
+    if (_current)
+        std::fclose(_current);
+
+    for (auto& p : _packs)
+    {
+        p.second.mapping = nullptr;
+        if (::remove(packName(p.first).c_str()) != 0)
+            ok = false;
+    }
+    _packs.clear();
+
+    for (auto& run : _runs)
+    {
+        run.file = nullptr;
+        ::remove(runName(run.generation).c_str());
+    }
+    _runs.clear();
+    _frozen = nullptr;
+    _overlay.clear();
+    rewriteJournal();
+
+    _currentPack = 0u;
+    _currentSize = 0u;
+    _current = std::fopen(packName(_currentPack).c_str(), "wb");
+
+    return ok && _current != nullptr;
+}
+
+void
+PackFile::scheduleCompaction(std::uint32_t pack)
+{
+    if (_arena)
+    {
+        // hold a reference so the store outlives the job
+        std::shared_ptr<PackFile> self = shared_from_this();
+        Job(_arena.get()).dispatch([self, pack](Cancelable*) {
+            self->compactPack(pack);
+        });
+    }
+    else
+    {
+        compactPack(pack);
+    }
+}
+
+void
+PackFile::compactPack(std::uint32_t pack)
+{
+    OE_PROFILING_ZONE;
+
+    std::vector<IndexEntry> entries;
+    bool keepTombstones;
+    {
+        ScopedMutexLock lock(_mutex);
+        forEachEntry([&](const IndexEntry& entry) {
+            if (packOf(entry) == pack)
+                entries.push_back(entry);
+        }, true);
+
+        // an older pack may still have a record that a tombstone hides
+        keepTombstones = firstPack() < pack;
+    }
+
+    std::uint64_t moved = 0u;
+
+    // copy each live record (and needed tombstone) to the end of the current pack:
+    std::shared_ptr<MappedFile> mapping;
+    for (auto& from : entries)
+    {
+        if (from.pack == TOMBSTONE && !keepTombstones)
+        {
+            // nothing left for it to hide; it goes with the pack, and out
+            // of the index once the runs are merged
+            ScopedMutexLock lock(_mutex);
+            const IndexEntry* e = find(from.hash);
+            if (e && e->pack == TOMBSTONE && e->reserved == pack && e->offset == from.offset)
+            {
+                PackInfo& info = _packs[pack];
+                info.live -= std::min(info.live, from.length);
+            }
+            continue;
+        }
+
+        if (!mapping || mapping->size() < from.offset + from.length)
+            mapping = getMapping(pack, from.offset + from.length);
+        if (!mapping)
+            break;
+
+        IndexEntry to = from;
+        std::uint32_t& toPack = from.pack == TOMBSTONE ? to.reserved : to.pack;
+        if (append(mapping->data() + from.offset, (std::size_t)from.length, toPack, to.offset))
+        {
+            if (update(to, &from))
+                moved += from.length;
+        }
+    }
+    mapping = nullptr;
+
+    ScopedMutexLock lock(_mutex);
+
+    auto i = _packs.find(pack);
+    if (i != _packs.end())
+    {
+        if (i->second.live == 0u)
+        {
+            // Readers may still hold the old mapping, which stays valid after
+            // the unlink. On Windows the delete fails while it's mapped, and
+            // the empty pack is cleaned up the next time the store opens.
+            _packs.erase(i);
+            ::remove(packName(pack).c_str());
+
+            OE_DEBUG << LC << "Compacted " << packName(pack) << ", moved " << moved << " bytes" << std::endl;
+        }
+        else
+        {
+            i->second.compacting = false;
+        }
+    }
+}
+
+void
+PackFile::compact()
+{
+    std::vector<std::uint32_t> packs;
+    {
+        ScopedMutexLock lock(_mutex);
+        for (auto& p : _packs)
+        {
+            if (p.first != _currentPack && !p.second.compacting && p.second.live < p.second.bytes)
+            {
+                p.second.compacting = true;
+                packs.push_back(p.first);
+            }
+        }
+    }
+
+    for (auto pack : packs)
+        compactPack(pack);
+}
+
+void
+PackFile::flush()
+{
+    // finish an overlay that is already on its way out, then write this one:
+    writeIndex();
+    {
+        ScopedMutexLock lock(_mutex);
+        if (_overlay.empty() || _frozen)
+            return;
+
+        _frozen = std::make_shared<const Overlay>(std::move(_overlay));
+        _overlay.clear();
+    }
+    writeIndex();
+}
+
+void
+PackFile::scheduleIndexWrite()
+{
+    if (_arena)
+    {
+        // hold a reference so the store outlives the job
+        std::shared_ptr<PackFile> self = shared_from_this();
+        Job(_arena.get()).dispatch([self](Cancelable*) {
+            self->writeIndex();
+        });
+    }
+    else
+    {
+        writeIndex();
+    }
+}
+
+bool
+PackFile::writeRun(std::uint32_t generation, const std::function<bool(IndexEntry&)>& next, Run& out)
+{
+    std::string name = runName(generation);
+    std::string tempName = name + ".tmp";
+
+    IndexHeader header;
+    header.magic = INDEX_MAGIC;
+    header.version = INDEX_VERSION;
+    header.count = 0u;
+
+    std::FILE* file = std::fopen(tempName.c_str(), "wb");
+    bool ok = file && std::fwrite(&header, sizeof(IndexHeader), 1, file) == 1;
+
+    IndexEntry entry;
+    while (ok && next(entry))
+    {
+        ok = std::fwrite(&entry, sizeof(IndexEntry), 1, file) == 1;
+        ++header.count;
+    }
+
+    // now that the count is known, finish the header:
+    ok = ok &&
+        seek64(file, 0u) == 0 &&
+        std::fwrite(&header, sizeof(IndexHeader), 1, file) == 1;
+
+    if (file)
+        ok = (std::fclose(file) == 0) && ok;
+
+    ok = ok && ::rename(tempName.c_str(), name.c_str()) == 0;
+
+    if (ok)
+    {
+        out.generation = generation;
+        out.file = MappedFile::open(name);
+        ok = (out.file != nullptr);
+    }
+
+    if (!ok)
+    {
+        OE_WARN << LC << "Failed to write index " << name << std::endl;
+        ::remove(tempName.c_str());
+        ::remove(name.c_str());
+    }
+
+    return ok;
+}
+
+void
+PackFile::writeIndex()
+{
+    OE_PROFILING_ZONE;
+
+    // Runs are written and merged here, without holding _mutex; readers
+    // and writers only wait while a finished run is swapped in.
+    ScopedMutexLock mergeLock(_mergeMutex);
+
+    std::shared_ptr<const Overlay> frozen;
+    bool oldest;
+    std::uint32_t generation;
+    std::uint32_t first;
+    {
+        ScopedMutexLock lock(_mutex);
+        if (!_frozen)
+            return;
+
+        frozen = _frozen;
+        oldest = _runs.empty();
+        generation = _nextGeneration++;
+        first = firstPack();
+    }
+
+    // The oldest run has no older entries to hide, so it only needs the
+    // tombstones that still hide records in the packs. The first pack
+    // number never goes down, so a stale one only keeps extra tombstones.
+    auto keep = [&](const IndexEntry& e) {
+        return !oldest || e.pack != TOMBSTONE || packOf(e) >= first;
+    };
+
+    std::vector<IndexEntry> changes;
+    changes.reserve(frozen->size());
+    for (auto& i : *frozen)
+    {
+        if (keep(i.second))
+            changes.push_back(i.second);
+    }
+
+    std::sort(changes.begin(), changes.end(),
+        [](const IndexEntry& lhs, const IndexEntry& rhs) { return lhs.hash < rhs.hash; });
+
+    Run run;
+    auto c = changes.begin();
+    bool ok = writeRun(generation, [&](IndexEntry& out)
+    {
+        if (c == changes.end())
+            return false;
+        out = *c++;
+        return true;
+    }, run);
+
+    {
+        ScopedMutexLock lock(_mutex);
+
+        if (ok)
+        {
+            _runs.insert(_runs.begin(), run);
+        }
+        else
+        {
+            // keep the changes in memory; the journal still has them
+            for (auto& i : *frozen)
+                _overlay.emplace(i.first, i.second);
+        }
+
+        _frozen = nullptr;
+
+        // the journal only needs to cover what the runs do not
+        if (ok)
+            rewriteJournal();
+    }
+
+    frozen = nullptr;
+
+    // Merge the two newest runs while they are close in size, like the
+    // carries of a binary counter. Each entry is rewritten O(log N) times
+    // over the life of the store, and there are O(log N) runs to search.
+    while (ok)
+    {
+        Run newer, older;
+        {
+            ScopedMutexLock lock(_mutex);
+            if (_runs.size() < 2u || _runs[0].size() * 2u < _runs[1].size())
+                break;
+
+            newer = _runs[0];
+            older = _runs[1];
+            oldest = (_runs.size() == 2u);
+            generation = _nextGeneration++;
+            first = firstPack();
+        }
+
+        const IndexEntry* a = newer.begin();
+        const IndexEntry* b = older.begin();
+        Run merged;
+        ok = writeRun(generation, [&](IndexEntry& out)
+        {
+            while (a != newer.end() || b != older.end())
+            {
+                // the newer run wins when both have the hash
+                const IndexEntry* e;
+                if (b == older.end() || (a != newer.end() && a->hash <= b->hash))
+                {
+                    if (b != older.end() && b->hash == a->hash)
+                        ++b;
+                    e = a++;
+                }
+                else
+                {
+                    e = b++;
+                }
+
+                if (keep(*e))
+                {
+                    out = *e;
+                    return true;
+                }
+            }
+            return false;
+        }, merged);
+
+        if (ok)
+        {
+            {
+                ScopedMutexLock lock(_mutex);
+                _runs[0] = merged;
+                _runs.erase(_runs.begin() + 1);
+            }
+
+            // unmap before deleting; Windows won't delete a mapped file
+            std::uint32_t newerGeneration = newer.generation, olderGeneration = older.generation;
+            newer.file = nullptr;
+            older.file = nullptr;
+            ::remove(runName(newerGeneration).c_str());
+            ::remove(runName(olderGeneration).c_str());
+        }
+    }
+}
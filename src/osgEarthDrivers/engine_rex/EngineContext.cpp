@@ -35,6 +35,7 @@ EngineContext::EngineContext(const Map*                     map,
                              TerrainEngineNode*             terrainEngine,
                              GeometryPool*                  geometryPool,
                              Merger*                        merger,
+                             Prefetcher*                    prefetcher,
                              TileNodeRegistry*              liveTiles,
                              const RenderBindings&          renderBindings,
                              const TerrainOptions&          options,
@@ -44,6 +45,7 @@ _map           ( map ),
 _terrainEngine ( terrainEngine ),
 _geometryPool  ( geometryPool ),
 _merger        ( merger ),
+_prefetcher    ( prefetcher ),
 _liveTiles     ( liveTiles ),
 _renderBindings( renderBindings ),
 _options       ( options ),
@@ -39,6 +39,10 @@ _geometryMapMutex("GeometryPool(OE)")
 {
     ADJUST_UPDATE_TRAV_COUNT(this, +1);
 
+    _stats.shared = 0u;
+    _stats.edited = 0u;
+    _stats.bytesSaved = 0u;
+
     // activate debugging mode
     if ( getenv("OSGEARTH_DEBUG_REX_GEOMETRY_POOL") != 0L )
     {
@@ -81,19 +85,56 @@ GeometryPool::getPooledGeometry(
 
     if ( _enabled )
     {
-        // first check the sharing cache:
-        if (!meshEditor.hasEdits())
+        // An edited tile can still share the vertices of the unedited one:
+        bool shareEdits =
+            meshEditor.hasEdits() &&
+            options.shareEditedGeometry() == true;
+
+        osg::ref_ptr<SharedGeometry> canonical;
+
+        if (!meshEditor.hasEdits() || shareEdits)
         {
-            Threading::ScopedMutexLock lock(_geometryMapMutex);
-            GeometryMap::iterator i = _geometryMap.find(geomKey);
-            if (i != _geometryMap.end())
+            // first check the sharing cache:
             {
-                // found it:
-                out = i->second.get();
+                Threading::ScopedMutexLock lock(_geometryMapMutex);
+                GeometryMap::iterator i = _geometryMap.find(geomKey);
+                if (i != _geometryMap.end())
+                {
+                    // found it:
+                    canonical = i->second.get();
+                }
+            }
+
+            if (!canonical.valid())
+            {
+                canonical = createGeometry(
+                    tileKey,
+                    tileSize,
+                    options.heightFieldSkirtRatio().get(),
+                    options.gpuTessellation().get(),
+                    options.morphTerrain().get(),
+                    nullptr,
+                    nullptr,
+                    progress);
+
+                // another thread may have beaten us to it
+                if (canonical.valid())
+                {
+                    Threading::ScopedMutexLock lock(_geometryMapMutex);
+                    osg::ref_ptr<SharedGeometry>& entry = _geometryMap[geomKey];
+                    if (entry.valid())
+                        canonical = entry.get();
+                    else
+                        entry = canonical.get();
+                }
             }
         }
 
-        if (!out.valid())
+        if (!meshEditor.hasEdits())
+        {
+            out = canonical.get();
+        }
+        else
         {
             out = createGeometry(
                 tileKey,
@@ -101,14 +142,15 @@ GeometryPool::getPooledGeometry(
                 options.heightFieldSkirtRatio().get(),
                 options.gpuTessellation().get(),
                 options.morphTerrain().get(),
-                meshEditor,
+                &meshEditor,
+                canonical.get(),
                 progress);
 
-            // only store as a shared geometry if there are no constraints.
-            if (out.valid() && !meshEditor.hasEdits())
+            // track it so we can report on the memory it saves
+            if (out.valid() && out->getCanonical())
             {
                 Threading::ScopedMutexLock lock(_geometryMapMutex);
-                _geometryMap[geomKey] = out.get();
+                _editedGeometries.push_back(out.get());
             }
         }
     }
@@ -121,7 +163,8 @@ GeometryPool::getPooledGeometry(
             options.heightFieldSkirtRatio().get(),
             options.gpuTessellation().get(),
             options.morphTerrain().get(),
-            meshEditor,
+            &meshEditor,
+            nullptr,
             progress);
     }
 }
@@ -254,7 +297,8 @@ GeometryPool::createGeometry(
     float skirtRatio,
     bool gpuTessellation,
     bool morphTerrain,
-    MeshEditor& editor,
+    MeshEditor* editor,
+    SharedGeometry* canonical,
     Cancelable* progress) const
 {
     OE_PROFILING_ZONE;
@@ -279,6 +323,25 @@ GeometryPool::createGeometry(
 
     GLenum mode = gpuTessellation ? GL_PATCHES : GL_TRIANGLES;
 
+    // Edited tile that borrows the vertex arrays of the unedited one:
+    if (editor && editor->hasEdits() && canonical)
+    {
+        osg::ref_ptr<SharedGeometry> geom = new SharedGeometry();
+
+        editor->createTileMesh(
+            geom.get(),
+            tileSize,
+            skirtRatio,
+            mode,
+            canonical,
+            progress);
+
+        if (geom->empty())
+            return nullptr;
+
+        return geom.release();
+    }
+
     osg::BoundingSphere tileBound;
 
     // the geometry:
@@ -330,13 +393,14 @@ GeometryPool::createGeometry(
     texCoords->reserve( numVerts );
     geom->setTexCoordArray(texCoords.get());
 
-    if (editor.hasEdits())
+    if (editor && editor->hasEdits())
     {
-        bool tileHasData = editor.createTileMesh(
+        bool tileHasData = editor->createTileMesh(
             geom.get(),
             tileSize,
             skirtRatio,
             mode,
+            nullptr,
             progress);
 
         if (geom->empty())
@@ -458,17 +522,56 @@ GeometryPool::traverse(osg::NodeVisitor& nv)
         {
             _geometryMap.erase(*key);
         }
+
+        // tally the memory saved by the edited geometries still in use:
+        Stats stats;
+        stats.shared = _geometryMap.size();
+        stats.edited = 0u;
+        stats.bytesSaved = 0u;
+
+        for (unsigned i = 0; i < _editedGeometries.size(); )
+        {
+            osg::ref_ptr<SharedGeometry> geom;
+            if (_editedGeometries[i].lock(geom))
+            {
+                ++stats.edited;
+                stats.bytesSaved += geom->getBytesSaved();
+                ++i;
+            }
+            else
+            {
+                _editedGeometries[i] = _editedGeometries.back();
+                _editedGeometries.pop_back();
+            }
+        }
+
+        if (_debug && stats.edited != _stats.edited)
+        {
+            OE_NOTICE << LC << stats.shared << " shared geometries, "
+                << stats.edited << " edited geometries sharing vertices, "
+                << (stats.bytesSaved / 1024) << " KB saved" << std::endl;
+        }
+
+        _stats = stats;
     }
 
     osg::Group::traverse(nv);
 }
 
+GeometryPool::Stats
+GeometryPool::getStats() const
+{
+    Threading::ScopedMutexLock lock(_geometryMapMutex);
+    return _stats;
+}
+
 void
 GeometryPool::clear()
 {
     releaseGLObjects(NULL);
     Threading::ScopedMutexLock lock(_geometryMapMutex);
     _geometryMap.clear();
+    _editedGeometries.clear();
 }
 
 void
@@ -518,7 +621,8 @@ GeometryPool::releaseGLObjects(osg::State* state) const
 
 SharedGeometry::SharedGeometry() :
     osg::Drawable(),
-    _hasConstraints(false)
+    _hasConstraints(false),
+    _bytesSaved(0u)
 {
     _supportsVertexBufferObjects = true;
     _ptype.resize(64u);
@@ -537,7 +641,10 @@ SharedGeometry::SharedGeometry(const SharedGeometry& rhs,const osg::CopyOp& copy
     _neighborArray(rhs._neighborArray),
     _neighborNormalArray(rhs._neighborNormalArray),
     _drawElements(rhs._drawElements),
-    _hasConstraints(rhs._hasConstraints)
+    _canonical(rhs._canonical),
+    _delta(rhs._delta),
+    _hasConstraints(rhs._hasConstraints),
+    _bytesSaved(rhs._bytesSaved)
 {
     _ptype.resize(64u);
     _ptype.setAllElementsTo(GL_TRIANGLES);
@@ -552,8 +659,8 @@ bool
 SharedGeometry::empty() const
 {
     return
-        (_drawElements.valid() == false || _drawElements->getNumIndices() == 0); //&&
-        //(_maskElements.valid() == false || _maskElements->getNumIndices() == 0);
+        (_drawElements.valid() == false || _drawElements->getNumIndices() == 0) &&
+        (_delta.valid() == false || _delta->empty());
 }
 
 #if OSG_MIN_VERSION_REQUIRED(3,5,9)
@@ -599,8 +706,10 @@ void SharedGeometry::resizeGLObjectBuffers(unsigned int maxSize)
     if (_neighborArray.valid()) _neighborArray->resizeGLObjectBuffers(maxSize);
     if (_neighborNormalArray.valid()) _neighborNormalArray->resizeGLObjectBuffers(maxSize);
 
-    // not here - it's shared
+    // not here - it's shared (unless we only borrow the vertex arrays)
     //if (_drawElements.valid()) _drawElements->resizeGLObjectBuffers(maxSize);
+    if (_canonical.valid() && _drawElements.valid()) _drawElements->resizeGLObjectBuffers(maxSize);
+    if (_delta.valid()) _delta->resizeGLObjectBuffers(maxSize);
 }
 
 void SharedGeometry::releaseGLObjects(osg::State* state) const
@@ -614,8 +723,10 @@ void SharedGeometry::releaseGLObjects(osg::State* state) const
     if (_neighborArray.valid()) _neighborArray->releaseGLObjects(state);
     if (_neighborNormalArray.valid()) _neighborNormalArray->releaseGLObjects(state);
 
-    // not here - it's shared
+    // not here - it's shared (unless we only borrow the vertex arrays)
     //if (_drawElements.valid()) _drawElements->releaseGLObjects(state);
+    if (_canonical.valid() && _drawElements.valid()) _drawElements->releaseGLObjects(state);
+    if (_delta.valid()) _delta->releaseGLObjects(state);
 }
 
 void
@@ -741,6 +852,13 @@ void SharedGeometry::drawImplementation(osg::RenderInfo& renderInfo) const
         vas->unbindVertexBufferObject();
         vas->unbindElementBufferObject();
     }
+
+    // vertices that aren't in the shared arrays:
+    if (_delta.valid())
+    {
+        _delta->_ptype[state.getContextID()] = _ptype[state.getContextID()];
+        _delta->draw(renderInfo);
+    }
 }
 
 void SharedGeometry::accept(osg::Drawable::AttributeFunctor& af)
@@ -769,12 +887,18 @@ void SharedGeometry::accept(osg::PrimitiveFunctor& pf) const
 {
     pf.setVertexArray(_vertexArray->getNumElements(),static_cast<const osg::Vec3*>(_vertexArray->getDataPointer()));
     _drawElements->accept(pf);
+
+    if (_delta.valid())
+        _delta->accept(pf);
 }
 
 void SharedGeometry::accept(osg::PrimitiveIndexFunctor& pif) const
 {
     pif.setVertexArray(_vertexArray->getNumElements(),static_cast<const osg::Vec3*>(_vertexArray->getDataPointer()));
     _drawElements->accept(pif);
+
+    if (_delta.valid())
+        _delta->accept(pif);
 }
 
 osg::Geometry*
@@ -784,6 +908,47 @@ SharedGeometry::makeOsgGeometry()
     geom->setUseVertexBufferObjects(true);
     geom->setUseDisplayList(false);
 
+    if (_delta.valid())
+    {
+        // flatten the shared vertices and the delta into one set of arrays,
+        // offsetting the delta's indices past the shared ones.
+        osg::Vec3Array* verts = new osg::Vec3Array(osg::Array::BIND_PER_VERTEX);
+        osg::Vec3Array* normals = new osg::Vec3Array(osg::Array::BIND_PER_VERTEX);
+        osg::Vec3Array* texCoords = new osg::Vec3Array(osg::Array::BIND_PER_VERTEX);
+
+        const SharedGeometry* parts[2] = { this, _delta.get() };
+        for (auto part : parts)
+        {
+            const osg::Vec3Array* v = static_cast<const osg::Vec3Array*>(part->getVertexArray());
+            const osg::Vec3Array* n = static_cast<const osg::Vec3Array*>(part->getNormalArray());
+            const osg::Vec3Array* t = static_cast<const osg::Vec3Array*>(part->getTexCoordArray());
+            verts->insert(verts->end(), v->begin(), v->end());
+            normals->insert(normals->end(), n->begin(), n->end());
+            texCoords->insert(texCoords->end(), t->begin(), t->end());
+        }
+
+        osg::DrawElements* de;
+        if (verts->size() > 0xFFFF)
+            de = new osg::DrawElementsUInt(_drawElements->getMode());
+        else
+            de = new osg::DrawElementsUShort(_drawElements->getMode());
+
+        de->reserveElements(_drawElements->getNumIndices() + _delta->getDrawElements()->getNumIndices());
+        for (unsigned i = 0; i < _drawElements->getNumIndices(); ++i)
+            de->addElement(_drawElements->index(i));
+
+        unsigned offset = _vertexArray->getNumElements();
+        for (unsigned i = 0; i < _delta->getDrawElements()->getNumIndices(); ++i)
+            de->addElement(offset + _delta->getDrawElements()->index(i));
+
+        geom->setVertexArray(verts);
+        geom->setNormalArray(normals);
+        geom->setTexCoordArray(0, texCoords);
+        geom->addPrimitiveSet(de);
+
+        return geom;
+    }
+
     geom->setVertexArray(getVertexArray());
     geom->setNormalArray(getNormalArray());
     geom->setTexCoordArray(0, getTexCoordArray());
@@ -41,6 +41,7 @@ LoadTileDataOperation::LoadTileDataOperation(
     _merged(false)
 {
     _engine = context->getEngine();
+    _context = context;
     _name = tilenode->getKey().str();
 }
 
@@ -56,6 +57,7 @@ LoadTileDataOperation::LoadTileDataOperation(
     _merged(false)
 {
     _engine = context->getEngine();
+    _context = context;
     _name = tilenode->getKey().str();
 }
 
@@ -113,6 +115,17 @@ LoadTileDataOperation::dispatch(bool async)
     };
 
 
+    // A full load may already be done (or underway) thanks to the prefetcher.
+    osg::ref_ptr<EngineContext> context;
+    if (async && _manifest.empty() && _context.lock(context) && context->getPrefetcher())
+    {
+        if (tile_obs.valid() &&
+            context->getPrefetcher()->claim(key, map.get(), priority_func, _result))
+        {
+            return true;
+        }
+    }
+
     if (async)
     {
         Job job;
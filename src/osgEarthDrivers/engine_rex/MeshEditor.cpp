@@ -96,12 +96,260 @@ MeshEditor::MeshEditor(const TileKey& key, unsigned tileSize, const Map* map, Pr
     PS->addElement((INDEX1)+1); \
 }
 
+namespace
+{
+    // Turns an edited mesh into a geometry that borrows the vertex arrays of
+    // the unedited (pooled) tile geometry. Triangles made only of grid
+    // vertices the edits left alone, and skirts along the untouched parts of
+    // the tile perimeter, index straight into the shared arrays. Everything
+    // else goes into a small delta geometry with vertices of its own.
+    void createSharedTileMesh(
+        mesh_t& mesh,
+        SharedGeometry* sharedGeom,
+        SharedGeometry* canonical,
+        unsigned tileSize,
+        double skirtHeightRatio,
+        GLenum mode,
+        const GeoLocator& locator,
+        const osg::Matrix& world2local,
+        const osg::Matrix& local2world)
+    {
+        using Vec3Ptr = osg::ref_ptr<osg::Vec3Array>;
+
+        const osg::Vec3Array* sharedVerts = static_cast<const osg::Vec3Array*>(canonical->getVertexArray());
+        const osg::Vec3Array* sharedNormals = static_cast<const osg::Vec3Array*>(canonical->getNormalArray());
+        const osg::Vec3Array* sharedTexCoords = static_cast<const osg::Vec3Array*>(canonical->getTexCoordArray());
+        const osg::Vec3Array* sharedNeighbors = static_cast<const osg::Vec3Array*>(canonical->getNeighborArray());
+        const osg::Vec3Array* sharedNeighborNormals = static_cast<const osg::Vec3Array*>(canonical->getNeighborNormalArray());
+
+        int original_grid_size = tileSize * tileSize;
+
+        sharedGeom->setCanonical(canonical);
+        sharedGeom->setVertexArray(canonical->getVertexArray());
+        sharedGeom->setNormalArray(canonical->getNormalArray());
+        sharedGeom->setTexCoordArray(canonical->getTexCoordArray());
+        sharedGeom->setNeighborArray(canonical->getNeighborArray());
+        sharedGeom->setNeighborNormalArray(canonical->getNeighborNormalArray());
+
+        osg::DrawElements* de = new osg::DrawElementsUShort(mode);
+        de->setElementBufferObject(new osg::ElementBufferObject());
+        sharedGeom->setDrawElements(de);
+
+        // the delta geometry holds the vertices we cannot borrow:
+        osg::ref_ptr<SharedGeometry> delta = new SharedGeometry();
+        osg::ref_ptr<osg::VertexBufferObject> vbo = new osg::VertexBufferObject();
+
+        Vec3Ptr verts = new osg::Vec3Array(osg::Array::BIND_PER_VERTEX);
+        verts->setVertexBufferObject(vbo.get());
+        delta->setVertexArray(verts.get());
+
+        Vec3Ptr normals = new osg::Vec3Array(osg::Array::BIND_PER_VERTEX);
+        normals->setVertexBufferObject(vbo.get());
+        delta->setNormalArray(normals.get());
+
+        Vec3Ptr texCoords = new osg::Vec3Array(osg::Array::BIND_PER_VERTEX);
+        texCoords->setVertexBufferObject(vbo.get());
+        delta->setTexCoordArray(texCoords.get());
+
+        Vec3Ptr neighbors, neighborNormals;
+        if (sharedNeighbors && sharedNeighborNormals)
+        {
+            neighbors = new osg::Vec3Array(osg::Array::BIND_PER_VERTEX);
+            neighbors->setVertexBufferObject(vbo.get());
+            delta->setNeighborArray(neighbors.get());
+
+            neighborNormals = new osg::Vec3Array(osg::Array::BIND_PER_VERTEX);
+            neighborNormals->setVertexBufferObject(vbo.get());
+            delta->setNeighborNormalArray(neighborNormals.get());
+        }
+
+        osg::DrawElements* deltaDE = new osg::DrawElementsUShort(mode);
+        deltaDE->setElementBufferObject(new osg::ElementBufferObject());
+        delta->setDrawElements(deltaDE);
+
+        // A grid vertex the edits did not touch is identical to the shared
+        // one. (The boundary marker only matters for skirt generation.)
+        auto isShared = [&](unsigned i)
+        {
+            return
+                (int)i < original_grid_size &&
+                (mesh._markers[i] & ~VERTEX_BOUNDARY) == VERTEX_VISIBLE;
+        };
+
+        // Appends mesh vertex "i" to the delta arrays, with the same data
+        // the private mesh would give it.
+        auto pushVertex = [&](unsigned i)
+        {
+            int marker = mesh._markers[i];
+
+            if ((int)i < original_grid_size && !(marker & VERTEX_CONSTRAINT))
+            {
+                verts->push_back((*sharedVerts)[i]);
+                normals->push_back((*sharedNormals)[i]);
+                const osg::Vec3f& tc = (*sharedTexCoords)[i];
+                texCoords->push_back(osg::Vec3f(tc.x(), tc.y(), (float)marker));
+                if (neighbors.valid())
+                {
+                    neighbors->push_back((*sharedNeighbors)[i]);
+                    neighborNormals->push_back((*sharedNeighborNormals)[i]);
+                }
+            }
+            else
+            {
+                const vert_t& vert = mesh._verts[i];
+                osg::Vec3d v(vert.x(), vert.y(), vert.z());
+                osg::Vec3d unit;
+                locator.worldToUnit(v * local2world, unit);
+                verts->push_back(v);
+                texCoords->push_back(osg::Vec3f(unit.x(), unit.y(), (float)marker));
+
+                unit.z() += 1.0;
+                osg::Vec3d modelPlusOne;
+                locator.unitToWorld(unit, modelPlusOne);
+                osg::Vec3d normal = (modelPlusOne*world2local) - v;
+                normal.normalize();
+                normals->push_back(normal);
+
+                // new or constrained vertex; no morphing
+                if (neighbors.valid())
+                {
+                    neighbors->push_back(v);
+                    neighborNormals->push_back(normal);
+                }
+            }
+        };
+
+        // Appends a surface copy (marked as skirt) and an extruded copy
+        // of mesh vertex "i" to the delta arrays
+        auto pushSkirtVertices = [&](unsigned i, double height)
+        {
+            pushVertex(i);
+            unsigned last = verts->size() - 1;
+            (*texCoords)[last].z() = (float)((int)(*texCoords)[last].z() | VERTEX_SKIRT);
+            verts->push_back((*verts)[last] - (*normals)[last] * height);
+            normals->push_back((*normals)[last]);
+            texCoords->push_back((*texCoords)[last]);
+            if (neighbors.valid())
+            {
+                neighbors->push_back((*neighbors)[last] - (*normals)[last] * height);
+                neighborNormals->push_back((*neighborNormals)[last]);
+            }
+        };
+
+        std::vector<int> deltaIndex(mesh._verts.size(), -1);
+
+        for (const auto& tri_iter : mesh._triangles)
+        {
+            const triangle_t& tri = tri_iter.second;
+            if (isShared(tri.i0) && isShared(tri.i1) && isShared(tri.i2))
+            {
+                de->addElement(tri.i0);
+                de->addElement(tri.i1);
+                de->addElement(tri.i2);
+            }
+            else
+            {
+                for (unsigned i : { tri.i0, tri.i1, tri.i2 })
+                {
+                    if (deltaIndex[i] < 0)
+                    {
+                        pushVertex(i);
+                        deltaIndex[i] = verts->size() - 1;
+                    }
+                    deltaDE->addElement(deltaIndex[i]);
+                }
+            }
+        }
+
+        unsigned numSkirtEdges = 0u;
+
+        if (skirtHeightRatio > 0.0)
+        {
+            osg::BoundingSphere tileBound;
+            for (auto& vert : mesh._verts)
+                tileBound.expandBy(osg::Vec3(vert.x(), vert.y(), vert.z()));
+
+            double skirtHeight = skirtHeightRatio * tileBound.radius();
+
+            // Position of each perimeter vertex in the shared skirt, which
+            // runs top, right, bottom, left (see GeometryPool::createGeometry)
+            int perimeterSize = 0;
+            std::vector<int> perimeter;
+            if ((int)sharedVerts->size() > original_grid_size)
+            {
+                perimeter.assign(original_grid_size, -1);
+                for (int c = 0; c < (int)tileSize - 1; ++c)
+                    perimeter[c] = perimeterSize++; //top
+                for (int r = 0; r < (int)tileSize - 1; ++r)
+                    perimeter[r*tileSize + (tileSize - 1)] = perimeterSize++; //right
+                for (int c = tileSize - 1; c > 0; --c)
+                    perimeter[(tileSize - 1)*tileSize + c] = perimeterSize++; //bottom
+                for (int r = tileSize - 1; r > 0; --r)
+                    perimeter[r*tileSize] = perimeterSize++; //left
+            }
+
+            // collect all edges marked as boundaries
+            edgeset_t boundary_edges(mesh, VERTEX_BOUNDARY);
+            numSkirtEdges = boundary_edges._edges.size();
+
+            for (auto& edge : boundary_edges._edges)
+            {
+                // an untouched stretch of the tile perimeter uses the shared skirt:
+                if (perimeterSize > 0 && isShared(edge._i0) && isShared(edge._i1))
+                {
+                    int k0 = perimeter[edge._i0];
+                    int k1 = perimeter[edge._i1];
+                    if (k0 >= 0 && k1 >= 0)
+                    {
+                        if ((k1 + 1) % perimeterSize == k0)
+                            std::swap(k0, k1);
+
+                        if ((k0 + 1) % perimeterSize == k1)
+                        {
+                            addSkirtTriangles(de, original_grid_size + 2 * k0, original_grid_size + 2 * k1);
+                            continue;
+                        }
+                    }
+                }
+
+                // bail if we run out of UShort space
+                if (verts->size() + 4 > 0xFFFF)
+                    break;
+
+                pushSkirtVertices(edge._i0, skirtHeight);
+                pushSkirtVertices(edge._i1, skirtHeight);
+                addSkirtTriangles(deltaDE, verts->size() - 4, verts->size() - 2);
+            }
+        }
+
+        if (deltaDE->getNumIndices() > 0)
+        {
+            sharedGeom->setDelta(delta.get());
+        }
+
+        // Mark the geometry appropriately
+        sharedGeom->setHasConstraints(mesh._num_edits > 0);
+
+        // Compare with the arrays and elements a private mesh would use:
+        std::size_t numArrays = neighbors.valid() ? 5u : 3u;
+        std::size_t privateBytes =
+            (mesh._verts.size() + numSkirtEdges * 4) * numArrays * sizeof(osg::Vec3f) +
+            (mesh._triangles.size() * 3 + numSkirtEdges * 6) * sizeof(GLushort);
+        std::size_t bytes =
+            (sharedGeom->getDelta() ? verts->size() : 0u) * numArrays * sizeof(osg::Vec3f) +
+            (de->getNumIndices() + deltaDE->getNumIndices()) * sizeof(GLushort);
+
+        sharedGeom->setBytesSaved(privateBytes > bytes ? (unsigned)(privateBytes - bytes) : 0u);
+    }
+}
+
 bool
 MeshEditor::createTileMesh(
     SharedGeometry* sharedGeom,
     unsigned tileSize,
     double skirtHeightRatio,
     GLenum mode,
+    SharedGeometry* canonical,
     Cancelable* progress)
 {
     // uncomment for easier debugging
@@ -327,6 +575,23 @@ MeshEditor::createTileMesh(
         }
     }
 
+    // Borrow the unedited tile's vertices where we can:
+    if (canonical)
+    {
+        createSharedTileMesh(
+            mesh,
+            sharedGeom,
+            canonical,
+            tileSize,
+            skirtHeightRatio,
+            mode,
+            locator,
+            world2local,
+            local2world);
+
+        return true;
+    }
+
     // We have an edited mesh, now turn it back into something OSG can render.
     using Vec3Ptr = osg::ref_ptr<osg::Vec3Array>;
     Vec3Ptr verts = dynamic_cast<osg::Vec3Array*>(sharedGeom->getVertexArray());
@@ -0,0 +1,509 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2008-2014 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "Prefetcher"
+#include "EngineContext"
+#include "SelectionInfo"
+#include "TerrainCuller"
+#include "TileNode"
+#include "TileNodeRegistry"
+
+#include <osgEarth/FrameClock>
+#include <osgEarth/GeoData>
+#include <osgEarth/Map>
+#include <osgEarth/Metrics>
+#include <osgEarth/TerrainEngineNode>
+#include <algorithm>
+
+using namespace osgEarth::REX;
+using namespace osgEarth;
+
+#define LC "[Prefetcher] "
+
+// Number of camera samples used to estimate velocity
+#define MAX_SAMPLES 8
+
+// Points along the predicted path at which to test tile ranges
+#define PATH_STEPS 4
+
+// Cap on the number of keys visited per path point, to bound the
+// cost of a prediction on the cull thread
+#define MAX_VISITS_PER_STEP 2048
+
+// Forget a camera that hasn't culled in this many frames
+#define CAMERA_EXPIRY_FRAMES 60u
+
+Prefetcher::Prefetcher() :
+    _frame(~0u),
+    _dispatched(0u),
+    _hits(0u),
+    _adopted(0u),
+    _dropped(0u)
+{
+    //nop
+}
+
+void
+Prefetcher::cull(TerrainCuller* culler)
+{
+    EngineContext* context = culler->getEngineContext();
+    const TerrainOptions& options = context->options();
+
+    if (options.prefetch() == false ||
+        options.rangeMode() == osg::LOD::PIXEL_SIZE_ON_SCREEN)
+    {
+        clear();
+        return;
+    }
+
+    // Spy and inherit-viewpoint cameras never subdivide the terrain,
+    // so there is nothing to predict for them.
+    const osg::Camera* camera = culler->getCamera();
+    if (camera == nullptr ||
+        culler->_isSpy ||
+        camera->getReferenceFrame() == osg::Camera::ABSOLUTE_RF_INHERIT_VIEWPOINT)
+    {
+        return;
+    }
+
+    osg::ref_ptr<const Map> map = context->getMap();
+    if (!map.valid())
+        return;
+
+    OE_PROFILING_ZONE;
+
+    unsigned frame = context->getClock()->getFrame();
+    double time = context->getClock()->getTime();
+    unsigned budget = options.prefetchBudget().get();
+
+    osg::Vec3d eye = culler->_cv->getViewPointLocal();
+    osg::Vec3d look = culler->_cv->getLookVectorLocal();
+    float lodScale = culler->_cv->getLODScale();
+
+    osg::Vec3d travel;
+    {
+        ScopedMutexLock lock(_mutex);
+
+        // once per frame, collect finished requests and drop stale ones
+        if (frame != _frame)
+        {
+            _frame = frame;
+            harvest(context, map.get());
+
+            for (auto i = _cameras.begin(); i != _cameras.end(); )
+            {
+                if (frame - i->second.lastFrame > CAMERA_EXPIRY_FRAMES)
+                    i = _cameras.erase(i);
+                else
+                    ++i;
+            }
+        }
+
+        CameraHistory& history = _cameras[camera];
+        if (!history.samples.empty() && history.lastFrame == frame)
+            return;
+
+        history.lastFrame = frame;
+        history.samples.push_back(Sample{ time, eye });
+        if (history.samples.size() > MAX_SAMPLES)
+            history.samples.pop_front();
+
+        if (history.samples.size() < 2u)
+            return;
+
+        const Sample& first = history.samples.front();
+        const Sample& last = history.samples.back();
+        double elapsed = last.time - first.time;
+        if (elapsed <= 0.0)
+            return;
+
+        // Extrapolate the average velocity over the sample window
+        osg::Vec3d velocity = (last.eye - first.eye) / elapsed;
+        double frameTime = elapsed / (double)(history.samples.size() - 1);
+        travel = velocity * frameTime * (double)options.prefetchFrames().get();
+    }
+
+    // Not moving enough to reach a new tile at the finest LOD; the
+    // regular cull will take care of everything in view.
+    const SelectionInfo& si = context->getSelectionInfo();
+    if (si.getNumLODs() == 0u ||
+        travel.length() < 0.5 * si.getLOD(si.getNumLODs() - 1)._visibilityRange)
+    {
+        return;
+    }
+
+    // Walk the quadtree at several points along the predicted path.
+    // Nearer points get the higher priority. This is most of the work,
+    // so it runs without the lock, which claim() takes on the tile
+    // loading path.
+    Bounds bounds;
+    Candidates candidates;
+    for (int step = 1; step <= PATH_STEPS; ++step)
+    {
+        float t = (float)step / (float)PATH_STEPS;
+        plan(context, map.get(), eye + travel * t, look, lodScale, t, bounds, candidates);
+    }
+
+    if (candidates.empty())
+        return;
+
+    ScopedMutexLock lock(_mutex);
+
+    // Keep the requests and models the plan still wants, and
+    // issue the most urgent new requests that fit in the budget.
+    std::vector<std::pair<float, TileKey>> sorted;
+    sorted.reserve(candidates.size());
+    for (auto& c : candidates)
+    {
+        auto p = _pending.find(c.first);
+        if (p != _pending.end())
+        {
+            p->second.lastWantedFrame = _frame;
+            if (c.second > p->second.priority->prefetch.load())
+                p->second.priority->prefetch.store(c.second);
+            continue;
+        }
+
+        auto cached = _cache.find(c.first);
+        if (cached != _cache.end())
+        {
+            _lru.splice(_lru.end(), _lru, cached->second.lru);
+            continue;
+        }
+
+        sorted.emplace_back(c.second, c.first);
+    }
+
+    std::sort(sorted.begin(), sorted.end(),
+        [](const std::pair<float, TileKey>& lhs, const std::pair<float, TileKey>& rhs) {
+            return lhs.first > rhs.first;
+        });
+
+    for (auto& s : sorted)
+    {
+        if (_pending.size() >= budget)
+            break;
+        dispatch(context, map.get(), s.second, s.first);
+    }
+}
+
+void
+Prefetcher::plan(
+    EngineContext* context,
+    const Map* map,
+    const osg::Vec3d& eye,
+    const osg::Vec3d& look,
+    float lodScale,
+    float t,
+    Bounds& bounds,
+    Candidates& candidates) const
+{
+    const SelectionInfo& si = context->getSelectionInfo();
+    const TerrainOptions& options = context->options();
+    const unsigned numLODs = si.getNumLODs();
+    const unsigned minLOD = options.minLOD().get();
+
+    std::vector<TileKey> stack;
+    map->getProfile()->getAllKeysAtLOD(options.firstLOD().get(), stack);
+
+    int visits = 0;
+    while (!stack.empty() && visits++ < MAX_VISITS_PER_STEP)
+    {
+        TileKey key = stack.back();
+        stack.pop_back();
+
+        if (key.getLOD() + 1u >= numLODs)
+            continue;
+
+        // Same test key the TileNode uses to decide whether to subdivide
+        unsigned tw, th;
+        key.getProfile()->getNumTiles(key.getLOD(), tw, th);
+        TileKey testKey = key.createChildKey(key.getTileY() <= th / 2 ? 0 : 3);
+
+        float range = si.getRange(testKey);
+        if (range <= 0.0f)
+            continue;
+
+        // REX creates (and loads) all four children once any of them is in range
+        TileKey children[4];
+        bool inRange = false;
+        for (unsigned q = 0; q < 4; ++q)
+        {
+            children[q] = key.createChildKey(q);
+            const osg::BoundingSphered& bs = getBound(context, children[q], bounds);
+            double distance = ((bs.center() - eye).length() - bs.radius()) * lodScale;
+            if (distance < range)
+                inRange = true;
+        }
+
+        if (!inRange)
+            continue;
+
+        for (unsigned q = 0; q < 4; ++q)
+        {
+            const TileKey& child = children[q];
+            const osg::BoundingSphered& bs = getBound(context, child, bounds);
+
+            // skip anything entirely behind the predicted eye point
+            if ((bs.center() - eye) * look < -bs.radius())
+                continue;
+
+            stack.push_back(child);
+
+            // below the minimum LOD, tiles don't load any data
+            if (child.getLOD() < minLOD)
+                continue;
+
+            // sooner first, then coarser first; always below zero, which
+            // is the lowest priority a visible tile can have.
+            float priority = -1.0f - t - (float)child.getLOD() / (float)numLODs;
+
+            // live tiles load their own data
+            if (context->liveTiles()->get(child).valid())
+                continue;
+
+            float& best = candidates.emplace(child, priority).first->second;
+            best = std::max(best, priority);
+        }
+    }
+}
+
+const osg::BoundingSphered&
+Prefetcher::getBound(EngineContext* context, const TileKey& key, Bounds& bounds) const
+{
+    auto i = bounds.find(key);
+    if (i != bounds.end())
+        return i->second;
+
+    osg::BoundingSphered& bs = bounds[key];
+
+    // A live tile knows its real bounds, including elevation
+    osg::ref_ptr<TileNode> tile = context->liveTiles()->get(key);
+    if (tile.valid())
+    {
+        const osg::BoundingSphere& tb = tile->getBound();
+        bs.set(osg::Vec3d(tb.center()), (double)tb.radius());
+    }
+
+    // Otherwise approximate it from the corners and center of the
+    // extent at sea level, which is much cheaper than
+    // GeoExtent::createWorldBoundingSphere.
+    else
+    {
+        const GeoExtent& e = key.getExtent();
+        osg::Vec3d center;
+        GeoPoint(e.getSRS(), 0.5*(e.xMin() + e.xMax()), 0.5*(e.yMin() + e.yMax()), 0.0, ALTMODE_ABSOLUTE).toWorld(center);
+
+        double radius2 = 0.0;
+        const double x[2] = { e.xMin(), e.xMax() };
+        const double y[2] = { e.yMin(), e.yMax() };
+        for (int xi = 0; xi < 2; ++xi)
+        {
+            for (int yi = 0; yi < 2; ++yi)
+            {
+                osg::Vec3d corner;
+                GeoPoint(e.getSRS(), x[xi], y[yi], 0.0, ALTMODE_ABSOLUTE).toWorld(corner);
+                radius2 = std::max(radius2, (corner - center).length2());
+            }
+        }
+        bs.set(center, sqrt(radius2));
+    }
+
+    return bs;
+}
+
+void
+Prefetcher::dispatch(
+    EngineContext* context,
+    const Map* map,
+    const TileKey& key,
+    float priority)
+{
+    osg::ref_ptr<TerrainEngineNode> engine = context->getEngine();
+    if (!engine.valid())
+        return;
+
+    osg::ref_ptr<const Map> map_ref(map);
+
+    auto load = [engine, map_ref, key](Cancelable* progress)
+    {
+        osg::ref_ptr<ProgressCallback> wrapper = new ProgressCallback(progress);
+
+        osg::ref_ptr<TerrainTileModel> result = engine->createTileModel(
+            map_ref.get(),
+            key,
+            CreateTileManifest(),
+            wrapper.get());
+
+        return result;
+    };
+
+    // The priority lives outside the request so that a TileNode that
+    // adopts the request can take over its scheduling. (The priority
+    // function must not hold the Future, or the job could never be
+    // abandoned.)
+    Request& request = _pending[key];
+    request.priority = std::make_shared<Priority>();
+    request.priority->prefetch.store(priority);
+    request.lastWantedFrame = _frame;
+
+    std::shared_ptr<const Priority> shared_priority = request.priority;
+
+    Job job;
+    job.setArena(ARENA_LOAD_TILE);
+    job.setName(key.str());
+    job.setPriorityFunction([shared_priority]()
+    {
+        std::shared_ptr<const std::function<float()>> adopted = std::atomic_load(&shared_priority->adopted);
+        return adopted ? (*adopted)() : shared_priority->prefetch.load();
+    });
+    request.result = job.dispatch<LoadResult>(load);
+
+    ++_dispatched;
+}
+
+void
+Prefetcher::harvest(EngineContext* context, const Map* map)
+{
+    const TerrainOptions& options = context->options();
+    unsigned expiry = options.prefetchFrames().get();
+
+    for (auto i = _pending.begin(); i != _pending.end(); )
+    {
+        Request& request = i->second;
+
+        if (request.result.isAvailable())
+        {
+            const LoadResult& model = request.result.get();
+            if (model.valid() && model->getRevision() == map->getDataModelRevision())
+                addToCache(i->first, model, options.prefetchCacheSize().get());
+            else
+                ++_dropped;
+            i = _pending.erase(i);
+        }
+
+        // Erasing the only Future cancels the request
+        else if (request.result.isAbandoned() || _frame - request.lastWantedFrame > expiry)
+        {
+            ++_dropped;
+            i = _pending.erase(i);
+        }
+
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+void
+Prefetcher::addToCache(const TileKey& key, const LoadResult& model, unsigned maxSize)
+{
+    auto c = _cache.find(key);
+    if (c != _cache.end())
+    {
+        c->second.model = model;
+        _lru.splice(_lru.end(), _lru, c->second.lru);
+    }
+    else
+    {
+        _lru.push_back(key);
+        Cached& entry = _cache[key];
+        entry.model = model;
+        entry.lru = std::prev(_lru.end());
+    }
+
+    while (_cache.size() > maxSize)
+    {
+        _cache.erase(_lru.front());
+        _lru.pop_front();
+        ++_dropped;
+    }
+}
+
+bool
+Prefetcher::claim(
+    const TileKey& key,
+    const Map* map,
+    const std::function<float()>& priority,
+    Future<LoadResult>& output)
+{
+    ScopedMutexLock lock(_mutex);
+
+    auto c = _cache.find(key);
+    if (c != _cache.end())
+    {
+        LoadResult model = c->second.model;
+        _lru.erase(c->second.lru);
+        _cache.erase(c);
+
+        if (model.valid() && model->getRevision() == map->getDataModelRevision())
+        {
+            Promise<LoadResult> promise;
+            output = promise.getFuture();
+            promise.resolve(model);
+            ++_hits;
+            return true;
+        }
+
+        ++_dropped;
+        return false;
+    }
+
+    auto p = _pending.find(key);
+    if (p != _pending.end())
+    {
+        // A visible tile wants it now, so from here on it competes with
+        // other visible tiles, re-evaluated each time the queue is sorted
+        std::atomic_store(
+            &p->second.priority->adopted,
+            std::shared_ptr<const std::function<float()>>(new std::function<float()>(priority)));
+        output = p->second.result;
+        _pending.erase(p);
+        ++_adopted;
+        return true;
+    }
+
+    return false;
+}
+
+void
+Prefetcher::clear()
+{
+    ScopedMutexLock lock(_mutex);
+    if (_pending.empty() && _cache.empty())
+        return;
+    _dropped += _pending.size() + _cache.size();
+    _pending.clear();
+    _cache.clear();
+    _lru.clear();
+}
+
+Prefetcher::Stats
+Prefetcher::getStats() const
+{
+    ScopedMutexLock lock(_mutex);
+    Stats stats;
+    stats.pending = _pending.size();
+    stats.cached = _cache.size();
+    stats.dispatched = _dispatched;
+    stats.hits = _hits;
+    stats.adopted = _adopted;
+    stats.dropped = _dropped;
+    return stats;
+}
@@ -41,6 +41,8 @@
 #include <osg/Depth>
 #include <osg/CullFace>
 #include <osg/ValueObject>
+#include <osg/Stats>
+#include <osg/Timer>
 
 #include <cstdlib> // for getenv
 
@@ -172,6 +174,7 @@ RexTerrainEngineNode::RexTerrainEngineNode() :
     ADJUST_EVENT_TRAV_COUNT(this, +1);
 
     _updatedThisFrame = false;
+    _updateTime = 0.0;
 }
 
 RexTerrainEngineNode::~RexTerrainEngineNode()
@@ -285,7 +288,6 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& inOptions)
     _liveTiles = new TileNodeRegistry("live");
     _liveTiles->setFrameClock(&_clock);
     _liveTiles->setMapRevision(map->getDataModelRevision());
-    _liveTiles->setNotifyNeighbors(options().normalizeEdges() == true);
     _liveTiles->setFirstLOD(options().firstLOD().get());
 
     // A shared geometry pool.
@@ -297,6 +299,9 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& inOptions)
     _merger->setMergesPerFrame(options().mergesPerFrame().get());
     this->addChild(_merger.get());
 
+    // Predictive loader for tiles the camera is heading towards
+    _prefetcher = new Prefetcher();
+
     // Loader concurrency (size of the thread pool)
     unsigned concurrency = options().concurrency().get();
     const char* concurrency_str = ::getenv("OSGEARTH_TERRAIN_CONCURRENCY");
@@ -334,6 +339,7 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& inOptions)
         this, // engine
         _geometryPool.get(),
         _merger.get(),
+        _prefetcher.get(),
         _liveTiles.get(),
         _renderBindings,
         options(),
@@ -399,6 +405,10 @@ RexTerrainEngineNode::invalidateRegion(
 
         _liveTiles->setDirty(extentLocal, minLevel, maxLevel, manifest);
     }
+
+    // prefetched data may be out of date now
+    if (_prefetcher.valid())
+        _prefetcher->clear();
 }
 
 void
@@ -435,6 +445,10 @@ RexTerrainEngineNode::invalidateRegion(
 
         _liveTiles->setDirty(extentLocal, minLevel, maxLevel, manifest);
     }
+
+    // prefetched data may be out of date now
+    if (_prefetcher.valid())
+        _prefetcher->clear();
 }
 
 void
@@ -549,6 +563,9 @@ RexTerrainEngineNode::dirtyTerrain()
     // clear the loader:
     _merger->clear();
 
+    // and anything loaded in anticipation:
+    _prefetcher->clear();
+
     // clear out the tile registry:
     if ( _liveTiles.valid() )
     {
@@ -641,6 +658,14 @@ RexTerrainEngineNode::cull_traverse(osg::NodeVisitor& nv)
 
     osgUtil::CullVisitor* cv = static_cast<osgUtil::CullVisitor*>(&nv);
 
+    // Timings and counts go in the camera stats, if requested
+    osg::Stats* stats = cv->getCurrentCamera()->getStats();
+    if (stats && (!stats->collectStats("terrain") || !cv->getFrameStamp()))
+        stats = nullptr;
+
+    const osg::Timer* timer = osg::Timer::instance();
+    osg::Timer_t cullStart = stats ? timer->tick() : 0;
+
     // Initialize a new culler
     TerrainCuller culler(cv, this->getEngineContext());
 
@@ -650,14 +675,48 @@ RexTerrainEngineNode::cull_traverse(osg::NodeVisitor& nv)
     // Assemble the terrain drawables:
     _terrain->accept(culler);
 
+    osg::Timer_t cullEnd = stats ? timer->tick() : 0;
+
+    // Anticipate the tiles this camera will need next
+    _prefetcher->cull(&culler);
+
     // If we're using geometry pooling, optimize the drawable for shared state
     // by sorting the draw commands.
     // TODO: benchmark this further to see whether it's worthwhile
+    osg::Timer_t sortStart = stats ? timer->tick() : 0;
     unsigned totalTiles = 0L;
     if (getEngineContext()->getGeometryPool()->isEnabled())
     {
         totalTiles = culler._terrain.sortDrawCommands();
     }
+    osg::Timer_t sortEnd = stats ? timer->tick() : 0;
+
+    // Report timings, loading progress, and geometry sharing
+    if (stats)
+    {
+        unsigned frame = cv->getFrameStamp()->getFrameNumber();
+
+        unsigned drawCommands = 0u;
+        for (auto& layer : culler._terrain.layers())
+            drawCommands += layer->_tiles.size();
+
+        stats->setAttribute(frame, "Terrain cull time taken", timer->delta_s(cullStart, cullEnd));
+        stats->setAttribute(frame, "Terrain sort time taken", timer->delta_s(sortStart, sortEnd));
+        stats->setAttribute(frame, "Terrain update time taken", _updateTime.load());
+        stats->setAttribute(frame, "Terrain tiles live", _liveTiles->size());
+        stats->setAttribute(frame, "Terrain draw commands", drawCommands);
+
+        Prefetcher::Stats prefetch = _prefetcher->getStats();
+        stats->setAttribute(frame, "Terrain tiles loading", culler._tilesLoading);
+        stats->setAttribute(frame, "Terrain prefetch pending", prefetch.pending);
+        stats->setAttribute(frame, "Terrain prefetch cached", prefetch.cached);
+        stats->setAttribute(frame, "Terrain prefetch dispatched", prefetch.dispatched);
+        stats->setAttribute(frame, "Terrain prefetch hits", prefetch.hits + prefetch.adopted);
+
+        GeometryPool::Stats pool = _geometryPool->getStats();
+        stats->setAttribute(frame, "Terrain edited geometries", pool.edited);
+        stats->setAttribute(frame, "Terrain geometry KB saved", (double)pool.bytesSaved / 1024.0);
+    }
 
     // The common stateset for the terrain group:
     cv->pushStateSet(_terrain->getOrCreateStateSet());
@@ -823,7 +882,9 @@ RexTerrainEngineNode::update_traverse(osg::NodeVisitor& nv)
     }
 
     // Call update on the tile registry
+    osg::Timer_t updateStart = osg::Timer::instance()->tick();
     _liveTiles->update(nv);
+    _updateTime = osg::Timer::instance()->delta_s(updateStart, osg::Timer::instance()->tick());
 }
 
 void
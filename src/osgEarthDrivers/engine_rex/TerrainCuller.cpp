@@ -32,6 +32,7 @@ TerrainCuller::TerrainCuller(osgUtil::CullVisitor* cullVisitor, EngineContext* c
 _camera(0L),
 _currentTileNode(0L),
 _orphanedPassesDetected(0u),
+_tilesLoading(0u),
 _cv(cullVisitor),
 _context(context),
 _layerExtents(nullptr)
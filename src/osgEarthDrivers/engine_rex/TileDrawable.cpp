@@ -99,20 +99,69 @@ TileDrawable::setElevationRaster(const osg::Image*   image,
         OE_WARN << "("<<_key.str()<<") precision error\n";
     }
 
-    const osg::Vec3Array& verts = *static_cast<osg::Vec3Array*>(_geom->getVertexArray());
     const osg::DrawElementsUShort* de = dynamic_cast<osg::DrawElementsUShort*>(_geom->getDrawElements());
 
     OE_SOFT_ASSERT_AND_RETURN(de != nullptr, void());
 
-    if (_mesh.size() < verts.size())
+    // vertices not in the shared arrays follow them in the mesh:
+    const SharedGeometry* delta = _geom->getDelta();
+    unsigned numShared = _geom->getVertexArray()->getNumElements();
+    unsigned numVerts = numShared + (delta ? delta->getVertexArray()->getNumElements() : 0u);
+
+    if (_mesh.size() < numVerts)
+    {
+        _mesh.resize(numVerts);
+    }
+
+    if (delta && !_elements.valid())
+    {
+        _elements = new osg::DrawElementsUShort(de->getMode());
+        _elements->reserveElements(de->getNumIndices() + delta->getDrawElements()->getNumIndices());
+        _elements->insert(_elements->end(), de->begin(), de->end());
+        for (unsigned i = 0; i < delta->getDrawElements()->getNumIndices(); ++i)
+            _elements->addElement(numShared + delta->getDrawElements()->index(i));
+    }
+
+    updateMesh(_geom.get(), 0u);
+
+    if (delta)
     {
-        _mesh.resize(verts.size());
+        updateMesh(delta, numShared);
     }
 
+    // Make a temporary geometry to build kdtrees on and copy the shape over
+    if (_geom->getDrawElements()->getMode() != GL_PATCHES)
+    {
+        osg::ref_ptr< osg::Geometry > tempGeom = new osg::Geometry;
+        osg::Vec3Array* tempVerts = new osg::Vec3Array;
+        tempVerts->reserve(_mesh.size());
+        for (unsigned int i = 0; i < _mesh.size(); i++)
+        {
+            tempVerts->push_back(_mesh[i]);
+        }
+        tempGeom->setVertexArray(tempVerts);
+        tempGeom->addPrimitiveSet(_elements.valid() ? _elements.get() : _geom->getDrawElements());
+
+        osg::ref_ptr< osg::KdTreeBuilder > kdTreeBuilder = new osg::KdTreeBuilder();
+        tempGeom->accept(*kdTreeBuilder.get());
+        if (tempGeom->getShape())
+        {
+            setShape(tempGeom->getShape());
+        }
+    }
+
+    dirtyBound();
+}
+
+void
+TileDrawable::updateMesh(const SharedGeometry* geom, unsigned offset)
+{
+    const osg::Vec3Array& verts = *static_cast<const osg::Vec3Array*>(geom->getVertexArray());
+
     if ( _elevationRaster.valid() )
     {
-        const osg::Vec3Array& normals = *static_cast<osg::Vec3Array*>(_geom->getNormalArray());
-        const osg::Vec3Array& units = *static_cast<osg::Vec3Array*>(_geom->getTexCoordArray());
+        const osg::Vec3Array& normals = *static_cast<const osg::Vec3Array*>(geom->getNormalArray());
+        const osg::Vec3Array& units = *static_cast<const osg::Vec3Array*>(geom->getTexCoordArray());
 
         //OE_INFO << LC << _key.str() << " - rebuilding height cache" << std::endl;
 
@@ -140,43 +189,19 @@ TileDrawable::setElevationRaster(const osg::Image*   image,
                     clamp(units[i].x()*scaleU + biasU, 0.0f, 1.0f),
                     clamp(units[i].y()*scaleV + biasV, 0.0f, 1.0f));
 
-                _mesh[i] = verts[i] + normals[i] * sample.r();
+                _mesh[offset + i] = verts[i] + normals[i] * sample.r();
             }
             else
             {
-                _mesh[i] = verts[i];
+                _mesh[offset + i] = verts[i];
             }
         }
     }
 
     else
     {
-        std::copy(verts.begin(), verts.end(), _mesh.begin());
+        std::copy(verts.begin(), verts.end(), _mesh.begin() + offset);
     }
-
-
-    // Make a temporary geometry to build kdtrees on and copy the shape over
-    if (_geom->getDrawElements()->getMode() != GL_PATCHES)
-    {
-        osg::ref_ptr< osg::Geometry > tempGeom = new osg::Geometry;
-        osg::Vec3Array* tempVerts = new osg::Vec3Array;
-        tempVerts->reserve(_mesh.size());
-        for (unsigned int i = 0; i < _mesh.size(); i++)
-        {
-            tempVerts->push_back(_mesh[i]);
-        }
-        tempGeom->setVertexArray(tempVerts);
-        tempGeom->addPrimitiveSet(_geom->getDrawElements());
-
-        osg::ref_ptr< osg::KdTreeBuilder > kdTreeBuilder = new osg::KdTreeBuilder();
-        tempGeom->accept(*kdTreeBuilder.get());
-        if (tempGeom->getShape())
-        {
-            setShape(tempGeom->getShape());
-        }
-    }
-
-    dirtyBound();
 }
 
 // Functor supplies triangles to things like IntersectionVisitor, ComputeBoundsVisitor, etc.
@@ -185,10 +210,14 @@ TileDrawable::accept(osg::PrimitiveFunctor& f) const
 {
     f.setVertexArray(_mesh.size(), _mesh.data());
 
+    const osg::DrawElements* de = _elements.valid() ?
+        _elements.get() :
+        _geom->getDrawElements();
+
     f.drawElements(
         GL_TRIANGLES,
-        _geom->getDrawElements()->getNumIndices(),
-        static_cast<const GLushort*>(_geom->getDrawElements()->getDataPointer()));
+        de->getNumIndices(),
+        static_cast<const GLushort*>(de->getDataPointer()));
 }
 
 osg::BoundingSphere
@@ -978,14 +978,7 @@ TileNode::merge(
                 osg::Texture* tex = etex->getNormalMapTexture();
                 int revision = model->elevationModel()->getRevision();
 
-                if (options().normalizeEdges() == true)
-                {
-                    // keep the normal map around because we might update it later
-                    tex->setUnRefImageDataAfterApply(false);
-                }
-
                 _renderModel.setSharedSampler(SamplerBinding::NORMAL, tex, revision);
-                updateNormalMap();
             }
         }
 
@@ -996,7 +989,6 @@ TileNode::merge(
             _renderModel._sharedSamplers[SamplerBinding::NORMAL].ownsTexture())
         {
             inheritSharedSampler(SamplerBinding::NORMAL);
-            updateNormalMap();
         }
     }
 
@@ -1295,6 +1287,8 @@ TileNode::load(TerrainCuller* culler)
 
     if (_loadQueue.empty() == false)
     {
+        ++culler->_tilesLoading;
+
         LoadTileDataOperationPtr& op = _loadQueue.front();
 
         if (op->_result.isAbandoned())
@@ -1354,103 +1348,6 @@ TileNode::removeSubTiles()
     _createChildResults.clear();
 }
 
-
-void
-TileNode::notifyOfArrival(TileNode* that)
-{
-    if (options().normalizeEdges() == true)
-    {
-        if (_key.createNeighborKey(1, 0) == that->getKey())
-            _eastNeighbor = that;
-
-        if (_key.createNeighborKey(0, 1) == that->getKey())
-            _southNeighbor = that;
-
-        updateNormalMap();
-    }
-}
-
-void
-TileNode::updateNormalMap()
-{
-    if (options().normalizeEdges() == false)
-        return;
-
-    Sampler& thisNormalMap = _renderModel._sharedSamplers[SamplerBinding::NORMAL];
-    if (thisNormalMap.inheritsTexture() || !thisNormalMap._texture->getImage(0))
-        return;
-
-    if (!_eastNeighbor.valid() || !_southNeighbor.valid())
-        return;
-
-    osg::ref_ptr<TileNode> east;
-    if (_eastNeighbor.lock(east))
-    {
-        const Sampler& thatNormalMap = east->_renderModel._sharedSamplers[SamplerBinding::NORMAL];
-        if (thatNormalMap.inheritsTexture() || !thatNormalMap._texture->getImage(0))
-            return;
-
-        osg::Image* thisImage = thisNormalMap._texture->getImage(0);
-        osg::Image* thatImage = thatNormalMap._texture->getImage(0);
-
-        int width = thisImage->s();
-        int height = thisImage->t();
-        if ( width != thatImage->s() || height != thatImage->t() )
-            return;
-
-        // Just copy the neighbor's edge normals over to our texture.
-        // Averaging them would be more accurate, but then we'd have to
-        // re-generate each texture multiple times instead of just once.
-        // Besides, there's almost no visual difference anyway.
-        osg::Vec4 pixel;
-        ImageUtils::PixelReader readThat(thatImage);
-        ImageUtils::PixelWriter writeThis(thisImage);
-        
-        for (int t=0; t<height; ++t)
-        {
-            readThat(pixel, 0, t);
-            writeThis(pixel, width-1, t);
-            //writeThis(readThat(0, t), width-1, t);
-        }
-
-        thisImage->dirty();
-    }
-
-    osg::ref_ptr<TileNode> south;
-    if (_southNeighbor.lock(south))
-    {
-        const Sampler& thatNormalMap = south->_renderModel._sharedSamplers[SamplerBinding::NORMAL];
-        if (thatNormalMap.inheritsTexture() || !thatNormalMap._texture->getImage(0))
-            return;
-
-        osg::Image* thisImage = thisNormalMap._texture->getImage(0);
-        osg::Image* thatImage = thatNormalMap._texture->getImage(0);
-
-        int width = thisImage->s();
-        int height = thisImage->t();
-        if ( width != thatImage->s() || height != thatImage->t() )
-            return;
-
-        // Just copy the neighbor's edge normals over to our texture.
-        // Averaging them would be more accurate, but then we'd have to
-        // re-generate each texture multiple times instead of just once.
-        // Besides, there's almost no visual difference anyway.
-        osg::Vec4 pixel;
-        ImageUtils::PixelReader readThat(thatImage);
-        ImageUtils::PixelWriter writeThis(thisImage);
-
-        for (int s=0; s<width; ++s)
-        {
-            readThat(pixel, s, height-1);
-            writeThis(pixel, s, 0);
-        }
-
-        thisImage->dirty();
-    }
-
-    //OE_INFO << LC << _key.str() << " : updated normal map.\n";
-}
-
 const TerrainOptions&
 TileNode::options() const
 {
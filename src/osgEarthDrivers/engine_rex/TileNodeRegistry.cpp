@@ -37,7 +37,6 @@ using namespace osgEarth;
 TileNodeRegistry::TileNodeRegistry(const std::string& name) :
 _name              ( name ),
 _revisioningEnabled( false ),
-_notifyNeighbors   ( false ),
 _firstLOD          ( 0u ),
 _mutex("TileNodeRegistry(OE)")
 {
@@ -56,12 +55,6 @@ TileNodeRegistry::setRevisioningEnabled(bool value)
     _revisioningEnabled = value;
 }
 
-void
-TileNodeRegistry::setNotifyNeighbors(bool value)
-{
-    _notifyNeighbors = value;
-}
-
 void
 TileNodeRegistry::setMapRevision(const Revision& rev,
                                  bool            setToDirty)
@@ -123,7 +116,6 @@ TileNodeRegistry::add(TileNode* tile)
     // the registry records for its descendants, but the orphaned record has
     // not yet itself been removed by the Unloader. So we have to check!
 
-    bool recyclingOrphan = false;
     TrackerEntry* se;
     TableEntry* te;
 
@@ -131,7 +123,6 @@ TileNodeRegistry::add(TileNode* tile)
     if (i != _tiles.end())
     {
         // found an orphan! Reuse and overwrite it.
-        recyclingOrphan = true;
         te = &i->second;
         se = (*te->_trackerptr);
         _tracker.erase(te->_trackerptr); // since we need to move it to the front
@@ -153,90 +144,10 @@ TileNodeRegistry::add(TileNode* tile)
     // init the table entry:
     te->_tile = tile;
     te->_trackerptr = _tracker.begin();
-    
-    // Start waiting on our neighbors.
-    // (If we're recycling and orphaned record, we need to remove old listeners first)
-    if (_notifyNeighbors)
-    {
-        const TileKey& key = tile->getKey();
-
-        // If we're recycling, we need to remove the old listeners first
-        if (recyclingOrphan)
-        {
-            stopListeningFor(key.createNeighborKey(1, 0), key);
-            stopListeningFor(key.createNeighborKey(0, 1), key);
-        }
-
-        startListeningFor(key.createNeighborKey(1, 0), tile);
-        startListeningFor(key.createNeighborKey(0, 1), tile);
-
-        // check for tiles that are waiting on this tile, and notify them!
-        TileKeyOneToMany::iterator notifier = _notifiers.find( tile->getKey() );
-        if ( notifier != _notifiers.end() )
-        {
-            TileKeySet& listeners = notifier->second;
-
-            for(TileKeySet::iterator listener = listeners.begin(); listener != listeners.end(); ++listener)
-            {
-                TileTable::iterator i = _tiles.find( *listener );
-                if ( i != _tiles.end())
-                {
-                    i->second._tile->notifyOfArrival( tile );
-                }
-            }
-            _notifiers.erase( notifier );
-        }
-
-        OE_DEBUG << LC << _name 
-            << ": tiles=" << _tiles.size()
-            << ", notifiers=" << _notifiers.size()
-            << std::endl;
-    }
 
     _mutex.unlock();
 }
 
-void
-TileNodeRegistry::startListeningFor(const TileKey& tileToWaitFor, TileNode* waiter)
-{
-    // ASSUME EXCLUSIVE LOCK
-
-    TileTable::iterator i = _tiles.find(tileToWaitFor);
-    if (i != _tiles.end())
-    {
-        TileNode* tile = i->second._tile.get();
-
-        OE_DEBUG << LC << waiter->getKey().str() << " listened for " << tileToWaitFor.str()
-            << ", but it was already in the repo.\n";
-
-        waiter->notifyOfArrival( tile );
-    }
-    else
-    {
-        OE_DEBUG << LC << waiter->getKey().str() << " listened for " << tileToWaitFor.str() << ".\n";
-        _notifiers[tileToWaitFor].insert( waiter->getKey() );
-    }
-}
-
-void
-TileNodeRegistry::stopListeningFor(const TileKey& tileToWaitFor, const TileKey& waiterKey)
-{
-    // ASSUME EXCLUSIVE LOCK
-
-    TileKeyOneToMany::iterator i = _notifiers.find(tileToWaitFor);
-    if (i != _notifiers.end())
-    {
-        // remove the waiter from this set:
-        i->second.erase(waiterKey);
-
-        // if the set is now empty, remove the set entirely
-        if (i->second.empty())
-        {
-            _notifiers.erase(i);
-        }
-    }
-}
-
 void
 TileNodeRegistry::releaseAll(osg::State* state)
 {
@@ -257,8 +168,6 @@ TileNodeRegistry::releaseAll(osg::State* state)
     _tracker.push_front(SENTRY_VALUE);
     _sentryptr = _tracker.begin();
 
-    _notifiers.clear();
-
     _tilesToUpdate.clear();
 
     OE_PROFILING_PLOT(PROFILING_REX_TILES, (float)(_tiles.size()));
@@ -361,13 +270,6 @@ TileNodeRegistry::collectDormantTiles(
             se->_lastRange > farthestAllowableRange &&
             se->_tile->areSiblingsDormant())
         {
-            if (_notifyNeighbors)
-            {
-                // remove neighbor listeners:
-                stopListeningFor(key.createNeighborKey(1, 0), key);
-                stopListeningFor(key.createNeighborKey(0, 1), key);
-            }
-
             // back up the iterator so we can safely erase the tracker entry:
             tmp = i;
             --i;
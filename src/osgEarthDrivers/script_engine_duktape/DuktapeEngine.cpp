@@ -208,6 +208,51 @@ namespace
         duk_pop(ctx);
     }
 
+    // Create a "feature" object in the global namespace from a row of a
+    // feature batch. Same layout as the minimal profile above, read
+    // straight from the batch columns.
+    void setFeature(duk_context* ctx, const FeatureBatch& features, unsigned row)
+    {
+        OE_PROFILING_ZONE;
+
+        duk_push_global_object(ctx); // [global]
+
+        duk_idx_t feature_i = duk_push_object(ctx);     // [global] [feature]
+        {
+            duk_push_number(ctx, features.getFID(row));    // [global] [feature] [id]
+            duk_put_prop_string(ctx, feature_i, "id");  // [global] [feature]
+
+            duk_idx_t props_i = duk_push_object(ctx);   // [global] [feature] [properties]
+            {
+                for(unsigned field = 0; field < features.getNumFields(); ++field)
+                {
+                    if (!features.hasAttr(row, field))
+                        continue;
+
+                    switch(features.getType(row, field)) {
+                    case ATTRTYPE_DOUBLE: duk_push_number (ctx, features.getDouble(row, field)); break;          // [global] [feature] [properties] [name]
+                    case ATTRTYPE_INT:    duk_push_number(ctx, (double)features.getInt(row, field)); break;      // [global] [feature] [properties] [name]
+                    case ATTRTYPE_BOOL:   duk_push_boolean(ctx, features.getBool(row, field)?1:0); break;        // [global] [feature] [properties] [name]
+                    case ATTRTYPE_DOUBLEARRAY: continue;
+                    case ATTRTYPE_STRING:
+                    default:              duk_push_string (ctx, features.getString(row, field).c_str()); break; // [global] [feature] [properties] [name]
+                    }
+                    duk_put_prop_string(ctx, props_i, features.getFieldName(field).c_str()); // [global] [feature] [properties]
+                }
+            }
+            duk_put_prop_string(ctx, feature_i, "properties"); // [global] [feature]
+
+            duk_idx_t geometry_i = duk_push_object(ctx);  // [global] [feature] [geometry]
+            {
+                duk_push_string(ctx, Geometry::toString(features.getComponentType(row)).c_str()); // [global] [feature] [geometry] [type]
+                duk_put_prop_string(ctx, geometry_i, "type"); // [global] [feature] [geometry]
+            }
+            duk_put_prop_string(ctx, feature_i, "geometry");
+        }
+        duk_put_prop_string(ctx, -2, "feature"); // [global] [feature]
+
+        duk_pop(ctx);
+    }
 }
 
 //............................................................................
@@ -408,6 +453,74 @@ DuktapeEngine::run(
     return true;
 }
 
+bool
+DuktapeEngine::run(
+    const std::string& code,
+    const FeatureBatch& features,
+    std::vector<ScriptResult>& results,
+    FilterContext const* context)
+{
+    if (code.empty())
+    {
+        for (unsigned row = 0; row < features.size(); ++row)
+            results.emplace_back(EMPTY_STRING, false, "Script is empty.");
+        return false;
+    }
+
+    OE_PROFILING_ZONE;
+
+    // the batch path only supports the minimal profile
+    const bool complete = false;
+
+    // cache the Context on a per-thread basis
+    Context& c = _contexts.get();
+    c.initialize(_options, complete);
+    duk_context* ctx = c._ctx;
+
+    std::string resultString;
+    ScriptResult result;
+
+    if (!compile(c, code, result)) // [function | null]
+    {
+        for (unsigned row = 0; row < features.size(); ++row)
+            results.push_back(result);
+        return false;
+    }
+
+    // the global "feature" no longer holds the last single feature:
+    c._feature = nullptr;
+
+    for (unsigned row = 0; row < features.size(); ++row)
+    {
+        // Load the next row into the global object:
+        setFeature(ctx, features, row);
+
+        // Duplicate the function on the top since we'll be calling it multiple times
+        duk_dup_top(ctx); // [function function]
+
+        // Run the script:
+        duk_int_t rc = duk_pcall(ctx, 0); // [function result]
+        resultString = duk_safe_to_string(ctx, -1);
+        duk_pop(ctx); // [function]
+
+        if (rc != DUK_EXEC_SUCCESS)
+        {
+            OE_WARN << LC << "Runtime error: " << resultString << std::endl;
+            c._errorCount++;
+            results.emplace_back(EMPTY_STRING, false, resultString); // error
+        }
+        else
+        {
+            results.emplace_back(resultString, true);
+        }
+    }
+
+    // Pop the function, clearing the stack
+    duk_pop(ctx); // []
+
+    return true;
+}
+
 ScriptResult
 DuktapeEngine::run(
     const std::string& code,
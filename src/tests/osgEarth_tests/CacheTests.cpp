@@ -24,6 +24,7 @@
 #include <osgEarth/GeoData>
 #include <osgEarth/Registry>
 #include <osgEarth/MemCache>
+#include <osg/Shape>
 
 using namespace osgEarth;
 
@@ -83,3 +84,40 @@ TEST_CASE( "Cache" ) {
         REQUIRE(r2.failed());
     }  
 }
+
+TEST_CASE("MemCache byte budget") {
+
+    // byte budget that holds three of the 64x64 objects below, but not four
+    MemCache::setGlobalBudget(60000u);
+
+    osg::ref_ptr<MemCache> cache = new MemCache();
+    REQUIRE(cache->isBudgeted());
+
+    osg::ref_ptr<CacheBin> bin = cache->addBin("budget_bin");
+    REQUIRE(bin.valid());
+
+    osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
+    hf->allocate(64, 64);
+    REQUIRE(bin->write("hf", hf.get(), Config(), 0L));
+
+    for (int i = 0; i < 3; ++i)
+    {
+        osg::ref_ptr<osg::Image> image = new osg::Image();
+        image->allocateImage(64, 64, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        REQUIRE(bin->write(Stringify() << "image" << i, image.get(), Config(), 0L));
+    }
+
+    MemCache::Stats stats = MemCache::getGlobalStats();
+    REQUIRE(stats.bytes <= stats.budget);
+    REQUIRE(stats.evictions >= 1u);
+
+    // elevation is more expensive to re-create, so the oldest image goes first
+    REQUIRE(bin->getRecordStatus("hf") == CacheBin::STATUS_OK);
+    REQUIRE(bin->getRecordStatus("image0") == CacheBin::STATUS_NOT_FOUND);
+    REQUIRE(bin->getRecordStatus("image2") == CacheBin::STATUS_OK);
+
+    REQUIRE(bin->readObject("hf", 0L).succeeded());
+
+    MemCache::setGlobalBudget(0u);
+    REQUIRE(MemCache::getGlobalStats().bytes == 0u);
+}
@@ -0,0 +1,190 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/ElevationPool>
+#include <osgEarth/HeightFieldUtils>
+#include <osgEarth/Registry>
+#include <vector>
+
+using namespace osgEarth;
+
+namespace ElevationPoolTest
+{
+    using LUT = ElevationPool::ShardedLUT;
+    using Key = Internal::RevElevationKey;
+
+    Key makeKey(unsigned x, unsigned y)
+    {
+        return Key { TileKey(6, x, y, Registry::instance()->getGlobalGeodeticProfile()), 0 };
+    }
+
+    ElevationPool::Pointer makeTexture(const Key& key)
+    {
+        osg::ref_ptr<osg::HeightField> hf = HeightFieldUtils::createReferenceHeightField(
+            key._tilekey.getExtent(), 17, 17, 0u);
+        return new ElevationTexture(
+            key._tilekey,
+            GeoHeightField(hf.get(), key._tilekey.getExtent()),
+            std::vector<float>(17 * 17, 1.0f));
+    }
+
+    // Some keys that all fall in the same shard as the first
+    std::vector<Key> keysInOneShard(LUT& lut, unsigned count)
+    {
+        std::vector<Key> keys;
+        LUT::Shard* first = nullptr;
+        for (unsigned x = 0; keys.size() < count; ++x)
+        {
+            Key key = makeKey(x % 128u, x / 128u);
+            if (first == nullptr)
+                first = &lut.shard(key);
+            if (&lut.shard(key) == first)
+                keys.push_back(key);
+        }
+        return keys;
+    }
+
+    // Puts a new texture, keeping no reference to it
+    void put(LUT& lut, const Key& key)
+    {
+        ElevationPool::Pointer tex = makeTexture(key);
+        lut.put(key, tex);
+    }
+
+    bool has(LUT& lut, const Key& key)
+    {
+        ElevationPool::Pointer tex;
+        return lut.get(key, tex);
+    }
+
+    std::size_t tileBytes()
+    {
+        LUT lut(~0u);
+        put(lut, makeKey(0, 0));
+        return lut.getStats().bytes;
+    }
+}
+
+using namespace ElevationPoolTest;
+
+TEST_CASE("ElevationPool cache counts hits, misses, and evictions")
+{
+    LUT lut(~0u);
+    const std::size_t bytes = tileBytes();
+    REQUIRE(bytes > 0u);
+
+    for (unsigned x = 0; x < 10; ++x)
+        put(lut, makeKey(x, 0));
+
+    ElevationPool::CacheStats stats = lut.getStats();
+    REQUIRE(stats.entries == 10u);
+    REQUIRE(stats.bytes == 10u * bytes);
+    REQUIRE(stats.hits == 0u);
+    REQUIRE(stats.misses == 0u);
+    REQUIRE(stats.evictions == 0u);
+
+    for (unsigned x = 0; x < 10; ++x)
+        REQUIRE(has(lut, makeKey(x, 0)));
+    REQUIRE(has(lut, makeKey(0, 1)) == false);
+
+    stats = lut.getStats();
+    REQUIRE(stats.hits == 10u);
+    REQUIRE(stats.misses == 1u);
+
+    SECTION("Clearing drops every entry")
+    {
+        lut.clear();
+        stats = lut.getStats();
+        REQUIRE(stats.entries == 0u);
+        REQUIRE(stats.bytes == 0u);
+        REQUIRE(has(lut, makeKey(0, 0)) == false);
+    }
+}
+
+TEST_CASE("ElevationPool cache stays within the budget set by setCacheBudget")
+{
+    osg::ref_ptr<ElevationPool> pool = new ElevationPool();
+    pool->setCacheBudget(1024u * 1024u);
+    REQUIRE(pool->getCacheStats().budget == 1024u * 1024u);
+    REQUIRE(pool->getCacheStats().entries == 0u);
+
+    LUT lut(~0u);
+    const std::size_t bytes = tileBytes();
+
+    // one texture held outside the cache:
+    Key held = makeKey(0, 0);
+    ElevationPool::Pointer heldTex = makeTexture(held);
+    lut.put(held, heldTex);
+
+    for (unsigned x = 1; x < 64; ++x)
+        put(lut, makeKey(x, 0));
+    REQUIRE(lut.getStats().bytes == 64u * bytes);
+
+    // room for about 2 tiles per shard:
+    const std::size_t budget = 2u * bytes * LUT::NUM_SHARDS;
+    lut.setBudget(budget);
+
+    ElevationPool::CacheStats stats = lut.getStats();
+    REQUIRE(stats.budget == budget);
+    REQUIRE(stats.bytes <= budget);
+    REQUIRE(stats.evictions == 64u - stats.bytes / bytes);
+
+    // an evicted texture that someone else still holds is still found:
+    lut.setBudget(0u);
+    stats = lut.getStats();
+    REQUIRE(stats.bytes == 0u);
+    REQUIRE(stats.evictions == 64u);
+    REQUIRE(has(lut, held));
+
+    // the rest are gone:
+    for (unsigned x = 1; x < 64; ++x)
+        REQUIRE(has(lut, makeKey(x, 0)) == false);
+    REQUIRE(lut.getStats().entries == 1u);
+}
+
+TEST_CASE("ElevationPool cache gives recently used tiles a second chance")
+{
+    const std::size_t bytes = tileBytes();
+
+    // room for 2 tiles per shard:
+    LUT lut(2u * bytes * LUT::NUM_SHARDS);
+    std::vector<Key> keys = keysInOneShard(lut, 4u);
+    Key a = keys[0], b = keys[1], c = keys[2], d = keys[3];
+
+    put(lut, a);
+    put(lut, b);
+
+    // everything was referenced, so the sweep comes back around
+    // to the oldest one:
+    put(lut, c);
+    REQUIRE(lut.getStats().evictions == 1u);
+    REQUIRE(has(lut, a) == false);
+
+    // using b saves it from the next sweep, even though c is newer:
+    REQUIRE(has(lut, b));
+    put(lut, d);
+    REQUIRE(lut.getStats().evictions == 2u);
+    REQUIRE(has(lut, c) == false);
+    REQUIRE(has(lut, b));
+    REQUIRE(has(lut, d));
+}
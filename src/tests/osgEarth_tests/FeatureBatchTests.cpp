@@ -0,0 +1,258 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/FeatureBatch>
+#include <osgEarth/FeatureCursor>
+#include <osgEarth/AttributesFilter>
+#include <osgEarth/ConvertTypeFilter>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace FeatureBatchTest
+{
+    Polygon* makeSquare(double x, double y, bool withHole)
+    {
+        Polygon* poly = new Polygon();
+        poly->push_back(osg::Vec3d(x, y, 0));
+        poly->push_back(osg::Vec3d(x + 10, y, 0));
+        poly->push_back(osg::Vec3d(x + 10, y + 10, 0));
+        poly->push_back(osg::Vec3d(x, y + 10, 0));
+        if (withHole)
+        {
+            Ring* hole = new Ring();
+            hole->push_back(osg::Vec3d(x + 2, y + 2, 0));
+            hole->push_back(osg::Vec3d(x + 4, y + 2, 0));
+            hole->push_back(osg::Vec3d(x + 4, y + 4, 0));
+            poly->getHoles().push_back(hole);
+        }
+        return poly;
+    }
+
+    // Building-like features: polygons, some with holes, one multi-polygon,
+    // one without geometry, and a mix of attribute types, NULLs, and
+    // attributes that only some features have.
+    void makeFeatures(unsigned count, FeatureList& features)
+    {
+        osg::ref_ptr<const SpatialReference> srs = SpatialReference::create("wgs84");
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            Geometry* geom = nullptr;
+            if (i % 7 == 3)
+            {
+                MultiGeometry* multi = new MultiGeometry();
+                multi->add(makeSquare(i, 0, false));
+                multi->add(makeSquare(i, 20, true));
+                geom = multi;
+            }
+            else if (i % 11 != 5)
+            {
+                geom = makeSquare(i, 0, i % 2 == 0);
+            }
+
+            Feature* f = new Feature(geom, srs.get(), Style(), i);
+            f->set("building", std::string(i % 3 == 0 ? "yes" : "house"));
+            f->set("height", 3.0 * (i % 10));
+            f->set("levels", (long long)(i % 10));
+            f->set("roof", i % 2 == 0);
+            if (i % 4 == 0)
+                f->set("name", std::string("Building ") + std::to_string(i));
+            if (i % 5 == 0)
+                f->setNull("height");
+            features.push_back(f);
+        }
+    }
+
+    bool sameGeometry(const Geometry* a, const Geometry* b)
+    {
+        if (a == nullptr || b == nullptr)
+            return a == b;
+
+        if (a->getType() != b->getType() || a->asVector() != b->asVector())
+            return false;
+
+        if (a->getType() == Geometry::TYPE_MULTI)
+        {
+            const GeometryCollection& pa = static_cast<const MultiGeometry*>(a)->getComponents();
+            const GeometryCollection& pb = static_cast<const MultiGeometry*>(b)->getComponents();
+            if (pa.size() != pb.size())
+                return false;
+            for (unsigned i = 0; i < pa.size(); ++i)
+                if (!sameGeometry(pa[i].get(), pb[i].get()))
+                    return false;
+        }
+
+        if (a->getType() == Geometry::TYPE_POLYGON)
+        {
+            const RingCollection& ha = static_cast<const Polygon*>(a)->getHoles();
+            const RingCollection& hb = static_cast<const Polygon*>(b)->getHoles();
+            if (ha.size() != hb.size())
+                return false;
+            for (unsigned i = 0; i < ha.size(); ++i)
+                if (ha[i]->asVector() != hb[i]->asVector())
+                    return false;
+        }
+
+        return true;
+    }
+
+    bool sameFeature(const Feature* a, const Feature* b)
+    {
+        if (a->getFID() != b->getFID() || !sameGeometry(a->getGeometry(), b->getGeometry()))
+            return false;
+
+        if (a->getAttrs().size() != b->getAttrs().size())
+            return false;
+
+        for (auto& attr : a->getAttrs())
+        {
+            if (!b->hasAttr(attr.first) ||
+                b->isSet(attr.first) != attr.second.second.set ||
+                b->getString(attr.first) != attr.second.getString())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool sameFeatures(const FeatureList& a, const FeatureList& b)
+    {
+        if (a.size() != b.size())
+            return false;
+
+        FeatureList::const_iterator j = b.begin();
+        for (FeatureList::const_iterator i = a.begin(); i != a.end(); ++i, ++j)
+            if (!sameFeature(i->get(), j->get()))
+                return false;
+        return true;
+    }
+
+    // Stand-in for filters that don't know about batches.
+    class EveryOtherFilter : public FeatureFilter
+    {
+    public:
+        FilterContext push(FeatureList& input, FilterContext& context)
+        {
+            FeatureList output;
+            bool keep = true;
+            for (auto& f : input)
+            {
+                if (keep)
+                    output.push_back(f);
+                keep = !keep;
+            }
+            input.swap(output);
+            return context;
+        }
+    };
+}
+
+TEST_CASE("FeatureBatch stores features in columns")
+{
+    FeatureList features;
+    FeatureBatchTest::makeFeatures(100, features);
+
+    osg::ref_ptr<FeatureBatch> batch = new FeatureBatch();
+    REQUIRE(batch->append(features) == 100u);
+    REQUIRE(batch->getSchema()->size() == 5u);
+
+    SECTION("Attributes read the same as from the Feature")
+    {
+        int height = batch->getSchema()->find("HEIGHT");
+        int name = batch->getSchema()->find("name");
+        int levels = batch->getSchema()->find("levels");
+        REQUIRE(height >= 0);
+        REQUIRE(batch->getSchema()->find("missing") == -1);
+
+        unsigned row = 0;
+        for (auto& f : features)
+        {
+            REQUIRE(batch->getFID(row) == f->getFID());
+            REQUIRE(batch->hasAttr(row, name) == f->hasAttr("name"));
+            REQUIRE(batch->isSet(row, height) == f->isSet("height"));
+            REQUIRE(batch->getDouble(row, height, -1.0) == f->getDouble("height", -1.0));
+            REQUIRE(batch->getString(row, levels) == f->getString("levels"));
+            REQUIRE(batch->hasGeometry(row) == (f->getGeometry() != nullptr));
+            ++row;
+        }
+    }
+
+    SECTION("Features come back unchanged")
+    {
+        FeatureList output;
+        batch->createFeatures(output);
+        REQUIRE(FeatureBatchTest::sameFeatures(features, output));
+    }
+
+    SECTION("A batch cursor copies rows into another batch")
+    {
+        osg::ref_ptr<FeatureCursor> cursor = new FeatureBatchCursor(batch.get());
+        osg::ref_ptr<FeatureBatch> copy = new FeatureBatch();
+        REQUIRE(cursor->fill(*copy.get(), 60u) == 60u);
+        REQUIRE(cursor->fill(*copy.get()) == 40u);
+
+        FeatureList output;
+        copy->createFeatures(output);
+        REQUIRE(FeatureBatchTest::sameFeatures(features, output));
+    }
+}
+
+TEST_CASE("Filters give the same results on batches as on lists")
+{
+    FeatureList features;
+    FeatureBatchTest::makeFeatures(100, features);
+
+    osg::ref_ptr<FeatureBatch> batch = new FeatureBatch();
+    batch->append(features);
+
+    FilterContext cx;
+    osg::ref_ptr<FeatureFilter> filter;
+
+    SECTION("AttributesFilter")
+    {
+        std::vector<std::string> attrs;
+        attrs.push_back("NAME");
+        attrs.push_back("nothing");
+        filter = new AttributesFilter(attrs);
+    }
+
+    SECTION("ConvertTypeFilter")
+    {
+        filter = new ConvertTypeFilter(Geometry::TYPE_LINESTRING);
+    }
+
+    SECTION("Filters without batch support")
+    {
+        filter = new FeatureBatchTest::EveryOtherFilter();
+    }
+
+    filter->push(features, cx);
+    filter->push(*batch.get(), cx);
+
+    FeatureList output;
+    batch->createFeatures(output);
+    REQUIRE(FeatureBatchTest::sameFeatures(features, output));
+}
@@ -0,0 +1,262 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/FeatureSource>
+#include <osgEarth/FeatureCursor>
+#include <osgEarth/AttributesFilter>
+#include <osgEarth/Registry>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace FeatureSourceTest
+{
+    // Makes ten points per tile and counts how often it's asked for them
+    class CountingSource : public FeatureSource
+    {
+    public:
+        META_Layer(osgEarth, CountingSource, FeatureSource::Options, FeatureSource, countingfeatures);
+
+        std::atomic<int> fetches{ 0 };
+        int delayMs = 0;
+        unsigned padding = 0u;
+
+    protected:
+        FeatureCursor* createFeatureCursorImplementation(const Query& query, ProgressCallback* progress) override
+        {
+            ++fetches;
+            if (delayMs > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+
+            const GeoExtent& extent = query.tileKey()->getExtent();
+
+            FeatureList features;
+            for (int i = 0; i < 10; ++i)
+            {
+                Point* point = new Point();
+                point->push_back(extent.xMin() + i, extent.yMin());
+
+                Feature* feature = new Feature(point, extent.getSRS());
+                feature->set("name", query.tileKey()->str());
+                if (padding > 0u)
+                    feature->set("padding", std::string(padding, 'x'));
+                features.push_back(feature);
+            }
+            return new FeatureListCursor(features);
+        }
+    };
+
+    TileKey getKey(unsigned x)
+    {
+        return TileKey(4, x, 0, Registry::instance()->getGlobalGeodeticProfile());
+    }
+
+    FeatureList read(FeatureSource* source, const TileKey& key, FeatureFilterChain* filters = nullptr)
+    {
+        Query query;
+        query.tileKey() = key;
+
+        FeatureList features;
+        osg::ref_ptr<FeatureCursor> cursor = source->createFeatureCursor(query, filters, nullptr, nullptr);
+        if (cursor.valid())
+            cursor->fill(features);
+        return features;
+    }
+
+    // Renames every feature that gets to it
+    class RenameFilter : public FeatureFilter
+    {
+    public:
+        FilterContext push(FeatureList& input, FilterContext& context) override
+        {
+            for (auto& feature : input)
+                feature->set("name", "renamed");
+            return context;
+        }
+    };
+}
+
+using namespace FeatureSourceTest;
+
+TEST_CASE("FeatureSource L2 cache shares feature tiles")
+{
+    osg::ref_ptr<CountingSource> source = new CountingSource();
+    REQUIRE(source->open().isOK());
+
+    TileKey key = getKey(0);
+
+    SECTION("A cache hit does not fetch the tile again")
+    {
+        REQUIRE(read(source.get(), key).size() == 10);
+        REQUIRE(read(source.get(), key).size() == 10);
+        REQUIRE(source->fetches == 1);
+    }
+
+    SECTION("Features read from a cached tile are private copies")
+    {
+        FeatureList first = read(source.get(), key);
+        for (auto& feature : first)
+        {
+            feature->set("name", "changed");
+            feature->getGeometry()->front().x() += 1000.0;
+        }
+
+        FeatureList second = read(source.get(), key);
+        REQUIRE(second.size() == first.size());
+        for (auto& feature : second)
+        {
+            REQUIRE(feature->getString("name") == key.str());
+            REQUIRE(feature->getGeometry()->front().x() < key.getExtent().xMax());
+        }
+    }
+
+    SECTION("Filling a batch from a cached tile gives the same rows")
+    {
+        read(source.get(), key);
+
+        Query query;
+        query.tileKey() = key;
+        osg::ref_ptr<FeatureCursor> cursor = source->createFeatureCursor(query, nullptr);
+        osg::ref_ptr<FeatureBatch> batch = new FeatureBatch();
+        REQUIRE(cursor->fill(*batch) == 10u);
+        REQUIRE(source->fetches == 1);
+
+        FeatureList list = read(source.get(), key);
+        REQUIRE(list.size() == batch->size());
+
+        unsigned row = 0;
+        for (auto& expected : list)
+        {
+            osg::ref_ptr<Feature> actual = batch->createFeature(row++);
+            REQUIRE(actual.valid());
+
+            const Geometry* a = actual->getGeometry();
+            const Geometry* e = expected->getGeometry();
+            REQUIRE(a->getType() == e->getType());
+            REQUIRE(a->size() == e->size());
+            for (unsigned i = 0; i < e->size(); ++i)
+            {
+                REQUIRE((*a)[i].x() == Approx((*e)[i].x()));
+                REQUIRE((*a)[i].y() == Approx((*e)[i].y()));
+            }
+
+            REQUIRE(actual->getAttrs().size() == expected->getAttrs().size());
+            for (auto& attr : expected->getAttrs())
+            {
+                REQUIRE(actual->hasAttr(attr.first));
+                REQUIRE(actual->getString(attr.first) == expected->getString(attr.first));
+            }
+        }
+    }
+
+    SECTION("Filters see the cached tile without changing it")
+    {
+        read(source.get(), key);
+
+        osg::ref_ptr<FeatureFilterChain> chain = new FeatureFilterChain();
+
+        SECTION("Read-only filter")
+        {
+            chain->push_back(new AttributesFilter(std::vector<std::string>{ "name" }));
+        }
+
+        SECTION("Read-only filter, then one that modifies")
+        {
+            chain->push_back(new AttributesFilter(std::vector<std::string>{ "name" }));
+            chain->push_back(new RenameFilter());
+        }
+
+        SECTION("Filter that modifies")
+        {
+            chain->push_back(new RenameFilter());
+        }
+
+        bool renames = !chain->back()->isReadOnly();
+
+        FeatureList filtered = read(source.get(), key, chain.get());
+        REQUIRE(filtered.size() == 10u);
+        for (auto& feature : filtered)
+        {
+            REQUIRE(feature->getString("name") == (renames ? std::string("renamed") : key.str()));
+
+            // whatever comes out of the cursor is the caller's to modify
+            feature->set("name", "changed");
+        }
+
+        FeatureList again = read(source.get(), key);
+        REQUIRE(again.size() == 10u);
+        for (auto& feature : again)
+            REQUIRE(feature->getString("name") == key.str());
+        REQUIRE(source->fetches == 1);
+    }
+
+    SECTION("Concurrent requests for a tile share one fetch")
+    {
+        source->delayMs = 50;
+
+        std::vector<std::thread> threads;
+        std::atomic<int> complete(0);
+        for (int i = 0; i < 8; ++i)
+        {
+            threads.emplace_back([&]() {
+                if (read(source.get(), key).size() == 10)
+                    ++complete;
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        REQUIRE(complete == 8);
+        REQUIRE(source->fetches == 1);
+    }
+}
+
+TEST_CASE("FeatureSource L2 cache stays within its memory budget")
+{
+    // each tile holds about 400K of attribute data
+    osg::ref_ptr<CountingSource> source = new CountingSource();
+    source->setL2CacheBudgetMB(1u);
+    source->padding = 40000u;
+    REQUIRE(source->open().isOK());
+
+    read(source.get(), getKey(0));
+    read(source.get(), getKey(1));
+    REQUIRE(source->fetches == 2);
+
+    // both fit:
+    read(source.get(), getKey(0));
+    REQUIRE(source->fetches == 2);
+
+    // the third pushes out the least recently used, which is tile 1:
+    read(source.get(), getKey(2));
+    read(source.get(), getKey(0));
+    REQUIRE(source->fetches == 3);
+
+    read(source.get(), getKey(1));
+    REQUIRE(source->fetches == 4);
+}
@@ -0,0 +1,149 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/GeometryCompiler>
+#include <osgEarth/FeatureIndex>
+#include <osgEarth/LineSymbol>
+#include <osgEarth/Registry>
+#include <map>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace GeometryCompilerTest
+{
+    // Records how many times each feature gets tagged.
+    class CountingIndex : public FeatureIndexBuilder
+    {
+    public:
+        std::map<FeatureID, int> tags;
+
+        ObjectID tagDrawable(osg::Drawable* drawable, Feature* feature) override {
+            return tag(feature);
+        }
+        ObjectID tagAllDrawables(osg::Node* node, Feature* feature) override {
+            return tag(feature);
+        }
+        ObjectID tagNode(osg::Node* node, Feature* feature) override {
+            return tag(feature);
+        }
+
+    private:
+        ObjectID tag(Feature* feature) {
+            ++tags[feature->getFID()];
+            return (ObjectID)feature->getFID() + 2u;
+        }
+    };
+
+    struct CountDrawables : public osg::NodeVisitor
+    {
+        unsigned count = 0u;
+        CountDrawables() : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN) { }
+        void apply(osg::Drawable& drawable) override { ++count; }
+    };
+
+    void makeFeatures(unsigned count, FeatureList& features)
+    {
+        osg::ref_ptr<const SpatialReference> srs = SpatialReference::create("wgs84");
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            double x = -100.0 + 0.1 * (i % 50);
+            double y = 30.0 + 0.1 * (i / 50);
+            LineString* line = new LineString();
+            line->push_back(osg::Vec3d(x, y, 0));
+            line->push_back(osg::Vec3d(x + 0.05, y, 0));
+            line->push_back(osg::Vec3d(x + 0.05, y + 0.05, 0));
+            line->push_back(osg::Vec3d(x, y + 0.05, 0));
+            features.push_back(new Feature(line, srs.get(), Style(), i));
+        }
+    }
+
+    struct Result
+    {
+        unsigned drawables = 0u;
+        unsigned features = 0u;
+        std::map<FeatureID, int> tags;
+    };
+
+    Result compile(unsigned count, bool parallel)
+    {
+        FeatureList features;
+        makeFeatures(count, features);
+
+        osg::ref_ptr<const SpatialReference> srs = SpatialReference::create("wgs84");
+        osg::ref_ptr<FeatureProfile> profile = new FeatureProfile(GeoExtent(srs.get(), -101, 29, -94, 36));
+
+        CountingIndex index;
+        FilterContext context(nullptr, profile.get(), profile->getExtent(), &index);
+
+        Style style;
+        style.getOrCreate<LineSymbol>()->stroke()->color() = Color::Yellow;
+
+        GeometryCompilerOptions options;
+        options.parallel() = parallel;
+        options.parallelChunkSize() = 16u;
+
+        GeometryCompiler compiler(options);
+        osg::ref_ptr<osg::Node> node = compiler.compile(features, style, context);
+
+        Result result;
+        if (node.valid())
+        {
+            CountDrawables counter;
+            node->accept(counter);
+            result.drawables = counter.count;
+        }
+        result.features = features.size();
+        result.tags = index.tags;
+        return result;
+    }
+}
+
+using namespace GeometryCompilerTest;
+
+TEST_CASE("GeometryCompiler parallel compile matches the serial compile")
+{
+    // Keep the line groups from merging drawables, so the results of
+    // the two compiles are comparable drawable for drawable.
+    unsigned maxVerts = Registry::instance()->getMaxNumberOfVertsPerDrawable();
+    Registry::instance()->setMaxNumberOfVertsPerDrawable(1u);
+
+    const unsigned count = 200u;
+    Result serial = compile(count, false);
+    Result parallel = compile(count, true);
+
+    Registry::instance()->setMaxNumberOfVertsPerDrawable(maxVerts);
+
+    REQUIRE(serial.drawables == count);
+    REQUIRE(parallel.drawables == serial.drawables);
+
+    // every feature goes back to the caller, tagged once:
+    REQUIRE(parallel.features == count);
+    REQUIRE(serial.tags.size() == count);
+    REQUIRE(parallel.tags == serial.tags);
+    for (auto& tag : parallel.tags)
+        REQUIRE(tag.second == 1);
+}
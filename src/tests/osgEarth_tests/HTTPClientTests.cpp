@@ -0,0 +1,309 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/HTTPClient>
+#include <osgEarth/Progress>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET socket_t;
+#define CLOSE_SOCKET ::closesocket
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define CLOSE_SOCKET ::close
+#endif
+
+// don't raise SIGPIPE when the client has already hung up
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+using namespace osgEarth::Threading;
+
+namespace HTTPClientTest
+{
+    // Stand-in HTTP/1.1 server on the loopback interface. Answers every
+    // GET with the request path as the body, after a fixed delay. Keeps
+    // connections alive, and counts connections, requests, and the most
+    // requests it was ever serving at the same time.
+    class LatencyServer
+    {
+    public:
+        std::atomic_int connections;
+        std::atomic_int requests;
+        std::atomic_int concurrent;
+        std::atomic_int peak;
+
+        LatencyServer(unsigned latency_ms) :
+            connections(0), requests(0), concurrent(0), peak(0),
+            _latency_ms(latency_ms),
+            _port(0),
+            _done(false)
+        {
+#ifdef _WIN32
+            WSADATA wsa;
+            WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+            _listener = ::socket(AF_INET, SOCK_STREAM, 0);
+
+            sockaddr_in addr;
+            ::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = 0;
+
+            socklen_t len = sizeof(addr);
+            if (_listener != INVALID_SOCKET &&
+                ::bind(_listener, (sockaddr*)&addr, sizeof(addr)) == 0 &&
+                ::listen(_listener, 64) == 0 &&
+                ::getsockname(_listener, (sockaddr*)&addr, &len) == 0)
+            {
+                _port = ntohs(addr.sin_port);
+                _acceptThread = std::thread([this]() { acceptLoop(); });
+            }
+        }
+
+        ~LatencyServer()
+        {
+            _done = true;
+            if (_acceptThread.joinable())
+                _acceptThread.join();
+            for (auto& t : _clients)
+                t.join();
+            if (_listener != INVALID_SOCKET)
+                CLOSE_SOCKET(_listener);
+        }
+
+        bool ok() const
+        {
+            return _port != 0;
+        }
+
+        std::string url(const std::string& path) const
+        {
+            std::stringstream buf;
+            buf << "http://127.0.0.1:" << _port << path;
+            return buf.str();
+        }
+
+    private:
+        unsigned _latency_ms;
+        int _port;
+        socket_t _listener;
+        std::atomic_bool _done;
+        std::thread _acceptThread;
+        std::vector<std::thread> _clients;
+
+        // waits up to 50ms for a socket to become readable
+        static bool readable(socket_t s)
+        {
+            fd_set fds;
+            FD_ZERO(&fds);
+            FD_SET(s, &fds);
+            timeval tv = { 0, 50000 };
+            return ::select((int)s + 1, &fds, NULL, NULL, &tv) > 0;
+        }
+
+        void acceptLoop()
+        {
+            while (!_done)
+            {
+                if (!readable(_listener))
+                    continue;
+
+                socket_t s = ::accept(_listener, NULL, NULL);
+                if (s == INVALID_SOCKET)
+                    continue;
+
+                ++connections;
+                _clients.emplace_back([this, s]() { serve(s); });
+            }
+        }
+
+        void serve(socket_t s)
+        {
+            std::string buffer;
+            char chunk[4096];
+
+            while (!_done)
+            {
+                std::string::size_type end = buffer.find("\r\n\r\n");
+                if (end == std::string::npos)
+                {
+                    if (!readable(s))
+                        continue;
+
+                    int n = ::recv(s, chunk, sizeof(chunk), 0);
+                    if (n <= 0)
+                        break;
+
+                    buffer.append(chunk, n);
+                    continue;
+                }
+
+                // "GET /path HTTP/1.1"
+                std::string line = buffer.substr(0, buffer.find("\r\n"));
+                buffer.erase(0, end + 4);
+                std::string::size_type p0 = line.find(' ') + 1;
+                std::string path = line.substr(p0, line.find(' ', p0) - p0);
+
+                ++requests;
+                int now = ++concurrent;
+                int prev = peak;
+                while (now > prev && !peak.compare_exchange_weak(prev, now));
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(_latency_ms));
+
+                --concurrent;
+
+                std::stringstream response;
+                response
+                    << "HTTP/1.1 200 OK\r\n"
+                    << "Content-Type: text/plain\r\n"
+                    << "Content-Length: " << path.size() << "\r\n"
+                    << "\r\n"
+                    << path;
+
+                std::string data = response.str();
+                if (::send(s, data.c_str(), (int)data.size(), SEND_FLAGS) != (int)data.size())
+                    break;
+            }
+
+            CLOSE_SOCKET(s);
+        }
+    };
+}
+
+TEST_CASE("HTTPClient async transfers")
+{
+    HTTPClient::globalInit();
+
+    SECTION("Concurrent requests for one URL share a transfer")
+    {
+        HTTPClientTest::LatencyServer server(250);
+        REQUIRE(server.ok());
+
+        HTTPClient::AsyncStats before = HTTPClient::getAsyncStats();
+
+        std::vector<Future<HTTPResponse>> results;
+        for (unsigned i = 0; i < 16; ++i)
+            results.push_back(HTTPClient::getAsync(HTTPRequest(server.url("/tile"))));
+
+        for (auto& result : results)
+        {
+            const HTTPResponse& response = result.join();
+            REQUIRE(response.isOK());
+            REQUIRE(response.getPartAsString(0) == "/tile");
+        }
+
+        REQUIRE(server.requests == 1);
+        REQUIRE(HTTPClient::getAsyncStats().coalesced - before.coalesced == 15u);
+    }
+
+    SECTION("Transfers to one host respect the connection limit")
+    {
+        unsigned maxPerHost = HTTPClient::getMaxConnectionsPerHost();
+        HTTPClient::setMaxConnectionsPerHost(2);
+
+        HTTPClientTest::LatencyServer server(100);
+        REQUIRE(server.ok());
+
+        std::vector<Future<HTTPResponse>> results;
+        for (unsigned i = 0; i < 8; ++i)
+            results.push_back(HTTPClient::getAsync(HTTPRequest(server.url("/tile/" + std::to_string(i)))));
+
+        for (unsigned i = 0; i < 8; ++i)
+        {
+            const HTTPResponse& response = results[i].join();
+            REQUIRE(response.isOK());
+            REQUIRE(response.getPartAsString(0) == "/tile/" + std::to_string(i));
+        }
+
+        HTTPClient::setMaxConnectionsPerHost(maxPerHost);
+
+        REQUIRE(server.requests == 8);
+        REQUIRE(server.peak <= 2);
+
+        // queued transfers reuse the open connections
+        REQUIRE(server.connections <= 2);
+    }
+
+    SECTION("Blocking get() goes through the engine when enabled")
+    {
+        HTTPClientTest::LatencyServer server(250);
+        REQUIRE(server.ok());
+
+        HTTPClient::setUseAsyncEngine(true);
+
+        std::atomic_int good(0);
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < 8; ++i)
+        {
+            threads.emplace_back([&]()
+            {
+                HTTPResponse response = HTTPClient::get(server.url("/shared"));
+                if (response.isOK() && response.getPartAsString(0) == "/shared")
+                    ++good;
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+
+        HTTPClient::setUseAsyncEngine(false);
+
+        REQUIRE(good == 8);
+        REQUIRE(server.requests == 1);
+    }
+
+    SECTION("Canceling the progress callback withdraws a request")
+    {
+        HTTPClientTest::LatencyServer server(500);
+        REQUIRE(server.ok());
+
+        osg::ref_ptr<ProgressCallback> progress = new ProgressCallback();
+        Future<HTTPResponse> result = HTTPClient::getAsync(HTTPRequest(server.url("/slow")), 0L, progress.get());
+        progress->cancel();
+
+        const HTTPResponse& response = result.join();
+        REQUIRE(result.isAvailable());
+        REQUIRE(response.isCanceled());
+    }
+}
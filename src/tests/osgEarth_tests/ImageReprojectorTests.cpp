@@ -0,0 +1,172 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/ImageReprojector>
+#include <osgEarth/GDAL>
+#include <cstdlib>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace ImageReprojectorTest
+{
+    // Smooth RGBA gradient, so that resampling differences stay small
+    osg::Image* makeImage(int size)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        for (int t = 0; t < size; ++t)
+        {
+            for (int s = 0; s < size; ++s)
+            {
+                unsigned char* p = image->data(s, t);
+                p[0] = (unsigned char)(255 * s / size);
+                p[1] = (unsigned char)(255 * t / size);
+                p[2] = (unsigned char)(255 * (s + t) / (2 * size));
+                p[3] = 255;
+            }
+        }
+        return image;
+    }
+
+    osg::Image* reprojectWithGDAL(const osg::Image* image, const GeoExtent& from, const GeoExtent& to, int width, int height, bool bilinear)
+    {
+        return GDAL::reprojectImage(
+            image,
+            from.getSRS()->getWKT(), from.xMin(), from.yMin(), from.xMax(), from.yMax(),
+            to.getSRS()->getWKT(), to.xMin(), to.yMin(), to.xMax(), to.yMax(),
+            width, height, bilinear);
+    }
+
+    // Compares the pixels that both images cover (alpha > 0), away from
+    // the edges of the covered area where the two differ in how they
+    // treat the border of the source image.
+    void compare(const osg::Image* a, const osg::Image* b, double& meanError, int& maxError)
+    {
+        REQUIRE(a->s() == b->s());
+        REQUIRE(a->t() == b->t());
+
+        const int border = 2;
+        double sum = 0.0;
+        unsigned count = 0;
+        maxError = 0;
+
+        for (int t = border; t < a->t() - border; ++t)
+        {
+            for (int s = border; s < a->s() - border; ++s)
+            {
+                bool covered = true;
+                for (int dt = -border; dt <= border && covered; ++dt)
+                    for (int ds = -border; ds <= border && covered; ++ds)
+                        covered = a->data(s + ds, t + dt)[3] > 0 && b->data(s + ds, t + dt)[3] > 0;
+                if (!covered)
+                    continue;
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    int e = std::abs((int)a->data(s, t)[k] - (int)b->data(s, t)[k]);
+                    sum += e;
+                    maxError = osg::maximum(maxError, e);
+                }
+                ++count;
+            }
+        }
+
+        REQUIRE(count > 0u);
+        meanError = sum / (3.0 * count);
+    }
+}
+
+TEST_CASE("ImageReprojector matches GDAL")
+{
+    osg::ref_ptr<const SpatialReference> wgs84 = SpatialReference::create("wgs84");
+    osg::ref_ptr<osg::Image> image = ImageReprojectorTest::makeImage(256);
+    GeoExtent from;
+
+    SECTION("Mercator to geographic")
+    {
+        from = GeoExtent(SpatialReference::create("spherical-mercator"), -5009377.085, 0.0, 0.0, 5009377.085);
+    }
+
+    SECTION("UTM to geographic")
+    {
+        from = GeoExtent(SpatialReference::create("+proj=utm +zone=33 +datum=WGS84 +units=m"), 400000.0, 5000000.0, 500000.0, 5100000.0);
+    }
+
+    GeoExtent to = from.transform(wgs84.get());
+    REQUIRE(to.isValid());
+
+    ImageReprojector reprojector;
+
+    for (int bilinear = 0; bilinear < 2; ++bilinear)
+    {
+        osg::ref_ptr<osg::Image> expected = ImageReprojectorTest::reprojectWithGDAL(image.get(), from, to, 256, 256, bilinear != 0);
+        osg::ref_ptr<osg::Image> actual = reprojector.reproject(image.get(), from, to, 256, 256, bilinear != 0);
+        REQUIRE(expected.valid());
+        REQUIRE(actual.valid());
+
+        double meanError;
+        int maxError;
+        ImageReprojectorTest::compare(expected.get(), actual.get(), meanError, maxError);
+        INFO("bilinear=" << bilinear << " mean error=" << meanError << " max error=" << maxError);
+        REQUIRE(meanError < 1.0);
+        REQUIRE(maxError <= 4);
+    }
+
+    // a second tile with the same extent reuses the mesh:
+    REQUIRE(reprojector.getCacheStats()._hitRatio > 0.0f);
+
+    // without a size, both pick about the same resolution as the source:
+    osg::ref_ptr<osg::Image> expected = ImageReprojectorTest::reprojectWithGDAL(image.get(), from, to, 0, 0, true);
+    osg::ref_ptr<osg::Image> actual = reprojector.reproject(image.get(), from, to, 0, 0, true);
+    REQUIRE(expected.valid());
+    REQUIRE(actual.valid());
+    REQUIRE(std::abs(expected->s() - actual->s()) <= 1);
+    REQUIRE(std::abs(expected->t() - actual->t()) <= 1);
+}
+
+TEST_CASE("ImageReprojector interpolation stays within its error bound")
+{
+    osg::ref_ptr<const SpatialReference> wgs84 = SpatialReference::create("wgs84");
+    osg::ref_ptr<osg::Image> image = ImageReprojectorTest::makeImage(256);
+    GeoExtent from(SpatialReference::create("spherical-mercator"), 0.0, 5009377.085, 5009377.085, 10018754.17);
+    GeoExtent to = from.transform(wgs84.get());
+
+    // a zero error bound transforms every pixel:
+    ImageReprojector exact;
+    exact.setMaxError(0.0);
+    REQUIRE(exact.getMesh(image.get(), from, to, 256, 256)->step == 1u);
+
+    ImageReprojector approx;
+    osg::ref_ptr<const ImageReprojector::WarpMesh> mesh = approx.getMesh(image.get(), from, to, 256, 256);
+    REQUIRE(mesh.valid());
+    REQUIRE(mesh->step > 1u);
+
+    // a fraction of a source pixel changes the gradient by at most one level
+    osg::ref_ptr<osg::Image> a = exact.reproject(image.get(), from, to, 256, 256, true);
+    osg::ref_ptr<osg::Image> b = approx.reproject(image.get(), from, to, 256, 256, true);
+    double meanError;
+    int maxError;
+    ImageReprojectorTest::compare(a.get(), b.get(), meanError, maxError);
+    REQUIRE(maxError <= 1);
+}
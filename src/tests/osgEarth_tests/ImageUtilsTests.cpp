@@ -0,0 +1,124 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/ImageUtils>
+
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT 0x140B
+#endif
+
+using namespace osgEarth;
+
+namespace ImageUtilsTest
+{
+    osg::Image* makeImage(int size, GLenum format, GLenum type)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(size, size, 1, format, type);
+        ImageUtils::PixelWriter write(image);
+        for (int t = 0; t < size; ++t)
+            for (int s = 0; s < size; ++s)
+                write(osg::Vec4f((float)s / (float)size, (float)t / (float)size, 0.5f, 1.0f), s, t);
+        return image;
+    }
+}
+
+TEST_CASE("PixelReader row reads match single pixel reads")
+{
+    GLenum formats[3][2] = {
+        { GL_RGBA, GL_UNSIGNED_BYTE },
+        { GL_RED, GL_FLOAT },
+        { GL_RG, GL_HALF_FLOAT } };
+
+    for (auto& f : formats)
+    {
+        osg::ref_ptr<osg::Image> image = ImageUtilsTest::makeImage(37, f[0], f[1]);
+        ImageUtils::PixelReader read(image.get());
+        REQUIRE(ImageUtils::PixelReader::supports(image.get()));
+
+        std::vector<osg::Vec4f> row(image->s());
+        for (int t = 0; t < image->t(); ++t)
+        {
+            read.readRow(row.data(), 0, t, image->s());
+            for (int s = 0; s < image->s(); ++s)
+                REQUIRE(row[s] == read(s, t));
+        }
+    }
+}
+
+TEST_CASE("Mipmaps of odd-sized images cover the last row and column")
+{
+    // 7x5 image that is zero except for its last column and row
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage(7, 5, 1, GL_RGBA, GL_FLOAT);
+    ImageUtils::PixelWriter write(image.get());
+    for (int t = 0; t < 5; ++t)
+        for (int s = 0; s < 7; ++s)
+            write(osg::Vec4f(s == 6 || t == 4 ? 1.0f : 0.0f, 1.0f, 0.0f, 1.0f), s, t);
+
+    osg::ref_ptr<const osg::Image> mipmapped = ImageUtils::mipmapImage(image.get());
+    REQUIRE(mipmapped->getNumMipmapLevels() > 1);
+
+    // level 1 is 3x2; its last column and row each take in three of the source's
+    osg::ref_ptr<osg::Image> level1 = new osg::Image();
+    level1->setImage(3, 2, 1, mipmapped->getInternalTextureFormat(), GL_RGBA, GL_FLOAT,
+        const_cast<unsigned char*>(mipmapped->getMipmapData(1)), osg::Image::NO_DELETE);
+    ImageUtils::PixelReader read(level1.get());
+
+    REQUIRE(read(0, 0).r() == Approx(0.0f));
+    REQUIRE(read(1, 0).r() == Approx(0.0f));
+    REQUIRE(read(2, 0).r() == Approx(2.0f / 6.0f));
+    REQUIRE(read(0, 1).r() == Approx(2.0f / 6.0f));
+    REQUIRE(read(1, 1).r() == Approx(2.0f / 6.0f));
+    REQUIRE(read(2, 1).r() == Approx(5.0f / 9.0f));
+
+    // the weights always add up to one
+    for (int t = 0; t < 2; ++t)
+        for (int s = 0; s < 3; ++s)
+            REQUIRE(read(s, t).g() == Approx(1.0f));
+}
+
+TEST_CASE("PixelWriter row writes round-trip half floats")
+{
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage(4, 1, 1, GL_RG, GL_HALF_FLOAT);
+
+    std::vector<osg::Vec4f> input = {
+        osg::Vec4f(0.0f, 1.0f, 0, 1),
+        osg::Vec4f(-2.5f, 0.25f, 0, 1),
+        osg::Vec4f(1024.0f, -0.125f, 0, 1),
+        osg::Vec4f(65504.0f, 0.5f, 0, 1) };
+
+    ImageUtils::PixelWriter write(image.get());
+    write.writeRow(input.data(), 0, 0, 4);
+
+    ImageUtils::PixelReader read(image.get());
+    std::vector<osg::Vec4f> output(4);
+    read.readRow(output.data(), 0, 0, 4);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        REQUIRE(output[i].r() == input[i].r());
+        REQUIRE(output[i].g() == input[i].g());
+    }
+}
@@ -0,0 +1,174 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/MBTiles>
+#include <osgEarth/Threading>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace osgEarth;
+
+namespace MBTilesTest
+{
+    unsigned char tileValue(const TileKey& key)
+    {
+        return (unsigned char)((key.getLOD()*31 + key.getTileX()*7 + key.getTileY()) % 251);
+    }
+
+    osg::Image* makeTile(const TileKey& key, int size)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        ::memset(image->data(), tileValue(key), image->getTotalSizeInBytes());
+        return image;
+    }
+
+    std::vector<TileKey> getKeys(const Profile* profile, unsigned maxLevel)
+    {
+        std::vector<TileKey> keys;
+        for (unsigned lod = 0; lod <= maxLevel; ++lod)
+        {
+            unsigned cols, rows;
+            profile->getNumTiles(lod, cols, rows);
+            for (unsigned x = 0; x < cols; ++x)
+                for (unsigned y = 0; y < rows; ++y)
+                    keys.push_back(TileKey(lod, x, y, profile));
+        }
+        return keys;
+    }
+
+    bool create(const std::string& filename, const std::vector<TileKey>& keys, int size)
+    {
+        ::remove(filename.c_str());
+
+        osg::ref_ptr<MBTilesImageLayer> layer = new MBTilesImageLayer();
+        layer->setURL(filename);
+        layer->setFormat("png");
+        layer->setProfile(keys.front().getProfile());
+        if (layer->openForWriting().isError())
+            return false;
+
+        for (auto& key : keys)
+        {
+            osg::ref_ptr<osg::Image> image = makeTile(key, size);
+            if (layer->writeImage(key, image.get()).isError())
+                return false;
+        }
+
+        layer->close();
+        return true;
+    }
+
+    // Reads every key from "threads" threads at once and counts the
+    // tiles whose content did not match.
+    void readAll(MBTilesImageLayer* layer, const std::vector<TileKey>& keys, unsigned threads, std::atomic_int& mismatches)
+    {
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t]()
+            {
+                for (unsigned i = t; i < keys.size(); i += threads)
+                {
+                    GeoImage image = layer->createImage(keys[i]);
+                    if (!image.valid() || *image.getImage()->data() != tileValue(keys[i]))
+                        ++mismatches;
+                }
+            });
+        }
+
+        for (auto& w : workers)
+            w.join();
+    }
+}
+
+TEST_CASE("MBTiles concurrent reads")
+{
+    std::string filename = "mbtiles_test.mbtiles";
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+    std::vector<TileKey> keys = MBTilesTest::getKeys(profile.get(), 3);
+
+    REQUIRE(MBTilesTest::create(filename, keys, 16));
+
+    osg::ref_ptr<MBTilesImageLayer> layer = new MBTilesImageLayer();
+    layer->setURL(filename);
+    REQUIRE(layer->open().isOK());
+
+    std::atomic_int mismatches(0);
+    MBTilesTest::readAll(layer.get(), keys, 8, mismatches);
+    REQUIRE(mismatches == 0);
+
+    layer->close();
+    ::remove(filename.c_str());
+}
+
+TEST_CASE("MBTiles close waits for reads in flight")
+{
+    std::string filename = "mbtiles_close_test.mbtiles";
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+    std::vector<TileKey> keys = MBTilesTest::getKeys(profile.get(), 3);
+
+    REQUIRE(MBTilesTest::create(filename, keys, 16));
+
+    MBTiles::Options options;
+    options.url() = URI(filename);
+    osg::ref_ptr<const Profile> openedProfile;
+    DataExtentList dataExtents;
+
+    MBTiles::Driver driver;
+    REQUIRE(driver.open("test", options, false, optional<std::string>(), openedProfile, dataExtents, nullptr).isOK());
+
+    // every read must either find the right tile or fail cleanly:
+    std::atomic_int mismatches(0);
+    std::atomic_int reads(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < 8; ++t)
+    {
+        workers.emplace_back([&, t]()
+        {
+            for (unsigned i = t; i < 4u * keys.size(); i += 8)
+            {
+                const TileKey& key = keys[i % keys.size()];
+                ReadResult r = driver.read(key, nullptr, nullptr);
+                if (r.succeeded() && *r.getImage()->data() != MBTilesTest::tileValue(key))
+                    ++mismatches;
+                ++reads;
+            }
+        });
+    }
+
+    while (reads < 64)
+        std::this_thread::yield();
+    driver.close();
+
+    for (auto& w : workers)
+        w.join();
+
+    REQUIRE(mismatches == 0);
+    REQUIRE(driver.read(keys.front(), nullptr, nullptr).succeeded() == false);
+
+    ::remove(filename.c_str());
+}
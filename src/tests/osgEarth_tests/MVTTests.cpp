@@ -0,0 +1,399 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/MVT>
+#include <osgEarth/Registry>
+#include <osgEarth/Geometry>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef OSGEARTH_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace osgEarth;
+
+namespace MVTTest
+{
+    // Minimal protocol buffers writer for building tiles by hand
+    struct Pbf
+    {
+        std::string buf;
+
+        Pbf& varint(std::uint64_t value)
+        {
+            while (value >= 0x80)
+            {
+                buf.push_back((char)((value & 0x7f) | 0x80));
+                value >>= 7;
+            }
+            buf.push_back((char)value);
+            return *this;
+        }
+
+        Pbf& key(unsigned field, unsigned type)
+        {
+            return varint((field << 3) | type);
+        }
+
+        Pbf& uint(unsigned field, std::uint64_t value)
+        {
+            return key(field, 0).varint(value);
+        }
+
+        Pbf& bytes(unsigned field, const std::string& value)
+        {
+            key(field, 2).varint(value.size());
+            buf += value;
+            return *this;
+        }
+
+        Pbf& fixed64(unsigned field, double value)
+        {
+            key(field, 1);
+            char bytes[8];
+            ::memcpy(bytes, &value, 8); // tests run on little-endian hosts
+            buf.append(bytes, 8);
+            return *this;
+        }
+    };
+
+    std::uint32_t zigzag(int n)
+    {
+        return (std::uint32_t)((n << 1) ^ (n >> 31));
+    }
+
+    std::uint32_t command(unsigned id, unsigned count)
+    {
+        return (count << 3) | id;
+    }
+
+    const unsigned MOVETO = 1, LINETO = 2, CLOSEPATH = 7;
+    const unsigned POINT = 1, LINESTRING = 2, POLYGON = 3;
+
+    // Geometry command stream from absolute tile coordinates
+    struct Commands
+    {
+        Pbf pbf;
+        int x = 0, y = 0;
+
+        Commands& cmd(unsigned id, unsigned count)
+        {
+            pbf.varint(command(id, count));
+            return *this;
+        }
+
+        Commands& to(int nx, int ny)
+        {
+            pbf.varint(zigzag(nx - x)).varint(zigzag(ny - y));
+            x = nx, y = ny;
+            return *this;
+        }
+
+        // A ring of 4 points, closed
+        Commands& ring(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3)
+        {
+            cmd(MOVETO, 1).to(x0, y0);
+            cmd(LINETO, 3).to(x1, y1).to(x2, y2).to(x3, y3);
+            return cmd(CLOSEPATH, 1);
+        }
+    };
+
+    std::string feature(unsigned type, const Commands& geometry, const std::vector<unsigned>& tags = {})
+    {
+        Pbf packed;
+        for (auto t : tags)
+            packed.varint(t);
+
+        Pbf f;
+        if (!tags.empty())
+            f.bytes(2, packed.buf);
+        f.uint(3, type);
+        f.bytes(4, geometry.pbf.buf);
+        return f.buf;
+    }
+
+    std::string stringValue(const std::string& value) { return Pbf().bytes(1, value).buf; }
+    std::string doubleValue(double value) { return Pbf().fixed64(3, value).buf; }
+    std::string intValue(std::int64_t value) { return Pbf().uint(4, (std::uint64_t)value).buf; }
+    std::string boolValue(bool value) { return Pbf().uint(7, value ? 1u : 0u).buf; }
+
+    std::string layer(
+        const std::string& name,
+        const std::vector<std::string>& features,
+        const std::vector<std::string>& keys = {},
+        const std::vector<std::string>& values = {})
+    {
+        Pbf l;
+        l.uint(15, 2u); // version
+        l.bytes(1, name);
+        for (auto& f : features) l.bytes(2, f);
+        for (auto& k : keys) l.bytes(3, k);
+        for (auto& v : values) l.bytes(4, v);
+        l.uint(5, 4096u);
+        return l.buf;
+    }
+
+    std::string tile(const std::vector<std::string>& layers)
+    {
+        Pbf t;
+        for (auto& l : layers)
+            t.bytes(3, l);
+        return t.buf;
+    }
+
+    // A tile with a point, a two-part line and a polygon with a hole
+    // in a "shapes" layer, and a line in a "roads" layer.
+    std::string makeTile()
+    {
+        Commands point;
+        point.cmd(MOVETO, 1).to(2048, 2048);
+
+        Commands lines;
+        lines.cmd(MOVETO, 1).to(0, 0).cmd(LINETO, 1).to(1024, 0);
+        lines.cmd(MOVETO, 1).to(0, 1024).cmd(LINETO, 2).to(1024, 1024).to(1024, 2048);
+
+        // exterior is clockwise on screen (y down), the hole counter-clockwise
+        Commands polygon;
+        polygon.ring(0, 0, 4096, 0, 4096, 4096, 0, 4096);
+        polygon.ring(1024, 1024, 1024, 3072, 3072, 3072, 3072, 1024);
+
+        Commands road;
+        road.cmd(MOVETO, 1).to(0, 0).cmd(LINETO, 1).to(4096, 4096);
+
+        std::vector<std::string> keys = { "name", "Height", "lanes", "open" };
+        std::vector<std::string> values = {
+            stringValue("Main"), doubleValue(12.5), intValue(3), boolValue(true) };
+
+        return tile({
+            layer("shapes", {
+                feature(POINT, point, { 0, 0, 1, 1 }),
+                feature(LINESTRING, lines),
+                feature(POLYGON, polygon) },
+                keys, values),
+            layer("roads", {
+                feature(LINESTRING, road, { 0, 0, 2, 2, 3, 3 }) },
+                keys, values) });
+    }
+
+    TileKey makeKey()
+    {
+        // level 0 tile (0,0) covers [-180,0] x [-90,90]
+        return TileKey(0, 0, 0, Registry::instance()->getGlobalGeodeticProfile());
+    }
+
+    bool read(const std::string& data, FeatureList& features, const MVT::ReadOptions* options = nullptr)
+    {
+        // an exact-size heap copy, so any read past the end is a real overrun
+        std::vector<char> copy(data.begin(), data.end());
+        return MVT::readTile(copy.data(), copy.size(), makeKey(), features, options);
+    }
+
+    Feature* find(FeatureList& features, const std::string& layer, Geometry::Type type)
+    {
+        for (auto& f : features)
+            if (f->getString("mvt_layer") == layer && f->getGeometry()->getType() == type)
+                return f.get();
+        return nullptr;
+    }
+
+    void checkTile(FeatureList& features)
+    {
+        REQUIRE(features.size() == 4u);
+
+        Feature* point = find(features, "shapes", Geometry::TYPE_POINTSET);
+        REQUIRE(point != nullptr);
+        REQUIRE(point->getGeometry()->size() == 1u);
+        REQUIRE((*point->getGeometry())[0].x() == Approx(-90.0));
+        REQUIRE((*point->getGeometry())[0].y() == Approx(0.0));
+        REQUIRE(point->getString("name") == "Main");
+        REQUIRE(point->getDouble("height") == Approx(12.5));
+
+        Feature* lines = find(features, "shapes", Geometry::TYPE_MULTI);
+        REQUIRE(lines != nullptr);
+        MultiGeometry* multi = dynamic_cast<MultiGeometry*>(lines->getGeometry());
+        REQUIRE(multi->getComponents().size() == 2u);
+        REQUIRE(multi->getComponents()[0]->getType() == Geometry::TYPE_LINESTRING);
+        REQUIRE(multi->getComponents()[0]->size() == 2u);
+        REQUIRE(multi->getComponents()[1]->size() == 3u);
+        REQUIRE((*multi->getComponents()[1])[2].x() == Approx(-135.0));
+        REQUIRE((*multi->getComponents()[1])[2].y() == Approx(0.0));
+
+        Feature* polygon = find(features, "shapes", Geometry::TYPE_POLYGON);
+        REQUIRE(polygon != nullptr);
+        Polygon* poly = dynamic_cast<Polygon*>(polygon->getGeometry());
+        REQUIRE(poly->size() == 4u);
+        REQUIRE(poly->getOrientation() == Geometry::ORIENTATION_CCW);
+        REQUIRE(poly->getHoles().size() == 1u);
+        REQUIRE(poly->getHoles()[0]->size() == 4u);
+        REQUIRE(poly->getHoles()[0]->getOrientation() == Geometry::ORIENTATION_CW);
+
+        Feature* road = find(features, "roads", Geometry::TYPE_LINESTRING);
+        REQUIRE(road != nullptr);
+        REQUIRE(road->getString("name") == "Main");
+        REQUIRE(road->getInt("lanes") == 3);
+        REQUIRE(road->getBool("open") == true);
+    }
+
+#ifdef OSGEARTH_HAVE_ZLIB
+    // windowBits 15 writes a zlib stream, 15+16 a gzip stream
+    std::string compress(const std::string& data, int windowBits)
+    {
+        z_stream zs;
+        ::memset(&zs, 0, sizeof(zs));
+        deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY);
+
+        std::string out(deflateBound(&zs, data.size()) + 32u, '\0');
+        zs.next_in = (Bytef*)data.data();
+        zs.avail_in = (uInt)data.size();
+        zs.next_out = (Bytef*)&out[0];
+        zs.avail_out = (uInt)out.size();
+        deflate(&zs, Z_FINISH);
+        out.resize(zs.total_out);
+        deflateEnd(&zs);
+        return out;
+    }
+#endif
+}
+
+using namespace MVTTest;
+
+TEST_CASE("MVT decodes points, lines and polygons")
+{
+    std::string data = makeTile();
+    FeatureList features;
+
+    SECTION("Raw")
+    {
+        REQUIRE(read(data, features));
+    }
+
+#ifdef OSGEARTH_HAVE_ZLIB
+    SECTION("Zlib")
+    {
+        REQUIRE(read(compress(data, 15), features));
+    }
+
+    SECTION("Gzip")
+    {
+        REQUIRE(read(compress(data, 15 + 16), features));
+    }
+#endif
+
+    checkTile(features);
+}
+
+TEST_CASE("MVT read options filter layers and attributes")
+{
+    std::string data = makeTile();
+    FeatureList features;
+    MVT::ReadOptions options;
+
+    SECTION("Layers")
+    {
+        options.layers.insert("roads");
+        REQUIRE(read(data, features, &options));
+        REQUIRE(features.size() == 1u);
+        REQUIRE(features.front()->getString("mvt_layer") == "roads");
+        REQUIRE(features.front()->hasAttr("lanes"));
+    }
+
+    SECTION("Attributes")
+    {
+        // matched in lower case against the tile's keys
+        options.attributes.insert("height");
+        REQUIRE(read(data, features, &options));
+        REQUIRE(features.size() == 4u);
+
+        Feature* point = find(features, "shapes", Geometry::TYPE_POINTSET);
+        REQUIRE(point != nullptr);
+        REQUIRE(point->getDouble("height") == Approx(12.5));
+        REQUIRE(point->hasAttr("name") == false);
+
+        Feature* road = find(features, "roads", Geometry::TYPE_LINESTRING);
+        REQUIRE(road != nullptr);
+        REQUIRE(road->hasAttr("lanes") == false);
+        REQUIRE(road->getString("mvt_layer") == "roads");
+    }
+}
+
+TEST_CASE("MVT rejects malformed tiles")
+{
+    FeatureList features;
+
+    SECTION("Truncated varint")
+    {
+        REQUIRE(read(std::string("\x1a\x80", 2), features) == false);
+        REQUIRE(features.empty());
+    }
+
+    SECTION("Varint longer than 10 bytes")
+    {
+        REQUIRE(read(std::string(12, '\xff'), features) == false);
+        REQUIRE(features.empty());
+    }
+
+    SECTION("Length past the end")
+    {
+        Pbf pbf;
+        pbf.key(3, 2).varint(1000u);
+        pbf.buf += "short";
+        REQUIRE(read(pbf.buf, features) == false);
+        REQUIRE(features.empty());
+    }
+
+    SECTION("Field number zero")
+    {
+        REQUIRE(read(std::string("\x02\x00", 2), features) == false);
+    }
+
+    SECTION("Every truncation of a valid tile")
+    {
+        // Each prefix either fails cleanly or decodes a subset
+        std::string data = makeTile();
+        for (std::size_t length = 0; length < data.size(); ++length)
+        {
+            FeatureList partial;
+            if (read(data.substr(0, length), partial) == false)
+            {
+                REQUIRE(partial.empty());
+            }
+            else
+            {
+                REQUIRE(partial.size() <= 4u);
+            }
+        }
+    }
+
+    SECTION("Tags out of range")
+    {
+        Commands point;
+        point.cmd(MOVETO, 1).to(10, 10);
+        std::string data = tile({ layer("bad", { feature(POINT, point, { 7, 9 }) }, { "name" }, { stringValue("x") }) });
+        REQUIRE(read(data, features));
+        REQUIRE(features.size() == 1u);
+        REQUIRE(features.front()->hasAttr("name") == false);
+    }
+}
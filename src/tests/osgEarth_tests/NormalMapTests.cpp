@@ -0,0 +1,131 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/Elevation>
+#include <cfloat>
+#include <vector>
+
+using namespace osgEarth;
+
+namespace NormalMapTest
+{
+    const int size = ELEVATION_TILE_SIZE;
+    const double spacing = 30.0; // meters
+
+    // Rolling terrain, defined everywhere so neighboring tiles agree
+    float terrain(int x, int y)
+    {
+        return (float)(200.0*sin(0.013*x) * cos(0.021*y) + 35.0*sin(0.11*(x + y)));
+    }
+
+    // Heights for the tile at (tileX, tileY) with its one-texel apron.
+    // Tiles share their edge texels, like elevation tiles do.
+    std::vector<float> makeHeights(int tileX, int tileY)
+    {
+        std::vector<float> heights((size + 2)*(size + 2));
+        for (int t = 0; t < size + 2; ++t)
+            for (int s = 0; s < size + 2; ++s)
+                heights[t*(size + 2) + s] = terrain(tileX*(size - 1) + s - 1, tileY*(size - 1) + t - 1);
+        return heights;
+    }
+
+    std::vector<unsigned char> makeNormals(const std::vector<float>& heights, const float* resolutions =nullptr)
+    {
+        std::vector<double> dx(size, spacing);
+        std::vector<unsigned char> normals(2 * size*size);
+        NormalMapGenerator::createNormals(&heights[0], size, size, &dx[0], spacing, resolutions, &normals[0], nullptr);
+        return normals;
+    }
+
+    osg::Vec3 unpack(const std::vector<unsigned char>& normals, int s, int t)
+    {
+        const unsigned char* p = &normals[2 * (t*size + s)];
+        osg::Vec3 normal;
+        NormalMapGenerator::unpack(osg::Vec4(p[0] / 255.0f, p[1] / 255.0f, 0.0f, 1.0f), normal);
+        return normal;
+    }
+}
+
+TEST_CASE("NormalMapGenerator computes normals from heights")
+{
+    std::vector<float> heights = NormalMapTest::makeHeights(0, 0);
+    const int size = NormalMapTest::size;
+    const int stride = size + 2;
+
+    SECTION("Normals match the cross product of the central differences")
+    {
+        std::vector<unsigned char> normals = NormalMapTest::makeNormals(heights);
+
+        for (int t = 0; t < size; t += 7)
+        {
+            for (int s = 0; s < size; s += 7)
+            {
+                const float* h = &heights[(t + 1)*stride + s + 1];
+                osg::Vec3 a(2.0 * NormalMapTest::spacing, 0.0, h[1] - h[-1]);
+                osg::Vec3 b(0.0, 2.0 * NormalMapTest::spacing, h[stride] - h[-stride]);
+                osg::Vec3 expected = a ^ b;
+                expected.normalize();
+
+                // 8-bit octahedral packing is good to about a degree:
+                REQUIRE(NormalMapTest::unpack(normals, s, t) * expected > cos(osg::DegreesToRadians(1.5)));
+            }
+        }
+    }
+
+    SECTION("Texels without data get a vertical normal")
+    {
+        heights[(10 + 1)*stride + 20 + 1 + 1] = NO_DATA_VALUE; // east of (20,10)
+        std::vector<float> resolutions(size*size, 1.0f);
+        resolutions[100 * size + 100] = FLT_MAX;
+
+        std::vector<unsigned char> normals = NormalMapTest::makeNormals(heights, &resolutions[0]);
+
+        osg::Vec4 packed;
+        NormalMapGenerator::pack(osg::Vec3(0, 0, 1), packed);
+        const unsigned char x = (unsigned char)(packed.x()*255.0f), y = (unsigned char)(packed.y()*255.0f);
+        REQUIRE(normals[2 * (10 * size + 20) + 0] == x);
+        REQUIRE(normals[2 * (10 * size + 20) + 1] == y);
+        REQUIRE(normals[2 * (100 * size + 100) + 0] == x);
+        REQUIRE(normals[2 * (100 * size + 100) + 1] == y);
+    }
+}
+
+TEST_CASE("NormalMapGenerator normals match across tile edges")
+{
+    const int size = NormalMapTest::size;
+
+    std::vector<unsigned char> tile = NormalMapTest::makeNormals(NormalMapTest::makeHeights(0, 0));
+    std::vector<unsigned char> east = NormalMapTest::makeNormals(NormalMapTest::makeHeights(1, 0));
+    std::vector<unsigned char> north = NormalMapTest::makeNormals(NormalMapTest::makeHeights(0, 1));
+
+    for (int i = 0; i < size; ++i)
+    {
+        // east edge of the tile = west edge of its east neighbor
+        REQUIRE(tile[2 * (i*size + size - 1)] == east[2 * (i*size)]);
+        REQUIRE(tile[2 * (i*size + size - 1) + 1] == east[2 * (i*size) + 1]);
+
+        // north edge of the tile = south edge of its north neighbor
+        REQUIRE(tile[2 * ((size - 1)*size + i)] == north[2 * i]);
+        REQUIRE(tile[2 * ((size - 1)*size + i) + 1] == north[2 * i + 1]);
+    }
+}
@@ -0,0 +1,434 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarthDrivers/cache_filesystem/PackFile>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+
+namespace PackFileTest
+{
+    const std::size_t PACK_SIZE = 1048576u;
+
+    // An empty folder for a store
+    std::string makeFolder(const std::string& name)
+    {
+        std::string path = osgDB::concatPaths("packfile_test", name);
+        osgDB::makeDirectory(path);
+        for (auto& file : osgDB::getDirectoryContents(path))
+            ::remove(osgDB::concatPaths(path, file).c_str());
+        return path;
+    }
+
+    std::shared_ptr<PackFile> open(const std::string& path)
+    {
+        // no arena, so compaction and index writes happen inline
+        return std::make_shared<PackFile>(path, PACK_SIZE, nullptr);
+    }
+
+    std::string key(int i)
+    {
+        return "tile/" + std::to_string(i);
+    }
+
+    std::string payload(int i, std::size_t size = 100u)
+    {
+        return std::string(size, (char)('a' + i % 26)) + std::to_string(i);
+    }
+
+    bool write(PackFile& store, int i, std::size_t size = 100u)
+    {
+        Config meta;
+        meta.set("key", key(i));
+        return store.write(key(i), PackFile::TYPE_OBJECT, payload(i, size), meta);
+    }
+
+    // Whether record i is there and holds what write() put in it
+    bool check(PackFile& store, int i, std::size_t size = 100u)
+    {
+        PackFile::Record record;
+        if (!store.read(key(i), record))
+            return false;
+
+        return
+            std::string(record.data, record.length) == payload(i, size) &&
+            record.type == PackFile::TYPE_OBJECT &&
+            record.meta.value("key") == key(i);
+    }
+
+    int countFiles(const std::string& path, const std::string& extension)
+    {
+        int count = 0;
+        for (auto& file : osgDB::getDirectoryContents(path))
+            if (osgDB::getFileExtension(file) == extension)
+                ++count;
+        return count;
+    }
+
+    void removeIndex(const std::string& path)
+    {
+        for (auto& file : osgDB::getDirectoryContents(path))
+            if (osgDB::getFileExtension(file) == "idx")
+                ::remove(osgDB::concatPaths(path, file).c_str());
+        ::remove(osgDB::concatPaths(path, "pack.journal").c_str());
+    }
+
+    void copyFile(const std::string& from, const std::string& to)
+    {
+        std::ifstream in(from.c_str(), std::ios::binary);
+        std::ofstream out(to.c_str(), std::ios::binary);
+        out << in.rdbuf();
+    }
+
+    void appendBytes(const std::string& filename, const std::string& bytes)
+    {
+        std::ofstream out(filename.c_str(), std::ios::binary | std::ios::app);
+        out.write(bytes.data(), bytes.size());
+    }
+}
+
+using namespace PackFileTest;
+
+TEST_CASE("PackFile round-trips records")
+{
+    std::string path = makeFolder("roundtrip");
+    std::shared_ptr<PackFile> store = open(path);
+    REQUIRE(store->isOpen());
+
+    for (int i = 0; i < 100; ++i)
+        REQUIRE(write(*store, i, 10u * i));
+
+    for (int i = 0; i < 100; ++i)
+        REQUIRE(check(*store, i, 10u * i));
+
+    PackFile::Record record;
+    REQUIRE(store->read("missing", record) == false);
+    REQUIRE(store->exists("missing") == false);
+
+    SECTION("Overwriting a record replaces it")
+    {
+        REQUIRE(write(*store, 7, 5000u));
+        REQUIRE(check(*store, 7, 5000u));
+    }
+
+    SECTION("Records survive a reopen")
+    {
+        store = nullptr;
+        store = open(path);
+        for (int i = 0; i < 100; ++i)
+            REQUIRE(check(*store, i, 10u * i));
+    }
+}
+
+TEST_CASE("PackFile removes records with tombstones")
+{
+    std::string path = makeFolder("remove");
+    std::shared_ptr<PackFile> store = open(path);
+
+    REQUIRE(write(*store, 1));
+    REQUIRE(write(*store, 2));
+    REQUIRE(store->remove(key(1)));
+
+    REQUIRE(store->exists(key(1)) == false);
+    REQUIRE(check(*store, 1) == false);
+    REQUIRE(store->remove(key(1)) == false);
+    REQUIRE(check(*store, 2));
+
+    SECTION("A removal survives a reopen")
+    {
+        store = nullptr;
+        store = open(path);
+        REQUIRE(store->exists(key(1)) == false);
+        REQUIRE(check(*store, 2));
+    }
+
+    SECTION("A removal survives rebuilding the index from the packs")
+    {
+        store = nullptr;
+        removeIndex(path);
+        store = open(path);
+        REQUIRE(store->exists(key(1)) == false);
+        REQUIRE(check(*store, 2));
+    }
+
+    SECTION("A removed key can be written again")
+    {
+        REQUIRE(write(*store, 1));
+        store = nullptr;
+        removeIndex(path);
+        store = open(path);
+        REQUIRE(check(*store, 1));
+    }
+}
+
+TEST_CASE("PackFile keeps tombstones while older packs hold the key")
+{
+    std::string path = makeFolder("remove_compact");
+    std::shared_ptr<PackFile> store = open(path);
+
+    // fill the first pack, then remove one of its records; the
+    // tombstone goes in the second pack
+    for (int i = 0; i < 16; ++i)
+        REQUIRE(write(*store, i, 65536u));
+    REQUIRE(osgDB::fileExists(osgDB::concatPaths(path, "pack_00001.dat")));
+    REQUIRE(store->remove(key(0)));
+
+    // fill the second pack and then overwrite all of it, so it is compacted
+    for (int i = 100; i < 116; ++i)
+        REQUIRE(write(*store, i, 65536u));
+    for (int i = 100; i < 116; ++i)
+        REQUIRE(write(*store, i, 8u));
+
+    REQUIRE(osgDB::fileExists(osgDB::concatPaths(path, "pack_00001.dat")) == false);
+    REQUIRE(osgDB::fileExists(osgDB::concatPaths(path, "pack_00000.dat")));
+    REQUIRE(store->exists(key(0)) == false);
+    store = nullptr;
+
+    SECTION("Reopen from the index")
+    {
+        store = open(path);
+    }
+
+    SECTION("Reopen from the packs alone")
+    {
+        removeIndex(path);
+        store = open(path);
+    }
+
+    REQUIRE(store->exists(key(0)) == false);
+    for (int i = 1; i < 16; ++i)
+        REQUIRE(check(*store, i, 65536u));
+
+    // the tombstone is still needed after a second reopen:
+    store = nullptr;
+    removeIndex(path);
+    store = open(path);
+    REQUIRE(store->exists(key(0)) == false);
+}
+
+TEST_CASE("PackFile keeps touched timestamps")
+{
+    std::string path = makeFolder("touch");
+    std::string crashed = makeFolder("touch_crashed");
+
+    std::shared_ptr<PackFile> store = open(path);
+    REQUIRE(write(*store, 1));
+    REQUIRE(write(*store, 2));
+
+    PackFile::Record record;
+    REQUIRE(store->read(key(1), record));
+    TimeStamp written = record.timestamp;
+
+    // timestamps have a resolution of one second
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    REQUIRE(store->touch(key(1)));
+    REQUIRE(store->read(key(1), record));
+    TimeStamp touched = record.timestamp;
+    REQUIRE(touched > written);
+
+    SECTION("After closing")
+    {
+        store = nullptr;
+        store = open(path);
+    }
+
+    SECTION("After a crash, before any index was written")
+    {
+        for (auto& file : osgDB::getDirectoryContents(path))
+        {
+            std::string ext = osgDB::getFileExtension(file);
+            if (ext == "dat" || ext == "journal")
+                copyFile(osgDB::concatPaths(path, file), osgDB::concatPaths(crashed, file));
+        }
+        store = nullptr;
+        store = open(crashed);
+    }
+
+    REQUIRE(store->read(key(1), record));
+    REQUIRE(record.timestamp == touched);
+    REQUIRE(store->read(key(2), record));
+    REQUIRE(record.timestamp == written);
+}
+
+TEST_CASE("PackFile recovers its index from the packs")
+{
+    std::string path = makeFolder("recover");
+    {
+        std::shared_ptr<PackFile> store = open(path);
+        for (int i = 0; i < 200; ++i)
+            REQUIRE(write(*store, i, 10000u));
+    }
+    REQUIRE(countFiles(path, "dat") > 1);
+
+    SECTION("Missing index")
+    {
+        removeIndex(path);
+    }
+
+    SECTION("Damaged index")
+    {
+        for (auto& file : osgDB::getDirectoryContents(path))
+            if (osgDB::getFileExtension(file) == "idx")
+                appendBytes(osgDB::concatPaths(path, file), "garbage");
+    }
+
+    std::shared_ptr<PackFile> store = open(path);
+    for (int i = 0; i < 200; ++i)
+        REQUIRE(check(*store, i, 10000u));
+    REQUIRE(countFiles(path, "idx") == 1);
+}
+
+TEST_CASE("PackFile replays its journal after a torn write")
+{
+    std::string path = makeFolder("journal");
+    std::string crashed = makeFolder("journal_crashed");
+
+    // Snapshot the folder of a live store, as if the process died right
+    // after writing record 49, halfway through appending one more record
+    // and its journal entry.
+    std::shared_ptr<PackFile> store = open(path);
+    for (int i = 0; i < 25; ++i)
+        REQUIRE(write(*store, i));
+    store->flush();
+    for (int i = 25; i < 50; ++i)
+        REQUIRE(write(*store, i));
+
+    for (auto& file : osgDB::getDirectoryContents(path))
+    {
+        std::string ext = osgDB::getFileExtension(file);
+        if (ext == "dat" || ext == "idx" || ext == "journal")
+            copyFile(osgDB::concatPaths(path, file), osgDB::concatPaths(crashed, file));
+    }
+    store = nullptr;
+
+    appendBytes(osgDB::concatPaths(crashed, "pack.journal"), std::string(7, '\x01'));
+    appendBytes(osgDB::concatPaths(crashed, "pack_00000.dat"), "OEPR\x01\x02\x03");
+
+    store = open(crashed);
+    for (int i = 0; i < 50; ++i)
+        REQUIRE(check(*store, i));
+
+    // new writes must not land behind the torn record or journal entry:
+    for (int i = 50; i < 100; ++i)
+        REQUIRE(write(*store, i));
+    store = nullptr;
+
+    SECTION("Reopen from the journal")
+    {
+        store = open(crashed);
+    }
+
+    SECTION("Reopen from the packs alone")
+    {
+        removeIndex(crashed);
+        store = open(crashed);
+    }
+
+    for (int i = 0; i < 100; ++i)
+        REQUIRE(check(*store, i));
+}
+
+TEST_CASE("PackFile compacts packs with dead space")
+{
+    std::string path = makeFolder("compact");
+    std::shared_ptr<PackFile> store = open(path);
+
+    // about 16 records per pack:
+    for (int i = 0; i < 40; ++i)
+        REQUIRE(write(*store, i, 65536u));
+    REQUIRE(osgDB::fileExists(osgDB::concatPaths(path, "pack_00000.dat")));
+
+    // overwriting most of the first pack moves the rest out of it:
+    for (int i = 0; i < 12; ++i)
+        REQUIRE(write(*store, i, 32768u));
+
+    REQUIRE(osgDB::fileExists(osgDB::concatPaths(path, "pack_00000.dat")) == false);
+
+    for (int i = 0; i < 40; ++i)
+        REQUIRE(check(*store, i, i < 12 ? 32768u : 65536u));
+
+    store = nullptr;
+    store = open(path);
+    for (int i = 0; i < 40; ++i)
+        REQUIRE(check(*store, i, i < 12 ? 32768u : 65536u));
+}
+
+TEST_CASE("PackFile merges index runs")
+{
+    std::string path = makeFolder("merge");
+    std::shared_ptr<PackFile> store = open(path);
+
+    // enough changes to fill the in-memory overlay twice:
+    const int count = 140000;
+    for (int i = 0; i < count; ++i)
+        REQUIRE(write(*store, i, 8u));
+
+    // remove records that are already in a run:
+    for (int i = 0; i < 100; ++i)
+        REQUIRE(store->remove(key(i)));
+
+    store = nullptr;
+    store = open(path);
+
+    int missing = 0;
+    for (int i = 100; i < count; ++i)
+        if (!check(*store, i, 8u))
+            ++missing;
+    REQUIRE(missing == 0);
+
+    for (int i = 0; i < 100; ++i)
+        REQUIRE(store->exists(key(i)) == false);
+
+    // merging keeps the number of runs small:
+    REQUIRE(countFiles(path, "idx") <= 2);
+}
+
+TEST_CASE("PackFile keeps out of a bin another store holds")
+{
+    std::string path = makeFolder("lock");
+    std::shared_ptr<PackFile> owner = open(path);
+    REQUIRE(owner->isOpen());
+    REQUIRE(write(*owner, 1));
+
+    std::shared_ptr<PackFile> other = open(path);
+    REQUIRE(other->isOpen() == false);
+    REQUIRE(write(*other, 2) == false);
+    REQUIRE(other->exists(key(1)) == false);
+    REQUIRE(other->clear() == false);
+    other = nullptr;
+
+    REQUIRE(check(*owner, 1));
+
+    // the bin opens again once the owner lets go:
+    owner = nullptr;
+    other = open(path);
+    REQUIRE(other->isOpen());
+    REQUIRE(check(*other, 1));
+}
@@ -0,0 +1,135 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/PackedRTree>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace PackedRTreeTest
+{
+    // Tile-sized boxes scattered over the globe, like a mosaic index
+    std::vector<PackedRTree::Box> makeBoxes(unsigned count, double size, unsigned seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> lon(-180.0, 180.0 - size);
+        std::uniform_real_distribution<double> lat(-90.0, 90.0 - size);
+        std::vector<PackedRTree::Box> boxes(count);
+        for (auto& box : boxes)
+        {
+            box.xmin = lon(rng);
+            box.ymin = lat(rng);
+            box.xmax = box.xmin + size;
+            box.ymax = box.ymin + size;
+        }
+        return boxes;
+    }
+
+    std::vector<unsigned> bruteForce(const std::vector<PackedRTree::Box>& boxes, const PackedRTree::Box& query)
+    {
+        std::vector<unsigned> hits;
+        for (unsigned i = 0; i < boxes.size(); ++i)
+        {
+            const PackedRTree::Box& b = boxes[i];
+            if (b.xmin <= query.xmax && b.xmax >= query.xmin && b.ymin <= query.ymax && b.ymax >= query.ymin)
+                hits.push_back(i);
+        }
+        return hits;
+    }
+
+    std::vector<unsigned> search(const PackedRTree& tree, const PackedRTree::Box& query)
+    {
+        std::vector<unsigned> hits;
+        tree.search(query, hits);
+        std::sort(hits.begin(), hits.end());
+        return hits;
+    }
+}
+
+TEST_CASE("PackedRTree finds the intersecting boxes")
+{
+    for (unsigned count : { 0u, 1u, 16u, 17u, 5000u })
+    {
+        std::vector<PackedRTree::Box> boxes = PackedRTreeTest::makeBoxes(count, 1.0, count);
+        PackedRTree tree;
+        tree.build(boxes);
+        REQUIRE(tree.getNumItems() == count);
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            REQUIRE(tree.getItemBox(i).xmin == boxes[i].xmin);
+        }
+
+        std::vector<PackedRTree::Box> queries = PackedRTreeTest::makeBoxes(100, 5.0, 99);
+        for (auto& query : queries)
+        {
+            REQUIRE(PackedRTreeTest::search(tree, query) == PackedRTreeTest::bruteForce(boxes, query));
+        }
+    }
+}
+
+TEST_CASE("PackedRTree attaches to a serialized tree")
+{
+    std::vector<PackedRTree::Box> boxes = PackedRTreeTest::makeBoxes(1000, 1.0, 7);
+    PackedRTree tree;
+    tree.build(boxes, 8u);
+
+    std::ostringstream out;
+    tree.write(out);
+    std::string bytes = out.str();
+    REQUIRE(bytes.size() == tree.getSerializedSize());
+
+    // attach() needs 8-byte alignment, as a memory-mapped file would have
+    std::vector<double> buffer(bytes.size() / sizeof(double) + 1u);
+    ::memcpy(buffer.data(), bytes.data(), bytes.size());
+
+    PackedRTree attached;
+    REQUIRE(attached.attach(buffer.data(), bytes.size()));
+    REQUIRE(attached.getNumItems() == 1000u);
+
+    std::vector<PackedRTree::Box> queries = PackedRTreeTest::makeBoxes(100, 5.0, 99);
+    for (auto& query : queries)
+    {
+        REQUIRE(PackedRTreeTest::search(attached, query) == PackedRTreeTest::bruteForce(boxes, query));
+    }
+
+    SECTION("Truncated data is rejected")
+    {
+        PackedRTree truncated;
+        REQUIRE_FALSE(truncated.attach(buffer.data(), bytes.size() - 1u));
+    }
+
+    SECTION("Damaged indices are rejected")
+    {
+        // point the root at a leaf
+        std::uint32_t* indices = reinterpret_cast<std::uint32_t*>(
+            reinterpret_cast<char*>(buffer.data()) + bytes.size()) - 1;
+        *indices = 0u;
+        PackedRTree damaged;
+        REQUIRE_FALSE(damaged.attach(buffer.data(), bytes.size()));
+    }
+}
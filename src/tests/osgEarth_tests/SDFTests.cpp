@@ -0,0 +1,155 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/SDF>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/SpatialReference>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace SDFTest
+{
+    const float NODATA = 32767.0f;
+
+    GeoExtent getExtent()
+    {
+        return GeoExtent(SpatialReference::get("wgs84"), 0.0, 0.0, 1.0, 1.0);
+    }
+
+    // A raster with data at a pseudo-random scattering of pixels
+    GeoImage makeRaster(int size, int density, std::vector<osg::Vec2i>& sites)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        ImageUtils::PixelWriter write(image);
+        write.assign(Color(1, 1, 1, 0));
+
+        std::srand(7);
+        for (int t = 0; t < size; ++t)
+        {
+            for (int s = 0; s < size; ++s)
+            {
+                if (std::rand() % 1000 < density)
+                {
+                    write(Color::Black, s, t);
+                    sites.push_back(osg::Vec2i(s, t));
+                }
+            }
+        }
+        return GeoImage(image, getExtent());
+    }
+
+    int nearestSquared(const std::vector<osg::Vec2i>& sites, int s, int t)
+    {
+        int best = INT_MAX;
+        for (auto& site : sites)
+        {
+            int d = (site.x() - s)*(site.x() - s) + (site.y() - t)*(site.y() - t);
+            best = std::min(best, d);
+        }
+        return best;
+    }
+}
+
+using namespace SDFTest;
+
+TEST_CASE("SDFGenerator computes an exact nearest-neighbor field")
+{
+    const int size = 64;
+    SDFGenerator sdfgen;
+
+    SECTION("Every pixel points to a nearest site")
+    {
+        std::vector<osg::Vec2i> sites;
+        GeoImage raster = makeRaster(size, 5, sites);
+        REQUIRE(sites.size() > 1u);
+
+        GeoImage nnfield;
+        REQUIRE(sdfgen.createNearestNeighborField(raster, false, nnfield, nullptr));
+
+        ImageUtils::PixelReader read(nnfield.getImage());
+        osg::Vec4f nn;
+        int wrong = 0;
+        for (int t = 0; t < size; ++t)
+        {
+            for (int s = 0; s < size; ++s)
+            {
+                read(nn, s, t);
+                int d = (int)((nn.x() - s)*(nn.x() - s) + (nn.y() - t)*(nn.y() - t));
+                if (d != nearestSquared(sites, s, t))
+                    ++wrong;
+            }
+        }
+        REQUIRE(wrong == 0);
+    }
+
+    SECTION("A raster without data leaves the field empty")
+    {
+        std::vector<osg::Vec2i> sites;
+        GeoImage raster = makeRaster(size, 0, sites);
+
+        GeoImage nnfield;
+        REQUIRE(sdfgen.createNearestNeighborField(raster, false, nnfield, nullptr));
+
+        ImageUtils::PixelReader read(nnfield.getImage());
+        osg::Vec4f nn;
+        read(nn, size / 2, size / 2);
+        REQUIRE(nn.x() == NODATA);
+    }
+}
+
+TEST_CASE("SDFGenerator encodes the distance field in one pass")
+{
+    const int size = 64;
+    const float span = 1000.0f, lo = 10.0f, hi = 200.0f;
+
+    SDFGenerator sdfgen;
+    std::vector<osg::Vec2i> sites;
+    GeoImage raster = makeRaster(size, 3, sites);
+
+    GeoImage nnfield;
+    GeoImage sdf = sdfgen.allocateSDF(size, raster.getExtent());
+    REQUIRE(sdfgen.createDistanceField(raster, false, nnfield, sdf, span, lo, hi, nullptr));
+    REQUIRE(nnfield.valid());
+
+    ImageUtils::PixelReader read(sdf.getImage());
+    osg::Vec4f pixel;
+    float worst = 0.0f;
+    for (int t = 0; t < size; ++t)
+    {
+        for (int s = 0; s < size; ++s)
+        {
+            read(pixel, s, t);
+            float d = sqrtf((float)nearestSquared(sites, s, t)) * span / (float)(size - 1);
+            float expected = osg::clampBetween((d - lo) / (hi - lo), 0.0f, 1.0f);
+            worst = std::max(worst, fabsf(pixel.r() - expected));
+        }
+    }
+    REQUIRE(worst <= 1.5f / 255.0f);
+}
@@ -0,0 +1,125 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/ScreenSpaceLayoutImpl>
+#include <osg/Group>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace osgEarth;
+using namespace osgEarth::Internal;
+
+namespace ScreenSpaceLayoutTest
+{
+    const float width = 1920.0f;
+    const float height = 1080.0f;
+
+    // Label-sized boxes scattered over (and a little past) the viewport.
+    // Every few labels share a parent, like the drawables of one PlaceNode.
+    void makeLabels(unsigned count, std::vector<osg::ref_ptr<osg::Node>>& parents, std::vector<RenderLeafBox>& labels)
+    {
+        std::mt19937 gen(count);
+        std::uniform_real_distribution<float> x(-100.0f, width + 100.0f);
+        std::uniform_real_distribution<float> y(-50.0f, height + 50.0f);
+        std::uniform_real_distribution<float> w(20.0f, 160.0f);
+        std::uniform_real_distribution<float> h(10.0f, 30.0f);
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            if (i % 3 == 0)
+                parents.push_back(new osg::Group());
+
+            float x0 = floor(x(gen)), y0 = floor(y(gen));
+            labels.push_back(std::make_pair(
+                parents.back().get(),
+                osg::BoundingBox(x0, y0, 0.0f, x0 + ceil(w(gen)), y0 + ceil(h(gen)), 0.0f)));
+        }
+    }
+
+    // The original occlusion test: each label against every placed label.
+    std::vector<bool> declutterBruteForce(const std::vector<RenderLeafBox>& labels)
+    {
+        std::vector<bool> visible;
+        std::vector<RenderLeafBox> used;
+        for (auto& label : labels)
+        {
+            bool clear = true;
+            for (auto& j : used)
+            {
+                bool isClear =
+                    label.second.xMin() > j.second.xMax() ||
+                    label.second.xMax() < j.second.xMin() ||
+                    label.second.yMin() > j.second.yMax() ||
+                    label.second.yMax() < j.second.yMin();
+
+                if (!isClear && label.first != j.first)
+                {
+                    clear = false;
+                    break;
+                }
+            }
+            if (clear)
+                used.push_back(label);
+            visible.push_back(clear);
+        }
+        return visible;
+    }
+
+    std::vector<bool> declutterGrid(DeclutterGrid& grid, const std::vector<RenderLeafBox>& labels)
+    {
+        std::vector<bool> visible;
+        grid.reset(0.0f, 0.0f, width, height);
+        for (auto& label : labels)
+        {
+            bool clear = !grid.overlaps(label.first, label.second);
+            if (clear)
+                grid.insert(label.first, label.second);
+            visible.push_back(clear);
+        }
+        return visible;
+    }
+}
+
+TEST_CASE("Declutter grid matches the brute-force occlusion test")
+{
+    std::vector<osg::ref_ptr<osg::Node>> parents;
+    std::vector<RenderLeafBox> labels;
+    ScreenSpaceLayoutTest::makeLabels(2000, parents, labels);
+
+    // a box with a non-finite corner (e.g. a point behind the camera)
+    // and one covering the whole screen:
+    float inf = std::numeric_limits<float>::infinity();
+    labels.insert(labels.begin() + 500, std::make_pair(parents[0].get(), osg::BoundingBox(10, 10, 0, inf, 40, 0)));
+    labels.push_back(std::make_pair(parents[1].get(), osg::BoundingBox(-5000, -5000, 0, 5000, 5000, 0)));
+
+    std::vector<bool> expected = ScreenSpaceLayoutTest::declutterBruteForce(labels);
+
+    // reusing the grid across frames must not change the result:
+    DeclutterGrid grid;
+    for (unsigned frame = 0; frame < 3; ++frame)
+    {
+        std::vector<bool> actual = ScreenSpaceLayoutTest::declutterGrid(grid, labels);
+        REQUIRE(actual == expected);
+    }
+}
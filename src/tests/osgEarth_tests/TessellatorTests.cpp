@@ -0,0 +1,215 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/Tessellator>
+#include <osgEarth/Geometry>
+#include <cmath>
+#include <random>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace TessellatorTest
+{
+    // Roughly circular ring with a jagged edge; star-shaped about its
+    // center, so it never crosses itself.
+    void makeRing(Ring* ring, double cx, double cy, double r, int n, double jitter, std::mt19937& rng, bool cw =false)
+    {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        for (int i = 0; i < n; ++i)
+        {
+            double a = 2.0*osg::PI*(double)(cw ? n - i : i) / (double)n;
+            double rr = r * (1.0 - jitter * uniform(rng));
+            ring->push_back(osg::Vec3d(cx + rr * cos(a), cy + rr * sin(a), 0.0));
+        }
+    }
+
+    // L-shaped building footprint
+    Polygon* building()
+    {
+        Polygon* p = new Polygon();
+        p->push_back(osg::Vec3d(0, 0, 0));
+        p->push_back(osg::Vec3d(20, 0, 0));
+        p->push_back(osg::Vec3d(20, 8, 0));
+        p->push_back(osg::Vec3d(8, 8, 0));
+        p->push_back(osg::Vec3d(8, 15, 0));
+        p->push_back(osg::Vec3d(0, 15, 0));
+        return p;
+    }
+
+    Polygon* coastline(int numPoints)
+    {
+        std::mt19937 rng(42);
+        Polygon* p = new Polygon();
+        makeRing(p, 0.0, 0.0, 50000.0, numPoints, 0.3, rng);
+        return p;
+    }
+
+    // Lake with a grid of islands
+    Polygon* lake(int islandsPerSide)
+    {
+        std::mt19937 rng(7);
+        Polygon* p = new Polygon();
+        makeRing(p, 0.0, 0.0, 1000.0 * islandsPerSide, 400, 0.05, rng);
+        double spacing = 1000.0;
+        double start = -0.5 * spacing * (double)(islandsPerSide - 1);
+        for (int i = 0; i < islandsPerSide; ++i)
+        {
+            for (int j = 0; j < islandsPerSide; ++j)
+            {
+                Ring* island = new Ring();
+                makeRing(island, start + i * spacing, start + j * spacing, 300.0, 24, 0.4, rng, true);
+                p->getHoles().push_back(island);
+            }
+        }
+        return p;
+    }
+
+    // Hole that touches the outer ring at a shared vertex
+    Polygon* touchingHole()
+    {
+        Polygon* p = new Polygon();
+        p->push_back(osg::Vec3d(0, 0, 0));
+        p->push_back(osg::Vec3d(10, 0, 0));
+        p->push_back(osg::Vec3d(10, 10, 0));
+        p->push_back(osg::Vec3d(0, 10, 0));
+        p->push_back(osg::Vec3d(0, 5, 0));
+        Ring* hole = new Ring();
+        hole->push_back(osg::Vec3d(0, 5, 0));
+        hole->push_back(osg::Vec3d(3, 7, 0));
+        hole->push_back(osg::Vec3d(3, 3, 0));
+        p->getHoles().push_back(hole);
+        return p;
+    }
+
+    // Points of the polygon in the order the tessellator indexes them
+    std::vector<osg::Vec3d> points(const Polygon* p)
+    {
+        std::vector<osg::Vec3d> result(p->begin(), p->end());
+        for (auto& hole : p->getHoles())
+            result.insert(result.end(), hole->begin(), hole->end());
+        return result;
+    }
+
+    double ringArea(const Ring* ring)
+    {
+        double area = 0.0;
+        for (unsigned i = 0, j = ring->size() - 1; i < ring->size(); j = i++)
+            area += (*ring)[j].x() * (*ring)[i].y() - (*ring)[i].x() * (*ring)[j].y();
+        return fabs(0.5*area);
+    }
+
+    double polygonArea(const Polygon* p)
+    {
+        double area = ringArea(p);
+        for (auto& hole : p->getHoles())
+            area -= ringArea(hole.get());
+        return area;
+    }
+
+    // Checks that the triangles are counter-clockwise and cover exactly
+    // the area of the polygon
+    void checkCoverage(const Polygon* p, const std::vector<uint32_t>& indices)
+    {
+        std::vector<osg::Vec3d> verts = points(p);
+        REQUIRE(indices.size() % 3 == 0);
+
+        double area = 0.0;
+        for (unsigned i = 0; i < indices.size(); i += 3)
+        {
+            REQUIRE(indices[i + 0] < verts.size());
+            REQUIRE(indices[i + 1] < verts.size());
+            REQUIRE(indices[i + 2] < verts.size());
+            const osg::Vec3d& a = verts[indices[i + 0]];
+            const osg::Vec3d& b = verts[indices[i + 1]];
+            const osg::Vec3d& c = verts[indices[i + 2]];
+            double tri = 0.5*((b.x() - a.x())*(c.y() - a.y()) - (b.y() - a.y())*(c.x() - a.x()));
+            REQUIRE(tri >= 0.0);
+            area += tri;
+        }
+
+        double expected = polygonArea(p);
+        REQUIRE(fabs(area - expected) <= 1e-9 * expected);
+    }
+}
+
+TEST_CASE("Tessellator sweep covers the polygon")
+{
+    Tessellator tess;
+    tess.setMethod(Tessellator::METHOD_SWEEP);
+    std::vector<uint32_t> indices;
+
+    SECTION("Building footprint")
+    {
+        osg::ref_ptr<Polygon> p = TessellatorTest::building();
+        REQUIRE(tess.tessellate2D(p.get(), indices));
+        REQUIRE(indices.size() / 3 == p->size() - 2);
+        TessellatorTest::checkCoverage(p.get(), indices);
+    }
+
+    SECTION("Coastline")
+    {
+        osg::ref_ptr<Polygon> p = TessellatorTest::coastline(50000);
+        REQUIRE(tess.tessellate2D(p.get(), indices));
+        REQUIRE(indices.size() / 3 == p->size() - 2);
+        TessellatorTest::checkCoverage(p.get(), indices);
+    }
+
+    SECTION("Lake with islands")
+    {
+        osg::ref_ptr<Polygon> p = TessellatorTest::lake(10);
+        REQUIRE(tess.tessellate2D(p.get(), indices));
+
+        // a polygon with n vertices and h holes has n + 2h - 2 triangles
+        unsigned n = p->getTotalPointCount();
+        unsigned h = p->getHoles().size();
+        REQUIRE(indices.size() / 3 == n + 2 * h - 2);
+        TessellatorTest::checkCoverage(p.get(), indices);
+    }
+
+    SECTION("Hole touching the outer ring")
+    {
+        osg::ref_ptr<Polygon> p = TessellatorTest::touchingHole();
+        REQUIRE(tess.tessellate2D(p.get(), indices));
+        TessellatorTest::checkCoverage(p.get(), indices);
+    }
+}
+
+TEST_CASE("Tessellator falls back on ear clipping")
+{
+    // Self-intersecting ring
+    osg::ref_ptr<Polygon> bowtie = new Polygon();
+    bowtie->push_back(osg::Vec3d(0, 0, 0));
+    bowtie->push_back(osg::Vec3d(2, 2, 0));
+    bowtie->push_back(osg::Vec3d(2, 0, 0));
+    bowtie->push_back(osg::Vec3d(0, 2, 0));
+
+    std::vector<uint32_t> indices;
+    Tessellator tess;
+
+    tess.setMethod(Tessellator::METHOD_SWEEP);
+    REQUIRE(tess.tessellate2D(bowtie.get(), indices) == false);
+
+    tess.setMethod(Tessellator::METHOD_AUTO);
+    REQUIRE(tess.tessellate2D(bowtie.get(), indices) == true);
+}
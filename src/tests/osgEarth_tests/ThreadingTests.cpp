@@ -22,7 +22,9 @@
 
 #include <osgEarth/catch.hpp>
 #include <osgEarth/Threading>
+#include <atomic>
 #include <thread>
+#include <vector>
 
 using namespace osgEarth;
 
@@ -133,4 +135,78 @@ TEST_CASE( "ReadWriteMutex can handle multiple read locks from the same thread w
     REQUIRE(!thread2.isRunning());
     REQUIRE(elapsedTime < maxTimeSeconds);
 }
-#endif
\ No newline at end of file
+#endif
+
+TEST_CASE("JobArena work-stealing scheduler runs every job in a group")
+{
+    JobArena arena("oe.test.ws", 4u, JobArena::THREAD_POOL, JobArena::SCHEDULER_WORK_STEALING);
+    REQUIRE(arena.getScheduler() == JobArena::SCHEDULER_WORK_STEALING);
+
+    std::atomic<int> count(0);
+    std::atomic<int> childCount(0);
+    JobGroup group;
+    Job job(&arena, &group);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        job.setPriority((float)(i % 40) - 4.0f);
+        job.dispatch([i, &count, &childCount, &arena, &group](Cancelable*) {
+            ++count;
+            // jobs dispatched from inside a worker go to its local queue
+            if ((i % 10) == 0)
+            {
+                Job child(&arena, &group);
+                child.dispatch([&childCount](Cancelable*) { ++childCount; });
+            }
+        });
+    }
+
+    group.join();
+    REQUIRE(count == 1000);
+    REQUIRE(childCount == 100);
+}
+
+TEST_CASE("JobArena work-stealing scheduler runs jobs in priority order")
+{
+    // One thread, held up by a first job until the rest are queued
+    JobArena arena("oe.test.ws.order", 1u, JobArena::THREAD_POOL, JobArena::SCHEDULER_WORK_STEALING);
+
+    std::atomic<bool> release(false);
+    std::vector<float> order;
+    std::atomic<float> dynamicPriority(10.0f);
+    JobGroup group;
+    Job job(&arena, &group);
+
+    job.setPriority(1e6f);
+    job.dispatch([&release](Cancelable*) {
+        while (!release)
+            std::this_thread::yield();
+    });
+
+    SECTION("Negative priorities keep their order")
+    {
+        for (float priority : { -1000.0f, -1.0f, -10.0f, -100.0f })
+        {
+            job.setPriority(priority);
+            job.dispatch([&order, priority](Cancelable*) { order.push_back(priority); });
+        }
+        release = true;
+        group.join();
+        REQUIRE(order == std::vector<float>({ -1.0f, -10.0f, -100.0f, -1000.0f }));
+    }
+
+    SECTION("A priority function is re-checked when its job comes up")
+    {
+        Job dynamic(&arena, &group);
+        dynamic.setPriorityFunction([&dynamicPriority]() { return dynamicPriority.load(); });
+        dynamic.dispatch([&order](Cancelable*) { order.push_back(1.0f); });
+
+        job.setPriority(5.0f);
+        job.dispatch([&order](Cancelable*) { order.push_back(5.0f); });
+
+        dynamicPriority = 1.0f;
+        release = true;
+        group.join();
+        REQUIRE(order == std::vector<float>({ 5.0f, 1.0f }));
+    }
+}
@@ -0,0 +1,212 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/TileVisitor>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace TileVisitorTest
+{
+    // Counts the tiles that pass through each stage, and optionally
+    // fails to write one key.
+    struct CountingHandler : public StagedTileHandler
+    {
+        CountingHandler() : _reads(0), _encodes(0), _writes(0), _failWrite(false) { }
+
+        bool readTile(const TileKey& key, osg::ref_ptr<osg::Referenced>& data)
+        {
+            ++_reads;
+            data = new osg::Referenced();
+            return true;
+        }
+
+        bool encodeTile(const TileKey& key, osg::ref_ptr<osg::Referenced>& data)
+        {
+            ++_encodes;
+            return data.valid();
+        }
+
+        bool writeTile(const TileKey& key, osg::ref_ptr<osg::Referenced>& data)
+        {
+            ++_writes;
+            if (_failWrite && key.getLevelOfDetail() == 2u && key.getTileX() == 2u && key.getTileY() == 1u)
+                return false;
+            return true;
+        }
+
+        std::atomic_int _reads, _encodes, _writes;
+        bool _failWrite;
+    };
+
+    // Counts the tiles handled at each level. Like a layer's mayHaveData,
+    // reports no data above level 2, which must not stop the visitor.
+    struct LevelCountingHandler : public TileHandler
+    {
+        LevelCountingHandler() : _counts(8u, 0) { }
+
+        bool handleTile(const TileKey& key, const TileVisitor& tv)
+        {
+            ++_counts[key.getLevelOfDetail()];
+            return true;
+        }
+
+        bool hasData(const TileKey& key) const
+        {
+            return key.getLevelOfDetail() >= 2u;
+        }
+
+        std::vector<int> _counts;
+    };
+
+    // Data everywhere except under the level-1 tile (0,0), which
+    // covers [-180,-90] x [0,90] in the global geodetic profile.
+    void addDataAroundFirstQuadrant(TileVisitor* visitor, const Profile* profile)
+    {
+        const SpatialReference* srs = profile->getSRS();
+        visitor->addDataExtent(GeoExtent(srs, -89.9, -90.0, 180.0, 90.0));
+        visitor->addDataExtent(GeoExtent(srs, -180.0, -90.0, -90.0, -0.1));
+    }
+}
+
+TEST_CASE("ProgressBitmap save and load")
+{
+    std::string filename = "progress_bitmap_test.oepb";
+
+    ProgressBitmap bitmap;
+    bitmap.set(0u, 0u, 0u);
+    bitmap.set(16u, 40000u, 12345u);
+    bitmap.set(16u, 40001u, 12345u);
+    bitmap.set(20u, 1500000u, 700000u);
+    REQUIRE(bitmap.count() == 4u);
+    REQUIRE(bitmap.isSet(16u, 40000u, 12345u));
+    REQUIRE_FALSE(bitmap.isSet(16u, 40000u, 12346u));
+    REQUIRE_FALSE(bitmap.isSet(15u, 40000u, 12345u));
+
+    REQUIRE(bitmap.save(filename));
+
+    ProgressBitmap loaded;
+    REQUIRE(loaded.load(filename));
+    REQUIRE(loaded.count() == 4u);
+    REQUIRE(loaded.isSet(0u, 0u, 0u));
+    REQUIRE(loaded.isSet(16u, 40001u, 12345u));
+    REQUIRE(loaded.isSet(20u, 1500000u, 700000u));
+
+    {
+        std::ofstream out(filename.c_str(), std::ios::out | std::ios::trunc);
+        out << "not a bitmap";
+    }
+    REQUIRE_FALSE(loaded.load(filename));
+    REQUIRE(loaded.count() == 0u);
+
+    ::remove(filename.c_str());
+}
+
+TEST_CASE("PipelinedTileVisitor resumes from a checkpoint")
+{
+    std::string filename = "pipelined_tile_visitor_test.oepb";
+    ::remove(filename.c_str());
+
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+
+    // 2 root tiles to level 3 is 170 tiles; the data extents prune
+    // the 21 tiles under level-1 tile (0,0).
+    const int expected = 170 - 21;
+
+    osg::ref_ptr<TileVisitorTest::CountingHandler> handler = new TileVisitorTest::CountingHandler();
+    handler->_failWrite = true;
+
+    osg::ref_ptr<PipelinedTileVisitor> visitor = new PipelinedTileVisitor(handler.get());
+    TileVisitorTest::addDataAroundFirstQuadrant(visitor.get(), profile.get());
+    visitor->setMaxLevel(3u);
+    visitor->setQueueSize(4u);
+    visitor->setNumThreads(PipelinedTileVisitor::STAGE_WRITE, 2u);
+    visitor->setCheckpointFile(filename);
+    visitor->run(profile.get());
+
+    REQUIRE(handler->_reads == expected);
+    REQUIRE(handler->_encodes == expected);
+    REQUIRE(handler->_writes == expected);
+    REQUIRE(visitor->getStageStats(PipelinedTileVisitor::STAGE_WRITE).tiles == (std::uint64_t)(expected - 1));
+    REQUIRE(visitor->getStageStats(PipelinedTileVisitor::STAGE_WRITE).failed == 1u);
+    REQUIRE(visitor->getProgressBitmap().count() == (std::uint64_t)(expected - 1));
+
+    // A new run picks up only the tile that failed
+    osg::ref_ptr<TileVisitorTest::CountingHandler> resumed = new TileVisitorTest::CountingHandler();
+    visitor = new PipelinedTileVisitor(resumed.get());
+    TileVisitorTest::addDataAroundFirstQuadrant(visitor.get(), profile.get());
+    visitor->setMaxLevel(3u);
+    visitor->setCheckpointFile(filename);
+    visitor->run(profile.get());
+
+    REQUIRE(resumed->_reads == 1);
+    REQUIRE(resumed->_writes == 1);
+    REQUIRE(visitor->getProgressBitmap().count() == (std::uint64_t)expected);
+
+    ::remove(filename.c_str());
+}
+
+TEST_CASE("TileVisitor descends to its min level")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+    osg::ref_ptr<TileVisitorTest::LevelCountingHandler> handler = new TileVisitorTest::LevelCountingHandler();
+
+    osg::ref_ptr<TileVisitor> visitor = new TileVisitor(handler.get());
+
+    SECTION("Visitor min level")
+    {
+        visitor->setMinLevel(2u);
+    }
+
+    SECTION("Data extent min level")
+    {
+        visitor->addDataExtent(DataExtent(profile->getExtent(), 2u));
+    }
+
+    visitor->setMaxLevel(3u);
+    visitor->run(profile.get());
+
+    REQUIRE(handler->_counts[0] == 0);
+    REQUIRE(handler->_counts[1] == 0);
+    REQUIRE(handler->_counts[2] == 32);
+    REQUIRE(handler->_counts[3] == 128);
+}
+
+TEST_CASE("TileVisitor stops below the data extents' max level")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+    osg::ref_ptr<TileVisitorTest::LevelCountingHandler> handler = new TileVisitorTest::LevelCountingHandler();
+
+    osg::ref_ptr<TileVisitor> visitor = new TileVisitor(handler.get());
+    visitor->addDataExtent(DataExtent(profile->getExtent(), 0u, 2u));
+    visitor->setMaxLevel(5u);
+    visitor->run(profile.get());
+
+    REQUIRE(handler->_counts[2] == 32);
+    REQUIRE(handler->_counts[3] == 0);
+    REQUIRE(handler->_counts[4] == 0);
+}
@@ -0,0 +1,100 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/VirtualProgram>
+#include <string>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace VirtualProgramTest
+{
+    osg::ref_ptr<osg::Program> makeProgram(const std::string& name)
+    {
+        osg::ref_ptr<osg::Program> program = new osg::Program();
+        program->setName(name);
+        program->addShader(new osg::Shader(osg::Shader::VERTEX, "void " + name + "(inout vec4 v) { }\n"));
+        return program;
+    }
+}
+
+TEST_CASE("ProgramRepo finds programs by key")
+{
+    osg::ref_ptr<ProgramRepo> repo = new ProgramRepo();
+
+    ProgramKey a = { 1u, 2u, 3u };
+    ProgramKey b = { 1u, 2u, 4u };
+    REQUIRE(ProgramRepo::hash(a) != ProgramRepo::hash(b));
+
+    osg::ref_ptr<osg::Program> programA = VirtualProgramTest::makeProgram("a");
+    osg::ref_ptr<osg::Program> programB = VirtualProgramTest::makeProgram("b");
+
+    SECTION("Lookups return the program added under the key")
+    {
+        REQUIRE_FALSE(repo->use(a, ProgramRepo::hash(a), 1u, 100).valid());
+        repo->add(a, ProgramRepo::hash(a), programA, 1u, 100);
+        REQUIRE(repo->use(a, ProgramRepo::hash(a), 1u, 100) == programA);
+        REQUIRE_FALSE(repo->use(b, ProgramRepo::hash(b), 1u, 100).valid());
+    }
+
+    SECTION("Keys with the same hash resolve to their own programs")
+    {
+        const std::uint64_t collision = 42u;
+        repo->add(a, collision, programA, 1u, 100);
+        repo->add(b, collision, programB, 1u, 100);
+        REQUIRE(repo->use(a, collision, 1u, 100) == programA);
+        REQUIRE(repo->use(b, collision, 1u, 100) == programB);
+    }
+
+    SECTION("Equivalent programs are shared")
+    {
+        osg::ref_ptr<osg::Program> copyOfA = VirtualProgramTest::makeProgram("a");
+        repo->add(a, ProgramRepo::hash(a), programA, 1u, 100);
+        repo->add(b, ProgramRepo::hash(b), copyOfA, 1u, 200);
+        REQUIRE(copyOfA == programA);
+        REQUIRE(repo->getNumPrograms() == 1u);
+
+        // the program stays until its last user lets go
+        repo->release(100, nullptr);
+        REQUIRE(repo->use(b, ProgramRepo::hash(b), 1u, 200) == programA);
+        repo->release(200, nullptr);
+        REQUIRE(repo->getNumPrograms() == 0u);
+    }
+
+    SECTION("Counters cover the last complete frame")
+    {
+        repo->use(a, ProgramRepo::hash(a), 1u, 100);
+        repo->add(a, ProgramRepo::hash(a), programA, 1u, 100);
+        repo->use(a, ProgramRepo::hash(a), 1u, 100);
+        repo->use(a, ProgramRepo::hash(a), 1u, 100);
+
+        // first lookup in frame 2 closes out frame 1
+        repo->use(a, ProgramRepo::hash(a), 2u, 100);
+
+        ProgramRepo::Stats stats = repo->getStats();
+        REQUIRE(stats.frameNumber == 1u);
+        REQUIRE(stats.lookups == 3u);
+        REQUIRE(stats.misses == 1u);
+        REQUIRE(stats.links == 0u);
+    }
+}